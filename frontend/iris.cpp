@@ -300,6 +300,7 @@ void init(iris::instance* iris, int argc, const char* argv[]) {
     renderer_set_scale(iris->ctx, iris->scale);
     renderer_set_aspect_mode(iris->ctx, iris->aspect_mode);
     renderer_set_bilinear(iris->ctx, iris->bilinear);
+    renderer_set_deinterlace_mode(iris->ctx, iris->deinterlace_mode);
     renderer_set_integer_scaling(iris->ctx, iris->integer_scaling);
 
     // Note:
@@ -418,19 +419,36 @@ void update(iris::instance* iris) {
         //     iris->pause = true;
         // }
 
+        // Without breakpoints to check there's no need to stop after
+        // every instruction, run until the end of the frame instead
+        if (iris->breakpoints.empty()) {
+            iris->ps2->iop_batch = PS2_IOP_BATCH;
+
+            ps2_run_frame(iris->ps2);
+
+            return;
+        }
+
         ps2_cycle(iris->ps2);
 
+        bool iop_breakpoints = false;
+
         for (const breakpoint& b : iris->breakpoints) {
             if (b.cpu == BKPT_CPU_EE) {
                 if (iris->ps2->ee->pc == b.addr) {
                     iris->pause = true;
                 }
             } else {
+                iop_breakpoints = true;
+
                 if (iris->ps2->iop->pc == b.addr) {
                     iris->pause = true;
                 }
             }
         }
+
+        // Batched IOP execution would skip over breakpoints
+        iris->ps2->iop_batch = iop_breakpoints ? 1 : PS2_IOP_BATCH;
     } else {
         if (iris->step) {
             ps2_cycle(iris->ps2);
@@ -476,6 +494,11 @@ void update_window(iris::instance* iris) {
     update_title(iris);
     update_time(iris);
 
+    iris->ee_idle_cycles = iris->ps2->ee_idle_cycles - iris->ee_idle_last;
+    iris->iop_idle_cycles = iris->ps2->iop_idle_cycles - iris->iop_idle_last;
+    iris->ee_idle_last = iris->ps2->ee_idle_cycles;
+    iris->iop_idle_last = iris->ps2->iop_idle_cycles;
+
     ImGuiIO& io = ImGui::GetIO();
 
     // Start the Dear ImGui frame
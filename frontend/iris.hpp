@@ -144,6 +144,7 @@ struct instance {
     int fullscreen = 0;
     int aspect_mode = RENDERER_ASPECT_AUTO;
     bool bilinear = true;
+    int deinterlace_mode = RENDERER_DEINTERLACE_WEAVE;
     bool integer_scaling = false;
     float scale = 1.5f;
     int window_mode = 0;
@@ -162,6 +163,16 @@ struct instance {
     bool limit_fps = true;
     float fps_cap = 60.0f;
 
+    bool ee_jit = false;
+    bool vu1_thread = false;
+    bool dma_timed = false;
+
+    // Cycles skipped by idle loop detection during the last frame
+    uint64_t ee_idle_cycles = 0;
+    uint64_t iop_idle_cycles = 0;
+    uint64_t ee_idle_last = 0;
+    uint64_t iop_idle_last = 0;
+
     std::string loaded = "";
 
     std::vector <std::string> ee_log = { "" };
@@ -42,6 +42,9 @@ void print_help(iris::instance* iris) {
         "      --slot2              Specify a path to a memory card file to\n"
         "                             be inserted on slot 2\n"
         "      --snap               Specify a directory for storing screenshots\n"
+        "      --ee-jit             Run the EE on the block recompiler\n"
+        "      --vu1-thread         Run VU1 microprograms on a separate thread\n"
+        "      --dma-timed          Slice GIF and VIF1 DMA transfers at bus speed\n"
         "  -h, --help               Display this help and exit\n"
         "  -v, --version            Output version information and exit\n"
     );
@@ -80,10 +83,16 @@ int parse_toml_settings(iris::instance* iris) {
     auto display = tbl["display"];
     iris->aspect_mode = display["aspect_mode"].value_or(RENDERER_ASPECT_AUTO);
     iris->bilinear = display["bilinear"].value_or(true);
+    iris->deinterlace_mode = display["deinterlace_mode"].value_or(RENDERER_DEINTERLACE_WEAVE);
     iris->integer_scaling = display["integer_scaling"].value_or(false);
     iris->scale = display["scale"].value_or(1.5f);
     iris->renderer_backend = display["renderer"].value_or(RENDERER_SOFTWARE_THREAD);
 
+    auto system = tbl["system"];
+    iris->ee_jit = system["ee_jit"].value_or(false);
+    iris->vu1_thread = system["vu1_thread"].value_or(false);
+    iris->dma_timed = system["dma_timed"].value_or(false);
+
     auto debugger = tbl["debugger"];
     iris->show_ee_control = debugger["show_ee_control"].value_or(false);
     iris->show_ee_state = debugger["show_ee_state"].value_or(false);
@@ -110,6 +119,7 @@ int parse_toml_settings(iris::instance* iris) {
 
     renderer_set_aspect_mode(iris->ctx, iris->aspect_mode);
     renderer_set_bilinear(iris->ctx, iris->bilinear);
+    renderer_set_deinterlace_mode(iris->ctx, iris->deinterlace_mode);
     renderer_set_integer_scaling(iris->ctx, iris->integer_scaling);
     renderer_set_scale(iris->ctx, iris->scale);
 
@@ -168,11 +178,21 @@ void parse_cli_settings(iris::instance* iris, int argc, const char* argv[]) {
             iris->mcd1_path = argv[i+1];
 
             ++i;
+        } else if (a == "--ee-jit") {
+            iris->ee_jit = true;
+        } else if (a == "--vu1-thread") {
+            iris->vu1_thread = true;
+        } else if (a == "--dma-timed") {
+            iris->dma_timed = true;
         } else {
             iris->disc_path = argv[i];
         }
     }
 
+    ps2_set_ee_jit(iris->ps2, iris->ee_jit);
+    ps2_set_vu1_thread(iris->ps2, iris->vu1_thread);
+    ps2_set_dma_timed(iris->ps2, iris->dma_timed);
+
     if (bios_path.size()) {
         ps2_load_bios(iris->ps2, bios_path.c_str());
     } else {
@@ -275,8 +295,14 @@ void close_settings(iris::instance* iris) {
             { "integer_scaling", iris->integer_scaling },
             { "fullscreen", iris->fullscreen },
             { "bilinear", iris->bilinear },
+            { "deinterlace_mode", iris->deinterlace_mode },
             { "renderer", iris->renderer_backend }
         } },
+        { "system", toml::table {
+            { "ee_jit", iris->ee_jit },
+            { "vu1_thread", iris->vu1_thread },
+            { "dma_timed", iris->dma_timed }
+        } },
         { "paths", toml::table {
             { "bios_path", iris->bios_path },
             { "rom1_path", iris->rom1_path },
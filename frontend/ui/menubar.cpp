@@ -24,7 +24,8 @@ const char* aspect_mode_names[] = {
 const char* renderer_names[] = {
     "Null",
     "Software",
-    "Software (Threaded)"
+    "Software (Threaded)",
+    "Software (Multithreaded)"
 };
 
 const char* fullscreen_names[] = {
@@ -280,7 +281,7 @@ void show_main_menubar(iris::instance* iris) {
         if (BeginMenu("Settings")) {
             if (BeginMenu(ICON_MS_MONITOR " Display")) {
                 if (BeginMenu(ICON_MS_BRUSH " Renderer")) {
-                    for (int i = 0; i < 3; i++) {
+                    for (int i = 0; i < 4; i++) {
                         if (Selectable(renderer_names[i], i == iris->renderer_backend)) {
                             iris->renderer_backend = i;
 
@@ -288,6 +289,7 @@ void show_main_menubar(iris::instance* iris) {
                             renderer_set_scale(iris->ctx, iris->scale);
                             renderer_set_aspect_mode(iris->ctx, iris->aspect_mode);
                             renderer_set_bilinear(iris->ctx, iris->bilinear);
+                            renderer_set_deinterlace_mode(iris->ctx, iris->deinterlace_mode);
                             renderer_set_integer_scaling(iris->ctx, iris->integer_scaling);
                             renderer_set_size(iris->ctx, 0, 0);
                         }
@@ -16,7 +16,8 @@ int selected_settings = 0;
 const char* settings_renderer_names[] = {
     "Null",
     "Software",
-    "Software (Threaded)"
+    "Software (Threaded)",
+    "Software (Multithreaded)"
 };
 
 const char* settings_aspect_mode_names[] = {
@@ -29,6 +30,11 @@ const char* settings_aspect_mode_names[] = {
     "Auto"
 };
 
+const char* settings_deinterlace_names[] = {
+    "Weave",
+    "Bob"
+};
+
 const char* settings_fullscreen_names[] = {
     "Windowed",
     "Fullscreen (Desktop)",
@@ -61,7 +67,7 @@ void show_graphics_settings(iris::instance* iris) {
     Text("Renderer");
 
     if (BeginCombo("##renderer", renderer_get_name(iris->ctx), ImGuiComboFlags_HeightSmall)) {
-        for (int i = 0; i < 3; i++) {
+        for (int i = 0; i < 4; i++) {
             if (Selectable(settings_renderer_names[i], i == iris->renderer_backend)) {
                 iris->renderer_backend = i;
 
@@ -69,6 +75,7 @@ void show_graphics_settings(iris::instance* iris) {
                 renderer_set_scale(iris->ctx, iris->scale);
                 renderer_set_aspect_mode(iris->ctx, iris->aspect_mode);
                 renderer_set_bilinear(iris->ctx, iris->bilinear);
+                renderer_set_deinterlace_mode(iris->ctx, iris->deinterlace_mode);
                 renderer_set_integer_scaling(iris->ctx, iris->integer_scaling);
                 renderer_set_size(iris->ctx, 0, 0);
             }
@@ -137,6 +144,20 @@ void show_graphics_settings(iris::instance* iris) {
 
     Checkbox("Integer scaling", &iris->integer_scaling);
 
+    Text("Deinterlacing");
+
+    if (BeginCombo("##deinterlace", settings_deinterlace_names[iris->deinterlace_mode])) {
+        for (int i = 0; i < 2; i++) {
+            if (Selectable(settings_deinterlace_names[i], iris->deinterlace_mode == i)) {
+                iris->deinterlace_mode = i;
+
+                renderer_set_deinterlace_mode(iris->ctx, iris->deinterlace_mode);
+            }
+        }
+
+        EndCombo();
+    }
+
     Text("Window mode");
 
     if (BeginCombo("##windowmode", settings_fullscreen_names[iris->fullscreen])) {
@@ -356,6 +377,82 @@ void show_memory_card_settings(iris::instance* iris) {
     show_memory_card(iris, 1);
 }
 
+void show_misc_settings(iris::instance* iris) {
+    using namespace ImGui;
+
+    Text("EE core");
+
+    if (BeginCombo("##eecore", iris->ee_jit ? "Recompiler" : "Interpreter", ImGuiComboFlags_HeightSmall)) {
+        if (Selectable("Interpreter", !iris->ee_jit)) {
+            iris->ee_jit = false;
+
+            ps2_set_ee_jit(iris->ps2, 0);
+        }
+
+        if (Selectable("Recompiler", iris->ee_jit)) {
+            iris->ee_jit = true;
+
+            ps2_set_ee_jit(iris->ps2, 1);
+        }
+
+        EndCombo();
+    }
+
+    if (IsItemHovered()) {
+        hovered = true;
+
+        tooltip = ICON_MS_INFO " The recompiler runs whole blocks of EE code at once. Stepping and breakpoints use the interpreter, so they still stop on every instruction";
+    }
+
+    Text("VU1");
+
+    if (BeginCombo("##vu1", iris->vu1_thread ? "Threaded" : "Synchronous", ImGuiComboFlags_HeightSmall)) {
+        if (Selectable("Synchronous", !iris->vu1_thread)) {
+            iris->vu1_thread = false;
+
+            ps2_set_vu1_thread(iris->ps2, 0);
+        }
+
+        if (Selectable("Threaded", iris->vu1_thread)) {
+            iris->vu1_thread = true;
+
+            ps2_set_vu1_thread(iris->ps2, 1);
+        }
+
+        EndCombo();
+    }
+
+    if (IsItemHovered()) {
+        hovered = true;
+
+        tooltip = ICON_MS_INFO " Runs VU1 microprograms on their own thread so they overlap with the EE, needs a multicore CPU";
+    }
+
+    Text("DMA");
+
+    if (BeginCombo("##dma", iris->dma_timed ? "Timed" : "Instant", ImGuiComboFlags_HeightSmall)) {
+        if (Selectable("Instant", !iris->dma_timed)) {
+            iris->dma_timed = false;
+
+            ps2_set_dma_timed(iris->ps2, 0);
+        }
+
+        if (Selectable("Timed", iris->dma_timed)) {
+            iris->dma_timed = true;
+
+            ps2_set_dma_timed(iris->ps2, 1);
+        }
+
+        EndCombo();
+    }
+
+    if (IsItemHovered()) {
+        hovered = true;
+
+        tooltip = ICON_MS_INFO " Timed mode spreads GIF and VIF1 transfers over time at bus speed so they overlap with the EE, instant mode is faster";
+    }
+}
+
 void show_settings(iris::instance* iris) {
     using namespace ImGui;
 
@@ -390,6 +487,7 @@ void show_settings(iris::instance* iris) {
                 case 0: show_graphics_settings(iris); break;
                 case 1: show_paths_settings(iris); break;
                 case 2: show_memory_card_settings(iris); break;
+                case 3: show_misc_settings(iris); break;
             }
         } EndChild();
 
@@ -85,6 +85,11 @@ void show_status_bar(iris::instance* iris) {
             );
         }
 
+        Text("| Idle EE %llu IOP %llu",
+            (unsigned long long)iris->ee_idle_cycles,
+            (unsigned long long)iris->iop_idle_cycles
+        );
+
         EndMainStatusBar();
     }
 }
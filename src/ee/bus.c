@@ -15,6 +15,7 @@ void ee_bus_init(struct ee_bus* bus, const char* bios_path) {
     for (int i = 0; i < 0x10000; i++) {
         bus->fastmem_r_table[i] = NULL;
         bus->fastmem_w_table[i] = NULL;
+        bus->code_page_table[i] = 0;
     }
 }
 
@@ -35,6 +36,53 @@ void ee_bus_init_fastmem(struct ee_bus* bus) {
         bus->fastmem_r_table[i+0xe000] = bus->iop_ram->buf + (i * 0x2000);
         bus->fastmem_w_table[i+0xe000] = bus->iop_ram->buf + (i * 0x2000);
     }
+
+    // Protections are lost after remapping
+    for (int i = 0; i < 0x10000; i++)
+        bus->code_page_table[i] = 0;
+}
+
+void ee_bus_init_code_write(struct ee_bus* bus, void (*code_write)(void*, uint32_t), void* udata) {
+    bus->code_write = code_write;
+    bus->code_write_udata = udata;
+}
+
+void ee_bus_protect_code_page(void* udata, uint32_t addr) {
+    struct ee_bus* bus = (struct ee_bus*)udata;
+    uint32_t page = addr >> 13;
+
+    // Only main RAM is tracked, everything else is either
+    // read-only (BIOS) or can't hold EE code
+    if (page >= 0x1000)
+        return;
+
+    bus->fastmem_w_table[page] = NULL;
+    bus->code_page_table[page] = 1;
+}
+
+void ee_bus_unprotect_code_pages(struct ee_bus* bus) {
+    for (int i = 0; i < 0x1000; i++) {
+        if (!bus->code_page_table[i])
+            continue;
+
+        bus->fastmem_w_table[i] = bus->fastmem_r_table[i];
+        bus->code_page_table[i] = 0;
+    }
+}
+
+static inline void* ee_bus_handle_code_write(struct ee_bus* bus, uint32_t addr) {
+    uint32_t page = addr >> 13;
+
+    if (!bus->code_page_table[page])
+        return NULL;
+
+    bus->fastmem_w_table[page] = bus->fastmem_r_table[page];
+    bus->code_page_table[page] = 0;
+
+    if (bus->code_write)
+        bus->code_write(bus->code_write_udata, addr);
+
+    return bus->fastmem_w_table[page];
 }
 
 void ee_bus_init_bios(struct ee_bus* bus, struct ps2_bios* bios) {
@@ -319,6 +367,9 @@ void ee_bus_write8(void* udata, uint32_t addr, uint64_t data) {
 
     void* ptr = bus->fastmem_w_table[addr >> 13];
 
+    if (!ptr)
+        ptr = ee_bus_handle_code_write(bus, addr);
+
     if (ptr) {
         *((uint8_t*)(((uint8_t*)ptr) + (addr & 0x1fff))) = data;
 
@@ -347,6 +398,9 @@ void ee_bus_write16(void* udata, uint32_t addr, uint64_t data) {
 
     void* ptr = bus->fastmem_w_table[addr >> 13];
 
+    if (!ptr)
+        ptr = ee_bus_handle_code_write(bus, addr);
+
     if (ptr) {
         *((uint16_t*)(((uint8_t*)ptr) + (addr & 0x1fff))) = data;
 
@@ -376,6 +430,9 @@ void ee_bus_write32(void* udata, uint32_t addr, uint64_t data) {
 
     void* ptr = bus->fastmem_w_table[addr >> 13];
 
+    if (!ptr)
+        ptr = ee_bus_handle_code_write(bus, addr);
+
     if (ptr) {
         *((uint32_t*)(((uint8_t*)ptr) + (addr & 0x1fff))) = data;
 
@@ -438,6 +495,9 @@ void ee_bus_write64(void* udata, uint32_t addr, uint64_t data) {
 
     void* ptr = bus->fastmem_w_table[addr >> 13];
 
+    if (!ptr)
+        ptr = ee_bus_handle_code_write(bus, addr);
+
     if (ptr) {
         *((uint64_t*)(((uint8_t*)ptr) + (addr & 0x1fff))) = data;
 
@@ -466,6 +526,9 @@ void ee_bus_write128(void* udata, uint32_t addr, uint128_t data) {
 
     void* ptr = bus->fastmem_w_table[addr >> 13];
 
+    if (!ptr)
+        ptr = ee_bus_handle_code_write(bus, addr);
+
     if (ptr) {
         *((uint128_t*)(((uint8_t*)ptr) + (addr & 0x1fff))) = data;
 
@@ -47,6 +47,13 @@ struct ee_bus {
     void* fastmem_r_table[0x10000];
     void* fastmem_w_table[0x10000];
 
+    // Pages holding decoded or recompiled code have their fastmem
+    // write pointer cleared, the first write to one of them is
+    // reported through code_write and unprotects the page
+    uint8_t code_page_table[0x10000];
+    void (*code_write)(void*, uint32_t);
+    void* code_write_udata;
+
     uint32_t mch_ricm;
     uint32_t mch_drd;
     uint32_t rdram_sdevid;
@@ -75,6 +82,9 @@ void ee_bus_init_vu0(struct ee_bus* bus, struct vu_state* vu);
 void ee_bus_init_vu1(struct ee_bus* bus, struct vu_state* vu);
 void ee_bus_init_kputchar(struct ee_bus* bus, void (*kputchar)(void*, char), void* udata);
 void ee_bus_init_fastmem(struct ee_bus* bus);
+void ee_bus_init_code_write(struct ee_bus* bus, void (*code_write)(void*, uint32_t), void* udata);
+void ee_bus_protect_code_page(void* udata, uint32_t addr);
+void ee_bus_unprotect_code_pages(struct ee_bus* bus);
 
 #ifdef __cplusplus
 }
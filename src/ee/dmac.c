@@ -4,6 +4,7 @@
 #include <assert.h>
 
 #include "dmac.h"
+#include "bus.h"
 
 static inline uint128_t dmac_read_qword(struct ps2_dmac* dmac, uint32_t addr, int mem) {
     int spr = mem || (addr & 0x80000000);
@@ -14,14 +15,50 @@ static inline uint128_t dmac_read_qword(struct ps2_dmac* dmac, uint32_t addr, in
     return ps2_ram_read128(dmac->spr, addr & 0x3ff0);
 }
 
+// Resolves up to qwc qwords at addr to a contiguous host span, returns
+// the number of qwords available at *ptr or 0 if addr isn't fastmem
+// mapped (MMIO, VU memory, etc.)
+static inline int dmac_map_span(struct ps2_dmac* dmac, uint32_t addr, int mem, int qwc, const uint128_t** ptr) {
+    if (mem || (addr & 0x80000000)) {
+        int avail = (0x4000 - (addr & 0x3ff0)) >> 4;
+
+        *ptr = (const uint128_t*)(dmac->spr->buf + (addr & 0x3ff0));
+
+        return qwc < avail ? qwc : avail;
+    }
+
+    addr &= 0xfffffff0;
+
+    uint8_t* base = dmac->bus->fastmem_r_table[addr >> 13];
+
+    if (!base)
+        return 0;
+
+    uint8_t* end = base + 0x2000;
+    uint32_t page = (addr >> 13) + 1;
+    int size = (0x2000 - (addr & 0x1fff)) >> 4;
+
+    // Keep going while the next page is backed by the same buffer
+    while ((size < qwc) && (page < 0x10000) && (dmac->bus->fastmem_r_table[page] == end)) {
+        size += 0x2000 >> 4;
+        end += 0x2000;
+        page++;
+    }
+
+    *ptr = (const uint128_t*)(base + (addr & 0x1fff));
+
+    return qwc < size ? qwc : size;
+}
+
 struct ps2_dmac* ps2_dmac_create(void) {
     return malloc(sizeof(struct ps2_dmac));
 }
 
-void ps2_dmac_init(struct ps2_dmac* dmac, struct ps2_sif* sif, struct ps2_iop_dma* iop_dma, struct ps2_ram* spr, struct ee_state* ee, struct ee_bus* bus) {
+void ps2_dmac_init(struct ps2_dmac* dmac, struct ps2_sif* sif, struct ps2_iop_dma* iop_dma, struct ps2_ram* spr, struct ee_state* ee, struct sched_state* sched, struct ee_bus* bus) {
     memset(dmac, 0, sizeof(struct ps2_dmac));
 
     dmac->bus = bus;
+    dmac->sched = sched;
     dmac->sif = sif;
     dmac->spr = spr;
     dmac->iop_dma = iop_dma;
@@ -310,6 +347,30 @@ void dmac_handle_vif0_transfer(struct ps2_dmac* dmac) {
 
     dmac_set_irq(dmac, DMAC_VIF0);
 }
+// Sends qwc qwords from MADR straight to the VIF1 FIFO, mapped spans
+// are handed over in place without going through the bus
+static inline void dmac_send_vif1(struct ps2_dmac* dmac, int qwc, int mem) {
+    while (qwc) {
+        const uint128_t* ptr;
+
+        int size = dmac_map_span(dmac, dmac->vif1.madr, mem, qwc, &ptr);
+
+        if (!size) {
+            uint128_t q = dmac_read_qword(dmac, dmac->vif1.madr, mem);
+
+            vif1_write_burst(dmac->bus->vif, &q, 1);
+
+            size = 1;
+        } else {
+            vif1_write_burst(dmac->bus->vif, ptr, size);
+        }
+
+        dmac->vif1.madr += size << 4;
+
+        qwc -= size;
+    }
+}
+
 void dmac_handle_vif1_transfer(struct ps2_dmac* dmac) {
     // printf("ee: VIF1 DMA dir=%d mode=%d tte=%d tie=%d qwc=%d madr=%08x tadr=%08x\n",
     //     dmac->vif1.chcr & 1,
@@ -321,17 +382,7 @@ void dmac_handle_vif1_transfer(struct ps2_dmac* dmac) {
     //     dmac->vif1.tadr
     // );
 
-    for (int i = 0; i < dmac->vif1.qwc; i++) {
-        uint128_t q = dmac_read_qword(dmac, dmac->vif1.madr, 0);
-
-        // VIF1 FIFO address
-        ee_bus_write32(dmac->bus, 0x10005000, q.u32[0]);
-        ee_bus_write32(dmac->bus, 0x10005000, q.u32[1]);
-        ee_bus_write32(dmac->bus, 0x10005000, q.u32[2]);
-        ee_bus_write32(dmac->bus, 0x10005000, q.u32[3]);
-
-        dmac->vif1.madr += 16;
-    }
+    dmac_send_vif1(dmac, dmac->vif1.qwc, 0);
 
     if (((dmac->vif1.chcr >> 2) & 7) != 1) {
         dmac->vif1.chcr &= ~0x100;
@@ -361,21 +412,7 @@ void dmac_handle_vif1_transfer(struct ps2_dmac* dmac) {
             ee_bus_write32(dmac->bus, 0x10005000, dmac->vif1.tag.data >> 32);
         }
 
-        for (int i = 0; i < dmac->vif1.tag.qwc; i++) {
-            uint128_t q = dmac_read_qword(dmac, dmac->vif1.madr, dmac->vif1.tag.mem);
-
-            // printf("ee: Sending %016lx%016lx from %08x to VIF1 FIFO\n",
-            //     q.u64[1], q.u64[0],
-            //     dmac->vif1.madr
-            // );
-
-            ee_bus_write32(dmac->bus, 0x10005000, q.u32[0]);
-            ee_bus_write32(dmac->bus, 0x10005000, q.u32[1]);
-            ee_bus_write32(dmac->bus, 0x10005000, q.u32[2]);
-            ee_bus_write32(dmac->bus, 0x10005000, q.u32[3]);
-
-            dmac->vif1.madr += 16;
-        }
+        dmac_send_vif1(dmac, dmac->vif1.tag.qwc, dmac->vif1.tag.mem);
 
         if (dmac->vif1.tag.id == 1) {
             dmac->vif1.tadr = dmac->vif1.madr;
@@ -387,26 +424,38 @@ void dmac_handle_vif1_transfer(struct ps2_dmac* dmac) {
     dmac_set_irq(dmac, DMAC_VIF1);
 }
 
-void dmac_handle_gif_transfer(struct ps2_dmac* dmac) {
-    dmac_set_irq(dmac, DMAC_GIF);
+// Sends qwc qwords from MADR to the GIF FIFO, mapped spans are
+// handed over in place so IMAGE data reaches the GS in large pieces
+static inline void dmac_send_gif(struct ps2_dmac* dmac, int qwc, int mem) {
+    while (qwc) {
+        const uint128_t* ptr;
 
-    dmac->gif.chcr &= ~0x100;
+        int size = dmac_map_span(dmac, dmac->gif.madr, mem, qwc, &ptr);
 
-    // printf("dmac: GIF transfer mode=%d madr=%08x qwc=%d\n", (dmac->gif.chcr >> 2) & 7, dmac->gif.madr, dmac->gif.qwc);
+        if (!size) {
+            uint128_t q = dmac_read_qword(dmac, dmac->gif.madr, mem);
 
-    for (int i = 0; i < dmac->gif.qwc; i++) {
-        uint128_t q = dmac_read_qword(dmac, dmac->gif.madr, 0);
+            ps2_gif_write_path(dmac->bus->gif, GIF_PATH3, &q, 1);
 
-        // fprintf(file, "ee: Sending %016lx%016lx from %08x to GIF FIFO (burst)\n",
-        //     q.u64[1], q.u64[0],
-        //     dmac->gif.madr
-        // );
+            size = 1;
+        } else {
+            ps2_gif_write_path(dmac->bus->gif, GIF_PATH3, ptr, size);
+        }
 
-        // GIF FIFO address
-        ee_bus_write128(dmac->bus, 0x10006000, q);
+        dmac->gif.madr += size << 4;
 
-        dmac->gif.madr += 16;
+        qwc -= size;
     }
+}
+
+void dmac_handle_gif_transfer(struct ps2_dmac* dmac) {
+    dmac_set_irq(dmac, DMAC_GIF);
+
+    dmac->gif.chcr &= ~0x100;
+
+    // printf("dmac: GIF transfer mode=%d madr=%08x qwc=%d\n", (dmac->gif.chcr >> 2) & 7, dmac->gif.madr, dmac->gif.qwc);
+
+    dmac_send_gif(dmac, dmac->gif.qwc, 0);
 
     if (((dmac->gif.chcr >> 2) & 7) != 1) {
         return;
@@ -420,23 +469,148 @@ void dmac_handle_gif_transfer(struct ps2_dmac* dmac) {
 
         // fprintf(file, "ee: gif tag qwc=%08x madr=%08x tadr=%08x\n", dmac->gif.tag.qwc, dmac->gif.madr, dmac->gif.tadr);
 
-        for (int i = 0; i < dmac->gif.tag.qwc; i++) {
-            uint128_t q = dmac_read_qword(dmac, dmac->gif.madr, dmac->gif.tag.mem);
+        dmac_send_gif(dmac, dmac->gif.tag.qwc, dmac->gif.tag.mem);
 
-            // fprintf(file, "ee: Sending %016lx%016lx from %08x to GIF FIFO (chain)\n",
-            //     q.u64[1], q.u64[0],
-            //     dmac->gif.madr
-            // );
+        if (dmac->gif.tag.id == 1) {
+            dmac->gif.tadr = dmac->gif.madr;
+        }
+    } while (!channel_is_done(&dmac->gif));
+}
+
+// Moves up to budget qwords of a GIF or VIF1 transfer, chain tags
+// count as one qword. QWC counts down as data goes out like it does
+// on hardware. Returns the number of qwords moved or -1 when the
+// channel has nothing left to send
+static int dmac_slice(struct ps2_dmac* dmac, struct dmac_channel* c, int budget, void (*send)(struct ps2_dmac*, int, int)) {
+    int moved = 0;
+
+    while (moved < budget) {
+        if (c->qwc) {
+            int size = c->qwc < (uint32_t)(budget - moved) ? c->qwc : (budget - moved);
 
-            ee_bus_write128(dmac->bus, 0x10006000, q);
+            send(dmac, size, c->tag.mem);
 
-            dmac->gif.madr += 16;
+            c->qwc -= size;
+            moved += size;
+
+            continue;
         }
 
-        if (dmac->gif.tag.id == 1) {
-            dmac->gif.tadr = dmac->gif.madr;
+        // Normal mode
+        if (((c->chcr >> 2) & 7) != 1)
+            break;
+
+        if (c->chained) {
+            if (c->tag.id == 1)
+                c->tadr = c->madr;
+
+            if (channel_is_done(c))
+                break;
         }
-    } while (!channel_is_done(&dmac->gif));
+
+        uint128_t tag = dmac_read_qword(dmac, c->tadr, 0);
+
+        dmac_process_source_tag(dmac, c, tag);
+
+        // CHCR.TTE: Transfer tag DATA field
+        if ((c == &dmac->vif1) && ((c->chcr >> 6) & 1)) {
+            ee_bus_write32(dmac->bus, 0x10005000, c->tag.data & 0xffffffff);
+            ee_bus_write32(dmac->bus, 0x10005000, c->tag.data >> 32);
+        }
+
+        c->qwc = c->tag.qwc;
+        c->chained = 1;
+
+        ++moved;
+    }
+
+    return moved ? moved : -1;
+}
+
+static inline void dmac_run_slice(struct ps2_dmac* dmac, struct dmac_channel* c, int ch, int hold, void (*send)(struct ps2_dmac*, int, int), void (*callback)(void*, int), const char* name) {
+    // Stopped by the EE while in flight
+    if (!(c->chcr & 0x100))
+        return;
+
+    long cycles = DMAC_SLICE_QWC * DMAC_QWORD_CYCLES;
+
+    // D_ENABLEW.CPND holds every channel until it's cleared, hold is
+    // set while the GIF is busy with another path's packet
+    if (!(dmac->enable & 0x10000) && !hold) {
+        int moved = dmac_slice(dmac, c, DMAC_SLICE_QWC, send);
+
+        if (moved == -1) {
+            c->chcr &= ~0x100;
+
+            dmac_set_irq(dmac, ch);
+
+            return;
+        }
+
+        cycles = moved * DMAC_QWORD_CYCLES;
+    }
+
+    struct sched_event event;
+
+    event.callback = callback;
+    event.cycles = cycles;
+    event.name = name;
+    event.udata = dmac;
+
+    c->event = sched_schedule(dmac->sched, event);
+}
+
+static void dmac_handle_gif_slice(void* udata, int overshoot) {
+    struct ps2_dmac* dmac = (struct ps2_dmac*)udata;
+
+    int hold = !ps2_gif_path_ready(dmac->bus->gif, GIF_PATH3);
+
+    dmac_run_slice(dmac, &dmac->gif, DMAC_GIF, hold, dmac_send_gif, dmac_handle_gif_slice, "GIF DMA slice");
+}
+
+static void dmac_handle_vif1_slice(void* udata, int overshoot) {
+    struct ps2_dmac* dmac = (struct ps2_dmac*)udata;
+
+    // The VIF stalls on DIRECT data the GIF hasn't taken yet
+    int hold = ps2_gif_path_queued(dmac->bus->gif, GIF_PATH2);
+
+    dmac_run_slice(dmac, &dmac->vif1, DMAC_VIF1, hold, dmac_send_vif1, dmac_handle_vif1_slice, "VIF1 DMA slice");
+}
+
+static inline void dmac_start_slices(struct ps2_dmac* dmac, struct dmac_channel* c, void (*callback)(void*, int)) {
+    // Restarting a channel drops whatever was left of the last run
+    sched_cancel(dmac->sched, c->event);
+
+    c->chained = 0;
+    c->tag.mem = 0;
+
+    callback(dmac, 0);
+}
+
+// Finishes a sliced transfer right away, used when its events get
+// cancelled while the channel is still running
+static inline void dmac_drain_slices(struct ps2_dmac* dmac, struct dmac_channel* c, int ch, void (*send)(struct ps2_dmac*, int, int)) {
+    sched_cancel(dmac->sched, c->event);
+
+    if (!(c->chcr & 0x100))
+        return;
+
+    while (dmac_slice(dmac, c, DMAC_SLICE_QWC, send) != -1);
+
+    c->chcr &= ~0x100;
+
+    dmac_set_irq(dmac, ch);
+}
+
+void ps2_dmac_set_timed(struct ps2_dmac* dmac, int timed) {
+    // Slices left in flight would otherwise keep running on top of
+    // the next instant transfer on that channel
+    if (dmac->timed && !timed) {
+        dmac_drain_slices(dmac, &dmac->vif1, DMAC_VIF1, dmac_send_vif1);
+        dmac_drain_slices(dmac, &dmac->gif, DMAC_GIF, dmac_send_gif);
+    }
+
+    dmac->timed = timed;
 }
 
 void dmac_handle_ipu_from_transfer(struct ps2_dmac* dmac) {
@@ -709,6 +883,13 @@ static inline void dmac_handle_channel_start(struct ps2_dmac* dmac, uint32_t add
     //     c->tadr
     // );
 
+    if (dmac->timed) {
+        switch (addr & 0xff00) {
+            case 0x9000: dmac_start_slices(dmac, c, dmac_handle_vif1_slice); return;
+            case 0xA000: dmac_start_slices(dmac, c, dmac_handle_gif_slice); return;
+        }
+    }
+
     switch (addr & 0xff00) {
         case 0x8000: dmac_handle_vif0_transfer(dmac); return;
         case 0x9000: dmac_handle_vif1_transfer(dmac); return;
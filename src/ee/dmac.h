@@ -16,6 +16,8 @@ extern "C" {
 
 #include "iop/dma.h"
 
+#include "sched.h"
+
 #define TAG_QWC(d) (d.u64[0] & 0xffff)
 #define TAG_PCT(d) ((d.u64[0] >> 26) & 3)
 #define TAG_ID(d) ((d.u64[0] >> 28) & 7)
@@ -24,6 +26,11 @@ extern "C" {
 #define TAG_MEM(d) ((d.u64[0] >> 63) & 1)
 #define TAG_DATA(d) (d.u64[1])
 
+// Timed transfers move up to DMAC_SLICE_QWC qwords per scheduler
+// event, one qword per BUSCLK (EE/2) cycle
+#define DMAC_SLICE_QWC 128
+#define DMAC_QWORD_CYCLES 8
+
 #define DMAC_VIF0 0
 #define DMAC_VIF1 1
 #define DMAC_GIF 2
@@ -56,6 +63,10 @@ struct dmac_channel {
     uint32_t sadr;
 
     struct dmac_tag tag;
+
+    // Timed transfers, chained is set once a chain tag was read
+    sched_handle event;
+    int chained;
 };
 
 struct ps2_dmac {
@@ -84,15 +95,21 @@ struct ps2_dmac {
     struct ps2_sif* sif;
     struct ps2_iop_dma* iop_dma;
     struct ee_state* ee;
+    struct sched_state* sched;
+
+    // GIF and VIF1 transfers are sliced through the scheduler
+    // instead of running to completion on the CHCR write
+    int timed;
 };
 
 struct ps2_dmac* ps2_dmac_create(void);
-void ps2_dmac_init(struct ps2_dmac* dmac, struct ps2_sif* sif, struct ps2_iop_dma* iop_dma, struct ps2_ram* spr, struct ee_state* ee, struct ee_bus* bus);
+void ps2_dmac_init(struct ps2_dmac* dmac, struct ps2_sif* sif, struct ps2_iop_dma* iop_dma, struct ps2_ram* spr, struct ee_state* ee, struct sched_state* sched, struct ee_bus* bus);
 void ps2_dmac_destroy(struct ps2_dmac* dmac);
 uint64_t ps2_dmac_read8(struct ps2_dmac* dmac, uint32_t addr);
 uint64_t ps2_dmac_read32(struct ps2_dmac* dmac, uint32_t addr);
 void ps2_dmac_write8(struct ps2_dmac* dmac, uint32_t addr, uint64_t data);
 void ps2_dmac_write32(struct ps2_dmac* dmac, uint32_t addr, uint64_t data);
+void ps2_dmac_set_timed(struct ps2_dmac* dmac, int timed);
 
 void dmac_handle_vif0_transfer(struct ps2_dmac* dmac);
 void dmac_handle_vif1_transfer(struct ps2_dmac* dmac);
@@ -13,6 +13,7 @@
 #endif
 
 #include "ee.h"
+#include "vu_thread.h"
 #include "ee_dis.h"
 
 #ifdef _WIN32
@@ -80,16 +81,18 @@ static inline uint32_t unpack_5551_8888(uint32_t v) {
 #define EE_KSSEG 3
 #define EE_KSEG3 4
 
-#define EE_D_RS ((ee->opcode >> 21) & 0x1f)
-#define EE_D_FS ((ee->opcode >> 11) & 0x1f)
-#define EE_D_RT ((ee->opcode >> 16) & 0x1f)
-#define EE_D_RD ((ee->opcode >> 11) & 0x1f)
-#define EE_D_FD ((ee->opcode >> 6) & 0x1f)
-#define EE_D_SA ((ee->opcode >> 6) & 0x1f)
-#define EE_D_I16 (ee->opcode & 0xffff)
-#define EE_D_I26 (ee->opcode & 0x3ffffff)
+// Fields come pre-extracted from the decoded instruction, see
+// ee_decode_instruction
+#define EE_D_RS (ee->ins->rs)
+#define EE_D_FS (ee->ins->rd)
+#define EE_D_RT (ee->ins->rt)
+#define EE_D_RD (ee->ins->rd)
+#define EE_D_FD (ee->ins->sa)
+#define EE_D_SA (ee->ins->sa)
+#define EE_D_I16 (ee->ins->i16)
+#define EE_D_I26 (ee->ins->i26)
 #define EE_D_SI26 ((int32_t)(EE_D_I26 << 6) >> 4)
-#define EE_D_SI16 ((int32_t)(EE_D_I16 << 16) >> 14)
+#define EE_D_SI16 (ee->ins->si16)
 
 #define EE_RT ee->r[EE_D_RT].ul64
 #define EE_RD ee->r[EE_D_RD].ul64
@@ -428,7 +431,7 @@ static inline void ee_exception_level2(struct ee_state* ee, uint32_t cause) {
     ee_set_pc(ee, ((ee->status & EE_SR_DEV) ? 0xbfc00200 : 0x80000000) + vec);
 }
 
-static inline void ee_check_irq(struct ee_state* ee) {
+int ee_check_irq(struct ee_state* ee) {
     int irq_enabled = (ee->status & EE_SR_IE) && (ee->status & EE_SR_EIE) &&
         (!(ee->status & EE_SR_EXL)) && (!(ee->status & EE_SR_ERL));
     int int0_pending = (ee->status & EE_SR_IM2) && (ee->cause & EE_CAUSE_IP2);
@@ -446,7 +449,11 @@ static inline void ee_check_irq(struct ee_state* ee) {
         // );
 
         ee_exception_level1(ee, CAUSE_EXC1_INT);
+
+        return 1;
     }
+
+    return 0;
 }
 
 void ee_set_int0(struct ee_state* ee, int v) {
@@ -625,6 +632,15 @@ static inline void ee_i_cfc2(struct ee_state* ee) {
         EE_RT &= 0x0c0c;
     }
 
+    // VPU_STAT, VU1 is running. The worker changes it in real time,
+    // so loops polling it can't be skipped
+    if ((d == 29) && ee->vu1->thread) {
+        ee->idle.polled = 1;
+
+        if (vu_thread_busy(ee->vu1->thread))
+            EE_RT |= 0x100;
+    }
+
     // static const char* regs[] = {
     //     "Status flag",
     //     "MAC flag",
@@ -869,6 +885,11 @@ static inline void ee_i_eret(struct ee_state* ee) {
         ee->status &= ~EE_SR_EXL;
     }
 }
+static inline void ee_i_invalid(struct ee_state* ee) {
+    printf("ee: Invalid instruction %08x @ pc=%08x (cyc=%ld)\n", ee->opcode, ee->prev_pc, ee->total_cycles);
+
+    exit(1);
+}
 static inline void ee_i_j(struct ee_state* ee) {
     ee_set_pc_delayed(ee, (ee->next_pc & 0xf0000000) | (EE_D_I26 << 2));
 }
@@ -2537,185 +2558,189 @@ void ee_init(struct ee_state* ee, struct vu_state* vu0, struct vu_state* vu1, st
 
     ee->scratchpad = ps2_ram_create();
     ps2_ram_init(ee->scratchpad, 0x4000);
+
+    ee->ins = &ee->uncached;
+
+    idle_loop_reset(&ee->idle);
 }
 
-static inline void ee_execute(struct ee_state* ee) {
-    switch ((ee->opcode & 0xFC000000) >> 26) {
+ee_instruction_func ee_decode(uint32_t opcode) {
+    switch ((opcode & 0xFC000000) >> 26) {
         case 0x00000000 >> 26: { // special
-            switch (ee->opcode & 0x0000003F) {
-                case 0x00000000: ee_i_sll(ee); return;
-                case 0x00000002: ee_i_srl(ee); return;
-                case 0x00000003: ee_i_sra(ee); return;
-                case 0x00000004: ee_i_sllv(ee); return;
-                case 0x00000006: ee_i_srlv(ee); return;
-                case 0x00000007: ee_i_srav(ee); return;
-                case 0x00000008: ee_i_jr(ee); return;
-                case 0x00000009: ee_i_jalr(ee); return;
-                case 0x0000000A: ee_i_movz(ee); return;
-                case 0x0000000B: ee_i_movn(ee); return;
-                case 0x0000000C: ee_i_syscall(ee); return;
-                case 0x0000000D: ee_i_break(ee); return;
-                case 0x0000000F: ee_i_sync(ee); return;
-                case 0x00000010: ee_i_mfhi(ee); return;
-                case 0x00000011: ee_i_mthi(ee); return;
-                case 0x00000012: ee_i_mflo(ee); return;
-                case 0x00000013: ee_i_mtlo(ee); return;
-                case 0x00000014: ee_i_dsllv(ee); return;
-                case 0x00000016: ee_i_dsrlv(ee); return;
-                case 0x00000017: ee_i_dsrav(ee); return;
-                case 0x00000018: ee_i_mult(ee); return;
-                case 0x00000019: ee_i_multu(ee); return;
-                case 0x0000001A: ee_i_div(ee); return;
-                case 0x0000001B: ee_i_divu(ee); return;
-                case 0x00000020: ee_i_add(ee); return;
-                case 0x00000021: ee_i_addu(ee); return;
-                case 0x00000022: ee_i_sub(ee); return;
-                case 0x00000023: ee_i_subu(ee); return;
-                case 0x00000024: ee_i_and(ee); return;
-                case 0x00000025: ee_i_or(ee); return;
-                case 0x00000026: ee_i_xor(ee); return;
-                case 0x00000027: ee_i_nor(ee); return;
-                case 0x00000028: ee_i_mfsa(ee); return;
-                case 0x00000029: ee_i_mtsa(ee); return;
-                case 0x0000002A: ee_i_slt(ee); return;
-                case 0x0000002B: ee_i_sltu(ee); return;
-                case 0x0000002C: ee_i_dadd(ee); return;
-                case 0x0000002D: ee_i_daddu(ee); return;
-                case 0x0000002E: ee_i_dsub(ee); return;
-                case 0x0000002F: ee_i_dsubu(ee); return;
-                case 0x00000030: ee_i_tge(ee); return;
-                case 0x00000031: ee_i_tgeu(ee); return;
-                case 0x00000032: ee_i_tlt(ee); return;
-                case 0x00000033: ee_i_tltu(ee); return;
-                case 0x00000034: ee_i_teq(ee); return;
-                case 0x00000036: ee_i_tne(ee); return;
-                case 0x00000038: ee_i_dsll(ee); return;
-                case 0x0000003A: ee_i_dsrl(ee); return;
-                case 0x0000003B: ee_i_dsra(ee); return;
-                case 0x0000003C: ee_i_dsll32(ee); return;
-                case 0x0000003E: ee_i_dsrl32(ee); return;
-                case 0x0000003F: ee_i_dsra32(ee); return;
+            switch (opcode & 0x0000003F) {
+                case 0x00000000: return ee_i_sll;
+                case 0x00000002: return ee_i_srl;
+                case 0x00000003: return ee_i_sra;
+                case 0x00000004: return ee_i_sllv;
+                case 0x00000006: return ee_i_srlv;
+                case 0x00000007: return ee_i_srav;
+                case 0x00000008: return ee_i_jr;
+                case 0x00000009: return ee_i_jalr;
+                case 0x0000000A: return ee_i_movz;
+                case 0x0000000B: return ee_i_movn;
+                case 0x0000000C: return ee_i_syscall;
+                case 0x0000000D: return ee_i_break;
+                case 0x0000000F: return ee_i_sync;
+                case 0x00000010: return ee_i_mfhi;
+                case 0x00000011: return ee_i_mthi;
+                case 0x00000012: return ee_i_mflo;
+                case 0x00000013: return ee_i_mtlo;
+                case 0x00000014: return ee_i_dsllv;
+                case 0x00000016: return ee_i_dsrlv;
+                case 0x00000017: return ee_i_dsrav;
+                case 0x00000018: return ee_i_mult;
+                case 0x00000019: return ee_i_multu;
+                case 0x0000001A: return ee_i_div;
+                case 0x0000001B: return ee_i_divu;
+                case 0x00000020: return ee_i_add;
+                case 0x00000021: return ee_i_addu;
+                case 0x00000022: return ee_i_sub;
+                case 0x00000023: return ee_i_subu;
+                case 0x00000024: return ee_i_and;
+                case 0x00000025: return ee_i_or;
+                case 0x00000026: return ee_i_xor;
+                case 0x00000027: return ee_i_nor;
+                case 0x00000028: return ee_i_mfsa;
+                case 0x00000029: return ee_i_mtsa;
+                case 0x0000002A: return ee_i_slt;
+                case 0x0000002B: return ee_i_sltu;
+                case 0x0000002C: return ee_i_dadd;
+                case 0x0000002D: return ee_i_daddu;
+                case 0x0000002E: return ee_i_dsub;
+                case 0x0000002F: return ee_i_dsubu;
+                case 0x00000030: return ee_i_tge;
+                case 0x00000031: return ee_i_tgeu;
+                case 0x00000032: return ee_i_tlt;
+                case 0x00000033: return ee_i_tltu;
+                case 0x00000034: return ee_i_teq;
+                case 0x00000036: return ee_i_tne;
+                case 0x00000038: return ee_i_dsll;
+                case 0x0000003A: return ee_i_dsrl;
+                case 0x0000003B: return ee_i_dsra;
+                case 0x0000003C: return ee_i_dsll32;
+                case 0x0000003E: return ee_i_dsrl32;
+                case 0x0000003F: return ee_i_dsra32;
             }
         } break;
         case 0x04000000 >> 26: { // regimm
-            switch ((ee->opcode & 0x001F0000) >> 16) {
-                case 0x00000000 >> 16: ee_i_bltz(ee); return;
-                case 0x00010000 >> 16: ee_i_bgez(ee); return;
-                case 0x00020000 >> 16: ee_i_bltzl(ee); return;
-                case 0x00030000 >> 16: ee_i_bgezl(ee); return;
-                case 0x00080000 >> 16: ee_i_tgei(ee); return;
-                case 0x00090000 >> 16: ee_i_tgeiu(ee); return;
-                case 0x000A0000 >> 16: ee_i_tlti(ee); return;
-                case 0x000B0000 >> 16: ee_i_tltiu(ee); return;
-                case 0x000C0000 >> 16: ee_i_teqi(ee); return;
-                case 0x000E0000 >> 16: ee_i_tnei(ee); return;
-                case 0x00100000 >> 16: ee_i_bltzal(ee); return;
-                case 0x00110000 >> 16: ee_i_bgezal(ee); return;
-                case 0x00120000 >> 16: ee_i_bltzall(ee); return;
-                case 0x00130000 >> 16: ee_i_bgezall(ee); return;
-                case 0x00180000 >> 16: ee_i_mtsab(ee); return;
-                case 0x00190000 >> 16: ee_i_mtsah(ee); return;
+            switch ((opcode & 0x001F0000) >> 16) {
+                case 0x00000000 >> 16: return ee_i_bltz;
+                case 0x00010000 >> 16: return ee_i_bgez;
+                case 0x00020000 >> 16: return ee_i_bltzl;
+                case 0x00030000 >> 16: return ee_i_bgezl;
+                case 0x00080000 >> 16: return ee_i_tgei;
+                case 0x00090000 >> 16: return ee_i_tgeiu;
+                case 0x000A0000 >> 16: return ee_i_tlti;
+                case 0x000B0000 >> 16: return ee_i_tltiu;
+                case 0x000C0000 >> 16: return ee_i_teqi;
+                case 0x000E0000 >> 16: return ee_i_tnei;
+                case 0x00100000 >> 16: return ee_i_bltzal;
+                case 0x00110000 >> 16: return ee_i_bgezal;
+                case 0x00120000 >> 16: return ee_i_bltzall;
+                case 0x00130000 >> 16: return ee_i_bgezall;
+                case 0x00180000 >> 16: return ee_i_mtsab;
+                case 0x00190000 >> 16: return ee_i_mtsah;
             }
         } break;
-        case 0x08000000 >> 26: ee_i_j(ee); return;
-        case 0x0C000000 >> 26: ee_i_jal(ee); return;
-        case 0x10000000 >> 26: ee_i_beq(ee); return;
-        case 0x14000000 >> 26: ee_i_bne(ee); return;
-        case 0x18000000 >> 26: ee_i_blez(ee); return;
-        case 0x1C000000 >> 26: ee_i_bgtz(ee); return;
-        case 0x20000000 >> 26: ee_i_addi(ee); return;
-        case 0x24000000 >> 26: ee_i_addiu(ee); return;
-        case 0x28000000 >> 26: ee_i_slti(ee); return;
-        case 0x2C000000 >> 26: ee_i_sltiu(ee); return;
-        case 0x30000000 >> 26: ee_i_andi(ee); return;
-        case 0x34000000 >> 26: ee_i_ori(ee); return;
-        case 0x38000000 >> 26: ee_i_xori(ee); return;
-        case 0x3C000000 >> 26: ee_i_lui(ee); return;
+        case 0x08000000 >> 26: return ee_i_j;
+        case 0x0C000000 >> 26: return ee_i_jal;
+        case 0x10000000 >> 26: return ee_i_beq;
+        case 0x14000000 >> 26: return ee_i_bne;
+        case 0x18000000 >> 26: return ee_i_blez;
+        case 0x1C000000 >> 26: return ee_i_bgtz;
+        case 0x20000000 >> 26: return ee_i_addi;
+        case 0x24000000 >> 26: return ee_i_addiu;
+        case 0x28000000 >> 26: return ee_i_slti;
+        case 0x2C000000 >> 26: return ee_i_sltiu;
+        case 0x30000000 >> 26: return ee_i_andi;
+        case 0x34000000 >> 26: return ee_i_ori;
+        case 0x38000000 >> 26: return ee_i_xori;
+        case 0x3C000000 >> 26: return ee_i_lui;
         case 0x40000000 >> 26: { // cop0
-            switch ((ee->opcode & 0x03E00000) >> 21) {
-                case 0x00000000 >> 21: ee_i_mfc0(ee); return;
-                case 0x00800000 >> 21: ee_i_mtc0(ee); return;
+            switch ((opcode & 0x03E00000) >> 21) {
+                case 0x00000000 >> 21: return ee_i_mfc0;
+                case 0x00800000 >> 21: return ee_i_mtc0;
                 case 0x01000000 >> 21: {
-                    switch ((ee->opcode & 0x001F0000) >> 16) {
-                        case 0x00000000 >> 16: ee_i_bc0f(ee); return;
-                        case 0x00010000 >> 16: ee_i_bc0t(ee); return;
-                        case 0x00020000 >> 16: ee_i_bc0fl(ee); return;
-                        case 0x00030000 >> 16: ee_i_bc0tl(ee); return;
+                    switch ((opcode & 0x001F0000) >> 16) {
+                        case 0x00000000 >> 16: return ee_i_bc0f;
+                        case 0x00010000 >> 16: return ee_i_bc0t;
+                        case 0x00020000 >> 16: return ee_i_bc0fl;
+                        case 0x00030000 >> 16: return ee_i_bc0tl;
                     }
                 } break;
                 case 0x02000000 >> 21: {
-                    switch (ee->opcode & 0x0000003F) {
-                        case 0x00000001: ee_i_tlbr(ee); return;
-                        case 0x00000002: ee_i_tlbwi(ee); return;
-                        case 0x00000006: ee_i_tlbwr(ee); return;
-                        case 0x00000008: ee_i_tlbp(ee); return;
-                        case 0x00000018: ee_i_eret(ee); return;
-                        case 0x00000038: ee_i_ei(ee); return;
-                        case 0x00000039: ee_i_di(ee); return;
+                    switch (opcode & 0x0000003F) {
+                        case 0x00000001: return ee_i_tlbr;
+                        case 0x00000002: return ee_i_tlbwi;
+                        case 0x00000006: return ee_i_tlbwr;
+                        case 0x00000008: return ee_i_tlbp;
+                        case 0x00000018: return ee_i_eret;
+                        case 0x00000038: return ee_i_ei;
+                        case 0x00000039: return ee_i_di;
                     }
                 } break;
             }
         } break;
         case 0x44000000 >> 26: { // cop1
-            switch ((ee->opcode & 0x03E00000) >> 21) {
-                case 0x00000000 >> 21: ee_i_mfc1(ee); return;
-                case 0x00400000 >> 21: ee_i_cfc1(ee); return;
-                case 0x00800000 >> 21: ee_i_mtc1(ee); return;
-                case 0x00C00000 >> 21: ee_i_ctc1(ee); return;
+            switch ((opcode & 0x03E00000) >> 21) {
+                case 0x00000000 >> 21: return ee_i_mfc1;
+                case 0x00400000 >> 21: return ee_i_cfc1;
+                case 0x00800000 >> 21: return ee_i_mtc1;
+                case 0x00C00000 >> 21: return ee_i_ctc1;
                 case 0x01000000 >> 21: {
-                    switch ((ee->opcode & 0x001F0000) >> 16) {
-                        case 0x00000000 >> 16: ee_i_bc1f(ee); return;
-                        case 0x00010000 >> 16: ee_i_bc1t(ee); return;
-                        case 0x00020000 >> 16: ee_i_bc1fl(ee); return;
-                        case 0x00030000 >> 16: ee_i_bc1tl(ee); return;
+                    switch ((opcode & 0x001F0000) >> 16) {
+                        case 0x00000000 >> 16: return ee_i_bc1f;
+                        case 0x00010000 >> 16: return ee_i_bc1t;
+                        case 0x00020000 >> 16: return ee_i_bc1fl;
+                        case 0x00030000 >> 16: return ee_i_bc1tl;
                     }
                 } break;
                 case 0x02000000 >> 21: {
-                    switch (ee->opcode & 0x0000003F) {
-                        case 0x00000000: ee_i_adds(ee); return;
-                        case 0x00000001: ee_i_subs(ee); return;
-                        case 0x00000002: ee_i_muls(ee); return;
-                        case 0x00000003: ee_i_divs(ee); return;
-                        case 0x00000004: ee_i_sqrts(ee); return;
-                        case 0x00000005: ee_i_abss(ee); return;
-                        case 0x00000006: ee_i_movs(ee); return;
-                        case 0x00000007: ee_i_negs(ee); return;
-                        case 0x00000016: ee_i_rsqrts(ee); return;
-                        case 0x00000018: ee_i_addas(ee); return;
-                        case 0x00000019: ee_i_subas(ee); return;
-                        case 0x0000001A: ee_i_mulas(ee); return;
-                        case 0x0000001C: ee_i_madds(ee); return;
-                        case 0x0000001D: ee_i_msubs(ee); return;
-                        case 0x0000001E: ee_i_maddas(ee); return;
-                        case 0x0000001F: ee_i_msubas(ee); return;
-                        case 0x00000024: ee_i_cvtw(ee); return;
-                        case 0x00000028: ee_i_maxs(ee); return;
-                        case 0x00000029: ee_i_mins(ee); return;
-                        case 0x00000030: ee_i_cf(ee); return;
-                        case 0x00000032: ee_i_ceq(ee); return;
-                        case 0x00000034: ee_i_clt(ee); return;
-                        case 0x00000036: ee_i_cle(ee); return;
+                    switch (opcode & 0x0000003F) {
+                        case 0x00000000: return ee_i_adds;
+                        case 0x00000001: return ee_i_subs;
+                        case 0x00000002: return ee_i_muls;
+                        case 0x00000003: return ee_i_divs;
+                        case 0x00000004: return ee_i_sqrts;
+                        case 0x00000005: return ee_i_abss;
+                        case 0x00000006: return ee_i_movs;
+                        case 0x00000007: return ee_i_negs;
+                        case 0x00000016: return ee_i_rsqrts;
+                        case 0x00000018: return ee_i_addas;
+                        case 0x00000019: return ee_i_subas;
+                        case 0x0000001A: return ee_i_mulas;
+                        case 0x0000001C: return ee_i_madds;
+                        case 0x0000001D: return ee_i_msubs;
+                        case 0x0000001E: return ee_i_maddas;
+                        case 0x0000001F: return ee_i_msubas;
+                        case 0x00000024: return ee_i_cvtw;
+                        case 0x00000028: return ee_i_maxs;
+                        case 0x00000029: return ee_i_mins;
+                        case 0x00000030: return ee_i_cf;
+                        case 0x00000032: return ee_i_ceq;
+                        case 0x00000034: return ee_i_clt;
+                        case 0x00000036: return ee_i_cle;
                     }
                 } break;
                 case 0x02800000 >> 21: {
-                    switch (ee->opcode & 0x0000003F) {
-                        case 0x00000020: ee_i_cvts(ee); return;
+                    switch (opcode & 0x0000003F) {
+                        case 0x00000020: return ee_i_cvts;
                     }
                 } break;
             }
         } break;
         case 0x48000000 >> 26: { // cop2
-            switch ((ee->opcode & 0x03E00000) >> 21) {
-                case 0x00200000 >> 21: ee_i_qmfc2(ee); return;
-                case 0x00400000 >> 21: ee_i_cfc2(ee); return;
-                case 0x00A00000 >> 21: ee_i_qmtc2(ee); return;
-                case 0x00C00000 >> 21: ee_i_ctc2(ee); return;
+            switch ((opcode & 0x03E00000) >> 21) {
+                case 0x00200000 >> 21: return ee_i_qmfc2;
+                case 0x00400000 >> 21: return ee_i_cfc2;
+                case 0x00A00000 >> 21: return ee_i_qmtc2;
+                case 0x00C00000 >> 21: return ee_i_ctc2;
                 case 0x01000000 >> 21: {
-                    switch ((ee->opcode & 0x001F0000) >> 16) {
-                        case 0x00000000 >> 16: ee_i_bc2f(ee); return;
-                        case 0x00010000 >> 16: ee_i_bc2t(ee); return;
-                        case 0x00020000 >> 16: ee_i_bc2fl(ee); return;
-                        case 0x00030000 >> 16: ee_i_bc2tl(ee); return;
+                    switch ((opcode & 0x001F0000) >> 16) {
+                        case 0x00000000 >> 16: return ee_i_bc2f;
+                        case 0x00010000 >> 16: return ee_i_bc2t;
+                        case 0x00020000 >> 16: return ee_i_bc2fl;
+                        case 0x00030000 >> 16: return ee_i_bc2tl;
                     }
                 } break;
                 case 0x02000000 >> 21:
@@ -2734,305 +2759,400 @@ static inline void ee_execute(struct ee_state* ee) {
                 case 0x03A00000 >> 21:
                 case 0x03C00000 >> 21:
                 case 0x03E00000 >> 21: {
-                    switch (ee->opcode & 0x0000003F) {
-                        case 0x00000000: ee_i_vaddx(ee); return;
-                        case 0x00000001: ee_i_vaddy(ee); return;
-                        case 0x00000002: ee_i_vaddz(ee); return;
-                        case 0x00000003: ee_i_vaddw(ee); return;
-                        case 0x00000004: ee_i_vsubx(ee); return;
-                        case 0x00000005: ee_i_vsuby(ee); return;
-                        case 0x00000006: ee_i_vsubz(ee); return;
-                        case 0x00000007: ee_i_vsubw(ee); return;
-                        case 0x00000008: ee_i_vmaddx(ee); return;
-                        case 0x00000009: ee_i_vmaddy(ee); return;
-                        case 0x0000000A: ee_i_vmaddz(ee); return;
-                        case 0x0000000B: ee_i_vmaddw(ee); return;
-                        case 0x0000000C: ee_i_vmsubx(ee); return;
-                        case 0x0000000D: ee_i_vmsuby(ee); return;
-                        case 0x0000000E: ee_i_vmsubz(ee); return;
-                        case 0x0000000F: ee_i_vmsubw(ee); return;
-                        case 0x00000010: ee_i_vmaxx(ee); return;
-                        case 0x00000011: ee_i_vmaxy(ee); return;
-                        case 0x00000012: ee_i_vmaxz(ee); return;
-                        case 0x00000013: ee_i_vmaxw(ee); return;
-                        case 0x00000014: ee_i_vminix(ee); return;
-                        case 0x00000015: ee_i_vminiy(ee); return;
-                        case 0x00000016: ee_i_vminiz(ee); return;
-                        case 0x00000017: ee_i_vminiw(ee); return;
-                        case 0x00000018: ee_i_vmulx(ee); return;
-                        case 0x00000019: ee_i_vmuly(ee); return;
-                        case 0x0000001A: ee_i_vmulz(ee); return;
-                        case 0x0000001B: ee_i_vmulw(ee); return;
-                        case 0x0000001C: ee_i_vmulq(ee); return;
-                        case 0x0000001D: ee_i_vmaxi(ee); return;
-                        case 0x0000001E: ee_i_vmuli(ee); return;
-                        case 0x0000001F: ee_i_vminii(ee); return;
-                        case 0x00000020: ee_i_vaddq(ee); return;
-                        case 0x00000021: ee_i_vmaddq(ee); return;
-                        case 0x00000022: ee_i_vaddi(ee); return;
-                        case 0x00000023: ee_i_vmaddi(ee); return;
-                        case 0x00000024: ee_i_vsubq(ee); return;
-                        case 0x00000025: ee_i_vmsubq(ee); return;
-                        case 0x00000026: ee_i_vsubi(ee); return;
-                        case 0x00000027: ee_i_vmsubi(ee); return;
-                        case 0x00000028: ee_i_vadd(ee); return;
-                        case 0x00000029: ee_i_vmadd(ee); return;
-                        case 0x0000002A: ee_i_vmul(ee); return;
-                        case 0x0000002B: ee_i_vmax(ee); return;
-                        case 0x0000002C: ee_i_vsub(ee); return;
-                        case 0x0000002D: ee_i_vmsub(ee); return;
-                        case 0x0000002E: ee_i_vopmsub(ee); return;
-                        case 0x0000002F: ee_i_vmini(ee); return;
-                        case 0x00000030: ee_i_viadd(ee); return;
-                        case 0x00000031: ee_i_visub(ee); return;
-                        case 0x00000032: ee_i_viaddi(ee); return;
-                        case 0x00000034: ee_i_viand(ee); return;
-                        case 0x00000035: ee_i_vior(ee); return;
-                        case 0x00000038: ee_i_vcallms(ee); return;
-                        case 0x00000039: ee_i_vcallmsr(ee); return;
+                    switch (opcode & 0x0000003F) {
+                        case 0x00000000: return ee_i_vaddx;
+                        case 0x00000001: return ee_i_vaddy;
+                        case 0x00000002: return ee_i_vaddz;
+                        case 0x00000003: return ee_i_vaddw;
+                        case 0x00000004: return ee_i_vsubx;
+                        case 0x00000005: return ee_i_vsuby;
+                        case 0x00000006: return ee_i_vsubz;
+                        case 0x00000007: return ee_i_vsubw;
+                        case 0x00000008: return ee_i_vmaddx;
+                        case 0x00000009: return ee_i_vmaddy;
+                        case 0x0000000A: return ee_i_vmaddz;
+                        case 0x0000000B: return ee_i_vmaddw;
+                        case 0x0000000C: return ee_i_vmsubx;
+                        case 0x0000000D: return ee_i_vmsuby;
+                        case 0x0000000E: return ee_i_vmsubz;
+                        case 0x0000000F: return ee_i_vmsubw;
+                        case 0x00000010: return ee_i_vmaxx;
+                        case 0x00000011: return ee_i_vmaxy;
+                        case 0x00000012: return ee_i_vmaxz;
+                        case 0x00000013: return ee_i_vmaxw;
+                        case 0x00000014: return ee_i_vminix;
+                        case 0x00000015: return ee_i_vminiy;
+                        case 0x00000016: return ee_i_vminiz;
+                        case 0x00000017: return ee_i_vminiw;
+                        case 0x00000018: return ee_i_vmulx;
+                        case 0x00000019: return ee_i_vmuly;
+                        case 0x0000001A: return ee_i_vmulz;
+                        case 0x0000001B: return ee_i_vmulw;
+                        case 0x0000001C: return ee_i_vmulq;
+                        case 0x0000001D: return ee_i_vmaxi;
+                        case 0x0000001E: return ee_i_vmuli;
+                        case 0x0000001F: return ee_i_vminii;
+                        case 0x00000020: return ee_i_vaddq;
+                        case 0x00000021: return ee_i_vmaddq;
+                        case 0x00000022: return ee_i_vaddi;
+                        case 0x00000023: return ee_i_vmaddi;
+                        case 0x00000024: return ee_i_vsubq;
+                        case 0x00000025: return ee_i_vmsubq;
+                        case 0x00000026: return ee_i_vsubi;
+                        case 0x00000027: return ee_i_vmsubi;
+                        case 0x00000028: return ee_i_vadd;
+                        case 0x00000029: return ee_i_vmadd;
+                        case 0x0000002A: return ee_i_vmul;
+                        case 0x0000002B: return ee_i_vmax;
+                        case 0x0000002C: return ee_i_vsub;
+                        case 0x0000002D: return ee_i_vmsub;
+                        case 0x0000002E: return ee_i_vopmsub;
+                        case 0x0000002F: return ee_i_vmini;
+                        case 0x00000030: return ee_i_viadd;
+                        case 0x00000031: return ee_i_visub;
+                        case 0x00000032: return ee_i_viaddi;
+                        case 0x00000034: return ee_i_viand;
+                        case 0x00000035: return ee_i_vior;
+                        case 0x00000038: return ee_i_vcallms;
+                        case 0x00000039: return ee_i_vcallmsr;
                         case 0x0000003C:
                         case 0x0000003D:
                         case 0x0000003E:
                         case 0x0000003F: {
-                            uint32_t func = (ee->opcode & 3) | ((ee->opcode & 0x7c0) >> 4);
+                            uint32_t func = (opcode & 3) | ((opcode & 0x7c0) >> 4);
 
                             switch (func) {
-                                case 0x00000000: ee_i_vaddax(ee); return;
-                                case 0x00000001: ee_i_vadday(ee); return;
-                                case 0x00000002: ee_i_vaddaz(ee); return;
-                                case 0x00000003: ee_i_vaddaw(ee); return;
-                                case 0x00000004: ee_i_vsubax(ee); return;
-                                case 0x00000005: ee_i_vsubay(ee); return;
-                                case 0x00000006: ee_i_vsubaz(ee); return;
-                                case 0x00000007: ee_i_vsubaw(ee); return;
-                                case 0x00000008: ee_i_vmaddax(ee); return;
-                                case 0x00000009: ee_i_vmadday(ee); return;
-                                case 0x0000000A: ee_i_vmaddaz(ee); return;
-                                case 0x0000000B: ee_i_vmaddaw(ee); return;
-                                case 0x0000000C: ee_i_vmsubax(ee); return;
-                                case 0x0000000D: ee_i_vmsubay(ee); return;
-                                case 0x0000000E: ee_i_vmsubaz(ee); return;
-                                case 0x0000000F: ee_i_vmsubaw(ee); return;
-                                case 0x00000010: ee_i_vitof0(ee); return;
-                                case 0x00000011: ee_i_vitof4(ee); return;
-                                case 0x00000012: ee_i_vitof12(ee); return;
-                                case 0x00000013: ee_i_vitof15(ee); return;
-                                case 0x00000014: ee_i_vftoi0(ee); return;
-                                case 0x00000015: ee_i_vftoi4(ee); return;
-                                case 0x00000016: ee_i_vftoi12(ee); return;
-                                case 0x00000017: ee_i_vftoi15(ee); return;
-                                case 0x00000018: ee_i_vmulax(ee); return;
-                                case 0x00000019: ee_i_vmulay(ee); return;
-                                case 0x0000001A: ee_i_vmulaz(ee); return;
-                                case 0x0000001B: ee_i_vmulaw(ee); return;
-                                case 0x0000001C: ee_i_vmulaq(ee); return;
-                                case 0x0000001D: ee_i_vabs(ee); return;
-                                case 0x0000001E: ee_i_vmulai(ee); return;
-                                case 0x0000001F: ee_i_vclipw(ee); return;
-                                case 0x00000020: ee_i_vaddaq(ee); return;
-                                case 0x00000021: ee_i_vmaddaq(ee); return;
-                                case 0x00000022: ee_i_vaddai(ee); return;
-                                case 0x00000023: ee_i_vmaddai(ee); return;
-                                case 0x00000024: ee_i_vsubaq(ee); return;
-                                case 0x00000025: ee_i_vmsubaq(ee); return;
-                                case 0x00000026: ee_i_vsubai(ee); return;
-                                case 0x00000027: ee_i_vmsubai(ee); return;
-                                case 0x00000028: ee_i_vadda(ee); return;
-                                case 0x00000029: ee_i_vmadda(ee); return;
-                                case 0x0000002A: ee_i_vmula(ee); return;
-                                case 0x0000002C: ee_i_vsuba(ee); return;
-                                case 0x0000002D: ee_i_vmsuba(ee); return;
-                                case 0x0000002E: ee_i_vopmula(ee); return;
-                                case 0x0000002F: ee_i_vnop(ee); return;
-                                case 0x00000030: ee_i_vmove(ee); return;
-                                case 0x00000031: ee_i_vmr32(ee); return;
-                                case 0x00000034: ee_i_vlqi(ee); return;
-                                case 0x00000035: ee_i_vsqi(ee); return;
-                                case 0x00000036: ee_i_vlqd(ee); return;
-                                case 0x00000037: ee_i_vsqd(ee); return;
-                                case 0x00000038: ee_i_vdiv(ee); return;
-                                case 0x00000039: ee_i_vsqrt(ee); return;
-                                case 0x0000003A: ee_i_vrsqrt(ee); return;
-                                case 0x0000003B: ee_i_vwaitq(ee); return;
-                                case 0x0000003C: ee_i_vmtir(ee); return;
-                                case 0x0000003D: ee_i_vmfir(ee); return;
-                                case 0x0000003E: ee_i_vilwr(ee); return;
-                                case 0x0000003F: ee_i_viswr(ee); return;
-                                case 0x00000040: ee_i_vrnext(ee); return;
-                                case 0x00000041: ee_i_vrget(ee); return;
-                                case 0x00000042: ee_i_vrinit(ee); return;
-                                case 0x00000043: ee_i_vrxor(ee); return;
+                                case 0x00000000: return ee_i_vaddax;
+                                case 0x00000001: return ee_i_vadday;
+                                case 0x00000002: return ee_i_vaddaz;
+                                case 0x00000003: return ee_i_vaddaw;
+                                case 0x00000004: return ee_i_vsubax;
+                                case 0x00000005: return ee_i_vsubay;
+                                case 0x00000006: return ee_i_vsubaz;
+                                case 0x00000007: return ee_i_vsubaw;
+                                case 0x00000008: return ee_i_vmaddax;
+                                case 0x00000009: return ee_i_vmadday;
+                                case 0x0000000A: return ee_i_vmaddaz;
+                                case 0x0000000B: return ee_i_vmaddaw;
+                                case 0x0000000C: return ee_i_vmsubax;
+                                case 0x0000000D: return ee_i_vmsubay;
+                                case 0x0000000E: return ee_i_vmsubaz;
+                                case 0x0000000F: return ee_i_vmsubaw;
+                                case 0x00000010: return ee_i_vitof0;
+                                case 0x00000011: return ee_i_vitof4;
+                                case 0x00000012: return ee_i_vitof12;
+                                case 0x00000013: return ee_i_vitof15;
+                                case 0x00000014: return ee_i_vftoi0;
+                                case 0x00000015: return ee_i_vftoi4;
+                                case 0x00000016: return ee_i_vftoi12;
+                                case 0x00000017: return ee_i_vftoi15;
+                                case 0x00000018: return ee_i_vmulax;
+                                case 0x00000019: return ee_i_vmulay;
+                                case 0x0000001A: return ee_i_vmulaz;
+                                case 0x0000001B: return ee_i_vmulaw;
+                                case 0x0000001C: return ee_i_vmulaq;
+                                case 0x0000001D: return ee_i_vabs;
+                                case 0x0000001E: return ee_i_vmulai;
+                                case 0x0000001F: return ee_i_vclipw;
+                                case 0x00000020: return ee_i_vaddaq;
+                                case 0x00000021: return ee_i_vmaddaq;
+                                case 0x00000022: return ee_i_vaddai;
+                                case 0x00000023: return ee_i_vmaddai;
+                                case 0x00000024: return ee_i_vsubaq;
+                                case 0x00000025: return ee_i_vmsubaq;
+                                case 0x00000026: return ee_i_vsubai;
+                                case 0x00000027: return ee_i_vmsubai;
+                                case 0x00000028: return ee_i_vadda;
+                                case 0x00000029: return ee_i_vmadda;
+                                case 0x0000002A: return ee_i_vmula;
+                                case 0x0000002C: return ee_i_vsuba;
+                                case 0x0000002D: return ee_i_vmsuba;
+                                case 0x0000002E: return ee_i_vopmula;
+                                case 0x0000002F: return ee_i_vnop;
+                                case 0x00000030: return ee_i_vmove;
+                                case 0x00000031: return ee_i_vmr32;
+                                case 0x00000034: return ee_i_vlqi;
+                                case 0x00000035: return ee_i_vsqi;
+                                case 0x00000036: return ee_i_vlqd;
+                                case 0x00000037: return ee_i_vsqd;
+                                case 0x00000038: return ee_i_vdiv;
+                                case 0x00000039: return ee_i_vsqrt;
+                                case 0x0000003A: return ee_i_vrsqrt;
+                                case 0x0000003B: return ee_i_vwaitq;
+                                case 0x0000003C: return ee_i_vmtir;
+                                case 0x0000003D: return ee_i_vmfir;
+                                case 0x0000003E: return ee_i_vilwr;
+                                case 0x0000003F: return ee_i_viswr;
+                                case 0x00000040: return ee_i_vrnext;
+                                case 0x00000041: return ee_i_vrget;
+                                case 0x00000042: return ee_i_vrinit;
+                                case 0x00000043: return ee_i_vrxor;
                             }
                         } break;
                     }
                 } break;
             }
         } break;
-        case 0x50000000 >> 26: ee_i_beql(ee); return;
-        case 0x54000000 >> 26: ee_i_bnel(ee); return;
-        case 0x58000000 >> 26: ee_i_blezl(ee); return;
-        case 0x5C000000 >> 26: ee_i_bgtzl(ee); return;
-        case 0x60000000 >> 26: ee_i_daddi(ee); return;
-        case 0x64000000 >> 26: ee_i_daddiu(ee); return;
-        case 0x68000000 >> 26: ee_i_ldl(ee); return;
-        case 0x6C000000 >> 26: ee_i_ldr(ee); return;
+        case 0x50000000 >> 26: return ee_i_beql;
+        case 0x54000000 >> 26: return ee_i_bnel;
+        case 0x58000000 >> 26: return ee_i_blezl;
+        case 0x5C000000 >> 26: return ee_i_bgtzl;
+        case 0x60000000 >> 26: return ee_i_daddi;
+        case 0x64000000 >> 26: return ee_i_daddiu;
+        case 0x68000000 >> 26: return ee_i_ldl;
+        case 0x6C000000 >> 26: return ee_i_ldr;
         case 0x70000000 >> 26: { // mmi
-            switch (ee->opcode & 0x0000003F) {
-                case 0x00000000: ee_i_madd(ee); return;
-                case 0x00000001: ee_i_maddu(ee); return;
-                case 0x00000004: ee_i_plzcw(ee); return;
+            switch (opcode & 0x0000003F) {
+                case 0x00000000: return ee_i_madd;
+                case 0x00000001: return ee_i_maddu;
+                case 0x00000004: return ee_i_plzcw;
                 case 0x00000008: {
-                    switch ((ee->opcode & 0x000007C0) >> 6) {
-                        case 0x00000000 >> 6: ee_i_paddw(ee); return;
-                        case 0x00000040 >> 6: ee_i_psubw(ee); return;
-                        case 0x00000080 >> 6: ee_i_pcgtw(ee); return;
-                        case 0x000000C0 >> 6: ee_i_pmaxw(ee); return;
-                        case 0x00000100 >> 6: ee_i_paddh(ee); return;
-                        case 0x00000140 >> 6: ee_i_psubh(ee); return;
-                        case 0x00000180 >> 6: ee_i_pcgth(ee); return;
-                        case 0x000001C0 >> 6: ee_i_pmaxh(ee); return;
-                        case 0x00000200 >> 6: ee_i_paddb(ee); return;
-                        case 0x00000240 >> 6: ee_i_psubb(ee); return;
-                        case 0x00000280 >> 6: ee_i_pcgtb(ee); return;
-                        case 0x00000400 >> 6: ee_i_paddsw(ee); return;
-                        case 0x00000440 >> 6: ee_i_psubsw(ee); return;
-                        case 0x00000480 >> 6: ee_i_pextlw(ee); return;
-                        case 0x000004C0 >> 6: ee_i_ppacw(ee); return;
-                        case 0x00000500 >> 6: ee_i_paddsh(ee); return;
-                        case 0x00000540 >> 6: ee_i_psubsh(ee); return;
-                        case 0x00000580 >> 6: ee_i_pextlh(ee); return;
-                        case 0x000005C0 >> 6: ee_i_ppach(ee); return;
-                        case 0x00000600 >> 6: ee_i_paddsb(ee); return;
-                        case 0x00000640 >> 6: ee_i_psubsb(ee); return;
-                        case 0x00000680 >> 6: ee_i_pextlb(ee); return;
-                        case 0x000006C0 >> 6: ee_i_ppacb(ee); return;
-                        case 0x00000780 >> 6: ee_i_pext5(ee); return;
-                        case 0x000007C0 >> 6: ee_i_ppac5(ee); return;
+                    switch ((opcode & 0x000007C0) >> 6) {
+                        case 0x00000000 >> 6: return ee_i_paddw;
+                        case 0x00000040 >> 6: return ee_i_psubw;
+                        case 0x00000080 >> 6: return ee_i_pcgtw;
+                        case 0x000000C0 >> 6: return ee_i_pmaxw;
+                        case 0x00000100 >> 6: return ee_i_paddh;
+                        case 0x00000140 >> 6: return ee_i_psubh;
+                        case 0x00000180 >> 6: return ee_i_pcgth;
+                        case 0x000001C0 >> 6: return ee_i_pmaxh;
+                        case 0x00000200 >> 6: return ee_i_paddb;
+                        case 0x00000240 >> 6: return ee_i_psubb;
+                        case 0x00000280 >> 6: return ee_i_pcgtb;
+                        case 0x00000400 >> 6: return ee_i_paddsw;
+                        case 0x00000440 >> 6: return ee_i_psubsw;
+                        case 0x00000480 >> 6: return ee_i_pextlw;
+                        case 0x000004C0 >> 6: return ee_i_ppacw;
+                        case 0x00000500 >> 6: return ee_i_paddsh;
+                        case 0x00000540 >> 6: return ee_i_psubsh;
+                        case 0x00000580 >> 6: return ee_i_pextlh;
+                        case 0x000005C0 >> 6: return ee_i_ppach;
+                        case 0x00000600 >> 6: return ee_i_paddsb;
+                        case 0x00000640 >> 6: return ee_i_psubsb;
+                        case 0x00000680 >> 6: return ee_i_pextlb;
+                        case 0x000006C0 >> 6: return ee_i_ppacb;
+                        case 0x00000780 >> 6: return ee_i_pext5;
+                        case 0x000007C0 >> 6: return ee_i_ppac5;
                     }
                 } break;
                 case 0x00000009: {
-                    switch ((ee->opcode & 0x000007C0) >> 6) {
-                        case 0x00000000 >> 6: ee_i_pmaddw(ee); return;
-                        case 0x00000080 >> 6: ee_i_psllvw(ee); return;
-                        case 0x000000C0 >> 6: ee_i_psrlvw(ee); return;
-                        case 0x00000100 >> 6: ee_i_pmsubw(ee); return;
-                        case 0x00000200 >> 6: ee_i_pmfhi(ee); return;
-                        case 0x00000240 >> 6: ee_i_pmflo(ee); return;
-                        case 0x00000280 >> 6: ee_i_pinth(ee); return;
-                        case 0x00000300 >> 6: ee_i_pmultw(ee); return;
-                        case 0x00000340 >> 6: ee_i_pdivw(ee); return;
-                        case 0x00000380 >> 6: ee_i_pcpyld(ee); return;
-                        case 0x00000400 >> 6: ee_i_pmaddh(ee); return;
-                        case 0x00000440 >> 6: ee_i_phmadh(ee); return;
-                        case 0x00000480 >> 6: ee_i_pand(ee); return;
-                        case 0x000004C0 >> 6: ee_i_pxor(ee); return;
-                        case 0x00000500 >> 6: ee_i_pmsubh(ee); return;
-                        case 0x00000540 >> 6: ee_i_phmsbh(ee); return;
-                        case 0x00000680 >> 6: ee_i_pexeh(ee); return;
-                        case 0x000006C0 >> 6: ee_i_prevh(ee); return;
-                        case 0x00000700 >> 6: ee_i_pmulth(ee); return;
-                        case 0x00000740 >> 6: ee_i_pdivbw(ee); return;
-                        case 0x00000780 >> 6: ee_i_pexew(ee); return;
-                        case 0x000007C0 >> 6: ee_i_prot3w(ee); return;
+                    switch ((opcode & 0x000007C0) >> 6) {
+                        case 0x00000000 >> 6: return ee_i_pmaddw;
+                        case 0x00000080 >> 6: return ee_i_psllvw;
+                        case 0x000000C0 >> 6: return ee_i_psrlvw;
+                        case 0x00000100 >> 6: return ee_i_pmsubw;
+                        case 0x00000200 >> 6: return ee_i_pmfhi;
+                        case 0x00000240 >> 6: return ee_i_pmflo;
+                        case 0x00000280 >> 6: return ee_i_pinth;
+                        case 0x00000300 >> 6: return ee_i_pmultw;
+                        case 0x00000340 >> 6: return ee_i_pdivw;
+                        case 0x00000380 >> 6: return ee_i_pcpyld;
+                        case 0x00000400 >> 6: return ee_i_pmaddh;
+                        case 0x00000440 >> 6: return ee_i_phmadh;
+                        case 0x00000480 >> 6: return ee_i_pand;
+                        case 0x000004C0 >> 6: return ee_i_pxor;
+                        case 0x00000500 >> 6: return ee_i_pmsubh;
+                        case 0x00000540 >> 6: return ee_i_phmsbh;
+                        case 0x00000680 >> 6: return ee_i_pexeh;
+                        case 0x000006C0 >> 6: return ee_i_prevh;
+                        case 0x00000700 >> 6: return ee_i_pmulth;
+                        case 0x00000740 >> 6: return ee_i_pdivbw;
+                        case 0x00000780 >> 6: return ee_i_pexew;
+                        case 0x000007C0 >> 6: return ee_i_prot3w;
                     }
                 } break;
-                case 0x00000010: ee_i_mfhi1(ee); return;
-                case 0x00000011: ee_i_mthi1(ee); return;
-                case 0x00000012: ee_i_mflo1(ee); return;
-                case 0x00000013: ee_i_mtlo1(ee); return;
-                case 0x00000018: ee_i_mult1(ee); return;
-                case 0x00000019: ee_i_multu1(ee); return;
-                case 0x0000001A: ee_i_div1(ee); return;
-                case 0x0000001B: ee_i_divu1(ee); return;
-                case 0x00000020: ee_i_madd1(ee); return;
-                case 0x00000021: ee_i_maddu1(ee); return;
+                case 0x00000010: return ee_i_mfhi1;
+                case 0x00000011: return ee_i_mthi1;
+                case 0x00000012: return ee_i_mflo1;
+                case 0x00000013: return ee_i_mtlo1;
+                case 0x00000018: return ee_i_mult1;
+                case 0x00000019: return ee_i_multu1;
+                case 0x0000001A: return ee_i_div1;
+                case 0x0000001B: return ee_i_divu1;
+                case 0x00000020: return ee_i_madd1;
+                case 0x00000021: return ee_i_maddu1;
                 case 0x00000028: {
-                    switch ((ee->opcode & 0x000007C0) >> 6) {
-                        case 0x00000040 >> 6: ee_i_pabsw(ee); return;
-                        case 0x00000080 >> 6: ee_i_pceqw(ee); return;
-                        case 0x000000C0 >> 6: ee_i_pminw(ee); return;
-                        case 0x00000100 >> 6: ee_i_padsbh(ee); return;
-                        case 0x00000140 >> 6: ee_i_pabsh(ee); return;
-                        case 0x00000180 >> 6: ee_i_pceqh(ee); return;
-                        case 0x000001C0 >> 6: ee_i_pminh(ee); return;
-                        case 0x00000280 >> 6: ee_i_pceqb(ee); return;
-                        case 0x00000400 >> 6: ee_i_padduw(ee); return;
-                        case 0x00000440 >> 6: ee_i_psubuw(ee); return;
-                        case 0x00000480 >> 6: ee_i_pextuw(ee); return;
-                        case 0x00000500 >> 6: ee_i_padduh(ee); return;
-                        case 0x00000540 >> 6: ee_i_psubuh(ee); return;
-                        case 0x00000580 >> 6: ee_i_pextuh(ee); return;
-                        case 0x00000600 >> 6: ee_i_paddub(ee); return;
-                        case 0x00000640 >> 6: ee_i_psubub(ee); return;
-                        case 0x00000680 >> 6: ee_i_pextub(ee); return;
-                        case 0x000006C0 >> 6: ee_i_qfsrv(ee); return;
+                    switch ((opcode & 0x000007C0) >> 6) {
+                        case 0x00000040 >> 6: return ee_i_pabsw;
+                        case 0x00000080 >> 6: return ee_i_pceqw;
+                        case 0x000000C0 >> 6: return ee_i_pminw;
+                        case 0x00000100 >> 6: return ee_i_padsbh;
+                        case 0x00000140 >> 6: return ee_i_pabsh;
+                        case 0x00000180 >> 6: return ee_i_pceqh;
+                        case 0x000001C0 >> 6: return ee_i_pminh;
+                        case 0x00000280 >> 6: return ee_i_pceqb;
+                        case 0x00000400 >> 6: return ee_i_padduw;
+                        case 0x00000440 >> 6: return ee_i_psubuw;
+                        case 0x00000480 >> 6: return ee_i_pextuw;
+                        case 0x00000500 >> 6: return ee_i_padduh;
+                        case 0x00000540 >> 6: return ee_i_psubuh;
+                        case 0x00000580 >> 6: return ee_i_pextuh;
+                        case 0x00000600 >> 6: return ee_i_paddub;
+                        case 0x00000640 >> 6: return ee_i_psubub;
+                        case 0x00000680 >> 6: return ee_i_pextub;
+                        case 0x000006C0 >> 6: return ee_i_qfsrv;
                     }
                 } break;
                 case 0x00000029: {
-                    switch ((ee->opcode & 0x000007C0) >> 6) {
-                        case 0x00000000 >> 6: ee_i_pmadduw(ee); return;
-                        case 0x000000C0 >> 6: ee_i_psravw(ee); return;
-                        case 0x00000200 >> 6: ee_i_pmthi(ee); return;
-                        case 0x00000240 >> 6: ee_i_pmtlo(ee); return;
-                        case 0x00000280 >> 6: ee_i_pinteh(ee); return;
-                        case 0x00000300 >> 6: ee_i_pmultuw(ee); return;
-                        case 0x00000340 >> 6: ee_i_pdivuw(ee); return;
-                        case 0x00000380 >> 6: ee_i_pcpyud(ee); return;
-                        case 0x00000480 >> 6: ee_i_por(ee); return;
-                        case 0x000004C0 >> 6: ee_i_pnor(ee); return;
-                        case 0x00000680 >> 6: ee_i_pexch(ee); return;
-                        case 0x000006C0 >> 6: ee_i_pcpyh(ee); return;
-                        case 0x00000780 >> 6: ee_i_pexcw(ee); return;
+                    switch ((opcode & 0x000007C0) >> 6) {
+                        case 0x00000000 >> 6: return ee_i_pmadduw;
+                        case 0x000000C0 >> 6: return ee_i_psravw;
+                        case 0x00000200 >> 6: return ee_i_pmthi;
+                        case 0x00000240 >> 6: return ee_i_pmtlo;
+                        case 0x00000280 >> 6: return ee_i_pinteh;
+                        case 0x00000300 >> 6: return ee_i_pmultuw;
+                        case 0x00000340 >> 6: return ee_i_pdivuw;
+                        case 0x00000380 >> 6: return ee_i_pcpyud;
+                        case 0x00000480 >> 6: return ee_i_por;
+                        case 0x000004C0 >> 6: return ee_i_pnor;
+                        case 0x00000680 >> 6: return ee_i_pexch;
+                        case 0x000006C0 >> 6: return ee_i_pcpyh;
+                        case 0x00000780 >> 6: return ee_i_pexcw;
                     }
                 } break;
                 case 0x00000030: {
-                    switch ((ee->opcode & 0x000007C0) >> 6) {
-                        case 0x00000000 >> 6: ee_i_pmfhllw(ee); return;
-                        case 0x00000040 >> 6: ee_i_pmfhluw(ee); return;
-                        case 0x00000080 >> 6: ee_i_pmfhlslw(ee); return;
-                        case 0x000000c0 >> 6: ee_i_pmfhllh(ee); return;
-                        case 0x00000100 >> 6: ee_i_pmfhlsh(ee); return;
+                    switch ((opcode & 0x000007C0) >> 6) {
+                        case 0x00000000 >> 6: return ee_i_pmfhllw;
+                        case 0x00000040 >> 6: return ee_i_pmfhluw;
+                        case 0x00000080 >> 6: return ee_i_pmfhlslw;
+                        case 0x000000c0 >> 6: return ee_i_pmfhllh;
+                        case 0x00000100 >> 6: return ee_i_pmfhlsh;
                     }
                 } break;
-                case 0x00000031: ee_i_pmthl(ee); return;
-                case 0x00000034: ee_i_psllh(ee); return;
-                case 0x00000036: ee_i_psrlh(ee); return;
-                case 0x00000037: ee_i_psrah(ee); return;
-                case 0x0000003C: ee_i_psllw(ee); return;
-                case 0x0000003E: ee_i_psrlw(ee); return;
-                case 0x0000003F: ee_i_psraw(ee); return;
+                case 0x00000031: return ee_i_pmthl;
+                case 0x00000034: return ee_i_psllh;
+                case 0x00000036: return ee_i_psrlh;
+                case 0x00000037: return ee_i_psrah;
+                case 0x0000003C: return ee_i_psllw;
+                case 0x0000003E: return ee_i_psrlw;
+                case 0x0000003F: return ee_i_psraw;
             }
         } break;
-        case 0x78000000 >> 26: ee_i_lq(ee); return;
-        case 0x7C000000 >> 26: ee_i_sq(ee); return;
-        case 0x80000000 >> 26: ee_i_lb(ee); return;
-        case 0x84000000 >> 26: ee_i_lh(ee); return;
-        case 0x88000000 >> 26: ee_i_lwl(ee); return;
-        case 0x8C000000 >> 26: ee_i_lw(ee); return;
-        case 0x90000000 >> 26: ee_i_lbu(ee); return;
-        case 0x94000000 >> 26: ee_i_lhu(ee); return;
-        case 0x98000000 >> 26: ee_i_lwr(ee); return;
-        case 0x9C000000 >> 26: ee_i_lwu(ee); return;
-        case 0xA0000000 >> 26: ee_i_sb(ee); return;
-        case 0xA4000000 >> 26: ee_i_sh(ee); return;
-        case 0xA8000000 >> 26: ee_i_swl(ee); return;
-        case 0xAC000000 >> 26: ee_i_sw(ee); return;
-        case 0xB0000000 >> 26: ee_i_sdl(ee); return;
-        case 0xB4000000 >> 26: ee_i_sdr(ee); return;
-        case 0xB8000000 >> 26: ee_i_swr(ee); return;
-        case 0xBC000000 >> 26: ee_i_cache(ee); return;
-        case 0xC4000000 >> 26: ee_i_lwc1(ee); return;
-        case 0xCC000000 >> 26: ee_i_pref(ee); return;
-        case 0xD8000000 >> 26: ee_i_lqc2(ee); return;
-        case 0xDC000000 >> 26: ee_i_ld(ee); return;
-        case 0xE4000000 >> 26: ee_i_swc1(ee); return;
-        case 0xF8000000 >> 26: ee_i_sqc2(ee); return;
-        case 0xFC000000 >> 26: ee_i_sd(ee); return;
+        case 0x78000000 >> 26: return ee_i_lq;
+        case 0x7C000000 >> 26: return ee_i_sq;
+        case 0x80000000 >> 26: return ee_i_lb;
+        case 0x84000000 >> 26: return ee_i_lh;
+        case 0x88000000 >> 26: return ee_i_lwl;
+        case 0x8C000000 >> 26: return ee_i_lw;
+        case 0x90000000 >> 26: return ee_i_lbu;
+        case 0x94000000 >> 26: return ee_i_lhu;
+        case 0x98000000 >> 26: return ee_i_lwr;
+        case 0x9C000000 >> 26: return ee_i_lwu;
+        case 0xA0000000 >> 26: return ee_i_sb;
+        case 0xA4000000 >> 26: return ee_i_sh;
+        case 0xA8000000 >> 26: return ee_i_swl;
+        case 0xAC000000 >> 26: return ee_i_sw;
+        case 0xB0000000 >> 26: return ee_i_sdl;
+        case 0xB4000000 >> 26: return ee_i_sdr;
+        case 0xB8000000 >> 26: return ee_i_swr;
+        case 0xBC000000 >> 26: return ee_i_cache;
+        case 0xC4000000 >> 26: return ee_i_lwc1;
+        case 0xCC000000 >> 26: return ee_i_pref;
+        case 0xD8000000 >> 26: return ee_i_lqc2;
+        case 0xDC000000 >> 26: return ee_i_ld;
+        case 0xE4000000 >> 26: return ee_i_swc1;
+        case 0xF8000000 >> 26: return ee_i_sqc2;
+        case 0xFC000000 >> 26: return ee_i_sd;
     }
 
-    printf("ee: Invalid instruction %08x @ pc=%08x (cyc=%ld)\n", ee->opcode, ee->prev_pc, ee->total_cycles);
+    return ee_i_invalid;
+}
 
-    exit(1);
+void ee_decode_instruction(struct ee_instruction* ins, uint32_t opcode) {
+    ins->func = ee_decode(opcode);
+    ins->opcode = opcode;
+    ins->i16 = opcode & 0xffff;
+    ins->i26 = opcode & 0x3ffffff;
+    ins->si16 = (int32_t)(opcode << 16) >> 14;
+    ins->rs = (opcode >> 21) & 0x1f;
+    ins->rt = (opcode >> 16) & 0x1f;
+    ins->rd = (opcode >> 11) & 0x1f;
+    ins->sa = (opcode >> 6) & 0x1f;
+}
+
+static struct ee_code_page* ee_load_code_page(struct ee_state* ee, uint32_t phys) {
+    struct ee_code_page* page = ee->code_cache[phys >> 13];
+
+    if (!page) {
+        page = malloc(sizeof(struct ee_code_page));
+        page->invalidations = 0;
+
+        ee->code_cache[phys >> 13] = page;
+    } else if (page->invalidations >= EE_CODE_PAGE_MAX_INVALIDATIONS) {
+        return NULL;
+    }
+
+    memset(page->ins, 0, sizeof(page->ins));
+
+    page->dirty = 0;
+
+    ee->bus.protect_code(ee->bus.udata, phys);
+
+    return page;
+}
+
+static inline struct ee_instruction* ee_fetch_cached(struct ee_state* ee) {
+    uint32_t phys;
+
+    // Only main RAM and BIOS code is cached, writes to anything else
+    // can't be tracked
+    if ((ee->pc & 3) || !ee->bus.protect_code)
+        return NULL;
+
+    if (((ee->pc & 0x70000000) == 0x70000000) || ee_translate_virt(ee, ee->pc, &phys))
+        return NULL;
+
+    if ((phys >= 0x02000000) && (phys < 0x1fc00000))
+        return NULL;
+
+    struct ee_code_page* page = ee->code_cache[phys >> 13];
+
+    if (!page || page->dirty) {
+        page = ee_load_code_page(ee, phys);
+
+        if (!page)
+            return NULL;
+    }
+
+    struct ee_instruction* ins = &page->ins[(phys & 0x1fff) >> 2];
+
+    if (!ins->func)
+        ee_decode_instruction(ins, ee->bus.read32(ee->bus.udata, phys));
+
+    return ins;
+}
+
+static inline struct ee_instruction* ee_fetch(struct ee_state* ee) {
+    struct ee_instruction* ins = ee_fetch_cached(ee);
+
+    if (ins)
+        return ins;
+
+    ee_decode_instruction(&ee->uncached, bus_read32(ee, ee->pc));
+
+    return &ee->uncached;
+}
+
+void ee_invalidate_code(struct ee_state* ee, uint32_t addr) {
+    struct ee_code_page* page = ee->code_cache[addr >> 13];
+
+    if (!page || page->dirty)
+        return;
+
+    page->dirty = 1;
+    page->invalidations++;
+}
+
+void ee_flush_code(struct ee_state* ee) {
+    for (int i = 0; i < 0x10000; i++) {
+        free(ee->code_cache[i]);
+
+        ee->code_cache[i] = NULL;
+    }
+}
+
+static inline void ee_execute(struct ee_state* ee) {
+    ee->ins->func(ee);
 }
 
 int loop = 0;
@@ -3114,7 +3234,8 @@ void ee_cycle(struct ee_state* ee) {
     // }
 
     ee->prev_pc = ee->pc;
-    ee->opcode = bus_read32(ee, ee->pc);
+    ee->ins = ee_fetch(ee);
+    ee->opcode = ee->ins->opcode;
 
     // if (p) {
     //     // fwrite(&ee->pc, 4, 1, file);
@@ -3190,9 +3311,26 @@ void ee_reset(struct ee_state* ee) {
     ee->prid = 0x2e20;
     ee->pc = EE_VEC_RESET;
     ee->next_pc = ee->pc + 4;
+
+    idle_loop_reset(&ee->idle);
+}
+
+static uint32_t ee_idle_read(void* udata, uint32_t addr) {
+    return bus_read32((struct ee_state*)udata, addr);
+}
+
+// Checks the loop the EE just jumped back into, prev_pc holds the
+// delay slot of the backward branch
+int ee_check_idle_loop(struct ee_state* ee) {
+    // Interrupts would take the EE out of the loop right away
+    if ((ee->cause & ee->status & (EE_CAUSE_IP2 | EE_CAUSE_IP3)) && (ee->status & EE_SR_IE))
+        return 0;
+
+    return idle_loop_check(&ee->idle, ee->pc, ee->prev_pc, 1, ee_idle_read, ee);
 }
 
 void ee_destroy(struct ee_state* ee) {
+    ee_flush_code(ee);
     ps2_ram_destroy(ee->scratchpad);
 
     free(ee);
@@ -8,11 +8,17 @@ extern "C" {
 #include <stdint.h>
 
 #include "shared/ram.h"
+#include "shared/idle.h"
 
 #include "u128.h"
 
 #include "vu.h"
 
+struct ee_state;
+
+// Instruction handler, as returned by ee_decode
+typedef void (*ee_instruction_func)(struct ee_state* ee);
+
 struct ee_bus_s {
     void* udata;
     uint64_t (*read8)(void* udata, uint32_t addr);
@@ -25,6 +31,10 @@ struct ee_bus_s {
     void (*write32)(void* udata, uint32_t addr, uint64_t data);
     void (*write64)(void* udata, uint32_t addr, uint64_t data);
     void (*write128)(void* udata, uint32_t addr, uint128_t data);
+
+    // Optional, write-protects a physical page so writes to it get
+    // reported back through ee_invalidate_code
+    void (*protect_code)(void* udata, uint32_t addr);
 };
 
 #define EE_SR_CU  0xf0000000
@@ -126,6 +136,35 @@ union ee_fpu_reg {
 #define EE_ALIGNED16
 #endif
 
+// Pre-decoded instruction, fields are extracted once so handlers
+// don't have to re-parse the opcode every time it's executed
+struct ee_instruction {
+    ee_instruction_func func;
+    uint32_t opcode;
+    uint32_t i16;
+    uint32_t i26;
+    int32_t si16; // Sign-extended and shifted, for branches
+    uint8_t rs;
+    uint8_t rt;
+    uint8_t rd;
+    uint8_t sa;
+};
+
+#define EE_CODE_PAGE_SIZE 0x800
+#define EE_CODE_PAGE_MAX_INVALIDATIONS 256
+
+struct ee_code_page {
+    // Set when the page gets written to, entries are only cleared
+    // on the next fetch since the running instruction may live here
+    int dirty;
+
+    // Pages that keep getting written to (code and data sharing a
+    // page) stop being cached past EE_CODE_PAGE_MAX_INVALIDATIONS
+    int invalidations;
+
+    struct ee_instruction ins[EE_CODE_PAGE_SIZE];
+};
+
 struct ee_state {
     struct ee_bus_s bus;
 
@@ -195,6 +234,17 @@ struct ee_state {
     struct vu_state* vu1;
 
     struct ee_vtlb_entry vtlb[48];
+
+    // Instruction being executed
+    struct ee_instruction* ins;
+
+    // Used for code outside of main RAM and BIOS
+    struct ee_instruction uncached;
+
+    // Decoded instruction cache, indexed by physical page (8 KiB)
+    struct ee_code_page* code_cache[0x10000];
+
+    struct idle_loop idle;
 };
 
 struct ee_state* ee_create(void);
@@ -205,6 +255,12 @@ void ee_destroy(struct ee_state* ee);
 void ee_set_int0(struct ee_state* ee, int v);
 void ee_set_int1(struct ee_state* ee, int v);
 void ee_set_cpcond0(struct ee_state* ee, int v);
+int ee_check_irq(struct ee_state* ee);
+ee_instruction_func ee_decode(uint32_t opcode);
+void ee_decode_instruction(struct ee_instruction* ins, uint32_t opcode);
+void ee_invalidate_code(struct ee_state* ee, uint32_t addr);
+void ee_flush_code(struct ee_state* ee);
+int ee_check_idle_loop(struct ee_state* ee);
 
 #undef EE_ALIGNED16
 
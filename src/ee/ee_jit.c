@@ -0,0 +1,474 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "ee_jit.h"
+
+/*
+    EE block recompiler (x86-64)
+
+    Basic blocks are translated into straight-line host code that
+    calls the interpreter's instruction handlers directly, with
+    pre-decoded instructions baked in as immediates. Fetching,
+    decoding and the per-instruction bookkeeping done by ee_cycle
+    are emitted inline, so the resulting state is identical to the
+    interpreter's on every instruction boundary.
+
+    Blocks are cached by physical address and never cross an 8 KiB
+    page. Pages holding code are write-protected through the bus'
+    fastmem write table, the first write to one of them drops every
+    block compiled from that page.
+
+    Register usage:
+      rbx - struct ee_state*
+      rax - scratch
+*/
+
+#define BRANCH_NONE  0
+#define BRANCH_DELAY 1 // Has a delay slot
+#define BRANCH_END   2 // Always ends the block (syscall, eret, etc.)
+
+#ifdef _WIN32
+#define ABI_ARG0_RBX 0xd9 // mov rcx, rbx
+#define ABI_ARG1_IMM 0xba // mov rdx, imm64
+#define ABI_RBX_ARG0 0xcb // mov rbx, rcx
+#define ABI_SHADOW_SPACE 32
+#else
+#define ABI_ARG0_RBX 0xdf // mov rdi, rbx
+#define ABI_ARG1_IMM 0xbe // mov rsi, imm64
+#define ABI_RBX_ARG0 0xfb // mov rbx, rdi
+#define ABI_SHADOW_SPACE 0
+#endif
+
+// Worst case host code size for a single EE instruction
+#define EE_JIT_INSTRUCTION_SIZE 256
+
+#define EE_OFFSET(m) ((uint32_t)offsetof(struct ee_state, m))
+
+static inline void* ee_jit_alloc_code(size_t size) {
+#ifdef _WIN32
+    return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    return ptr == MAP_FAILED ? NULL : ptr;
+#endif
+}
+
+static inline void ee_jit_free_code(void* ptr, size_t size) {
+#ifdef _WIN32
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+    munmap(ptr, size);
+#endif
+}
+
+static inline void emit8(struct ee_jit* jit, uint8_t v) {
+    *jit->code_ptr++ = v;
+}
+
+static inline void emit32(struct ee_jit* jit, uint32_t v) {
+    memcpy(jit->code_ptr, &v, 4);
+
+    jit->code_ptr += 4;
+}
+
+static inline void emit64(struct ee_jit* jit, uint64_t v) {
+    memcpy(jit->code_ptr, &v, 8);
+
+    jit->code_ptr += 8;
+}
+
+// mov eax, dword [rbx+off]
+static inline void emit_load_eax(struct ee_jit* jit, uint32_t off) {
+    emit8(jit, 0x8b); emit8(jit, 0x83); emit32(jit, off);
+}
+
+// mov dword [rbx+off], eax
+static inline void emit_store_eax(struct ee_jit* jit, uint32_t off) {
+    emit8(jit, 0x89); emit8(jit, 0x83); emit32(jit, off);
+}
+
+// mov qword [rbx+off], rax
+static inline void emit_store_rax(struct ee_jit* jit, uint32_t off) {
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, 0x83); emit32(jit, off);
+}
+
+// mov rax, imm64; mov qword [rbx+off], rax
+static inline void emit_store_imm64(struct ee_jit* jit, uint32_t off, uint64_t imm) {
+    emit8(jit, 0x48); emit8(jit, 0xb8); emit64(jit, imm);
+    emit_store_rax(jit, off);
+}
+
+// mov dword [rbx+off], imm32
+static inline void emit_store_imm32(struct ee_jit* jit, uint32_t off, uint32_t imm) {
+    emit8(jit, 0xc7); emit8(jit, 0x83); emit32(jit, off); emit32(jit, imm);
+}
+
+// mov eax, imm32
+static inline void emit_mov_eax_imm32(struct ee_jit* jit, uint32_t imm) {
+    emit8(jit, 0xb8); emit32(jit, imm);
+}
+
+// jmp rel32
+static inline void emit_jmp(struct ee_jit* jit, uint8_t* target) {
+    emit8(jit, 0xe9); emit32(jit, (uint32_t)(target - (jit->code_ptr + 4)));
+}
+
+// Call func(ee) or func(ee, arg) if arg is non-NULL
+static inline void emit_call(struct ee_jit* jit, uintptr_t func, void* arg) {
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, ABI_ARG0_RBX);
+
+    if (arg) {
+        emit8(jit, 0x48); emit8(jit, ABI_ARG1_IMM); emit64(jit, (uintptr_t)arg);
+    }
+
+    // mov rax, imm64; call rax
+    emit8(jit, 0x48); emit8(jit, 0xb8); emit64(jit, func);
+    emit8(jit, 0xff); emit8(jit, 0xd0);
+}
+
+// Leave the block returning "count" if ZF is clear
+static inline void emit_exit_if_nz(struct ee_jit* jit, uint8_t* epilogue, int count) {
+    // jz +10
+    emit8(jit, 0x74); emit8(jit, 0x0a);
+    emit_mov_eax_imm32(jit, count);
+    emit_jmp(jit, epilogue);
+}
+
+static inline int ee_jit_branch_type(uint32_t opcode) {
+    switch (opcode >> 26) {
+        case 0x00: {
+            switch (opcode & 0x3f) {
+                case 0x08: // jr
+                case 0x09: // jalr
+                    return BRANCH_DELAY;
+
+                case 0x0c: // syscall
+                case 0x0d: // break
+                    return BRANCH_END;
+            }
+        } break;
+
+        case 0x01: {
+            switch ((opcode >> 16) & 0x1f) {
+                case 0x00: case 0x01: case 0x02: case 0x03: // bltz/bgez(l)
+                case 0x10: case 0x11: case 0x12: case 0x13: // bltzal/bgezal(l)
+                    return BRANCH_DELAY;
+            }
+        } break;
+
+        case 0x02: case 0x03: // j/jal
+        case 0x04: case 0x05: case 0x06: case 0x07: // beq/bne/blez/bgtz
+        case 0x14: case 0x15: case 0x16: case 0x17: // likely variants
+            return BRANCH_DELAY;
+
+        case 0x10: {
+            // bc0x
+            if (((opcode >> 21) & 0x1f) == 0x08)
+                return BRANCH_DELAY;
+
+            // eret
+            if ((opcode & 0x03e0003f) == 0x02000018)
+                return BRANCH_END;
+        } break;
+
+        case 0x11: case 0x12: {
+            // bc1x/bc2x
+            if (((opcode >> 21) & 0x1f) == 0x08)
+                return BRANCH_DELAY;
+        } break;
+    }
+
+    return BRANCH_NONE;
+}
+
+// Instructions that might raise an interrupt or write to code,
+// the following instruction has to sync with the dispatcher first
+static inline int ee_jit_needs_sync(uint32_t opcode) {
+    switch (opcode >> 26) {
+        case 0x10: // cop0
+        case 0x1f: // sq
+        case 0x28: case 0x29: case 0x2a: case 0x2b: // sb/sh/swl/sw
+        case 0x2c: case 0x2d: case 0x2e: // sdl/sdr/swr
+        case 0x39: case 0x3e: case 0x3f: // swc1/sqc2/sd
+            return 1;
+
+        case 0x12: {
+            switch ((opcode >> 21) & 0x1f) {
+                case 0x05: // qmtc2
+                case 0x06: // ctc2
+                    return 1;
+            }
+        } break;
+    }
+
+    return 0;
+}
+
+static int ee_jit_sync(struct ee_state* ee, struct ee_jit* jit) {
+    if (jit->invalidated)
+        return 1;
+
+    return ee_check_irq(ee);
+}
+
+static inline void ee_jit_emit_instruction(struct ee_jit* jit, uint8_t* epilogue, uint32_t opcode, int index, int sync) {
+    struct ee_instruction* ins = &jit->ins[jit->ins_count++];
+
+    ee_decode_instruction(ins, opcode);
+
+    // delay_slot = branch, branch = 0
+    emit_load_eax(jit, EE_OFFSET(branch));
+    emit_store_eax(jit, EE_OFFSET(delay_slot));
+    emit_store_imm32(jit, EE_OFFSET(branch), 0);
+
+    if (sync) {
+        emit_call(jit, (uintptr_t)ee_jit_sync, jit);
+
+        // test eax, eax
+        emit8(jit, 0x85); emit8(jit, 0xc0);
+        emit_exit_if_nz(jit, epilogue, index);
+    }
+
+    // prev_pc = pc, pc = next_pc, next_pc += 4
+    emit_load_eax(jit, EE_OFFSET(pc));
+    emit_store_eax(jit, EE_OFFSET(prev_pc));
+    emit_store_imm32(jit, EE_OFFSET(opcode), opcode);
+    emit_store_imm64(jit, EE_OFFSET(ins), (uintptr_t)ins);
+    emit_load_eax(jit, EE_OFFSET(next_pc));
+    emit_store_eax(jit, EE_OFFSET(pc));
+    emit8(jit, 0x83); emit8(jit, 0xc0); emit8(jit, 0x04);
+    emit_store_eax(jit, EE_OFFSET(next_pc));
+
+    emit_call(jit, (uintptr_t)ins->func, NULL);
+
+    // inc qword [rbx+total_cycles]; inc dword [rbx+count]
+    emit8(jit, 0x48); emit8(jit, 0xff); emit8(jit, 0x83); emit32(jit, EE_OFFSET(total_cycles));
+    emit8(jit, 0xff); emit8(jit, 0x83); emit32(jit, EE_OFFSET(count));
+
+    // Only instructions with a zero rt or rd field can write to r0
+    if (!(opcode & 0x001f0000) || !(opcode & 0x0000f800)) {
+        // xor eax, eax
+        emit8(jit, 0x31); emit8(jit, 0xc0);
+        emit_store_rax(jit, EE_OFFSET(r));
+        emit_store_rax(jit, EE_OFFSET(r) + 8);
+    }
+
+    // Leave if the instruction didn't fall through (taken likely
+    // branches, exceptions, eret, etc.)
+    emit_load_eax(jit, EE_OFFSET(prev_pc));
+    emit8(jit, 0x83); emit8(jit, 0xc0); emit8(jit, 0x04);
+
+    // cmp eax, dword [rbx+pc]
+    emit8(jit, 0x3b); emit8(jit, 0x83); emit32(jit, EE_OFFSET(pc));
+
+    // je +10
+    emit8(jit, 0x74); emit8(jit, 0x0a);
+    emit_mov_eax_imm32(jit, index + 1);
+    emit_jmp(jit, epilogue);
+}
+
+static ee_jit_block_func ee_jit_compile(struct ee_jit* jit, uint32_t phys) {
+    size_t worst = (EE_JIT_MAX_BLOCK_SIZE * EE_JIT_INSTRUCTION_SIZE) + 64;
+
+    if ((size_t)(jit->code_ptr - jit->code) + worst > EE_JIT_CODE_SIZE)
+        ee_jit_flush(jit);
+
+    if (jit->ins_count + EE_JIT_MAX_BLOCK_SIZE > EE_JIT_MAX_INSTRUCTIONS)
+        ee_jit_flush(jit);
+
+    uint32_t page = phys >> 13;
+
+    if (!jit->block_table[page])
+        jit->block_table[page] = calloc(0x800, sizeof(ee_jit_block_func));
+
+    uint8_t* mem = jit->bus->fastmem_r_table[page];
+
+    // Epilogue goes first so every exit is a backwards jump
+    uint8_t* epilogue = jit->code_ptr;
+
+    if (ABI_SHADOW_SPACE) {
+        // add rsp, 32
+        emit8(jit, 0x48); emit8(jit, 0x83); emit8(jit, 0xc4); emit8(jit, ABI_SHADOW_SPACE);
+    }
+
+    // pop rbx; ret
+    emit8(jit, 0x5b);
+    emit8(jit, 0xc3);
+
+    uint8_t* entry = jit->code_ptr;
+
+    // push rbx
+    emit8(jit, 0x53);
+
+    if (ABI_SHADOW_SPACE) {
+        // sub rsp, 32
+        emit8(jit, 0x48); emit8(jit, 0x83); emit8(jit, 0xec); emit8(jit, ABI_SHADOW_SPACE);
+    }
+
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, ABI_RBX_ARG0);
+
+    uint32_t addr = phys;
+    int delay_slot = 0;
+    int sync = 1;
+    int count = 0;
+
+    while (1) {
+        uint32_t opcode = *(uint32_t*)(mem + (addr & 0x1fff));
+
+        ee_jit_emit_instruction(jit, epilogue, opcode, count, sync);
+
+        sync = ee_jit_needs_sync(opcode);
+        addr += 4;
+
+        ++count;
+
+        if (delay_slot)
+            break;
+
+        int type = ee_jit_branch_type(opcode);
+
+        if (type == BRANCH_END)
+            break;
+
+        // Blocks can end between a branch and its delay slot, the
+        // interpreter state carries the pending branch over
+        if (!(addr & 0x1fff))
+            break;
+
+        if (type == BRANCH_DELAY) {
+            delay_slot = 1;
+
+            continue;
+        }
+
+        if (count >= EE_JIT_MAX_BLOCK_SIZE)
+            break;
+    }
+
+    emit_mov_eax_imm32(jit, count);
+    emit_jmp(jit, epilogue);
+
+    ee_jit_block_func block = (ee_jit_block_func)(uintptr_t)entry;
+
+    jit->block_table[page][(phys & 0x1fff) >> 2] = block;
+    jit->blocks_compiled++;
+
+    ee_bus_protect_code_page(jit->bus, phys);
+
+    return block;
+}
+
+static inline int ee_jit_translate(struct ee_jit* jit, uint32_t virt, uint32_t* phys) {
+    switch (virt & 0xe0000000) {
+        case 0x80000000:
+        case 0xa0000000: {
+            *phys = virt & 0x1fffffff;
+        } break;
+
+        default: {
+            uint32_t seg = virt & 0xfe000000;
+
+            if ((seg != 0x00000000) && (seg != 0x20000000) && (seg != 0x30000000))
+                return 0;
+
+            *phys = virt & 0x1ffffff;
+        } break;
+    }
+
+    // Main RAM and BIOS only
+    if ((*phys >= 0x02000000) && (*phys < 0x1fc00000))
+        return 0;
+
+    return jit->bus->fastmem_r_table[*phys >> 13] != NULL;
+}
+
+struct ee_jit* ee_jit_create(void) {
+    return malloc(sizeof(struct ee_jit));
+}
+
+int ee_jit_init(struct ee_jit* jit, struct ee_state* ee, struct ee_bus* bus) {
+    memset(jit, 0, sizeof(struct ee_jit));
+
+    jit->ee = ee;
+    jit->bus = bus;
+
+#ifndef EE_JIT_SUPPORTED
+    return 1;
+#else
+    jit->code = ee_jit_alloc_code(EE_JIT_CODE_SIZE);
+
+    if (!jit->code) {
+        printf("ee_jit: Couldn't allocate code buffer\n");
+
+        return 1;
+    }
+
+    jit->code_ptr = jit->code;
+    jit->ins = malloc(EE_JIT_MAX_INSTRUCTIONS * sizeof(struct ee_instruction));
+
+    return 0;
+#endif
+}
+
+int ee_jit_run(struct ee_jit* jit) {
+    struct ee_state* ee = jit->ee;
+    uint32_t phys;
+
+    if ((ee->pc & 3) || !ee_jit_translate(jit, ee->pc, &phys)) {
+        ee_cycle(ee);
+
+        return 1;
+    }
+
+    ee_jit_block_func* table = jit->block_table[phys >> 13];
+    ee_jit_block_func block = table ? table[(phys & 0x1fff) >> 2] : NULL;
+
+    if (!block)
+        block = ee_jit_compile(jit, phys);
+
+    jit->running_page = phys >> 13;
+    jit->invalidated = 0;
+
+    return block(ee);
+}
+
+void ee_jit_invalidate(struct ee_jit* jit, uint32_t addr) {
+    uint32_t page = addr >> 13;
+
+    if (jit->block_table[page])
+        memset(jit->block_table[page], 0, 0x800 * sizeof(ee_jit_block_func));
+
+    if (page == jit->running_page)
+        jit->invalidated = 1;
+}
+
+void ee_jit_flush(struct ee_jit* jit) {
+    for (int i = 0; i < 0x10000; i++) {
+        free(jit->block_table[i]);
+
+        jit->block_table[i] = NULL;
+    }
+
+    jit->code_ptr = jit->code;
+    jit->ins_count = 0;
+    jit->flushes++;
+}
+
+void ee_jit_destroy(struct ee_jit* jit) {
+    if (jit->code) {
+        ee_jit_flush(jit);
+        ee_jit_free_code(jit->code, EE_JIT_CODE_SIZE);
+    }
+
+    free(jit->ins);
+
+    free(jit);
+}
@@ -0,0 +1,60 @@
+#ifndef EE_JIT_H
+#define EE_JIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ee.h"
+#include "bus.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define EE_JIT_SUPPORTED
+#endif
+
+#define EE_JIT_CODE_SIZE 0x2000000
+#define EE_JIT_MAX_BLOCK_SIZE 128
+#define EE_JIT_MAX_INSTRUCTIONS 0x40000
+
+// Returns the number of instructions executed
+typedef int (*ee_jit_block_func)(struct ee_state* ee);
+
+struct ee_jit {
+    struct ee_state* ee;
+    struct ee_bus* bus;
+
+    uint8_t* code;
+    uint8_t* code_ptr;
+
+    // Decoded instructions referenced by compiled code
+    struct ee_instruction* ins;
+    int ins_count;
+
+    // Block entry points, indexed by physical page (8 KiB) and
+    // then by word offset within the page
+    ee_jit_block_func* block_table[0x10000];
+
+    // Set when the page holding the running block gets written to
+    uint32_t running_page;
+    int invalidated;
+
+    // Stats
+    uint64_t blocks_compiled;
+    uint64_t flushes;
+};
+
+struct ee_jit* ee_jit_create(void);
+int ee_jit_init(struct ee_jit* jit, struct ee_state* ee, struct ee_bus* bus);
+int ee_jit_run(struct ee_jit* jit);
+void ee_jit_invalidate(struct ee_jit* jit, uint32_t addr);
+void ee_jit_flush(struct ee_jit* jit);
+void ee_jit_destroy(struct ee_jit* jit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,10 +1,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <inttypes.h>
 
 #include "gif.h"
 
-#define printf(fmt, ...)(0)
+// 0: silent, 1: GIFtags, 2: every register write
+#ifndef GIF_LOG_LEVEL
+#define GIF_LOG_LEVEL 0
+#endif
+
+#define gif_log(level, ...) do { if ((level) <= GIF_LOG_LEVEL) printf(__VA_ARGS__); } while (0)
 
 static inline const char* gif_get_reg_name(uint8_t r) {
     switch (r) {
@@ -148,6 +154,38 @@ void gif_write_fog(struct ps2_gif* gif, uint128_t data) {
     ps2_gs_write_internal(gif->gs, GS_FOG, data.u64[1] << 20);
 }
 
+static inline int gif_get_packed_layout(struct gif_tag* tag) {
+    // Trace every register write through the generic path
+    if (GIF_LOG_LEVEL >= 2)
+        return GIF_PACKED_GENERIC;
+
+    int ad = 1;
+
+    for (int i = 0; i < tag->nregs; i++)
+        ad &= tag->regs[i] == 0x0e;
+
+    if (ad)
+        return GIF_PACKED_AD;
+
+    if (tag->nregs == 3) {
+        if ((tag->regs[0] == 0x02) && (tag->regs[1] == 0x01) && (tag->regs[2] == 0x05))
+            return GIF_PACKED_STQ_RGBAQ_XYZ2;
+
+        if ((tag->regs[0] == 0x02) && (tag->regs[1] == 0x01) && (tag->regs[2] == 0x04))
+            return GIF_PACKED_STQ_RGBAQ_XYZF2;
+    }
+
+    if (tag->nregs == 2) {
+        if ((tag->regs[0] == 0x01) && (tag->regs[1] == 0x05))
+            return GIF_PACKED_RGBAQ_XYZ2;
+
+        if ((tag->regs[0] == 0x01) && (tag->regs[1] == 0x04))
+            return GIF_PACKED_RGBAQ_XYZF2;
+    }
+
+    return GIF_PACKED_GENERIC;
+}
+
 void gif_handle_tag(struct ps2_gif* gif, uint128_t data) {
     // 1.0f
     gif->q = 0x3f800000;
@@ -160,9 +198,16 @@ void gif_handle_tag(struct ps2_gif* gif, uint128_t data) {
     gif->tag.nregs = (data.u64[0] >> 60) & 0xf;
     gif->tag.reg = data.u64[1];
     gif->tag.index = 0;
+    gif->tag.cur = 0;
+
+    for (int i = 0; i < gif->tag.nregs; i++)
+        gif->tag.regs[i] = (gif->tag.reg >> (i * 4)) & 0xf;
 
     switch (gif->tag.fmt) {
-        case 0:
+        case 0: {
+            gif->tag.remaining = gif->tag.nregs * gif->tag.nloop;
+            gif->tag.layout = gif_get_packed_layout(&gif->tag);
+        } break;
         case 1: {
             gif->tag.remaining = gif->tag.nregs * gif->tag.nloop;
         } break;
@@ -172,9 +217,9 @@ void gif_handle_tag(struct ps2_gif* gif, uint128_t data) {
         } break;
     }
 
-    // printf("giftag: nloop=%04lx eop=%d prim=%d fmt=%d nregs=%d reg=%016lx\n",
-    //     gif->tag.nloop, gif->tag.eop, gif->tag.prim, gif->tag.fmt, gif->tag.nregs, gif->tag.reg
-    // );
+    gif_log(1, "giftag: nloop=%04" PRIx64 " eop=%d prim=%d fmt=%d nregs=%d reg=%016" PRIx64 "\n",
+        gif->tag.nloop, gif->tag.eop, gif->tag.prim, gif->tag.fmt, gif->tag.nregs, gif->tag.reg
+    );
 
     if (gif->tag.pre) {
         ps2_gs_write_internal(gif->gs, GS_PRIM, gif->tag.prim);
@@ -185,36 +230,47 @@ void gif_handle_tag(struct ps2_gif* gif, uint128_t data) {
     }
 }
 
-void gif_handle_packed(struct ps2_gif* gif, uint128_t data) {
-    int index = (gif->tag.index++) % gif->tag.nregs;
-    int r = (gif->tag.reg >> (index * 4)) & 0xf;
+static inline int gif_next_reg(struct ps2_gif* gif) {
+    int r = gif->tag.regs[gif->tag.cur];
+
+    if (++gif->tag.cur == gif->tag.nregs)
+        gif->tag.cur = 0;
+
+    ++gif->tag.index;
+
+    return r;
+}
+
+static inline void gif_write_packed(struct ps2_gif* gif, int r, uint128_t data) {
+    gif_log(2, "gif: %s <- %016" PRIx64 "\n", r == 0x0e ? gif_get_reg_name(data.u64[1]) : gif_get_reg_name(r), data.u64[0]);
 
     switch (r) {
-        case 0x00: printf("gif: PRIM <- %016lx\n", data.u64[0]); ps2_gs_write_internal(gif->gs, GS_PRIM, data.u64[0] & 0x3ff); break;
-        case 0x01: printf("gif: RGBAQ <- %016lx\n", data.u64[0]); gif_write_rgbaq(gif, data); break;
-        case 0x02: printf("gif: STQ <- %016lx\n", data.u64[0]); gif_write_stq(gif, data); break;
-        case 0x03: printf("gif: UV <- %016lx\n", data.u64[0]); gif_write_uv(gif, data); break;
-        case 0x04: printf("gif: XYZF23 <- %016lx\n", data.u64[0]); gif_write_xyzf23(gif, data); break;
-        case 0x05: printf("gif: XYZ23 <- %016lx\n", data.u64[0]); gif_write_xyz23(gif, data); break;
-        case 0x06: printf("gif: TEX0_1 <- %016lx\n", data.u64[0]); ps2_gs_write_internal(gif->gs, GS_TEX0_1, data.u64[0]); break;
-        case 0x07: printf("gif: TEX0_2 <- %016lx\n", data.u64[0]); ps2_gs_write_internal(gif->gs, GS_TEX0_2, data.u64[0]); break;
-        case 0x08: printf("gif: CLAMP_1 <- %016lx\n", data.u64[0]); ps2_gs_write_internal(gif->gs, GS_CLAMP_1, data.u64[0]); break;
-        case 0x09: printf("gif: CLAMP_2 <- %016lx\n", data.u64[0]); ps2_gs_write_internal(gif->gs, GS_CLAMP_2, data.u64[0]); break;
-        case 0x0a: printf("gif: FOG <- %016lx\n", data.u64[0]); gif_write_fog(gif, data); break;
-        case 0x0c: printf("gif: XYZF3 <- %016lx\n", data.u64[0]); ps2_gs_write_internal(gif->gs, GS_XYZF3, data.u64[0]); break;
-        case 0x0d: printf("gif: XYZ3 <- %016lx\n", data.u64[0]); ps2_gs_write_internal(gif->gs, GS_XYZ3, data.u64[0]); break;
+        case 0x00: ps2_gs_write_internal(gif->gs, GS_PRIM, data.u64[0] & 0x3ff); break;
+        case 0x01: gif_write_rgbaq(gif, data); break;
+        case 0x02: gif_write_stq(gif, data); break;
+        case 0x03: gif_write_uv(gif, data); break;
+        case 0x04: gif_write_xyzf23(gif, data); break;
+        case 0x05: gif_write_xyz23(gif, data); break;
+        case 0x06: ps2_gs_write_internal(gif->gs, GS_TEX0_1, data.u64[0]); break;
+        case 0x07: ps2_gs_write_internal(gif->gs, GS_TEX0_2, data.u64[0]); break;
+        case 0x08: ps2_gs_write_internal(gif->gs, GS_CLAMP_1, data.u64[0]); break;
+        case 0x09: ps2_gs_write_internal(gif->gs, GS_CLAMP_2, data.u64[0]); break;
+        case 0x0a: gif_write_fog(gif, data); break;
+        case 0x0c: ps2_gs_write_internal(gif->gs, GS_XYZF3, data.u64[0]); break;
+        case 0x0d: ps2_gs_write_internal(gif->gs, GS_XYZ3, data.u64[0]); break;
 
         // A+D
-        case 0x0e: {
-            printf("gif: write %s (A+D)\n", gif_get_reg_name(data.u64[1]));
-            ps2_gs_write_internal(gif->gs, data.u64[1], data.u64[0]); 
-        } break;
+        case 0x0e: ps2_gs_write_internal(gif->gs, data.u64[1], data.u64[0]); break;
 
         // NOP
         case 0x0f: break;
 
-        default: printf("gif: PACKED format for reg %d unimplemented\n", r); exit(1); break;
+        default: gif_log(0, "gif: PACKED format for reg %d unimplemented\n", r); exit(1); break;
     }
+}
+
+void gif_handle_packed(struct ps2_gif* gif, uint128_t data) {
+    gif_write_packed(gif, gif_next_reg(gif), data);
 
     // Note: This handles odd NREGS*NLOOP case
     if (gif->tag.index == gif->tag.remaining) {
@@ -224,10 +280,79 @@ void gif_handle_packed(struct ps2_gif* gif, uint128_t data) {
     }
 }
 
+// Runs the PACKED loop over up to qwc qwords of the current tag,
+// whole REGS loops go through the tag's specialized layout. Returns
+// the number of qwords consumed
+static inline int gif_handle_packed_burst(struct ps2_gif* gif, const uint128_t* data, int qwc) {
+    int size = gif->tag.remaining - gif->tag.index;
+
+    if (size > qwc)
+        size = qwc;
+
+    int i = 0;
+
+    // Finish a loop a previous burst left halfway through
+    while ((i < size) && gif->tag.cur)
+        gif_write_packed(gif, gif_next_reg(gif), data[i++]);
+
+    int start = i;
+    int end = i + (((size - i) / gif->tag.nregs) * gif->tag.nregs);
+
+    switch (gif->tag.layout) {
+        case GIF_PACKED_AD: {
+            for (; i < end; i++)
+                ps2_gs_write_internal(gif->gs, data[i].u64[1], data[i].u64[0]);
+        } break;
+
+        case GIF_PACKED_STQ_RGBAQ_XYZ2: {
+            for (; i < end; i += 3) {
+                gif_write_stq(gif, data[i]);
+                gif_write_rgbaq(gif, data[i+1]);
+                gif_write_xyz23(gif, data[i+2]);
+            }
+        } break;
+
+        case GIF_PACKED_STQ_RGBAQ_XYZF2: {
+            for (; i < end; i += 3) {
+                gif_write_stq(gif, data[i]);
+                gif_write_rgbaq(gif, data[i+1]);
+                gif_write_xyzf23(gif, data[i+2]);
+            }
+        } break;
+
+        case GIF_PACKED_RGBAQ_XYZ2: {
+            for (; i < end; i += 2) {
+                gif_write_rgbaq(gif, data[i]);
+                gif_write_xyz23(gif, data[i+1]);
+            }
+        } break;
+
+        case GIF_PACKED_RGBAQ_XYZF2: {
+            for (; i < end; i += 2) {
+                gif_write_rgbaq(gif, data[i]);
+                gif_write_xyzf23(gif, data[i+1]);
+            }
+        } break;
+    }
+
+    // Whole loops leave the slot cursor at 0
+    gif->tag.index += i - start;
+
+    // Generic layout, or the start of a loop the burst cut short
+    while (i < size)
+        gif_write_packed(gif, gif_next_reg(gif), data[i++]);
+
+    if (gif->tag.index == gif->tag.remaining)
+        gif->state = GIF_STATE_RECV_TAG;
+
+    return size;
+}
+
 void gif_handle_reglist(struct ps2_gif* gif, uint128_t data) {
     for (int i = 0; i < 2; i++) {
-        int index = (gif->tag.index++) % gif->tag.nregs;
-        int r = (gif->tag.reg >> (index * 4)) & 0xf;
+        int r = gif_next_reg(gif);
+
+        gif_log(2, "gif: %s <- %016" PRIx64 " (REGLIST)\n", gif_get_reg_name(r), data.u64[i]);
 
         switch (r) {
             case 0x00: ps2_gs_write_internal(gif->gs, GS_PRIM, data.u64[i]); break;
@@ -267,11 +392,12 @@ void gif_handle_reglist(struct ps2_gif* gif, uint128_t data) {
     }
 }
 
-void gif_handle_image(struct ps2_gif* gif, uint128_t data) {
-    ps2_gs_write_internal(gif->gs, GS_HWREG, data.u64[0]);
-    ps2_gs_write_internal(gif->gs, GS_HWREG, data.u64[1]);
-    
-    ++gif->tag.index;
+// Hands qwc qwords of IMAGE data to the GS in one go, qwc can't go
+// past the end of the current tag
+void gif_handle_image(struct ps2_gif* gif, const uint128_t* data, int qwc) {
+    ps2_gs_write_image(gif->gs, (const uint64_t*)data, qwc * 2);
+
+    gif->tag.index += qwc;
 
     if (gif->tag.index == gif->tag.remaining) {
         gif->state = GIF_STATE_RECV_TAG;
@@ -280,7 +406,7 @@ void gif_handle_image(struct ps2_gif* gif, uint128_t data) {
     return;
 }
 
-void ps2_gif_write128(struct ps2_gif* gif, uint32_t addr, uint128_t data) {
+static void gif_write_qword(struct ps2_gif* gif, uint128_t data) {
     if (gif->state == GIF_STATE_RECV_TAG) {
         gif_handle_tag(gif, data);
 
@@ -291,10 +417,162 @@ void ps2_gif_write128(struct ps2_gif* gif, uint32_t addr, uint128_t data) {
         switch (gif->tag.fmt) {
             case 0: gif_handle_packed(gif, data); return;
             case 1: gif_handle_reglist(gif, data); return;
-            case 2: gif_handle_image(gif, data); return;
-            case 3: gif_handle_image(gif, data); return;
+            case 2: gif_handle_image(gif, &data, 1); return;
+            case 3: gif_handle_image(gif, &data, 1); return;
         }
     }
 }
 
-#undef printf
\ No newline at end of file
+static void gif_write_burst(struct ps2_gif* gif, const uint128_t* data, int qwc) {
+    while (qwc) {
+        int size = 1;
+
+        if ((gif->state != GIF_STATE_PROCESSING) || (gif->tag.index == gif->tag.remaining)) {
+            gif_write_qword(gif, *data);
+        } else {
+            switch (gif->tag.fmt) {
+                case 0: {
+                    size = gif_handle_packed_burst(gif, data, qwc);
+                } break;
+
+                case 1: {
+                    gif_handle_reglist(gif, *data);
+                } break;
+
+                // Send everything up to the end of the tag at once
+                case 2:
+                case 3: {
+                    size = gif->tag.remaining - gif->tag.index;
+
+                    if (size > qwc)
+                        size = qwc;
+
+                    gif_handle_image(gif, data, size);
+                } break;
+            }
+        }
+
+        data += size;
+        qwc -= size;
+    }
+}
+
+// The last packet hasn't reached its EOP yet, other paths have to wait
+static inline int gif_packet_open(struct ps2_gif* gif) {
+    if (!gif->path)
+        return 0;
+
+    return (gif->state != GIF_STATE_RECV_TAG) || !gif->tag.eop;
+}
+
+static inline void gif_send(struct ps2_gif* gif, int path, const uint128_t* data, int qwc) {
+    gif->path = path;
+
+    gif_write_burst(gif, data, qwc);
+}
+
+static inline void gif_send_segment(struct ps2_gif* gif) {
+    struct gif_queue_segment* seg = &gif->segment[gif->segment_head];
+
+    const uint128_t* data = &gif->queue[gif->queue_head];
+    int path = seg->path;
+    int qwc = seg->qwc;
+
+    gif->segment_head++;
+    gif->segment_count--;
+    gif->queue_head += qwc;
+    gif->queue_qwc -= qwc;
+
+    gif_send(gif, path, data, qwc);
+
+    if (!gif->segment_count) {
+        gif->segment_head = 0;
+        gif->queue_head = 0;
+    }
+}
+
+// Sends held back data in arrival order, stops when a packet is
+// left open by a path other than the next one in the queue
+static void gif_drain_queue(struct ps2_gif* gif) {
+    while (gif->segment_count) {
+        if (gif_packet_open(gif) && (gif->path != gif->segment[gif->segment_head].path))
+            return;
+
+        gif_send_segment(gif);
+    }
+}
+
+static void gif_queue(struct ps2_gif* gif, int path, const uint128_t* data, int qwc) {
+    int tail = gif->queue_head + gif->queue_qwc;
+    int seg = gif->segment_head + gif->segment_count;
+    int merge = gif->segment_count && (gif->segment[seg - 1].path == path);
+
+    // Make room at the end
+    if ((tail + qwc > GIF_QUEUE_SIZE) || (!merge && (seg == GIF_QUEUE_SEGMENTS))) {
+        memmove(gif->queue, &gif->queue[gif->queue_head], gif->queue_qwc * sizeof(uint128_t));
+        memmove(gif->segment, &gif->segment[gif->segment_head], gif->segment_count * sizeof(struct gif_queue_segment));
+
+        gif->queue_head = 0;
+        gif->segment_head = 0;
+
+        tail = gif->queue_qwc;
+        seg = gif->segment_count;
+    }
+
+    // Still full, give up on arbitration rather than drop data
+    if ((tail + qwc > GIF_QUEUE_SIZE) || (!merge && (seg == GIF_QUEUE_SEGMENTS))) {
+        gif_log(1, "gif: Queue full, forcing PATH%d in\n", path);
+
+        while (gif->segment_count)
+            gif_send_segment(gif);
+
+        gif_send(gif, path, data, qwc);
+
+        return;
+    }
+
+    memcpy(&gif->queue[tail], data, qwc * sizeof(uint128_t));
+
+    gif->queue_qwc += qwc;
+
+    if (merge) {
+        gif->segment[seg - 1].qwc += qwc;
+    } else {
+        gif->segment[seg].path = path;
+        gif->segment[seg].qwc = qwc;
+        gif->segment_count++;
+    }
+}
+
+// Whether data from path would go straight to the GS. Paths only
+// take over between packets, after anything already held back
+int ps2_gif_path_ready(struct ps2_gif* gif, int path) {
+    if (gif_packet_open(gif))
+        return gif->path == path;
+
+    return !gif->segment_count;
+}
+
+int ps2_gif_path_queued(struct ps2_gif* gif, int path) {
+    for (int i = 0; i < gif->segment_count; i++)
+        if (gif->segment[gif->segment_head + i].path == path)
+            return 1;
+
+    return 0;
+}
+
+void ps2_gif_write_path(struct ps2_gif* gif, int path, const uint128_t* data, int qwc) {
+    if (ps2_gif_path_ready(gif, path)) {
+        gif_send(gif, path, data, qwc);
+    } else {
+        gif_queue(gif, path, data, qwc);
+    }
+
+    // The packet might have just ended
+    gif_drain_queue(gif);
+}
+
+// GIF FIFO writes from the EE go through PATH3
+void ps2_gif_write128(struct ps2_gif* gif, uint32_t addr, uint128_t data) {
+    ps2_gif_write_path(gif, GIF_PATH3, &data, 1);
+}
@@ -14,6 +14,22 @@ extern "C" {
 #define GIF_STATE_RECV_TAG 0
 #define GIF_STATE_PROCESSING 1
 
+#define GIF_PATH1 1 // VU1 XGKICK
+#define GIF_PATH2 2 // VIF1 DIRECT/DIRECTHL
+#define GIF_PATH3 3 // GIF DMA and EE FIFO writes
+
+// Data held back from paths waiting for another path's packet to end
+#define GIF_QUEUE_SIZE 0x4000
+#define GIF_QUEUE_SEGMENTS 64
+
+// PACKED REGS layouts with a dedicated loop
+#define GIF_PACKED_GENERIC 0
+#define GIF_PACKED_AD 1
+#define GIF_PACKED_STQ_RGBAQ_XYZ2 2
+#define GIF_PACKED_STQ_RGBAQ_XYZF2 3
+#define GIF_PACKED_RGBAQ_XYZ2 4
+#define GIF_PACKED_RGBAQ_XYZF2 5
+
 struct gif_tag {
     uint64_t nloop;
     uint32_t prim;
@@ -25,6 +41,16 @@ struct gif_tag {
 
     int index;
     int remaining;
+
+    // REGS decoded once per tag, cur is the next slot
+    uint8_t regs[16];
+    int cur;
+    int layout;
+};
+
+struct gif_queue_segment {
+    int path;
+    int qwc;
 };
 
 struct ps2_gif {
@@ -47,6 +73,19 @@ struct ps2_gif {
 
     // From ST(Q) to RGBA(Q)
     uint64_t q;
+
+    // Path that sent the last packet, the GIF only switches paths
+    // once that packet has ended
+    int path;
+
+    // Held back data in arrival order, one segment per run of
+    // writes from the same path
+    uint128_t queue[GIF_QUEUE_SIZE];
+    int queue_head;
+    int queue_qwc;
+    struct gif_queue_segment segment[GIF_QUEUE_SEGMENTS];
+    int segment_head;
+    int segment_count;
 };
 
 struct ps2_gif* ps2_gif_create(void);
@@ -55,6 +94,9 @@ void ps2_gif_destroy(struct ps2_gif* gif);
 uint64_t ps2_gif_read32(struct ps2_gif* gif, uint32_t addr);
 void ps2_gif_write32(struct ps2_gif* gif, uint32_t addr, uint64_t data);
 void ps2_gif_write128(struct ps2_gif* gif, uint32_t addr, uint128_t data);
+void ps2_gif_write_path(struct ps2_gif* gif, int path, const uint128_t* data, int qwc);
+int ps2_gif_path_ready(struct ps2_gif* gif, int path);
+int ps2_gif_path_queued(struct ps2_gif* gif, int path);
 
 #ifdef __cplusplus
 }
@@ -8,6 +8,14 @@ struct ps2_ee_timers* ps2_ee_timers_create(void) {
     return malloc(sizeof(struct ps2_ee_timers));
 }
 
+// Scheduler cycles per counter tick for each clock source, the
+// scheduler runs 4 cycles per EE cycle
+static const uint64_t ee_timer_div[4] = {
+    4, 4 * 16, 4 * 256, 4 * 9370
+};
+
+void ee_timer_handle_event(void* udata, int overshoot);
+
 void ps2_ee_timers_init(struct ps2_ee_timers* timers, struct ps2_intc* intc, struct sched_state* sched) {
     memset(timers, 0, sizeof(struct ps2_ee_timers));
 
@@ -19,6 +27,9 @@ void ps2_ee_timers_init(struct ps2_ee_timers* timers, struct ps2_intc* intc, str
         timers->timer[i].mode = 0;
         timers->timer[i].counter = 0;
         timers->timer[i].hold = 0;
+        timers->timer[i].last = sched->now;
+        timers->timer[i].id = i;
+        timers->timer[i].timers = timers;
     }
 }
 
@@ -26,13 +37,134 @@ void ps2_ee_timers_destroy(struct ps2_ee_timers* timers) {
     free(timers);
 }
 
+// Moves the counter forward, raising every compare and overflow
+// condition passed on the way
+static void ee_timer_advance(struct ee_timer* t, uint64_t ticks) {
+    struct ps2_ee_timers* timers = t->timers;
+
+    while (ticks) {
+        uint64_t step = 0x10000 - t->counter;
+        int cmp = t->counter < t->compare;
+
+        if (cmp)
+            step = t->compare - t->counter;
+
+        if (ticks < step) {
+            t->counter += ticks;
+
+            return;
+        }
+
+        ticks -= step;
+
+        if (cmp) {
+            t->counter = t->compare;
+            t->mode |= 0x400;
+
+            if (t->mode & 0x100) {
+                printf("ee: timer %d compare IRQ\n", t->id);
+
+                ps2_intc_irq(timers->intc, EE_INTC_TIMER0 + t->id);
+            }
+
+            if (t->mode & 0x40) {
+                t->counter = 0;
+            }
+        } else {
+            t->counter = 0;
+            t->mode |= 0x800;
+
+            if (t->mode & 0x200) {
+                printf("ee: timer %d overflow IRQ\n", t->id);
+
+                ps2_intc_irq(timers->intc, EE_INTC_TIMER0 + t->id);
+            }
+        }
+
+        // Past a wrap the counter is periodic, skip all but
+        // one of the remaining periods
+        if (!t->counter) {
+            uint64_t period = ((t->mode & 0x40) && t->compare) ? t->compare : 0x10000;
+
+            if (ticks > period)
+                ticks = period + (ticks % period);
+        }
+    }
+}
+
+// Catches the counter up with the scheduler
+static void ee_timer_sync(struct ee_timer* t) {
+    uint64_t now = t->timers->sched->now;
+
+    if (!(t->mode & 0x80)) {
+        t->last = now;
+
+        return;
+    }
+
+    uint64_t div = ee_timer_div[t->mode & 3];
+    uint64_t ticks = (now - t->last) / div;
+
+    if (!ticks)
+        return;
+
+    t->last += ticks * div;
+
+    ee_timer_advance(t, ticks);
+}
+
+// Schedules an event for the next compare or overflow, has to
+// be called right after syncing
+static void ee_timer_schedule(struct ee_timer* t) {
+    struct sched_state* sched = t->timers->sched;
+
+    if (!(t->mode & 0x80)) {
+        sched_cancel(sched, t->event);
+
+        return;
+    }
+
+    uint64_t ticks = 0x10000 - t->counter;
+
+    if (t->counter < t->compare)
+        ticks = t->compare - t->counter;
+
+    long cycles = (long)(t->last + (ticks * ee_timer_div[t->mode & 3]) - sched->now);
+
+    if (sched_reschedule(sched, t->event, cycles))
+        return;
+
+    struct sched_event event;
+
+    event.callback = ee_timer_handle_event;
+    event.cycles = cycles;
+    event.name = "EE timer event";
+    event.udata = t;
+
+    t->event = sched_schedule(sched, event);
+}
+
+void ee_timer_handle_event(void* udata, int overshoot) {
+    struct ee_timer* t = (struct ee_timer*)udata;
+
+    ee_timer_sync(t);
+    ee_timer_schedule(t);
+}
+
 uint64_t ps2_ee_timers_read32(struct ps2_ee_timers* timers, uint32_t addr) {
     int t = (addr >> 11) & 3;
 
     // printf("ee: timer %d read %08x\n", t, addr & 0xff);
 
+    ee_timer_sync(&timers->timer[t]);
+
     switch (addr & 0xff) {
-        case 0x00: return timers->timer[t].counter;
+        case 0x00: {
+            if (timers->idle)
+                timers->idle->polled = 1;
+
+            return timers->timer[t].counter;
+        }
         case 0x10: return timers->timer[t].mode;
         case 0x20: return timers->timer[t].compare;
         case 0x30: return timers->timer[t].hold;
@@ -42,10 +174,16 @@ uint64_t ps2_ee_timers_read32(struct ps2_ee_timers* timers, uint32_t addr) {
 }
 
 static inline void ee_timers_write_mode(struct ps2_ee_timers* timers, uint32_t data, int t) {
+    uint16_t prev = timers->timer[t].mode;
+
     timers->timer[t].mode &= 0xc00;
     timers->timer[t].mode |= data & (~0xc00);
     timers->timer[t].mode &= ~(data & 0xc00);
 
+    // Start counting from a fresh prescaler period
+    if ((prev ^ timers->timer[t].mode) & 3)
+        timers->timer[t].last = timers->sched->now;
+
     // printf("timers: timer %d write %08x -> %08x\n", t, data, timers->timer[t].mode);
 }
 
@@ -54,83 +192,15 @@ void ps2_ee_timers_write32(struct ps2_ee_timers* timers, uint32_t addr, uint64_t
 
     // printf("ee: timer %d write %08x to %02x\n", t, data, addr & 0xff);
 
+    ee_timer_sync(&timers->timer[t]);
+
     switch (addr & 0xff) {
-        case 0x00: timers->timer[t].counter = data & 0xffff; return;
-        case 0x10: ee_timers_write_mode(timers, data & 0xffff, t); return;
-        case 0x20: timers->timer[t].compare = data; return;
+        case 0x00: timers->timer[t].counter = data & 0xffff; break;
+        case 0x10: ee_timers_write_mode(timers, data & 0xffff, t); break;
+        case 0x20: timers->timer[t].compare = data & 0xffff; break;
         case 0x30: timers->timer[t].hold = data & 0xffff; return;
+        default: return;
     }
-}
-
-void ee_timer_tick(struct ps2_ee_timers* timers, int timer) {
-    struct ee_timer* t = &timers->timer[timer];
-
-    if (!(t->mode & 0x80))
-        return;
 
-    uint32_t prev = t->counter;
-
-    switch (t->mode & 3) {
-        case 0: {
-            ++t->counter;
-        } break;
-        case 1: {
-            if (t->internal >= 16) {
-                ++t->counter;
-                t->internal = 0;
-            } else {
-                ++t->internal;
-            }
-        } break;
-        case 2: {
-            if (t->internal >= 256) {
-                ++t->counter;
-                t->internal = 0;
-            } else {
-                ++t->internal;
-            }
-        } break;
-        case 3: {
-            if (t->internal >= 9370) {
-                ++t->counter;
-                t->internal = 0;
-            } else {
-                ++t->internal;
-            }
-        } break;
-    }
-
-    // printf("ee: timer %d counter=%08x\n", timer, t->counter);
-
-    if ((t->counter >= t->compare) && (prev < t->compare)) {
-        t->mode |= 0x400;
-
-        if (t->mode & 0x100) {
-            printf("ee: timer %d compare IRQ\n", timer);
-
-            ps2_intc_irq(timers->intc, EE_INTC_TIMER0 + timer);
-        }
-
-        if (t->mode & 0x40) {
-            t->counter = 0;
-        }
-    }
-
-    if (t->counter > 0xffff) {
-        t->mode |= 0x800;
-        t->counter -= 0xffff;
-
-        if (t->mode & 0x200) {
-            printf("ee: timer %d overflow IRQ\n", timer);
-
-            ps2_intc_irq(timers->intc, EE_INTC_TIMER0 + timer);
-        }
-    }
-
-    t->counter &= 0xffff;
+    ee_timer_schedule(&timers->timer[t]);
 }
-
-void ps2_ee_timers_tick(struct ps2_ee_timers* timers) {
-    for (int i = 0; i < 4; i++)
-        ee_timer_tick(timers, i);
-}
\ No newline at end of file
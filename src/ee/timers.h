@@ -10,12 +10,25 @@ extern "C" {
 #include "sched.h"
 #include "intc.h"
 
+#include "shared/idle.h"
+
+struct ps2_ee_timers;
+
+// Counters are only brought up to date when they're accessed,
+// compare and overflow interrupts are scheduled ahead of time
 struct ee_timer {
     uint32_t counter;
     uint16_t mode;
     uint32_t compare;
     uint16_t hold;
-    uint32_t internal;
+
+    // Scheduler time the counter was last updated at, always
+    // aligned to a counter tick
+    uint64_t last;
+    sched_handle event;
+
+    int id;
+    struct ps2_ee_timers* timers;
 };
 
 struct ps2_ee_timers {
@@ -23,6 +36,9 @@ struct ps2_ee_timers {
 
     struct ps2_intc* intc;
     struct sched_state* sched;
+
+    // Counter reads keep the EE from skipping idle loops
+    struct idle_loop* idle;
 };
 
 struct ps2_ee_timers* ps2_ee_timers_create(void);
@@ -30,7 +46,6 @@ void ps2_ee_timers_init(struct ps2_ee_timers* timers, struct ps2_intc* intc, str
 void ps2_ee_timers_destroy(struct ps2_ee_timers* timers);
 uint64_t ps2_ee_timers_read32(struct ps2_ee_timers* timers, uint32_t addr);
 void ps2_ee_timers_write32(struct ps2_ee_timers* timers, uint32_t addr, uint64_t data);
-void ps2_ee_timers_tick(struct ps2_ee_timers* timers);
 void ps2_ee_timers_handle_hblank(struct ps2_ee_timers* timers);
 void ps2_ee_timers_handle_vblank_in(struct ps2_ee_timers* timers);
 void ps2_ee_timers_handle_vblank_out(struct ps2_ee_timers* timers);
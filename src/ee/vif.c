@@ -4,15 +4,21 @@
 #include <stdio.h>
 #include <math.h>
 
+#ifdef _EE_USE_INTRINSICS
+#include <smmintrin.h>
+#endif
+
 #include "vif.h"
+#include "vu_thread.h"
 
 struct ps2_vif* ps2_vif_create(void) {
     return malloc(sizeof(struct ps2_vif));
 }
 
-void ps2_vif_init(struct ps2_vif* vif, struct vu_state* vu0, struct vu_state* vu1, struct ps2_intc* intc, struct sched_state* sched, struct ee_bus* bus) {
+void ps2_vif_init(struct ps2_vif* vif, struct vu_state* vu0, struct vu_state* vu1, struct ps2_intc* intc, struct sched_state* sched, struct idle_loop* idle, struct ee_bus* bus) {
     memset(vif, 0, sizeof(struct ps2_vif));
 
+    vif->idle = idle;
     vif->sched = sched;
     vif->intc = intc;
     vif->bus = bus;
@@ -32,6 +38,374 @@ void vif1_send_irq(void* udata, int overshoot) {
 
 static int loop = 0;
 
+// Stalls the VIF until VU1 is done with its microprogram
+static inline void vif1_wait_vu1(struct ps2_vif* vif) {
+    if (vif->vu1->thread)
+        vu_thread_wait(vif->vu1->thread);
+}
+
+// Bytes per vector for each UNPACK format, 0 for invalid ones
+static const int vif_unpack_size[16] = {
+    4, 2, 1, 0,
+    8, 4, 2, 0,
+    12, 6, 3, 0,
+    16, 8, 4, 2
+};
+
+static inline uint32_t vif_read32(const uint8_t* s) {
+    uint32_t v;
+
+    memcpy(&v, s, sizeof(uint32_t));
+
+    return v;
+}
+
+static inline uint32_t vif_read16(const uint8_t* s, int usn) {
+    uint16_t v;
+
+    memcpy(&v, s, sizeof(uint16_t));
+
+    return usn ? (uint32_t)v : (uint32_t)(int32_t)(int16_t)v;
+}
+
+static inline uint32_t vif_read8(const uint8_t* s, int usn) {
+    return usn ? (uint32_t)s[0] : (uint32_t)(int32_t)(int8_t)s[0];
+}
+
+static inline uint128_t vif_vec(uint32_t x, uint32_t y, uint32_t z, uint32_t w) {
+    uint128_t v;
+
+    v.u32[0] = x;
+    v.u32[1] = y;
+    v.u32[2] = z;
+    v.u32[3] = w;
+
+    return v;
+}
+
+static inline uint128_t vif_decode_s32(const uint8_t* s, int usn) {
+    uint32_t x = vif_read32(s);
+
+    return vif_vec(x, x, x, x);
+}
+
+static inline uint128_t vif_decode_s16(const uint8_t* s, int usn) {
+    uint32_t x = vif_read16(s, usn);
+
+    return vif_vec(x, x, x, x);
+}
+
+static inline uint128_t vif_decode_s8(const uint8_t* s, int usn) {
+    uint32_t x = vif_read8(s, usn);
+
+    return vif_vec(x, x, x, x);
+}
+
+// V2 formats write XYXY, V3 formats leave W cleared
+static inline uint128_t vif_decode_v2_32(const uint8_t* s, int usn) {
+    uint32_t x = vif_read32(s);
+    uint32_t y = vif_read32(s + 4);
+
+    return vif_vec(x, y, x, y);
+}
+
+static inline uint128_t vif_decode_v2_16(const uint8_t* s, int usn) {
+    uint32_t x = vif_read16(s, usn);
+    uint32_t y = vif_read16(s + 2, usn);
+
+    return vif_vec(x, y, x, y);
+}
+
+static inline uint128_t vif_decode_v2_8(const uint8_t* s, int usn) {
+    uint32_t x = vif_read8(s, usn);
+    uint32_t y = vif_read8(s + 1, usn);
+
+    return vif_vec(x, y, x, y);
+}
+
+static inline uint128_t vif_decode_v3_32(const uint8_t* s, int usn) {
+    return vif_vec(vif_read32(s), vif_read32(s + 4), vif_read32(s + 8), 0);
+}
+
+static inline uint128_t vif_decode_v3_16(const uint8_t* s, int usn) {
+    return vif_vec(vif_read16(s, usn), vif_read16(s + 2, usn), vif_read16(s + 4, usn), 0);
+}
+
+static inline uint128_t vif_decode_v3_8(const uint8_t* s, int usn) {
+    return vif_vec(vif_read8(s, usn), vif_read8(s + 1, usn), vif_read8(s + 2, usn), 0);
+}
+
+static inline uint128_t vif_decode_v4_32(const uint8_t* s, int usn) {
+    uint128_t v;
+
+    memcpy(&v, s, sizeof(uint128_t));
+
+    return v;
+}
+
+static inline uint128_t vif_decode_v4_16(const uint8_t* s, int usn) {
+#ifdef _EE_USE_INTRINSICS
+    uint128_t v;
+    __m128i d = _mm_loadl_epi64((const __m128i*)s);
+
+    d = usn ? _mm_cvtepu16_epi32(d) : _mm_cvtepi16_epi32(d);
+
+    _mm_storeu_si128((__m128i*)&v, d);
+
+    return v;
+#else
+    return vif_vec(vif_read16(s, usn), vif_read16(s + 2, usn), vif_read16(s + 4, usn), vif_read16(s + 6, usn));
+#endif
+}
+
+static inline uint128_t vif_decode_v4_8(const uint8_t* s, int usn) {
+#ifdef _EE_USE_INTRINSICS
+    uint128_t v;
+    __m128i d = _mm_cvtsi32_si128(vif_read32(s));
+
+    d = usn ? _mm_cvtepu8_epi32(d) : _mm_cvtepi8_epi32(d);
+
+    _mm_storeu_si128((__m128i*)&v, d);
+
+    return v;
+#else
+    return vif_vec(vif_read8(s, usn), vif_read8(s + 1, usn), vif_read8(s + 2, usn), vif_read8(s + 3, usn));
+#endif
+}
+
+// RGBA5551 expanded to 8 bits per channel
+static inline uint128_t vif_decode_v4_5(const uint8_t* s, int usn) {
+    uint32_t c = vif_read16(s, 1);
+
+    return vif_vec(
+        (c & 0x1f) << 3,
+        ((c >> 5) & 0x1f) << 3,
+        ((c >> 10) & 0x1f) << 3,
+        ((c >> 15) & 1) << 7
+    );
+}
+
+// Writes one vector to VU1 memory through STMOD and STMASK and moves
+// on to the next write cycle. Fill writes (data = 0) have no input
+// vector, their data lanes take the row registers instead
+static inline void vif1_unpack_store(struct ps2_vif* vif, uint128_t v, int data) {
+    int row = vif->vif1_unpack_cycle < 3 ? vif->vif1_unpack_cycle : 3;
+    uint32_t m = vif->vif1_unpack_masked ? ((vif->vif1_mask >> (row * 8)) & 0xff) : 0;
+    int mode = vif->vif1_mode & 3;
+    uint128_t* dst = &vif->vu1->vu_mem[vif->vif1_addr & 0x3ff];
+
+#ifdef _EE_USE_INTRINSICS
+    __m128i sel = _mm_set_epi32((m >> 6) & 3, (m >> 4) & 3, (m >> 2) & 3, m & 3);
+    __m128i dm = _mm_cmpeq_epi32(sel, _mm_setzero_si128());
+    __m128i rm = _mm_cmpeq_epi32(sel, _mm_set1_epi32(1));
+    __m128i cm = _mm_cmpeq_epi32(sel, _mm_set1_epi32(2));
+    __m128i pm = _mm_cmpeq_epi32(sel, _mm_set1_epi32(3));
+    __m128i r = _mm_loadu_si128((const __m128i*)vif->vif1_r);
+    __m128i d = _mm_loadu_si128((const __m128i*)&v);
+
+    if (!data) {
+        rm = _mm_or_si128(rm, dm);
+        dm = _mm_setzero_si128();
+    } else if (mode == 1) {
+        d = _mm_add_epi32(d, r);
+    } else if (mode == 2) {
+        d = _mm_add_epi32(d, r);
+        r = _mm_blendv_epi8(r, d, dm);
+
+        _mm_storeu_si128((__m128i*)vif->vif1_r, r);
+    }
+
+    __m128i out = _mm_and_si128(d, dm);
+
+    out = _mm_or_si128(out, _mm_and_si128(r, rm));
+    out = _mm_or_si128(out, _mm_and_si128(_mm_set1_epi32(vif->vif1_c[row]), cm));
+    out = _mm_or_si128(out, _mm_and_si128(_mm_loadu_si128((const __m128i*)dst), pm));
+
+    _mm_storeu_si128((__m128i*)dst, out);
+#else
+    for (int i = 0; i < 4; i++) {
+        switch ((m >> (i * 2)) & 3) {
+            case 0: {
+                if (!data) {
+                    dst->u32[i] = vif->vif1_r[i];
+                } else if (mode == 1) {
+                    dst->u32[i] = v.u32[i] + vif->vif1_r[i];
+                } else if (mode == 2) {
+                    vif->vif1_r[i] += v.u32[i];
+                    dst->u32[i] = vif->vif1_r[i];
+                } else {
+                    dst->u32[i] = v.u32[i];
+                }
+            } break;
+            case 1: dst->u32[i] = vif->vif1_r[i]; break;
+            case 2: dst->u32[i] = vif->vif1_c[row]; break;
+            case 3: break;
+        }
+    }
+#endif
+
+    --vif->vif1_unpack_num;
+    ++vif->vif1_addr;
+
+    if (++vif->vif1_unpack_cycle == vif->vif1_unpack_wl) {
+        vif->vif1_unpack_cycle = 0;
+
+        // Skipping write
+        if (vif->vif1_unpack_cl > vif->vif1_unpack_wl)
+            vif->vif1_addr += vif->vif1_unpack_cl - vif->vif1_unpack_wl;
+    }
+}
+
+// Filling write, WL > CL cycles past CL don't consume any data
+static inline void vif1_unpack_fill(struct ps2_vif* vif) {
+    while (vif->vif1_unpack_num && (vif->vif1_unpack_cycle >= vif->vif1_unpack_cl))
+        vif1_unpack_store(vif, vif_vec(0, 0, 0, 0), 0);
+}
+
+#define VIF1_UNPACK_KERNEL(name, size, usn) \
+    static void vif1_unpack_##name##_##usn(struct ps2_vif* vif, const uint8_t* src, int count) { \
+        for (int i = 0; i < count; i++) { \
+            vif1_unpack_store(vif, vif_decode_##name(src + (i * size), usn), 1); \
+            vif1_unpack_fill(vif); \
+        } \
+    }
+
+#define VIF1_UNPACK_KERNELS(name, size) \
+    VIF1_UNPACK_KERNEL(name, size, 0) \
+    VIF1_UNPACK_KERNEL(name, size, 1)
+
+VIF1_UNPACK_KERNELS(s32, 4)
+VIF1_UNPACK_KERNELS(s16, 2)
+VIF1_UNPACK_KERNELS(s8, 1)
+VIF1_UNPACK_KERNELS(v2_32, 8)
+VIF1_UNPACK_KERNELS(v2_16, 4)
+VIF1_UNPACK_KERNELS(v2_8, 2)
+VIF1_UNPACK_KERNELS(v3_32, 12)
+VIF1_UNPACK_KERNELS(v3_16, 6)
+VIF1_UNPACK_KERNELS(v3_8, 3)
+VIF1_UNPACK_KERNELS(v4_32, 16)
+VIF1_UNPACK_KERNELS(v4_16, 8)
+VIF1_UNPACK_KERNELS(v4_8, 4)
+VIF1_UNPACK_KERNELS(v4_5, 2)
+
+#undef VIF1_UNPACK_KERNELS
+#undef VIF1_UNPACK_KERNEL
+
+#define VIF1_UNPACK_ENTRY(name) { vif1_unpack_##name##_0, vif1_unpack_##name##_1 }
+
+// Indexed by format and USN
+static void (*const vif1_unpack_table[16][2])(struct ps2_vif*, const uint8_t*, int) = {
+    VIF1_UNPACK_ENTRY(s32), VIF1_UNPACK_ENTRY(s16), VIF1_UNPACK_ENTRY(s8), { NULL, NULL },
+    VIF1_UNPACK_ENTRY(v2_32), VIF1_UNPACK_ENTRY(v2_16), VIF1_UNPACK_ENTRY(v2_8), { NULL, NULL },
+    VIF1_UNPACK_ENTRY(v3_32), VIF1_UNPACK_ENTRY(v3_16), VIF1_UNPACK_ENTRY(v3_8), { NULL, NULL },
+    VIF1_UNPACK_ENTRY(v4_32), VIF1_UNPACK_ENTRY(v4_16), VIF1_UNPACK_ENTRY(v4_8), VIF1_UNPACK_ENTRY(v4_5)
+};
+
+#undef VIF1_UNPACK_ENTRY
+
+static inline void vif1_start_unpack(struct ps2_vif* vif, uint32_t data) {
+    int fmt = (data >> 24) & 0xf;
+    int size = vif_unpack_size[fmt];
+    int cl = vif->vif1_cycle & 0xff;
+    int wl = (vif->vif1_cycle >> 8) & 0xff;
+    int num = (data >> 16) & 0xff;
+    int usn = (data >> 14) & 1;
+    int addr = data & 0x3ff;
+
+    if (!size) {
+        printf("vif1: Invalid unpack format %02x\n", fmt);
+
+        exit(1);
+    }
+
+    if (!num) num = 256;
+    if ((data >> 15) & 1) addr += vif->vif1_tops;
+
+    // Reset CYCLE, unpack linearly
+    if (!wl) {
+        cl = 1;
+        wl = 1;
+    }
+
+    int vectors = num;
+
+    if (cl < wl)
+        vectors = ((num / wl) * cl) + ((num % wl) < cl ? (num % wl) : cl);
+
+    // printf("vif: UNPACK %02x fmt=%02x num=%02x addr=%08x tops=%08x cl=%d wl=%d\n", data >> 24, fmt, num, addr, vif->vif1_tops, cl, wl);
+
+    vif->vif1_unpack_fmt = fmt;
+    vif->vif1_unpack_func = vif1_unpack_table[fmt][usn];
+    vif->vif1_unpack_num = num;
+    vif->vif1_unpack_vectors = vectors;
+    vif->vif1_unpack_cycle = 0;
+    vif->vif1_unpack_cl = cl;
+    vif->vif1_unpack_wl = wl;
+    vif->vif1_unpack_masked = (data >> 28) & 1;
+    vif->vif1_unpack_buffered = 0;
+    vif->vif1_addr = addr;
+
+    // Data is padded to a whole word
+    vif->vif1_pending_words = ((vectors * size) + 3) / 4;
+
+    // CL = 0 fills without reading anything
+    vif1_unpack_fill(vif);
+
+    if (vif->vif1_pending_words)
+        vif->vif1_state = VIF_RECV_DATA;
+}
+
+// Unpacks words worth of FIFO data, vectors can straddle calls
+static inline void vif1_unpack(struct ps2_vif* vif, const uint8_t* src, int words) {
+    int size = vif_unpack_size[vif->vif1_unpack_fmt];
+    int bytes = words * 4;
+
+    vif->vif1_pending_words -= words;
+
+    // Finish the vector the last write left halfway through
+    if (vif->vif1_unpack_buffered) {
+        int n = size - vif->vif1_unpack_buffered;
+
+        if (n > bytes)
+            n = bytes;
+
+        memcpy(vif->vif1_unpack_buf + vif->vif1_unpack_buffered, src, n);
+
+        vif->vif1_unpack_buffered += n;
+        src += n;
+        bytes -= n;
+
+        if (vif->vif1_unpack_buffered == size) {
+            vif->vif1_unpack_func(vif, vif->vif1_unpack_buf, 1);
+            vif->vif1_unpack_vectors--;
+            vif->vif1_unpack_buffered = 0;
+        }
+    }
+
+    int count = bytes / size;
+
+    if (count > vif->vif1_unpack_vectors)
+        count = vif->vif1_unpack_vectors;
+
+    vif->vif1_unpack_func(vif, src, count);
+    vif->vif1_unpack_vectors -= count;
+
+    src += count * size;
+    bytes -= count * size;
+
+    // Anything left past the last vector is padding
+    if (vif->vif1_unpack_vectors && bytes) {
+        memcpy(vif->vif1_unpack_buf + vif->vif1_unpack_buffered, src, bytes);
+
+        vif->vif1_unpack_buffered += bytes;
+    }
+
+    if (!vif->vif1_pending_words) {
+        vif->vif1_unpack_buffered = 0;
+        vif->vif1_state = VIF_IDLE;
+    }
+}
+
 void vif1_handle_fifo_write(struct ps2_vif* vif, uint32_t data) {
     if (vif->vif1_state == VIF_IDLE) {
         vif->vif1_cmd = (data >> 24) & 0xff;
@@ -94,16 +468,25 @@ void vif1_handle_fifo_write(struct ps2_vif* vif, uint32_t data) {
             } break;
             case VIF_CMD_FLUSHE: {
                 // printf("vif1: FLUSHE\n");
+
+                vif1_wait_vu1(vif);
             } break;
             case VIF_CMD_FLUSH: {
                 // printf("vif1: FLUSH\n");
+
+                vif1_wait_vu1(vif);
             } break;
             case VIF_CMD_FLUSHA: {
                 // printf("vif1: FLUSHA\n");
+
+                vif1_wait_vu1(vif);
             } break;
             case VIF_CMD_MSCAL: {
                 // printf("vif1: MSCAL(%04x)\n", data & 0xffff);
 
+                // TOP/TOPS are read by the running program
+                vif1_wait_vu1(vif);
+
                 vif->vif1_top = vif->vif1_tops;
 
                 // Toggle DBF
@@ -114,7 +497,11 @@ void vif1_handle_fifo_write(struct ps2_vif* vif, uint32_t data) {
                     vif->vif1_tops += vif->vif1_ofst;
                 }
 
-                vu_execute_program(vif->vu1, data & 0xffff);
+                if (vif->vu1->thread) {
+                    vu_thread_start(vif->vu1->thread, data & 0xffff);
+                } else {
+                    vu_execute_program(vif->vu1, data & 0xffff);
+                }
             } break;
             case VIF_CMD_MSCALF: {
                 printf("vif1: MSCALF(%04x)\n", data & 0xffff);
@@ -151,6 +538,9 @@ void vif1_handle_fifo_write(struct ps2_vif* vif, uint32_t data) {
 
                 if (!num) num = 256;
 
+                // Micro memory can't be written while VU1 is running
+                vif1_wait_vu1(vif);
+
                 vif->vif1_addr = data & 0xffff;
                 vif->vif1_state = VIF_RECV_DATA;
                 vif->vif1_pending_words = num * 2;
@@ -180,29 +570,7 @@ void vif1_handle_fifo_write(struct ps2_vif* vif, uint32_t data) {
             case 0x74: case 0x75: case 0x76: case 0x77:
             case 0x78: case 0x79: case 0x7a: case 0x7b:
             case 0x7c: case 0x7d: case 0x7e: case 0x7f: {
-                int fmt = (data >> 24) & 0xf;
-                int cl = vif->vif1_cycle & 0xff;
-                int wl = (vif->vif1_cycle >> 8) & 0xff;
-                int vl = (data >> 24) & 3;
-                int vn = (data >> 26) & 3;
-                int num = (data >> 16) & 0xff;
-                int flg = (data >> 15) & 1;
-                int usn = (data >> 14) & 1;
-                int addr = data & 0x3ff;
-                int filling = cl < wl;
-
-                if (!num) num = 256;
-                if (flg) addr += vif->vif1_tops;
-
-                // printf("vif: UNPACK %02x fmt=%02x flg=%d num=%02x addr=%08x tops=%08x\n", data >> 24, fmt, flg, num, addr, vif->vif1_tops);
-
-                assert(!filling);
-
-                vif->vif1_pending_words = (((32>>vl) * (vn+1)) * num) / 32;
-                vif->vif1_state = VIF_RECV_DATA;
-                vif->vif1_shift = 0;
-                vif->vif1_unpack_fmt = fmt;
-                vif->vif1_addr = addr;
+                vif1_start_unpack(vif, data);
             } break;
             default: {
                 printf("vif1: Unhandled command %02x\n", vif->vif1_cmd);
@@ -238,6 +606,7 @@ void vif1_handle_fifo_write(struct ps2_vif* vif, uint32_t data) {
                 } else {
                     vif->vif1_data.u32[1] = data;
                     vif->vu1->micro_mem[vif->vif1_addr++] = vif->vif1_data.u64[0];
+                    vif->vu1->program = NULL;
                     vif->vif1_shift = 0;
                 }
 
@@ -250,7 +619,7 @@ void vif1_handle_fifo_write(struct ps2_vif* vif, uint32_t data) {
                 vif->vif1_data.u32[vif->vif1_shift++] = data;
 
                 if (vif->vif1_shift == 4) {
-                    ee_bus_write128(vif->bus, 0x10006000, vif->vif1_data);
+                    ps2_gif_write_path(vif->vu1->gif, GIF_PATH2, &vif->vif1_data, 1);
 
                     vif->vif1_shift = 0;
                 }
@@ -268,38 +637,35 @@ void vif1_handle_fifo_write(struct ps2_vif* vif, uint32_t data) {
             case 0x74: case 0x75: case 0x76: case 0x77:
             case 0x78: case 0x79: case 0x7a: case 0x7b:
             case 0x7c: case 0x7d: case 0x7e: case 0x7f: {
-                switch (vif->vif1_unpack_fmt) {
-                    // V4-32
-                    case 0x0c: {
-                        vif->vif1_data.u32[vif->vif1_shift++] = data;
-
-                        if (vif->vif1_shift == 4) {
-                            // printf("vif: Writing %08x %08x %08x %08x to VUmem at %08x\n",
-                            //     vif->vif1_data.u32[3],
-                            //     vif->vif1_data.u32[2],
-                            //     vif->vif1_data.u32[1],
-                            //     vif->vif1_data.u32[0],
-                            //     vif->vif1_addr * 16
-                            // );
-
-                            vif->vu1->vu_mem[vif->vif1_addr++] = vif->vif1_data;
-                            vif->vif1_shift = 0;
-                        }
-                    } break;
-
-                    default: {
-                        printf("vif: Unimplemented unpack format %02x\n", vif->vif1_unpack_fmt);
-                    } break;
-                }
-
-                if (!(--vif->vif1_pending_words)) {
-                    vif->vif1_state = VIF_IDLE;
-                }
+                vif1_unpack(vif, (const uint8_t*)&data, 1);
             } break;
         }
     }
 }
 
+void vif1_write_burst(struct ps2_vif* vif, const uint128_t* data, int qwc) {
+    const uint32_t* words = (const uint32_t*)data;
+    int count = qwc * 4;
+
+    while (count) {
+        // UNPACK data goes through the kernels in one piece
+        if ((vif->vif1_state == VIF_RECV_DATA) && ((vif->vif1_cmd & 0x60) == 0x60)) {
+            int size = vif->vif1_pending_words < count ? vif->vif1_pending_words : count;
+
+            vif1_unpack(vif, (const uint8_t*)words, size);
+
+            words += size;
+            count -= size;
+
+            continue;
+        }
+
+        vif1_handle_fifo_write(vif, *words++);
+
+        --count;
+    }
+}
+
 uint64_t ps2_vif_read32(struct ps2_vif* vif, uint32_t addr) {
     switch (addr) {
         case 0x10003800: return vif->vif0_stat;
@@ -321,7 +687,19 @@ uint64_t ps2_vif_read32(struct ps2_vif* vif, uint32_t addr) {
         case 0x10003950: return vif->vif0_c[1];
         case 0x10003960: return vif->vif0_c[2];
         case 0x10003970: return vif->vif0_c[3];
-        case 0x10003c00: return vif->vif1_stat;
+        case 0x10003c00: {
+            // VEW, VU1 is running. The worker changes it in real time,
+            // so loops polling it can't be skipped
+            if (vif->vu1->thread) {
+                if (vif->idle)
+                    vif->idle->polled = 1;
+
+                if (vu_thread_busy(vif->vu1->thread))
+                    return vif->vif1_stat | 4;
+            }
+
+            return vif->vif1_stat;
+        }
         // case 0x10003c10: return vif->vif1_fbrst;
         case 0x10003c20: return vif->vif1_err;
         case 0x10003c30: return vif->vif1_mark;
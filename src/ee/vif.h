@@ -13,6 +13,7 @@ extern "C" {
 #include "ee/intc.h"
 #include "ee/vu.h"
 #include "sched.h"
+#include "shared/idle.h"
 
 enum {
     VIF_IDLE,
@@ -101,21 +102,37 @@ struct ps2_vif {
     uint32_t vif1_addr;
     uint32_t vif1_unpack_fmt;
 
+    // UNPACK state, num counts VU memory writes left (data and fill)
+    // and vectors the data vectors still expected from the FIFO
+    void (*vif1_unpack_func)(struct ps2_vif*, const uint8_t*, int);
+    int vif1_unpack_num;
+    int vif1_unpack_vectors;
+    int vif1_unpack_cycle;
+    int vif1_unpack_cl;
+    int vif1_unpack_wl;
+    int vif1_unpack_masked;
+    uint8_t vif1_unpack_buf[16];
+    int vif1_unpack_buffered;
+
     struct vu_state* vu0;
     struct vu_state* vu1;
 
     struct sched_state* sched;
     struct ps2_intc* intc;
     struct ee_bus* bus;
+
+    // VEW reads keep the EE from skipping idle loops
+    struct idle_loop* idle;
 };
 
 struct ps2_vif* ps2_vif_create(void);
-void ps2_vif_init(struct ps2_vif* vif, struct vu_state* vu0, struct vu_state* vu1, struct ps2_intc* intc, struct sched_state* sched, struct ee_bus* bus);
+void ps2_vif_init(struct ps2_vif* vif, struct vu_state* vu0, struct vu_state* vu1, struct ps2_intc* intc, struct sched_state* sched, struct idle_loop* idle, struct ee_bus* bus);
 void ps2_vif_destroy(struct ps2_vif* vif);
 uint64_t ps2_vif_read32(struct ps2_vif* vif, uint32_t addr);
 void ps2_vif_write32(struct ps2_vif* vif, uint32_t addr, uint64_t data);
 uint128_t ps2_vif_read128(struct ps2_vif* vif, uint32_t addr);
 void ps2_vif_write128(struct ps2_vif* vif, uint32_t addr, uint128_t data);
+void vif1_write_burst(struct ps2_vif* vif, const uint128_t* data, int qwc);
 
 #ifdef __cplusplus
 }
@@ -3,7 +3,13 @@
 #include <stdio.h>
 #include <math.h>
 
+#ifdef _VU_USE_INTRINSICS
+#include <smmintrin.h>
+#endif
+
 #include "vu.h"
+#include "vu_jit.h"
+#include "vu_thread.h"
 
 #define printf(fmt, ...)(0)
 
@@ -201,1294 +207,452 @@ static inline float vu_acc_i(struct vu_state* vu, int i) {
     return vu_cvtf(vu->acc.u32[i]);
 }
 
-// Upper pipeline
-void vu_i_abs(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
+// Upper pipeline arithmetic. Every op in the add/sub/mul/madd/msub
+// and max/mini families goes through vu_upper_op/vu_upper_minmax,
+// the SSE path computes all four lanes and the MAC flags at once
+#define VU_OP_ADD  0
+#define VU_OP_SUB  1
+#define VU_OP_MUL  2
+#define VU_OP_MADD 3
+#define VU_OP_MSUB 4
+#define VU_OP_MAX  5
+#define VU_OP_MIN  6
 
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) vu_set_vf(vu, t, i, fabsf(vu_vf_i(vu, s, i)));
-    }
-}
-void vu_i_add(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int d = VU_UD_D;
-    int t = VU_UD_T;
+// Result goes to ACC instead of a VF register
+#define VU_DEST_ACC -1
 
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) + vu_vf_i(vu, t, i);
+#ifdef _VU_USE_INTRINSICS
+typedef __m128 vu_vec;
 
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
+// movemask puts x in bit 0, MAC flags and the dest field have x in bit 3
+static const uint32_t vu_lane_flags[16] = {
+    0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
+    0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf
+};
 
-    vu_update_status(vu);
-}
-void vu_i_addi(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
+static inline __m128i vu_cvtf_epi32(__m128i v) {
+    const __m128i exp_mask = _mm_set1_epi32(0x7f800000);
+    __m128i sign = _mm_and_si128(v, _mm_set1_epi32(0x80000000));
+    __m128i exp = _mm_and_si128(v, exp_mask);
+    __m128i max = _mm_or_si128(sign, _mm_set1_epi32(0x7f7fffff));
 
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) + vu->i.f;
+    v = _mm_blendv_epi8(v, sign, _mm_cmpeq_epi32(exp, _mm_setzero_si128()));
 
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
+    return _mm_blendv_epi8(v, max, _mm_cmpeq_epi32(exp, exp_mask));
+}
 
-    vu_update_status(vu);
+static inline vu_vec vu_vec_vf(struct vu_state* vu, int r) {
+    return _mm_castsi128_ps(vu_cvtf_epi32(_mm_loadu_si128((__m128i*)vu->vf[r].u32)));
 }
-void vu_i_addq(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
 
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) + vu->q.f;
+static inline vu_vec vu_vec_acc(struct vu_state* vu) {
+    return _mm_castsi128_ps(vu_cvtf_epi32(_mm_loadu_si128((__m128i*)vu->acc.u32)));
+}
 
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
+static inline vu_vec vu_vec_set1(float f) {
+    return _mm_set1_ps(f);
+}
 
-    vu_update_status(vu);
+static inline vu_vec vu_vec_bc(struct vu_state* vu, int r, int i) {
+    return _mm_set1_ps(vu_vf_i(vu, r, i));
 }
-void vu_i_addx(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
-    int t = VU_UD_T;
 
-    float bc = vu_vf_x(vu, t);
+static inline __m128 vu_vec_update_flags(struct vu_state* vu, __m128 value, int dest) {
+    const __m128i exp_mask = _mm_set1_epi32(0x7f800000);
+    __m128i v = _mm_castps_si128(value);
+    __m128i sign = _mm_and_si128(v, _mm_set1_epi32(0x80000000));
+    __m128i exp = _mm_and_si128(v, exp_mask);
+    __m128i zero = _mm_cmpeq_epi32(_mm_and_si128(v, _mm_set1_epi32(0x7fffffff)), _mm_setzero_si128());
+    __m128i under = _mm_andnot_si128(zero, _mm_cmpeq_epi32(exp, _mm_setzero_si128()));
+    __m128i over = _mm_cmpeq_epi32(exp, exp_mask);
 
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) + bc;
+    uint32_t z = vu_lane_flags[_mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(zero, under)))];
+    uint32_t s = vu_lane_flags[_mm_movemask_ps(value)];
+    uint32_t u = vu_lane_flags[_mm_movemask_ps(_mm_castsi128_ps(under))];
+    uint32_t o = vu_lane_flags[_mm_movemask_ps(_mm_castsi128_ps(over))];
 
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
+    // Lanes outside of dest get their flags cleared
+    vu->mac &= 0xffff0000;
+    vu->mac |= (z | (s << 4) | (u << 8) | (o << 12)) & (dest * 0x1111);
 
-    vu_update_status(vu);
-}
-void vu_i_addy(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
-    int t = VU_UD_T;
+    // Underflow flushes to signed zero, overflow clamps to signed max
+    v = _mm_blendv_epi8(v, sign, under);
+    v = _mm_blendv_epi8(v, _mm_or_si128(sign, _mm_set1_epi32(0x7f7fffff)), over);
 
-    float bc = vu_vf_y(vu, t);
+    return _mm_castsi128_ps(v);
+}
 
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) + bc;
+static inline void vu_vec_store(struct vu_state* vu, int d, __m128 value, int dest) {
+    const __m128i bits = _mm_setr_epi32(8, 4, 2, 1);
+    __m128i mask = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(dest), bits), bits);
+    float* r;
 
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
+    if (d == VU_DEST_ACC) {
+        r = vu->acc.f;
+    } else if (d) {
+        r = vu->vf[d].f;
+    } else {
+        return;
     }
 
-    vu_update_status(vu);
+    _mm_storeu_ps(r, _mm_blendv_ps(_mm_loadu_ps(r), value, _mm_castsi128_ps(mask)));
 }
-void vu_i_addz(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_z(vu, t);
 
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) + bc;
+static inline void vu_upper_op(struct vu_state* vu, int op, int d, vu_vec s, vu_vec t) {
+    int dest = VU_UD_DEST;
+    __m128 result;
 
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
+    switch (op) {
+        case VU_OP_ADD: result = _mm_add_ps(s, t); break;
+        case VU_OP_SUB: result = _mm_sub_ps(s, t); break;
+        case VU_OP_MUL: result = _mm_mul_ps(s, t); break;
+        case VU_OP_MADD: result = _mm_add_ps(vu_vec_acc(vu), _mm_mul_ps(s, t)); break;
+        case VU_OP_MSUB: result = _mm_sub_ps(vu_vec_acc(vu), _mm_mul_ps(s, t)); break;
     }
 
+    vu_vec_store(vu, d, vu_vec_update_flags(vu, result, dest), dest);
     vu_update_status(vu);
 }
-void vu_i_addw(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
-    int t = VU_UD_T;
 
-    float bc = vu_vf_w(vu, t);
+// maxps/minps return the second operand on ties, same as the
+// (s > t) ? s : t comparison done by the scalar path
+static inline void vu_upper_minmax(struct vu_state* vu, int op, int d, vu_vec s, vu_vec t) {
+    __m128 result = (op == VU_OP_MAX) ? _mm_max_ps(s, t) : _mm_min_ps(s, t);
 
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) + bc;
+    vu_vec_store(vu, d, result, VU_UD_DEST);
+}
+#else
+typedef struct vu_reg vu_vec;
 
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
+static inline vu_vec vu_vec_vf(struct vu_state* vu, int r) {
+    vu_vec v;
 
-    vu_update_status(vu);
+    for (int i = 0; i < 4; i++)
+        v.f[i] = vu_vf_i(vu, r, i);
+
+    return v;
 }
-void vu_i_adda(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
 
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) + vu_vf_i(vu, t, i);
+static inline vu_vec vu_vec_acc(struct vu_state* vu) {
+    vu_vec v;
 
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
+    for (int i = 0; i < 4; i++)
+        v.f[i] = vu_acc_i(vu, i);
 
-    vu_update_status(vu);
+    return v;
 }
-void vu_i_addai(struct vu_state* vu) { printf("vu: addai unimplemented\n"); exit(1); }
-void vu_i_addaq(struct vu_state* vu) { printf("vu: addaq unimplemented\n"); exit(1); }
-void vu_i_addax(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
 
-    float bc = vu_vf_x(vu, t);
+static inline vu_vec vu_vec_set1(float f) {
+    vu_vec v;
 
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) + bc;
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
+    for (int i = 0; i < 4; i++)
+        v.f[i] = f;
 
-    vu_update_status(vu);
+    return v;
 }
-void vu_i_adday(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
 
-    float bc = vu_vf_y(vu, t);
+static inline vu_vec vu_vec_bc(struct vu_state* vu, int r, int i) {
+    return vu_vec_set1(vu_vf_i(vu, r, i));
+}
 
+static inline void vu_upper_op(struct vu_state* vu, int op, int d, vu_vec s, vu_vec t) {
     for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) + bc;
+        float result;
 
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
+        if (!VU_UD_DI(i)) {
             vu_clear_flags(vu, i);
-        }
-    }
 
-    vu_update_status(vu);
-}
-void vu_i_addaz(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
+            continue;
+        }
 
-    float bc = vu_vf_z(vu, t);
+        switch (op) {
+            case VU_OP_ADD: result = s.f[i] + t.f[i]; break;
+            case VU_OP_SUB: result = s.f[i] - t.f[i]; break;
+            case VU_OP_MUL: result = s.f[i] * t.f[i]; break;
+            case VU_OP_MADD: result = vu_acc_i(vu, i) + s.f[i] * t.f[i]; break;
+            case VU_OP_MSUB: result = vu_acc_i(vu, i) - s.f[i] * t.f[i]; break;
+        }
 
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) + bc;
+        result = vu_update_flags(vu, result, i);
 
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
+        if (d == VU_DEST_ACC) {
+            vu->acc.f[i] = result;
         } else {
-            vu_clear_flags(vu, i);
+            vu_set_vf(vu, d, i, result);
         }
     }
 
     vu_update_status(vu);
 }
-void vu_i_addaw(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_w(vu, t);
 
+static inline void vu_upper_minmax(struct vu_state* vu, int op, int d, vu_vec s, vu_vec t) {
     for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) + bc;
+        if (!VU_UD_DI(i))
+            continue;
 
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
+        if (op == VU_OP_MAX) {
+            vu_set_vf(vu, d, i, (s.f[i] > t.f[i]) ? s.f[i] : t.f[i]);
         } else {
-            vu_clear_flags(vu, i);
+            vu_set_vf(vu, d, i, (s.f[i] < t.f[i]) ? s.f[i] : t.f[i]);
         }
     }
-
-    vu_update_status(vu);
 }
-void vu_i_sub(struct vu_state* vu) {
+#endif
+
+// Upper pipeline
+void vu_i_abs(struct vu_state* vu) {
     int s = VU_UD_S;
-    int d = VU_UD_D;
     int t = VU_UD_T;
 
     for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) - vu_vf_i(vu, t, i);
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
+        if (VU_UD_DI(i)) vu_set_vf(vu, t, i, fabsf(vu_vf_i(vu, s, i)));
     }
-
-    vu_update_status(vu);
+}
+void vu_i_add(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_ADD, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_vf(vu, VU_UD_T));
+}
+void vu_i_addi(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_ADD, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->i.f));
+}
+void vu_i_addq(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_ADD, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->q.f));
+}
+void vu_i_addx(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_ADD, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 0));
+}
+void vu_i_addy(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_ADD, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 1));
+}
+void vu_i_addz(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_ADD, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 2));
+}
+void vu_i_addw(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_ADD, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 3));
+}
+void vu_i_adda(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_ADD, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_vf(vu, VU_UD_T));
+}
+void vu_i_addai(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_ADD, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->i.f));
+}
+void vu_i_addaq(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_ADD, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->q.f));
+}
+void vu_i_addax(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_ADD, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 0));
+}
+void vu_i_adday(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_ADD, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 1));
+}
+void vu_i_addaz(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_ADD, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 2));
+}
+void vu_i_addaw(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_ADD, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 3));
+}
+void vu_i_sub(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_SUB, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_vf(vu, VU_UD_T));
 }
 void vu_i_subi(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) - vu->i.f;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_SUB, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->i.f));
 }
 void vu_i_subq(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) - vu->q.f;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_SUB, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->q.f));
 }
 void vu_i_subx(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_x(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) - bc;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_SUB, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 0));
 }
 void vu_i_suby(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_y(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) - bc;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_SUB, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 1));
 }
 void vu_i_subz(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_z(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) - bc;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_SUB, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 2));
 }
 void vu_i_subw(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_w(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) - bc;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_SUB, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 3));
 }
 void vu_i_suba(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) - vu_vf_i(vu, t, i);
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_SUB, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_vf(vu, VU_UD_T));
+}
+void vu_i_subai(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_SUB, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->i.f));
+}
+void vu_i_subaq(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_SUB, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->q.f));
 }
-void vu_i_subai(struct vu_state* vu) { printf("vu: subai unimplemented\n"); exit(1); }
-void vu_i_subaq(struct vu_state* vu) { printf("vu: subaq unimplemented\n"); exit(1); }
 void vu_i_subax(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_x(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) - bc;
-            
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_SUB, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 0));
 }
 void vu_i_subay(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_y(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) - bc;
-            
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_SUB, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 1));
 }
 void vu_i_subaz(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_z(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) - bc;
-            
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_SUB, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 2));
 }
 void vu_i_subaw(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_w(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) - bc;
-            
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_SUB, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 3));
 }
 void vu_i_mul(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int d = VU_UD_D;
-    int t = VU_UD_T;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) * vu_vf_i(vu, t, i);
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MUL, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_vf(vu, VU_UD_T));
 }
 void vu_i_muli(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) * vu->i.f;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MUL, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->i.f));
 }
 void vu_i_mulq(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) * vu->q.f;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MUL, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->q.f));
 }
 void vu_i_mulx(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_x(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) * bc;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MUL, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 0));
 }
 void vu_i_muly(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_y(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) * bc;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MUL, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 1));
 }
 void vu_i_mulz(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_z(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) * bc;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MUL, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 2));
 }
 void vu_i_mulw(struct vu_state* vu) {
-    int d = VU_UD_D;
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_w(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) * bc;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MUL, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 3));
 }
 void vu_i_mula(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) * vu_vf_i(vu, t, i);
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MUL, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_vf(vu, VU_UD_T));
 }
 void vu_i_mulai(struct vu_state* vu) {
-    int s = VU_UD_S;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) * vu->i.f;
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MUL, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->i.f));
+}
+void vu_i_mulaq(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_MUL, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->q.f));
 }
-void vu_i_mulaq(struct vu_state* vu) { printf("vu: mulaq unimplemented\n"); exit(1); }
 void vu_i_mulax(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_x(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) * bc;
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MUL, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 0));
 }
 void vu_i_mulay(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_y(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) * bc;
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MUL, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 1));
 }
 void vu_i_mulaz(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_z(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) * bc;
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MUL, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 2));
 }
 void vu_i_mulaw(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_w(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_vf_i(vu, s, i) * bc;
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MUL, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 3));
 }
 void vu_i_madd(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) + vu_vf_i(vu, s, i) * vu_vf_i(vu, t, i);
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MADD, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_vf(vu, VU_UD_T));
 }
 void vu_i_maddi(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int d = VU_UD_D;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) + vu_vf_i(vu, s, i) * vu->i.f;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MADD, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->i.f));
 }
 void vu_i_maddq(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int d = VU_UD_D;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) + vu_vf_i(vu, s, i) * vu->q.f;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MADD, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->q.f));
 }
 void vu_i_maddx(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    float bc = vu_vf_x(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) + vu_vf_i(vu, s, i) * bc;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MADD, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 0));
 }
 void vu_i_maddy(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    float bc = vu_vf_y(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) + vu_vf_i(vu, s, i) * bc;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MADD, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 1));
 }
 void vu_i_maddz(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    float bc = vu_vf_z(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) + vu_vf_i(vu, s, i) * bc;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MADD, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 2));
 }
 void vu_i_maddw(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    float bc = vu_vf_w(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) + vu_vf_i(vu, s, i) * bc;
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MADD, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 3));
 }
 void vu_i_madda(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) + vu_vf_i(vu, s, i) * vu_vf_i(vu, t, i);
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MADD, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_vf(vu, VU_UD_T));
 }
 void vu_i_maddai(struct vu_state* vu) {
-    int s = VU_UD_S;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) + vu_vf_i(vu, s, i) * vu->i.f;
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MADD, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->i.f));
+}
+void vu_i_maddaq(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_MADD, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->q.f));
 }
-void vu_i_maddaq(struct vu_state* vu) { printf("vu: maddaq unimplemented\n"); exit(1); }
 void vu_i_maddax(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_x(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) + vu_vf_i(vu, s, i) * bc;
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MADD, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 0));
 }
 void vu_i_madday(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_y(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) + vu_vf_i(vu, s, i) * bc;
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MADD, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 1));
 }
 void vu_i_maddaz(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_z(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) + vu_vf_i(vu, s, i) * bc;
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MADD, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 2));
 }
 void vu_i_maddaw(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_w(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) + vu_vf_i(vu, s, i) * bc;
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MADD, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 3));
 }
 void vu_i_msub(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) - vu_vf_i(vu, s, i) * vu_vf_i(vu, t, i);
-
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MSUB, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_vf(vu, VU_UD_T));
 }
 void vu_i_msubi(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int d = VU_UD_D;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) - vu_vf_i(vu, s, i) * vu->i.f;
-            
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
-}
-void vu_i_msubq(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int d = VU_UD_D;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) - (vu_vf_i(vu, s, i) * vu->q.f);
-            
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
-}
-void vu_i_msubx(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    float bc = vu_vf_x(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) - vu_vf_i(vu, s, i) * bc;
-            
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MSUB, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->i.f));
+}
+void vu_i_msubq(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_MSUB, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->q.f));
+}
+void vu_i_msubx(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_MSUB, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 0));
 }
 void vu_i_msuby(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    float bc = vu_vf_y(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) - vu_vf_i(vu, s, i) * bc;
-            
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MSUB, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 1));
 }
 void vu_i_msubz(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    float bc = vu_vf_z(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) - vu_vf_i(vu, s, i) * bc;
-            
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MSUB, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 2));
 }
 void vu_i_msubw(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    float bc = vu_vf_w(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) - vu_vf_i(vu, s, i) * bc;
-            
-            vu_set_vf(vu, d, i, vu_update_flags(vu, result, i));
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MSUB, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 3));
 }
 void vu_i_msuba(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) - vu_vf_i(vu, s, i) * vu_vf_i(vu, t, i);
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MSUB, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_vf(vu, VU_UD_T));
 }
 void vu_i_msubai(struct vu_state* vu) {
-    int s = VU_UD_S;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) - vu_vf_i(vu, s, i) * vu->i.f;
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MSUB, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->i.f));
+}
+void vu_i_msubaq(struct vu_state* vu) {
+    vu_upper_op(vu, VU_OP_MSUB, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->q.f));
 }
-void vu_i_msubaq(struct vu_state* vu) { printf("vu: msubaq unimplemented\n"); exit(1); }
 void vu_i_msubax(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_x(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) - vu_vf_i(vu, s, i) * bc;
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MSUB, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 0));
 }
 void vu_i_msubay(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_y(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) - vu_vf_i(vu, s, i) * bc;
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MSUB, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 1));
 }
 void vu_i_msubaz(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_z(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) - vu_vf_i(vu, s, i) * bc;
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MSUB, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 2));
 }
 void vu_i_msubaw(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-
-    float bc = vu_vf_w(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float result = vu_acc_i(vu, i) - vu_vf_i(vu, s, i) * bc;
-
-            vu->acc.f[i] = vu_update_flags(vu, result, i);
-        } else {
-            vu_clear_flags(vu, i);
-        }
-    }
-
-    vu_update_status(vu);
+    vu_upper_op(vu, VU_OP_MSUB, VU_DEST_ACC, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 3));
 }
 void vu_i_max(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float fs = vu_vf_i(vu, s, i);
-            float ft = vu_vf_i(vu, t, i);
-
-            vu_set_vf(vu, d, i, (fs > ft) ? fs : ft);
-        }
-    }
+    vu_upper_minmax(vu, VU_OP_MAX, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_vf(vu, VU_UD_T));
+}
+void vu_i_maxi(struct vu_state* vu) {
+    vu_upper_minmax(vu, VU_OP_MAX, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->i.f));
 }
-void vu_i_maxi(struct vu_state* vu) { printf("vu: maxi unimplemented\n"); exit(1); }
 void vu_i_maxx(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    float bc = vu_vf_x(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float fs = vu_vf_i(vu, s, i);
-
-            vu_set_vf(vu, d, i, (fs > bc) ? fs : bc);
-        }
-    }
+    vu_upper_minmax(vu, VU_OP_MAX, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 0));
 }
 void vu_i_maxy(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    float bc = vu_vf_y(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float fs = vu_vf_i(vu, s, i);
-
-            vu_set_vf(vu, d, i, (fs > bc) ? fs : bc);
-        }
-    }
+    vu_upper_minmax(vu, VU_OP_MAX, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 1));
 }
 void vu_i_maxz(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    float bc = vu_vf_z(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float fs = vu_vf_i(vu, s, i);
-
-            vu_set_vf(vu, d, i, (fs > bc) ? fs : bc);
-        }
-    }
+    vu_upper_minmax(vu, VU_OP_MAX, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 2));
 }
 void vu_i_maxw(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    float bc = vu_vf_w(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float fs = vu_vf_i(vu, s, i);
-
-            vu_set_vf(vu, d, i, (fs > bc) ? fs : bc);
-        }
-    }
+    vu_upper_minmax(vu, VU_OP_MAX, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 3));
 }
 void vu_i_mini(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float fs = vu_vf_i(vu, s, i);
-            float ft = vu_vf_i(vu, t, i);
-
-            vu_set_vf(vu, d, i, (fs < ft) ? fs : ft);
-        }
-    }
+    vu_upper_minmax(vu, VU_OP_MIN, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_vf(vu, VU_UD_T));
 }
 void vu_i_minii(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float fs = vu_vf_i(vu, s, i);
-            float ft = vu_vf_i(vu, t, i);
-
-            vu_set_vf(vu, d, i, (fs < ft) ? fs : ft);
-        }
-    }
+    vu_upper_minmax(vu, VU_OP_MIN, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_set1(vu->i.f));
 }
 void vu_i_minix(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    float bc = vu_vf_x(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float fs = vu_vf_i(vu, s, i);
-
-            vu_set_vf(vu, d, i, (fs < bc) ? fs : bc);
-        }
-    }
+    vu_upper_minmax(vu, VU_OP_MIN, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 0));
 }
 void vu_i_miniy(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    float bc = vu_vf_y(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float fs = vu_vf_i(vu, s, i);
-
-            vu_set_vf(vu, d, i, (fs < bc) ? fs : bc);
-        }
-    }
+    vu_upper_minmax(vu, VU_OP_MIN, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 1));
 }
 void vu_i_miniz(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    float bc = vu_vf_z(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float fs = vu_vf_i(vu, s, i);
-
-            vu_set_vf(vu, d, i, (fs < bc) ? fs : bc);
-        }
-    }
+    vu_upper_minmax(vu, VU_OP_MIN, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 2));
 }
 void vu_i_miniw(struct vu_state* vu) {
-    int s = VU_UD_S;
-    int t = VU_UD_T;
-    int d = VU_UD_D;
-
-    float bc = vu_vf_w(vu, t);
-
-    for (int i = 0; i < 4; i++) {
-        if (VU_UD_DI(i)) {
-            float fs = vu_vf_i(vu, s, i);
-
-            vu_set_vf(vu, d, i, (fs < bc) ? fs : bc);
-        }
-    }
+    vu_upper_minmax(vu, VU_OP_MIN, VU_UD_D, vu_vec_vf(vu, VU_UD_S), vu_vec_bc(vu, VU_UD_T, 3));
 }
 void vu_i_opmula(struct vu_state* vu) {
     int s = VU_UD_S;
@@ -1878,10 +1042,17 @@ void vu_i_xgkick(struct vu_state* vu) {
     int eop = 0;
     int addr = VU_IS;
 
+    // Queued on PATH1, the EE thread sends it to the GIF
+    if (vu->thread) {
+        vu_thread_kick(vu->thread, addr);
+
+        return;
+    }
+
     do {
         uint128_t tag = vu->vu_mem[addr++];
 
-        ps2_gif_write128(vu->gif, 0, tag);
+        ps2_gif_write_path(vu->gif, GIF_PATH1, &tag, 1);
 
         eop = (tag.u64[0] & 0x8000) != 0;
 
@@ -1909,16 +1080,9 @@ void vu_i_xgkick(struct vu_state* vu) {
             qwc
         );
 
-        for (int i = 0; i < qwc; i++) {
-            // printf("vu: %08x %08x %08x %08x\n",
-            //     vu->vu_mem[addr].u32[3],
-            //     vu->vu_mem[addr].u32[2],
-            //     vu->vu_mem[addr].u32[1],
-            //     vu->vu_mem[addr].u32[0]
-            // );
+        ps2_gif_write_path(vu->gif, GIF_PATH1, &vu->vu_mem[addr], qwc);
 
-            ps2_gif_write128(vu->gif, 0, vu->vu_mem[addr++]);
-        }
+        addr += qwc;
     } while (!eop);
 }
 void vu_i_xitop(struct vu_state* vu) { printf("vu: xitop unimplemented\n"); exit(1); }
@@ -1985,6 +1149,8 @@ uint128_t ps2_vu_read128(struct vu_state* vu, uint32_t addr) {
 }
 void ps2_vu_write8(struct vu_state* vu, uint32_t addr, uint64_t data) {
     if (addr <= 0x3FFF) {
+        vu->program = NULL;
+
         uint8_t* ptr = (uint8_t*)vu->micro_mem;
 
         *(uint8_t*)(&ptr[addr & ((vu->micro_mem_size << 3) | 7)]) = data;
@@ -1996,6 +1162,8 @@ void ps2_vu_write8(struct vu_state* vu, uint32_t addr, uint64_t data) {
 }
 void ps2_vu_write16(struct vu_state* vu, uint32_t addr, uint64_t data) {
     if (addr <= 0x3FFF) {
+        vu->program = NULL;
+
         uint8_t* ptr = (uint8_t*)vu->micro_mem;
 
         *(uint16_t*)(&ptr[addr & ((vu->micro_mem_size << 3) | 7)]) = data;
@@ -2007,6 +1175,8 @@ void ps2_vu_write16(struct vu_state* vu, uint32_t addr, uint64_t data) {
 }
 void ps2_vu_write32(struct vu_state* vu, uint32_t addr, uint64_t data) {
     if (addr <= 0x3FFF) {
+        vu->program = NULL;
+
         uint8_t* ptr = (uint8_t*)vu->micro_mem;
 
         *(uint32_t*)(&ptr[addr & ((vu->micro_mem_size << 3) | 7)]) = data;
@@ -2018,6 +1188,8 @@ void ps2_vu_write32(struct vu_state* vu, uint32_t addr, uint64_t data) {
 }
 void ps2_vu_write64(struct vu_state* vu, uint32_t addr, uint64_t data) {
     if (addr <= 0x3FFF) {
+        vu->program = NULL;
+
         uint8_t* ptr = (uint8_t*)vu->micro_mem;
 
         *(uint64_t*)(&ptr[addr & ((vu->micro_mem_size << 3) | 7)]) = data;
@@ -2029,6 +1201,8 @@ void ps2_vu_write64(struct vu_state* vu, uint32_t addr, uint64_t data) {
 }
 void ps2_vu_write128(struct vu_state* vu, uint32_t addr, uint128_t data) {
     if (addr <= 0x3FFF) {
+        vu->program = NULL;
+
         uint8_t* ptr = (uint8_t*)vu->micro_mem;
 
         *(uint128_t*)(&ptr[addr & ((vu->micro_mem_size << 3) | 7)]) = data;
@@ -2039,7 +1213,7 @@ void ps2_vu_write128(struct vu_state* vu, uint32_t addr, uint128_t data) {
     }
 }
 
-static inline void vu_execute_upper(struct vu_state* vu, uint32_t opcode) {
+static inline vu_instruction_func vu_decode_upper(uint32_t opcode) {
     // Decode 000007FF style instruction
     if ((opcode & 0x3c) == 0x3c) {
         // 0EEEE 1111 EE
@@ -2051,196 +1225,279 @@ static inline void vu_execute_upper(struct vu_state* vu, uint32_t opcode) {
         // bits 0-1 and bits 6-9 (6 bits) are enough to decode
         // all of the following
         switch (((opcode & 0x3c0) >> 4) | (opcode & 3)) {
-            case 0x00: printf("vu: addax  "); vu_i_addax(vu); return;
-            case 0x01: printf("vu: adday  "); vu_i_adday(vu); return;
-            case 0x02: printf("vu: addaz  "); vu_i_addaz(vu); return;
-            case 0x03: printf("vu: addaw  "); vu_i_addaw(vu); return;
-            case 0x04: printf("vu: subax  "); vu_i_subax(vu); return;
-            case 0x05: printf("vu: subay  "); vu_i_subay(vu); return;
-            case 0x06: printf("vu: subaz  "); vu_i_subaz(vu); return;
-            case 0x07: printf("vu: subaw  "); vu_i_subaw(vu); return;
-            case 0x08: printf("vu: maddax "); vu_i_maddax(vu); return;
-            case 0x09: printf("vu: madday "); vu_i_madday(vu); return;
-            case 0x0A: printf("vu: maddaz "); vu_i_maddaz(vu); return;
-            case 0x0B: printf("vu: maddaw "); vu_i_maddaw(vu); return;
-            case 0x0C: printf("vu: msubax "); vu_i_msubax(vu); return;
-            case 0x0D: printf("vu: msubay "); vu_i_msubay(vu); return;
-            case 0x0E: printf("vu: msubaz "); vu_i_msubaz(vu); return;
-            case 0x0F: printf("vu: msubaw "); vu_i_msubaw(vu); return;
-            case 0x10: printf("vu: itof0  "); vu_i_itof0(vu); return;
-            case 0x11: printf("vu: itof4  "); vu_i_itof4(vu); return;
-            case 0x12: printf("vu: itof12 "); vu_i_itof12(vu); return;
-            case 0x13: printf("vu: itof15 "); vu_i_itof15(vu); return;
-            case 0x14: printf("vu: ftoi0  "); vu_i_ftoi0(vu); return;
-            case 0x15: printf("vu: ftoi4  "); vu_i_ftoi4(vu); return;
-            case 0x16: printf("vu: ftoi12 "); vu_i_ftoi12(vu); return;
-            case 0x17: printf("vu: ftoi15 "); vu_i_ftoi15(vu); return;
-            case 0x18: printf("vu: mulax  "); vu_i_mulax(vu); return;
-            case 0x19: printf("vu: mulay  "); vu_i_mulay(vu); return;
-            case 0x1A: printf("vu: mulaz  "); vu_i_mulaz(vu); return;
-            case 0x1B: printf("vu: mulaw  "); vu_i_mulaw(vu); return;
-            case 0x1C: printf("vu: mulaq  "); vu_i_mulaq(vu); return;
-            case 0x1D: printf("vu: abs    "); vu_i_abs(vu); return;
-            case 0x1E: printf("vu: mulai  "); vu_i_mulai(vu); return;
-            case 0x1F: printf("vu: clip   "); vu_i_clip(vu); return;
-            case 0x20: printf("vu: addaq  "); vu_i_addaq(vu); return;
-            case 0x21: printf("vu: maddaq "); vu_i_maddaq(vu); return;
-            case 0x22: printf("vu: addai  "); vu_i_addai(vu); return;
-            case 0x23: printf("vu: maddai "); vu_i_maddai(vu); return;
-            case 0x24: printf("vu: subaq  "); vu_i_subaq(vu); return;
-            case 0x25: printf("vu: msubaq "); vu_i_msubaq(vu); return;
-            case 0x26: printf("vu: subai  "); vu_i_subai(vu); return;
-            case 0x27: printf("vu: msubai "); vu_i_msubai(vu); return;
-            case 0x28: printf("vu: adda   "); vu_i_adda(vu); return;
-            case 0x29: printf("vu: madda  "); vu_i_madda(vu); return;
-            case 0x2A: printf("vu: mula   "); vu_i_mula(vu); return;
-            case 0x2C: printf("vu: suba   "); vu_i_suba(vu); return;
-            case 0x2D: printf("vu: msuba  "); vu_i_msuba(vu); return;
-            case 0x2E: printf("vu: opmula "); vu_i_opmula(vu); return;
-            case 0x2F: printf("vu: nop    "); vu_i_nop(vu); return;
+            case 0x00: return vu_i_addax;
+            case 0x01: return vu_i_adday;
+            case 0x02: return vu_i_addaz;
+            case 0x03: return vu_i_addaw;
+            case 0x04: return vu_i_subax;
+            case 0x05: return vu_i_subay;
+            case 0x06: return vu_i_subaz;
+            case 0x07: return vu_i_subaw;
+            case 0x08: return vu_i_maddax;
+            case 0x09: return vu_i_madday;
+            case 0x0A: return vu_i_maddaz;
+            case 0x0B: return vu_i_maddaw;
+            case 0x0C: return vu_i_msubax;
+            case 0x0D: return vu_i_msubay;
+            case 0x0E: return vu_i_msubaz;
+            case 0x0F: return vu_i_msubaw;
+            case 0x10: return vu_i_itof0;
+            case 0x11: return vu_i_itof4;
+            case 0x12: return vu_i_itof12;
+            case 0x13: return vu_i_itof15;
+            case 0x14: return vu_i_ftoi0;
+            case 0x15: return vu_i_ftoi4;
+            case 0x16: return vu_i_ftoi12;
+            case 0x17: return vu_i_ftoi15;
+            case 0x18: return vu_i_mulax;
+            case 0x19: return vu_i_mulay;
+            case 0x1A: return vu_i_mulaz;
+            case 0x1B: return vu_i_mulaw;
+            case 0x1C: return vu_i_mulaq;
+            case 0x1D: return vu_i_abs;
+            case 0x1E: return vu_i_mulai;
+            case 0x1F: return vu_i_clip;
+            case 0x20: return vu_i_addaq;
+            case 0x21: return vu_i_maddaq;
+            case 0x22: return vu_i_addai;
+            case 0x23: return vu_i_maddai;
+            case 0x24: return vu_i_subaq;
+            case 0x25: return vu_i_msubaq;
+            case 0x26: return vu_i_subai;
+            case 0x27: return vu_i_msubai;
+            case 0x28: return vu_i_adda;
+            case 0x29: return vu_i_madda;
+            case 0x2A: return vu_i_mula;
+            case 0x2C: return vu_i_suba;
+            case 0x2D: return vu_i_msuba;
+            case 0x2E: return vu_i_opmula;
+            case 0x2F: return vu_i_nop;
         }
     } else {
         // Decode 0000003F style instruction
         switch (opcode & 0x3f) {
-            case 0x00: printf("vu: addx   "); vu_i_addx(vu); return;
-            case 0x01: printf("vu: addy   "); vu_i_addy(vu); return;
-            case 0x02: printf("vu: addz   "); vu_i_addz(vu); return;
-            case 0x03: printf("vu: addw   "); vu_i_addw(vu); return;
-            case 0x04: printf("vu: subx   "); vu_i_subx(vu); return;
-            case 0x05: printf("vu: suby   "); vu_i_suby(vu); return;
-            case 0x06: printf("vu: subz   "); vu_i_subz(vu); return;
-            case 0x07: printf("vu: subw   "); vu_i_subw(vu); return;
-            case 0x08: printf("vu: maddx  "); vu_i_maddx(vu); return;
-            case 0x09: printf("vu: maddy  "); vu_i_maddy(vu); return;
-            case 0x0A: printf("vu: maddz  "); vu_i_maddz(vu); return;
-            case 0x0B: printf("vu: maddw  "); vu_i_maddw(vu); return;
-            case 0x0C: printf("vu: msubx  "); vu_i_msubx(vu); return;
-            case 0x0D: printf("vu: msuby  "); vu_i_msuby(vu); return;
-            case 0x0E: printf("vu: msubz  "); vu_i_msubz(vu); return;
-            case 0x0F: printf("vu: msubw  "); vu_i_msubw(vu); return;
-            case 0x10: printf("vu: maxx   "); vu_i_maxx(vu); return;
-            case 0x11: printf("vu: maxy   "); vu_i_maxy(vu); return;
-            case 0x12: printf("vu: maxz   "); vu_i_maxz(vu); return;
-            case 0x13: printf("vu: maxw   "); vu_i_maxw(vu); return;
-            case 0x14: printf("vu: minix  "); vu_i_minix(vu); return;
-            case 0x15: printf("vu: miniy  "); vu_i_miniy(vu); return;
-            case 0x16: printf("vu: miniz  "); vu_i_miniz(vu); return;
-            case 0x17: printf("vu: miniw  "); vu_i_miniw(vu); return;
-            case 0x18: printf("vu: mulx   "); vu_i_mulx(vu); return;
-            case 0x19: printf("vu: muly   "); vu_i_muly(vu); return;
-            case 0x1A: printf("vu: mulz   "); vu_i_mulz(vu); return;
-            case 0x1B: printf("vu: mulw   "); vu_i_mulw(vu); return;
-            case 0x1C: printf("vu: mulq   "); vu_i_mulq(vu); return;
-            case 0x1D: printf("vu: maxi   "); vu_i_maxi(vu); return;
-            case 0x1E: printf("vu: muli   "); vu_i_muli(vu); return;
-            case 0x1F: printf("vu: minii  "); vu_i_minii(vu); return;
-            case 0x20: printf("vu: addq   "); vu_i_addq(vu); return;
-            case 0x21: printf("vu: maddq  "); vu_i_maddq(vu); return;
-            case 0x22: printf("vu: addi   "); vu_i_addi(vu); return;
-            case 0x23: printf("vu: maddi  "); vu_i_maddi(vu); return;
-            case 0x24: printf("vu: subq   "); vu_i_subq(vu); return;
-            case 0x25: printf("vu: msubq  "); vu_i_msubq(vu); return;
-            case 0x26: printf("vu: subi   "); vu_i_subi(vu); return;
-            case 0x27: printf("vu: msubi  "); vu_i_msubi(vu); return;
-            case 0x28: printf("vu: add    "); vu_i_add(vu); return;
-            case 0x29: printf("vu: madd   "); vu_i_madd(vu); return;
-            case 0x2A: printf("vu: mul    "); vu_i_mul(vu); return;
-            case 0x2B: printf("vu: max    "); vu_i_max(vu); return;
-            case 0x2C: printf("vu: sub    "); vu_i_sub(vu); return;
-            case 0x2D: printf("vu: msub   "); vu_i_msub(vu); return;
-            case 0x2E: printf("vu: opmsub "); vu_i_opmsub(vu); return;
-            case 0x2F: printf("vu: mini   "); vu_i_mini(vu); return;
-        }
-    }
-}
-
-static inline void vu_execute_lower(struct vu_state* vu, uint32_t opcode) {
+            case 0x00: return vu_i_addx;
+            case 0x01: return vu_i_addy;
+            case 0x02: return vu_i_addz;
+            case 0x03: return vu_i_addw;
+            case 0x04: return vu_i_subx;
+            case 0x05: return vu_i_suby;
+            case 0x06: return vu_i_subz;
+            case 0x07: return vu_i_subw;
+            case 0x08: return vu_i_maddx;
+            case 0x09: return vu_i_maddy;
+            case 0x0A: return vu_i_maddz;
+            case 0x0B: return vu_i_maddw;
+            case 0x0C: return vu_i_msubx;
+            case 0x0D: return vu_i_msuby;
+            case 0x0E: return vu_i_msubz;
+            case 0x0F: return vu_i_msubw;
+            case 0x10: return vu_i_maxx;
+            case 0x11: return vu_i_maxy;
+            case 0x12: return vu_i_maxz;
+            case 0x13: return vu_i_maxw;
+            case 0x14: return vu_i_minix;
+            case 0x15: return vu_i_miniy;
+            case 0x16: return vu_i_miniz;
+            case 0x17: return vu_i_miniw;
+            case 0x18: return vu_i_mulx;
+            case 0x19: return vu_i_muly;
+            case 0x1A: return vu_i_mulz;
+            case 0x1B: return vu_i_mulw;
+            case 0x1C: return vu_i_mulq;
+            case 0x1D: return vu_i_maxi;
+            case 0x1E: return vu_i_muli;
+            case 0x1F: return vu_i_minii;
+            case 0x20: return vu_i_addq;
+            case 0x21: return vu_i_maddq;
+            case 0x22: return vu_i_addi;
+            case 0x23: return vu_i_maddi;
+            case 0x24: return vu_i_subq;
+            case 0x25: return vu_i_msubq;
+            case 0x26: return vu_i_subi;
+            case 0x27: return vu_i_msubi;
+            case 0x28: return vu_i_add;
+            case 0x29: return vu_i_madd;
+            case 0x2A: return vu_i_mul;
+            case 0x2B: return vu_i_max;
+            case 0x2C: return vu_i_sub;
+            case 0x2D: return vu_i_msub;
+            case 0x2E: return vu_i_opmsub;
+            case 0x2F: return vu_i_mini;
+        }
+    }
+
+    return vu_i_nop;
+}
+
+static inline vu_instruction_func vu_decode_lower(uint32_t opcode) {
     switch ((opcode & 0xFE000000) >> 25) {
-        case 0x00: printf("lq\n"); vu_i_lq(vu); return;
-        case 0x01: printf("sq\n"); vu_i_sq(vu); return;
-        case 0x04: printf("ilw\n"); vu_i_ilw(vu); return;
-        case 0x05: printf("isw\n"); vu_i_isw(vu); return;
-        case 0x08: printf("iaddiu\n"); vu_i_iaddiu(vu); return;
-        case 0x09: printf("isubiu\n"); vu_i_isubiu(vu); return;
-        case 0x10: printf("fceq\n"); vu_i_fceq(vu); return;
-        case 0x11: printf("fcset\n"); vu_i_fcset(vu); return;
-        case 0x12: printf("fcand\n"); vu_i_fcand(vu); return;
-        case 0x13: printf("fcor\n"); vu_i_fcor(vu); return;
-        case 0x14: printf("fseq\n"); vu_i_fseq(vu); return;
-        case 0x15: printf("fsset\n"); vu_i_fsset(vu); return;
-        case 0x16: printf("fsand\n"); vu_i_fsand(vu); return;
-        case 0x17: printf("fsor\n"); vu_i_fsor(vu); return;
-        case 0x18: printf("fmeq\n"); vu_i_fmeq(vu); return;
-        case 0x1A: printf("fmand\n"); vu_i_fmand(vu); return;
-        case 0x1B: printf("fmor\n"); vu_i_fmor(vu); return;
-        case 0x1C: printf("fcget\n"); vu_i_fcget(vu); return;
-        case 0x20: printf("b\n"); vu_i_b(vu); return;
-        case 0x21: printf("bal\n"); vu_i_bal(vu); return;
-        case 0x24: printf("jr\n"); vu_i_jr(vu); return;
-        case 0x25: printf("jalr\n"); vu_i_jalr(vu); return;
-        case 0x28: printf("ibeq\n"); vu_i_ibeq(vu); return;
-        case 0x29: printf("ibne\n"); vu_i_ibne(vu); return;
-        case 0x2C: printf("ibltz\n"); vu_i_ibltz(vu); return;
-        case 0x2D: printf("ibgtz\n"); vu_i_ibgtz(vu); return;
-        case 0x2E: printf("iblez\n"); vu_i_iblez(vu); return;
-        case 0x2F: printf("ibgez\n"); vu_i_ibgez(vu); return;
+        case 0x00: return vu_i_lq;
+        case 0x01: return vu_i_sq;
+        case 0x04: return vu_i_ilw;
+        case 0x05: return vu_i_isw;
+        case 0x08: return vu_i_iaddiu;
+        case 0x09: return vu_i_isubiu;
+        case 0x10: return vu_i_fceq;
+        case 0x11: return vu_i_fcset;
+        case 0x12: return vu_i_fcand;
+        case 0x13: return vu_i_fcor;
+        case 0x14: return vu_i_fseq;
+        case 0x15: return vu_i_fsset;
+        case 0x16: return vu_i_fsand;
+        case 0x17: return vu_i_fsor;
+        case 0x18: return vu_i_fmeq;
+        case 0x1A: return vu_i_fmand;
+        case 0x1B: return vu_i_fmor;
+        case 0x1C: return vu_i_fcget;
+        case 0x20: return vu_i_b;
+        case 0x21: return vu_i_bal;
+        case 0x24: return vu_i_jr;
+        case 0x25: return vu_i_jalr;
+        case 0x28: return vu_i_ibeq;
+        case 0x29: return vu_i_ibne;
+        case 0x2C: return vu_i_ibltz;
+        case 0x2D: return vu_i_ibgtz;
+        case 0x2E: return vu_i_iblez;
+        case 0x2F: return vu_i_ibgez;
         case 0x40: {
             if ((opcode & 0x3C) == 0x3C) {
                 switch (((opcode & 0x7C0) >> 4) | (opcode & 3)) {
-                    case 0x30: printf("move\n"); vu_i_move(vu); return;
-                    case 0x31: printf("mr32\n"); vu_i_mr32(vu); return;
-                    case 0x34: printf("lqi\n"); vu_i_lqi(vu); return;
-                    case 0x35: printf("sqi\n"); vu_i_sqi(vu); return;
-                    case 0x36: printf("lqd\n"); vu_i_lqd(vu); return;
-                    case 0x37: printf("sqd\n"); vu_i_sqd(vu); return;
-                    case 0x38: printf("div\n"); vu_i_div(vu); return;
-                    case 0x39: printf("sqrt\n"); vu_i_sqrt(vu); return;
-                    case 0x3A: printf("rsqrt\n"); vu_i_rsqrt(vu); return;
-                    case 0x3B: printf("waitq\n"); vu_i_waitq(vu); return;
-                    case 0x3C: printf("mtir\n"); vu_i_mtir(vu); return;
-                    case 0x3D: printf("mfir\n"); vu_i_mfir(vu); return;
-                    case 0x3E: printf("ilwr\n"); vu_i_ilwr(vu); return;
-                    case 0x3F: printf("iswr\n"); vu_i_iswr(vu); return;
-                    case 0x40: printf("rnext\n"); vu_i_rnext(vu); return;
-                    case 0x41: printf("rget\n"); vu_i_rget(vu); return;
-                    case 0x42: printf("rinit\n"); vu_i_rinit(vu); return;
-                    case 0x43: printf("rxor\n"); vu_i_rxor(vu); return;
-                    case 0x64: printf("mfp\n"); vu_i_mfp(vu); return;
-                    case 0x68: printf("xtop\n"); vu_i_xtop(vu); return;
-                    case 0x69: printf("xitop\n"); vu_i_xitop(vu); return;
-                    case 0x6C: printf("xgkick\n"); vu_i_xgkick(vu); return;
-                    case 0x70: printf("esadd\n"); vu_i_esadd(vu); return;
-                    case 0x71: printf("ersadd\n"); vu_i_ersadd(vu); return;
-                    case 0x72: printf("eleng\n"); vu_i_eleng(vu); return;
-                    case 0x73: printf("erleng\n"); vu_i_erleng(vu); return;
-                    case 0x74: printf("eatanxy\n"); vu_i_eatanxy(vu); return;
-                    case 0x75: printf("eatanxz\n"); vu_i_eatanxz(vu); return;
-                    case 0x76: printf("esum\n"); vu_i_esum(vu); return;
-                    case 0x78: printf("esqrt\n"); vu_i_esqrt(vu); return;
-                    case 0x79: printf("ersqrt\n"); vu_i_ersqrt(vu); return;
-                    case 0x7A: printf("ercpr\n"); vu_i_ercpr(vu); return;
-                    case 0x7B: printf("waitp\n"); vu_i_waitp(vu); return;
-                    case 0x7C: printf("esin\n"); vu_i_esin(vu); return;
-                    case 0x7D: printf("eatan\n"); vu_i_eatan(vu); return;
-                    case 0x7E: printf("eexp\n"); vu_i_eexp(vu); return;
+                    case 0x30: return vu_i_move;
+                    case 0x31: return vu_i_mr32;
+                    case 0x34: return vu_i_lqi;
+                    case 0x35: return vu_i_sqi;
+                    case 0x36: return vu_i_lqd;
+                    case 0x37: return vu_i_sqd;
+                    case 0x38: return vu_i_div;
+                    case 0x39: return vu_i_sqrt;
+                    case 0x3A: return vu_i_rsqrt;
+                    case 0x3B: return vu_i_waitq;
+                    case 0x3C: return vu_i_mtir;
+                    case 0x3D: return vu_i_mfir;
+                    case 0x3E: return vu_i_ilwr;
+                    case 0x3F: return vu_i_iswr;
+                    case 0x40: return vu_i_rnext;
+                    case 0x41: return vu_i_rget;
+                    case 0x42: return vu_i_rinit;
+                    case 0x43: return vu_i_rxor;
+                    case 0x64: return vu_i_mfp;
+                    case 0x68: return vu_i_xtop;
+                    case 0x69: return vu_i_xitop;
+                    case 0x6C: return vu_i_xgkick;
+                    case 0x70: return vu_i_esadd;
+                    case 0x71: return vu_i_ersadd;
+                    case 0x72: return vu_i_eleng;
+                    case 0x73: return vu_i_erleng;
+                    case 0x74: return vu_i_eatanxy;
+                    case 0x75: return vu_i_eatanxz;
+                    case 0x76: return vu_i_esum;
+                    case 0x78: return vu_i_esqrt;
+                    case 0x79: return vu_i_ersqrt;
+                    case 0x7A: return vu_i_ercpr;
+                    case 0x7B: return vu_i_waitp;
+                    case 0x7C: return vu_i_esin;
+                    case 0x7D: return vu_i_eatan;
+                    case 0x7E: return vu_i_eexp;
                 }
             } else {
                 switch (opcode & 0x3F) {
-                    case 0x30: printf("iadd\n"); vu_i_iadd(vu); return;
-                    case 0x31: printf("isub\n"); vu_i_isub(vu); return;
-                    case 0x32: printf("iaddi\n"); vu_i_iaddi(vu); return;
-                    case 0x34: printf("iand\n"); vu_i_iand(vu); return;
-                    case 0x35: printf("ior\n"); vu_i_ior(vu); return;
+                    case 0x30: return vu_i_iadd;
+                    case 0x31: return vu_i_isub;
+                    case 0x32: return vu_i_iaddi;
+                    case 0x34: return vu_i_iand;
+                    case 0x35: return vu_i_ior;
                 }
             }
         } break;
     }
+
+    // Unknown lower instructions are ignored
+    return vu_i_nop;
+}
+
+void vu_decode_instruction(struct vu_instruction* ins, uint64_t liw) {
+    ins->upper = liw >> 32;
+    ins->lower = liw & 0xffffffff;
+    ins->upper_func = vu_decode_upper(ins->upper);
+    ins->lower_func = vu_decode_lower(ins->lower);
+}
+
+static inline uint64_t vu_hash_micro_mem(struct vu_state* vu) {
+    // FNV-1a over whole LIWs
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (int i = 0; i <= vu->micro_mem_size; i++) {
+        hash ^= vu->micro_mem[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static struct vu_program* vu_lookup_program(struct vu_state* vu) {
+    uint64_t hash = vu_hash_micro_mem(vu);
+
+    for (int i = 0; i < VU_PROGRAM_CACHE_SIZE; i++) {
+        struct vu_program* program = &vu->program_cache[i];
+
+        if (program->valid && (program->hash == hash))
+            return program;
+    }
+
+    // Not cached, evict the oldest translation
+    struct vu_program* program = &vu->program_cache[vu->program_cache_next];
+
+    vu->program_cache_next = (vu->program_cache_next + 1) % VU_PROGRAM_CACHE_SIZE;
+
+    memset(program->ins, 0, sizeof(program->ins));
+
+    program->hash = hash;
+    program->generation = 0;
+    program->valid = 1;
+
+    return program;
+}
+
+static inline int vu_execute_liw(struct vu_state* vu, struct vu_program* program) {
+    uint32_t tpc = vu->tpc & vu->micro_mem_size;
+    struct vu_instruction* ins = &program->ins[tpc];
+
+    // LIWs are decoded the first time they're reached
+    if (!ins->upper_func)
+        vu_decode_instruction(ins, vu->micro_mem[tpc]);
+
+    vu->tpc = vu->next_tpc;
+    vu->next_tpc = vu->tpc + 1;
+
+    int delayed_e_bit = vu->e_bit;
+
+    vu->upper = ins->upper;
+    vu->lower = ins->lower;
+    vu->i_bit = vu->upper & 0x80000000;
+    vu->e_bit = vu->upper & 0x40000000;
+    vu->m_bit = vu->upper & 0x20000000;
+    vu->d_bit = vu->upper & 0x10000000;
+    vu->t_bit = vu->upper & 0x08000000;
+
+    ins->upper_func(vu);
+    ins->lower_func(vu);
+
+    return delayed_e_bit;
+}
+
+// Runs a single LIW, returns non-zero if it ended the microprogram
+int vu_step(struct vu_state* vu, struct vu_program* program) {
+    return vu_execute_liw(vu, program);
 }
 
 void vu_execute_program(struct vu_state* vu, uint32_t addr) {
-    printf("vu: Executing program at %08x (%08x) TOP=%08x\n", addr, addr << 3, vu->vif->vif1_top);
+    // Translations are keyed by a hash of the whole micro memory,
+    // we only need to rehash after it's been written to
+    if (!vu->program)
+        vu->program = vu_lookup_program(vu);
 
-    printf("vu: upper  lower\n");
+    struct vu_program* program = vu->program;
 
     vu->tpc = addr;
     vu->next_tpc = addr + 1;
@@ -2253,31 +1510,11 @@ void vu_execute_program(struct vu_state* vu, uint32_t addr) {
     vu->d_bit = 0;
     vu->t_bit = 0;
 
-    int delayed_e_bit = 0;
+    if (vu->jit) {
+        vu_jit_run(vu->jit, program);
 
-    while (!delayed_e_bit) {
-        uint64_t liw = vu->micro_mem[vu->tpc];
-
-        vu->tpc = vu->next_tpc;
-        vu->next_tpc = vu->tpc + 1;
-
-        delayed_e_bit = vu->e_bit;
-
-        vu->upper = liw >> 32;
-        vu->lower = liw & 0xffffffff;
-        vu->i_bit = vu->upper & 0x80000000;
-        vu->e_bit = vu->upper & 0x40000000;
-        vu->m_bit = vu->upper & 0x20000000;
-        vu->d_bit = vu->upper & 0x10000000;
-        vu->t_bit = vu->upper & 0x08000000;
-
-        if (vu->e_bit) printf("--> ");
-
-        printf("e=%d %08x %08x ", vu->e_bit != 0, vu->upper, vu->lower);
-
-        vu_execute_upper(vu, liw >> 32);
-        vu_execute_lower(vu, liw & 0xffffffff);
+        return;
     }
-}
 
-#undef printf
\ No newline at end of file
+    while (!vu_execute_liw(vu, program));
+}
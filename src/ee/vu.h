@@ -29,6 +29,38 @@ struct vu_reg {
     };
 };
 
+struct vu_state;
+struct vu_thread;
+struct vu_jit;
+
+typedef void (*vu_instruction_func)(struct vu_state* vu);
+
+// Recompiled block, returns non-zero once the microprogram ends
+typedef int (*vu_block_func)(struct vu_state* vu);
+
+// Pre-decoded LIW
+struct vu_instruction {
+    vu_instruction_func upper_func;
+    vu_instruction_func lower_func;
+    uint32_t upper;
+    uint32_t lower;
+};
+
+#define VU_PROGRAM_CACHE_SIZE 8
+
+// Translated copy of the micro memory
+struct vu_program {
+    uint64_t hash;
+    int valid;
+
+    struct vu_instruction ins[0x800];
+
+    // Recompiled blocks by entry address, only valid while
+    // generation matches the recompiler's
+    vu_block_func block[0x800];
+    uint32_t generation;
+};
+
 struct vu_state {
     struct vu_reg vf[32];
     uint16_t vi[16];
@@ -86,6 +118,19 @@ struct vu_state {
     struct ps2_gif* gif;
     struct ps2_vif* vif;
     struct vu_state* vu1;
+
+    // Worker thread running this VU's microprograms, NULL when
+    // they're run synchronously by the VIF
+    struct vu_thread* thread;
+
+    // Recompiler for this VU's microprograms, NULL to interpret
+    struct vu_jit* jit;
+
+    // Translation for the current micro memory contents, cleared
+    // whenever micro memory is written to
+    struct vu_program* program;
+    struct vu_program program_cache[VU_PROGRAM_CACHE_SIZE];
+    int program_cache_next;
 };
 
 struct vu_state* vu_create(void);
@@ -273,6 +318,8 @@ void ps2_vu_write64(struct vu_state* vu, uint32_t addr, uint64_t data);
 void ps2_vu_write128(struct vu_state* vu, uint32_t addr, uint128_t data);
 
 void vu_cycle(struct vu_state* vu);
+void vu_decode_instruction(struct vu_instruction* ins, uint64_t liw);
+int vu_step(struct vu_state* vu, struct vu_program* program);
 void vu_execute_program(struct vu_state* vu, uint32_t addr);
 
 #ifdef __cplusplus
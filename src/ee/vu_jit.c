@@ -0,0 +1,411 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "vu_jit.h"
+
+/*
+    VU microprogram recompiler (x86-64)
+
+    Straight-line runs of LIWs are translated into host code. Most
+    instructions are calls to the interpreter's handlers with the
+    LIW baked in as immediates, NOPs are dropped and vector moves
+    and integer adds are emitted as native SSE/integer code. The
+    per-LIW bookkeeping done by the interpreter is emitted inline,
+    so the resulting state is identical on every LIW boundary.
+
+    Blocks belong to the cached translation of the micro memory they
+    were compiled from, so they're reused across MSCALs as long as
+    the program stays in the cache. A block ends after a branch's
+    delay slot, after the LIW following an E bit or at the end of
+    micro memory.
+
+    Blocks assume they're entered in sequence, LIWs that aren't (the
+    delay slot of an E bit ending a block or the target of a branch
+    in a delay slot) are run through the interpreter.
+
+    Register usage:
+      rbx - struct vu_state*
+      rax - scratch
+      xmm0-2 - scratch
+*/
+
+#ifdef _WIN32
+#define ABI_ARG0_RBX 0xd9 // mov rcx, rbx
+#define ABI_RBX_ARG0 0xcb // mov rbx, rcx
+#define ABI_SHADOW_SPACE 32
+#else
+#define ABI_ARG0_RBX 0xdf // mov rdi, rbx
+#define ABI_RBX_ARG0 0xfb // mov rbx, rdi
+#define ABI_SHADOW_SPACE 0
+#endif
+
+// Worst case host code size for a single LIW
+#define VU_JIT_LIW_SIZE 192
+
+#define VU_OFFSET(m) ((uint32_t)offsetof(struct vu_state, m))
+#define VU_VF_OFFSET(r) (VU_OFFSET(vf) + ((r) * 16))
+#define VU_VI_OFFSET(r) (VU_OFFSET(vi) + ((r) * 2))
+
+// Lanes written by a dest field, x is bit 3
+static uint32_t vu_jit_dest_mask[16][4];
+
+static inline void* vu_jit_alloc_code(size_t size) {
+#ifdef _WIN32
+    return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    return ptr == MAP_FAILED ? NULL : ptr;
+#endif
+}
+
+static inline void vu_jit_free_code(void* ptr, size_t size) {
+#ifdef _WIN32
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+    munmap(ptr, size);
+#endif
+}
+
+static inline void emit8(struct vu_jit* jit, uint8_t v) {
+    *jit->code_ptr++ = v;
+}
+
+static inline void emit32(struct vu_jit* jit, uint32_t v) {
+    memcpy(jit->code_ptr, &v, 4);
+
+    jit->code_ptr += 4;
+}
+
+static inline void emit64(struct vu_jit* jit, uint64_t v) {
+    memcpy(jit->code_ptr, &v, 8);
+
+    jit->code_ptr += 8;
+}
+
+// mov eax, dword [rbx+off]
+static inline void emit_load_eax(struct vu_jit* jit, uint32_t off) {
+    emit8(jit, 0x8b); emit8(jit, 0x83); emit32(jit, off);
+}
+
+// mov dword [rbx+off], eax
+static inline void emit_store_eax(struct vu_jit* jit, uint32_t off) {
+    emit8(jit, 0x89); emit8(jit, 0x83); emit32(jit, off);
+}
+
+// mov dword [rbx+off], imm32
+static inline void emit_store_imm32(struct vu_jit* jit, uint32_t off, uint32_t imm) {
+    emit8(jit, 0xc7); emit8(jit, 0x83); emit32(jit, off); emit32(jit, imm);
+}
+
+// movzx eax, word [rbx+off]
+static inline void emit_load_ax(struct vu_jit* jit, uint32_t off) {
+    emit8(jit, 0x0f); emit8(jit, 0xb7); emit8(jit, 0x83); emit32(jit, off);
+}
+
+// mov word [rbx+off], ax
+static inline void emit_store_ax(struct vu_jit* jit, uint32_t off) {
+    emit8(jit, 0x66); emit8(jit, 0x89); emit8(jit, 0x83); emit32(jit, off);
+}
+
+// movups xmmN, [rbx+off]
+static inline void emit_load_xmm(struct vu_jit* jit, int xmm, uint32_t off) {
+    emit8(jit, 0x0f); emit8(jit, 0x10); emit8(jit, 0x83 | (xmm << 3)); emit32(jit, off);
+}
+
+// movups [rbx+off], xmm0
+static inline void emit_store_xmm0(struct vu_jit* jit, uint32_t off) {
+    emit8(jit, 0x0f); emit8(jit, 0x11); emit8(jit, 0x83); emit32(jit, off);
+}
+
+// Call func(vu)
+static inline void emit_call(struct vu_jit* jit, uintptr_t func) {
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, ABI_ARG0_RBX);
+
+    // mov rax, imm64; call rax
+    emit8(jit, 0x48); emit8(jit, 0xb8); emit64(jit, func);
+    emit8(jit, 0xff); emit8(jit, 0xd0);
+}
+
+// Stores xmm0 to vf[t], keeping the lanes not in dest
+static inline void emit_store_vf_masked(struct vu_jit* jit, int t, int dest) {
+    if (dest != 0xf) {
+        emit_load_xmm(jit, 1, VU_VF_OFFSET(t));
+
+        // mov rax, imm64; movups xmm2, [rax]
+        emit8(jit, 0x48); emit8(jit, 0xb8); emit64(jit, (uintptr_t)vu_jit_dest_mask[dest]);
+        emit8(jit, 0x0f); emit8(jit, 0x10); emit8(jit, 0x10);
+
+        // andps xmm0, xmm2; andnps xmm2, xmm1; orps xmm0, xmm2
+        emit8(jit, 0x0f); emit8(jit, 0x54); emit8(jit, 0xc2);
+        emit8(jit, 0x0f); emit8(jit, 0x55); emit8(jit, 0xd1);
+        emit8(jit, 0x0f); emit8(jit, 0x56); emit8(jit, 0xc2);
+    }
+
+    emit_store_xmm0(jit, VU_VF_OFFSET(t));
+}
+
+// Emits simple lower instructions natively, returns 0 if the
+// handler has to be called instead
+static inline int vu_jit_emit_lower(struct vu_jit* jit, struct vu_instruction* ins) {
+    uint32_t lower = ins->lower;
+    int dest = (lower >> 21) & 0xf;
+    int t = (lower >> 16) & 0x1f;
+    int s = (lower >> 11) & 0x1f;
+    int d = (lower >> 6) & 0x1f;
+
+    if (ins->lower_func == vu_i_nop)
+        return 1;
+
+    if ((ins->lower_func == vu_i_move) || (ins->lower_func == vu_i_mr32)) {
+        if (!t || !dest)
+            return 1;
+
+        emit_load_xmm(jit, 0, VU_VF_OFFSET(s));
+
+        // shufps xmm0, xmm0, yzwx
+        if (ins->lower_func == vu_i_mr32) {
+            emit8(jit, 0x0f); emit8(jit, 0xc6); emit8(jit, 0xc0); emit8(jit, 0x39);
+        }
+
+        emit_store_vf_masked(jit, t, dest);
+
+        return 1;
+    }
+
+    if (ins->lower_func == vu_i_iadd) {
+        if (!d)
+            return 1;
+
+        // add ax, word [rbx+vi[t]]
+        emit_load_ax(jit, VU_VI_OFFSET(s));
+        emit8(jit, 0x66); emit8(jit, 0x03); emit8(jit, 0x83); emit32(jit, VU_VI_OFFSET(t));
+        emit_store_ax(jit, VU_VI_OFFSET(d));
+
+        return 1;
+    }
+
+    if ((ins->lower_func == vu_i_iaddi) || (ins->lower_func == vu_i_iaddiu)) {
+        if (!t)
+            return 1;
+
+        uint32_t imm;
+
+        if (ins->lower_func == vu_i_iaddi) {
+            imm = ((int32_t)(d << 27)) >> 27;
+        } else {
+            imm = (lower & 0x7ff) | ((lower & 0x1e00000) >> 10);
+        }
+
+        // add eax, imm32
+        emit_load_ax(jit, VU_VI_OFFSET(s));
+        emit8(jit, 0x05); emit32(jit, imm);
+        emit_store_ax(jit, VU_VI_OFFSET(t));
+
+        return 1;
+    }
+
+    return 0;
+}
+
+static inline void vu_jit_emit_liw(struct vu_jit* jit, struct vu_instruction* ins) {
+    uint32_t upper = ins->upper;
+
+    // tpc = next_tpc, next_tpc = tpc + 1
+    emit_load_eax(jit, VU_OFFSET(next_tpc));
+    emit_store_eax(jit, VU_OFFSET(tpc));
+    emit8(jit, 0x83); emit8(jit, 0xc0); emit8(jit, 0x01);
+    emit_store_eax(jit, VU_OFFSET(next_tpc));
+
+    emit_store_imm32(jit, VU_OFFSET(upper), upper);
+    emit_store_imm32(jit, VU_OFFSET(lower), ins->lower);
+    emit_store_imm32(jit, VU_OFFSET(i_bit), upper & 0x80000000);
+    emit_store_imm32(jit, VU_OFFSET(e_bit), upper & 0x40000000);
+    emit_store_imm32(jit, VU_OFFSET(m_bit), upper & 0x20000000);
+    emit_store_imm32(jit, VU_OFFSET(d_bit), upper & 0x10000000);
+    emit_store_imm32(jit, VU_OFFSET(t_bit), upper & 0x08000000);
+
+    if (ins->upper_func != vu_i_nop)
+        emit_call(jit, (uintptr_t)ins->upper_func);
+
+    if (!vu_jit_emit_lower(jit, ins))
+        emit_call(jit, (uintptr_t)ins->lower_func);
+}
+
+// B, BAL, JR, JALR and the IBxx conditional branches
+static inline int vu_jit_is_branch(uint32_t lower) {
+    switch (lower >> 25) {
+        case 0x20: case 0x21: case 0x24: case 0x25:
+        case 0x28: case 0x29: case 0x2c: case 0x2d: case 0x2e: case 0x2f:
+            return 1;
+    }
+
+    return 0;
+}
+
+static vu_block_func vu_jit_compile(struct vu_jit* jit, struct vu_program* program, uint32_t tpc) {
+    struct vu_state* vu = jit->vu;
+    size_t worst = ((VU_JIT_MAX_BLOCK_SIZE + 1) * VU_JIT_LIW_SIZE) + 64;
+
+    if ((size_t)(jit->code_ptr - jit->code) + worst > VU_JIT_CODE_SIZE) {
+        vu_jit_flush(jit);
+
+        memset(program->block, 0, sizeof(program->block));
+
+        program->generation = jit->generation;
+    }
+
+    uint8_t* entry = jit->code_ptr;
+
+    // push rbx
+    emit8(jit, 0x53);
+
+    if (ABI_SHADOW_SPACE) {
+        // sub rsp, 32
+        emit8(jit, 0x48); emit8(jit, 0x83); emit8(jit, 0xec); emit8(jit, ABI_SHADOW_SPACE);
+    }
+
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, ABI_RBX_ARG0);
+
+    uint32_t addr = tpc;
+    int count = 0;
+    int e_bit = 0;
+    int delay_slot = 0;
+    int end = 0;
+
+    while (1) {
+        struct vu_instruction* ins = &program->ins[addr];
+
+        if (!ins->upper_func)
+            vu_decode_instruction(ins, vu->micro_mem[addr]);
+
+        vu_jit_emit_liw(jit, ins);
+
+        ++count;
+
+        // This was the E bit's delay slot
+        if (e_bit) {
+            end = 1;
+
+            break;
+        }
+
+        if (delay_slot)
+            break;
+
+        e_bit = (ins->upper & 0x40000000) != 0;
+        delay_slot = vu_jit_is_branch(ins->lower);
+
+        // The next LIW wraps around, leave it to the next block
+        if (addr == (uint32_t)vu->micro_mem_size)
+            break;
+
+        ++addr;
+
+        // Don't split the last LIW from its delay slot
+        if (e_bit || delay_slot)
+            continue;
+
+        if (count >= VU_JIT_MAX_BLOCK_SIZE)
+            break;
+    }
+
+    if (ABI_SHADOW_SPACE) {
+        // add rsp, 32
+        emit8(jit, 0x48); emit8(jit, 0x83); emit8(jit, 0xc4); emit8(jit, ABI_SHADOW_SPACE);
+    }
+
+    // mov eax, end; pop rbx; ret
+    emit8(jit, 0xb8); emit32(jit, end);
+    emit8(jit, 0x5b);
+    emit8(jit, 0xc3);
+
+    vu_block_func block = (vu_block_func)(uintptr_t)entry;
+
+    program->block[tpc] = block;
+    jit->blocks_compiled++;
+
+    return block;
+}
+
+struct vu_jit* vu_jit_create(void) {
+    return malloc(sizeof(struct vu_jit));
+}
+
+int vu_jit_init(struct vu_jit* jit, struct vu_state* vu) {
+    memset(jit, 0, sizeof(struct vu_jit));
+
+    jit->vu = vu;
+
+    // Translations start out at generation 0
+    jit->generation = 1;
+
+    for (int dest = 0; dest < 16; dest++)
+        for (int i = 0; i < 4; i++)
+            vu_jit_dest_mask[dest][i] = (dest & (8 >> i)) ? 0xffffffff : 0;
+
+#ifndef VU_JIT_SUPPORTED
+    return 1;
+#else
+    jit->code = vu_jit_alloc_code(VU_JIT_CODE_SIZE);
+
+    if (!jit->code) {
+        printf("vu_jit: Couldn't allocate code buffer\n");
+
+        return 1;
+    }
+
+    jit->code_ptr = jit->code;
+
+    return 0;
+#endif
+}
+
+void vu_jit_run(struct vu_jit* jit, struct vu_program* program) {
+    struct vu_state* vu = jit->vu;
+
+    if (program->generation != jit->generation) {
+        memset(program->block, 0, sizeof(program->block));
+
+        program->generation = jit->generation;
+    }
+
+    while (1) {
+        // Out of sequence, interpret a single LIW
+        if (vu->e_bit || (vu->next_tpc != vu->tpc + 1)) {
+            if (vu_step(vu, program))
+                return;
+
+            continue;
+        }
+
+        uint32_t tpc = vu->tpc & vu->micro_mem_size;
+        vu_block_func block = program->block[tpc];
+
+        if (!block)
+            block = vu_jit_compile(jit, program, tpc);
+
+        if (block(vu))
+            return;
+    }
+}
+
+void vu_jit_flush(struct vu_jit* jit) {
+    jit->code_ptr = jit->code;
+    jit->generation++;
+    jit->flushes++;
+}
+
+void vu_jit_destroy(struct vu_jit* jit) {
+    if (jit->code)
+        vu_jit_free_code(jit->code, VU_JIT_CODE_SIZE);
+
+    free(jit);
+}
@@ -0,0 +1,45 @@
+#ifndef VU_JIT_H
+#define VU_JIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "vu.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define VU_JIT_SUPPORTED
+#endif
+
+#define VU_JIT_CODE_SIZE 0x800000
+#define VU_JIT_MAX_BLOCK_SIZE 256
+
+struct vu_jit {
+    struct vu_state* vu;
+
+    uint8_t* code;
+    uint8_t* code_ptr;
+
+    // Bumped on every flush, blocks compiled for an older
+    // generation point into code that's been thrown away
+    uint32_t generation;
+
+    // Stats
+    uint64_t blocks_compiled;
+    uint64_t flushes;
+};
+
+struct vu_jit* vu_jit_create(void);
+int vu_jit_init(struct vu_jit* jit, struct vu_state* vu);
+void vu_jit_run(struct vu_jit* jit, struct vu_program* program);
+void vu_jit_flush(struct vu_jit* jit);
+void vu_jit_destroy(struct vu_jit* jit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,209 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "vu_thread.h"
+
+static void* vu_thread_main(void* udata) {
+    struct vu_thread* t = (struct vu_thread*)udata;
+
+    pthread_mutex_lock(&t->mtx);
+
+    while (1) {
+        while (!t->pending && !t->quit)
+            pthread_cond_wait(&t->start_cond, &t->mtx);
+
+        if (t->quit)
+            break;
+
+        uint32_t addr = t->addr;
+
+        t->pending = 0;
+
+        pthread_mutex_unlock(&t->mtx);
+
+        vu_execute_program(t->vu, addr);
+
+        pthread_mutex_lock(&t->mtx);
+
+        __atomic_store_n(&t->busy, 0, __ATOMIC_RELEASE);
+
+        pthread_cond_broadcast(&t->done_cond);
+    }
+
+    pthread_mutex_unlock(&t->mtx);
+
+    return NULL;
+}
+
+struct vu_thread* vu_thread_create(void) {
+    return malloc(sizeof(struct vu_thread));
+}
+
+int vu_thread_init(struct vu_thread* t, struct vu_state* vu, struct ps2_gif* gif) {
+    memset(t, 0, sizeof(struct vu_thread));
+
+    t->vu = vu;
+    t->gif = gif;
+
+    pthread_mutex_init(&t->mtx, NULL);
+    pthread_cond_init(&t->start_cond, NULL);
+    pthread_cond_init(&t->done_cond, NULL);
+    pthread_cond_init(&t->space_cond, NULL);
+
+    if (pthread_create(&t->thread, NULL, vu_thread_main, t))
+        return 1;
+
+    t->started = 1;
+
+    return 0;
+}
+
+// MSCAL, waits for the previous microprogram like the VIF does
+void vu_thread_start(struct vu_thread* t, uint32_t addr) {
+    vu_thread_wait(t);
+
+    pthread_mutex_lock(&t->mtx);
+
+    t->addr = addr;
+    t->pending = 1;
+
+    __atomic_store_n(&t->busy, 1, __ATOMIC_RELEASE);
+
+    pthread_cond_signal(&t->start_cond);
+    pthread_mutex_unlock(&t->mtx);
+}
+
+// FLUSHE/FLUSH/FLUSHA, waits for the running microprogram to end
+// and for its PATH1 packets to reach the GIF
+void vu_thread_wait(struct vu_thread* t) {
+    pthread_mutex_lock(&t->mtx);
+
+    while (t->busy) {
+        // The VU thread is stuck on a full PATH1 queue, make room.
+        // The GIF queues whatever can't go in yet, so this never
+        // waits on a PATH3 transfer that's still being sliced
+        if (__atomic_load_n(&t->path1_stalled, __ATOMIC_SEQ_CST)) {
+            pthread_mutex_unlock(&t->mtx);
+
+            vu_thread_flush_path1(t);
+
+            pthread_mutex_lock(&t->mtx);
+
+            continue;
+        }
+
+        pthread_cond_wait(&t->done_cond, &t->mtx);
+    }
+
+    pthread_mutex_unlock(&t->mtx);
+
+    vu_thread_flush_path1(t);
+}
+
+int vu_thread_busy(struct vu_thread* t) {
+    return __atomic_load_n(&t->busy, __ATOMIC_ACQUIRE);
+}
+
+static inline uint32_t vu_thread_path1_space(struct vu_thread* t) {
+    return VU_THREAD_PATH1_SIZE - (t->path1_tail - __atomic_load_n(&t->path1_head, __ATOMIC_SEQ_CST));
+}
+
+// Called on the VU thread by XGKICK
+void vu_thread_kick(struct vu_thread* t, uint32_t addr) {
+    struct vu_state* vu = t->vu;
+    uint32_t size = 0;
+    int eop;
+
+    // Walk the GIF tags to find out how long the packet is
+    do {
+        uint128_t tag = vu->vu_mem[(addr + size) & vu->vu_mem_size];
+
+        int nloop = tag.u64[0] & 0x7fff;
+        int flg = (tag.u64[0] >> 58) & 3;
+        int nregs = (tag.u64[0] >> 60) & 0xf;
+
+        size += 1 + ((flg < 2) ? (nregs * nloop) : nloop);
+
+        eop = (tag.u64[0] & 0x8000) != 0;
+    } while (!eop && (size < VU_THREAD_PATH1_SIZE));
+
+    if (size > VU_THREAD_PATH1_SIZE)
+        size = VU_THREAD_PATH1_SIZE;
+
+    while (vu_thread_path1_space(t) < size) {
+        pthread_mutex_lock(&t->mtx);
+
+        __atomic_store_n(&t->path1_stalled, 1, __ATOMIC_SEQ_CST);
+
+        // The EE thread might be waiting on us in vu_thread_wait
+        pthread_cond_broadcast(&t->done_cond);
+
+        if (vu_thread_path1_space(t) < size)
+            pthread_cond_wait(&t->space_cond, &t->mtx);
+
+        __atomic_store_n(&t->path1_stalled, 0, __ATOMIC_SEQ_CST);
+
+        pthread_mutex_unlock(&t->mtx);
+    }
+
+    uint32_t tail = t->path1_tail;
+
+    for (uint32_t i = 0; i < size; i++)
+        t->path1[(tail + i) & (VU_THREAD_PATH1_SIZE - 1)] = vu->vu_mem[(addr + i) & vu->vu_mem_size];
+
+    __atomic_store_n(&t->path1_tail, tail + size, __ATOMIC_RELEASE);
+}
+
+// Called on the EE thread. The GIF holds PATH1 packets back until
+// any packet already in flight on another path has ended
+void vu_thread_flush_path1(struct vu_thread* t) {
+    uint32_t tail = __atomic_load_n(&t->path1_tail, __ATOMIC_ACQUIRE);
+    uint32_t head = t->path1_head;
+
+    if (head == tail)
+        return;
+
+    // Hand the ring to the GIF in at most two contiguous pieces
+    while (head != tail) {
+        uint32_t index = head & (VU_THREAD_PATH1_SIZE - 1);
+        uint32_t size = tail - head;
+
+        if (size > VU_THREAD_PATH1_SIZE - index)
+            size = VU_THREAD_PATH1_SIZE - index;
+
+        ps2_gif_write_path(t->gif, GIF_PATH1, &t->path1[index], size);
+
+        head += size;
+    }
+
+    __atomic_store_n(&t->path1_head, head, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&t->path1_stalled, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&t->mtx);
+        pthread_cond_signal(&t->space_cond);
+        pthread_mutex_unlock(&t->mtx);
+    }
+}
+
+void vu_thread_destroy(struct vu_thread* t) {
+    if (t->started) {
+        vu_thread_wait(t);
+
+        pthread_mutex_lock(&t->mtx);
+
+        t->quit = 1;
+
+        pthread_cond_signal(&t->start_cond);
+        pthread_mutex_unlock(&t->mtx);
+
+        pthread_join(t->thread, NULL);
+    }
+
+    pthread_cond_destroy(&t->space_cond);
+    pthread_cond_destroy(&t->done_cond);
+    pthread_cond_destroy(&t->start_cond);
+    pthread_mutex_destroy(&t->mtx);
+
+    free(t);
+}
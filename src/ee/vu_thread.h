@@ -0,0 +1,59 @@
+#ifndef VU_THREAD_H
+#define VU_THREAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "u128.h"
+#include "gif.h"
+#include "vu.h"
+
+// PATH1 queue size in qwords, must be a power of 2 and larger
+// than VU1 data memory so a whole XGKICK packet always fits
+#define VU_THREAD_PATH1_SIZE 0x2000
+
+struct vu_thread {
+    struct vu_state* vu;
+    struct ps2_gif* gif;
+
+    pthread_t thread;
+    pthread_mutex_t mtx;
+    pthread_cond_t start_cond;
+    pthread_cond_t done_cond;
+    pthread_cond_t space_cond;
+    int started;
+
+    // Protected by mtx, busy is also polled without the lock
+    // for VPU_STAT and VIF1_STAT reads
+    int busy;
+    int pending;
+    int quit;
+    uint32_t addr;
+
+    // XGKICK packets are queued here by the VU thread, the EE
+    // thread feeds them to the GIF on packet boundaries. Head and
+    // tail are free-running, only whole packets get published
+    uint128_t path1[VU_THREAD_PATH1_SIZE];
+    uint32_t path1_head;
+    uint32_t path1_tail;
+    int path1_stalled;
+};
+
+struct vu_thread* vu_thread_create(void);
+int vu_thread_init(struct vu_thread* t, struct vu_state* vu, struct ps2_gif* gif);
+void vu_thread_start(struct vu_thread* t, uint32_t addr);
+void vu_thread_wait(struct vu_thread* t);
+int vu_thread_busy(struct vu_thread* t);
+void vu_thread_kick(struct vu_thread* t, uint32_t addr);
+void vu_thread_flush_path1(struct vu_thread* t);
+void vu_thread_destroy(struct vu_thread* t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
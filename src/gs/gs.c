@@ -380,6 +380,8 @@ void ps2_gs_write64(struct ps2_gs* gs, uint32_t addr, uint64_t data) {
 //                             gs->clut_cache[cache_addr] = gs->vram[vram_addr];
 //                         }
 //                     }
+
+//                     ++gs->block_version[GS_BLOCK_CLUT];
 //                 } break;
 
 //                 case GS_PSMCT16:
@@ -404,6 +406,8 @@ void ps2_gs_write64(struct ps2_gs* gs, uint32_t addr, uint64_t data) {
 //                             gs->clut_cache[cache_addr] = gs->vram[vram_addr];
 //                         }
 //                     }
+
+//                     ++gs->block_version[GS_BLOCK_CLUT];
 //                 } break;
 
 //                 case GS_PSMCT16:
@@ -570,7 +574,47 @@ static inline void gs_unpack_dimx(struct ps2_gs* gs) {
     gs->dither[3][3] = ((int32_t)(((gs->dimx >> 60) & 7) << 29)) >> 29;
 }
 
+// Returns the drawing state block a register belongs to, or -1.
+// Vertex data and PRIM/PRMODE are sent along with every primitive
+static inline int gs_get_block(int reg) {
+    switch (reg) {
+        case 0x06: case 0x08: case 0x14: case 0x16: case 0x18: case 0x34:
+        case 0x36: case 0x40: case 0x42: case 0x47: case 0x4A: case 0x4C:
+        case 0x4E:
+            return GS_BLOCK_CONTEXT1;
+
+        case 0x07: case 0x09: case 0x15: case 0x17: case 0x19: case 0x35:
+        case 0x37: case 0x41: case 0x43: case 0x48: case 0x4B: case 0x4D:
+        case 0x4F:
+            return GS_BLOCK_CONTEXT2;
+
+        case 0x1C: case 0x3B:
+            return GS_BLOCK_TEX;
+
+        case 0x22: case 0x3D: case 0x44: case 0x45: case 0x46: case 0x49:
+            return GS_BLOCK_MISC;
+    }
+
+    return -1;
+}
+
 void ps2_gs_write_internal(struct ps2_gs* gs, int reg, uint64_t data) {
+    int block = gs_get_block(reg);
+
+    // Rewriting the same value is common, don't invalidate snapshots.
+    // TEX2 overwrites fields unpacked from TEX0 and the other way
+    // around, so the register alone doesn't tell if those changed
+    switch (reg) {
+        case 0x06: case 0x07: case 0x16: case 0x17: {
+            ++gs->block_version[block];
+        } break;
+
+        default: {
+            if ((block != -1) && (ps2_gs_read_internal(gs, reg) != data))
+                ++gs->block_version[block];
+        } break;
+    }
+
     switch (reg) {
         case 0x00: /* printf("gs: PRIM <- %016lx\n", data); */ gs->prim = data; gs_start_primitive(gs); return;
         case 0x01: /* printf("gs: RGBAQ <- %016lx\n", data); */ gs->rgbaq = data; return;
@@ -712,6 +756,12 @@ uint64_t ps2_gs_read_internal(struct ps2_gs* gs, int reg) {
     return 0;
 }
 
+// Same as writing every element of data to HWREG, lets the backend
+// store the payload in bulk instead of 64 bits at a time
+void ps2_gs_write_image(struct ps2_gs* gs, const uint64_t* data, int count) {
+    gs->backend.transfer_image(gs, data, count, gs->backend.udata);
+}
+
 void ps2_gs_init_callback(struct ps2_gs* gs, int event, void (*func)(void*), void* udata) {
     gs->events[event].func = func;
     gs->events[event].udata = udata;
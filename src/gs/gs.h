@@ -134,6 +134,9 @@ struct gs_renderer {
     void (*transfer_start)(struct ps2_gs*, void*);
     void (*transfer_write)(struct ps2_gs*, void*);
     void (*transfer_read)(struct ps2_gs*, void*);
+
+    // Whole IMAGE-mode payloads, count HWREG writes at once
+    void (*transfer_image)(struct ps2_gs*, const uint64_t*, int, void*);
     void* udata;
 };
 
@@ -254,6 +257,15 @@ struct gs_context {
     uint32_t scay1;
 };
 
+// Drawing state blocks, versioned separately so threaded renderers
+// only snapshot the parts that changed. FBA lives in the contexts
+#define GS_BLOCK_CONTEXT1 0
+#define GS_BLOCK_CONTEXT2 1
+#define GS_BLOCK_TEX 2 // TEXA, TEXCLUT
+#define GS_BLOCK_MISC 3 // SCANMSK, FOGCOL, DIMX, DTHE, COLCLAMP, PABE
+#define GS_BLOCK_CLUT 4
+#define GS_BLOCK_COUNT 5
+
 #define GS_EVENT_VBLANK 0
 #define GS_EVENT_SCISSOR 1
 
@@ -269,6 +281,9 @@ struct ps2_gs {
 
     uint32_t attr;
     struct gs_context context[2];
+
+    // Bumped every time a register in a block changes value
+    uint32_t block_version[GS_BLOCK_COUNT];
     struct gs_context* ctx;
 
     // Privileged registers
@@ -375,6 +390,7 @@ uint64_t ps2_gs_read64(struct ps2_gs* gs, uint32_t addr);
 void ps2_gs_write64(struct ps2_gs* gs, uint32_t addr, uint64_t data);
 void ps2_gs_write_internal(struct ps2_gs* gs, int reg, uint64_t data);
 uint64_t ps2_gs_read_internal(struct ps2_gs* gs, int reg);
+void ps2_gs_write_image(struct ps2_gs* gs, const uint64_t* data, int count);
 void ps2_gs_init_callback(struct ps2_gs* gs, int event, void (*func)(void*), void* udata);
 struct gs_callback* ps2_gs_get_callback(struct ps2_gs* gs, int event);
 void ps2_gs_remove_callback(struct ps2_gs* gs, int event);
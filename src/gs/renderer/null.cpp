@@ -7,6 +7,7 @@ void null_set_scale(void* ctx, float scale) {}
 void null_set_aspect_mode(void* ctx, int aspect_mode) {}
 void null_set_integer_scaling(void* ctx, bool integer_scaling) {}
 void null_set_bilinear(void* ctx, bool bilinear) {}
+void null_set_deinterlace_mode(void* ctx, int mode) {}
 void null_get_viewport_size(void* ctx, int* w, int* h) {
     *w = 0;
     *h = 0;
@@ -32,4 +33,5 @@ extern "C" void null_render_sprite(struct ps2_gs* gs, void* udata) {}
 extern "C" void null_render(struct ps2_gs* gs, void* udata) {}
 extern "C" void null_transfer_start(struct ps2_gs* gs, void* udata) {}
 extern "C" void null_transfer_write(struct ps2_gs* gs, void* udata) {}
-extern "C" void null_transfer_read(struct ps2_gs* gs, void* udata) {}
\ No newline at end of file
+extern "C" void null_transfer_read(struct ps2_gs* gs, void* udata) {}
+extern "C" void null_transfer_image(struct ps2_gs* gs, const uint64_t* data, int count, void* udata) {}
\ No newline at end of file
@@ -14,6 +14,7 @@ void null_set_scale(void* ctx, float scale);
 void null_set_aspect_mode(void* ctx, int aspect_mode);
 void null_set_integer_scaling(void* ctx, bool integer_scaling);
 void null_set_bilinear(void* ctx, bool bilinear);
+void null_set_deinterlace_mode(void* ctx, int mode);
 void null_get_viewport_size(void* ctx, int* w, int* h);
 void null_get_display_size(void* ctx, int* w, int* h);
 void null_get_display_format(void* ctx, int* fmt);
@@ -31,4 +32,5 @@ void null_render(struct ps2_gs* gs, void* udata);
 void null_transfer_start(struct ps2_gs* gs, void* udata);
 void null_transfer_write(struct ps2_gs* gs, void* udata);
 void null_transfer_read(struct ps2_gs* gs, void* udata);
+void null_transfer_image(struct ps2_gs* gs, const uint64_t* data, int count, void* udata);
 }
\ No newline at end of file
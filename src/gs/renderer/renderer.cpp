@@ -17,6 +17,7 @@ void renderer_init_null(renderer_state* renderer, struct ps2_gs* gs, SDL_Window*
     renderer->set_aspect_mode = null_set_aspect_mode;
     renderer->set_integer_scaling = null_set_integer_scaling;
     renderer->set_bilinear = null_set_bilinear;
+    renderer->set_deinterlace_mode = null_set_deinterlace_mode;
     renderer->get_viewport_size = null_get_viewport_size;
     renderer->get_display_size = null_get_display_size;
     renderer->get_display_format = null_get_display_format;
@@ -33,6 +34,7 @@ void renderer_init_null(renderer_state* renderer, struct ps2_gs* gs, SDL_Window*
     gs->backend.transfer_start = null_transfer_start;
     gs->backend.transfer_write = null_transfer_write;
     gs->backend.transfer_read = null_transfer_read;
+    gs->backend.transfer_image = null_transfer_image;
     gs->backend.udata = renderer->udata;
 }
 
@@ -45,6 +47,7 @@ void renderer_init_software(renderer_state* renderer, struct ps2_gs* gs, SDL_Win
     renderer->set_aspect_mode = software_set_aspect_mode;
     renderer->set_integer_scaling = software_set_integer_scaling;
     renderer->set_bilinear = software_set_bilinear;
+    renderer->set_deinterlace_mode = software_set_deinterlace_mode;
     renderer->get_viewport_size = software_get_viewport_size;
     renderer->get_display_size = software_get_display_size;
     renderer->get_display_format = software_get_display_format;
@@ -61,6 +64,7 @@ void renderer_init_software(renderer_state* renderer, struct ps2_gs* gs, SDL_Win
     gs->backend.transfer_start = software_transfer_start;
     gs->backend.transfer_write = software_transfer_write;
     gs->backend.transfer_read = software_transfer_read;
+    gs->backend.transfer_image = software_transfer_image;
     gs->backend.udata = renderer->udata;
 }
 
@@ -73,6 +77,7 @@ void renderer_init_software_thread(renderer_state* renderer, struct ps2_gs* gs,
     renderer->set_aspect_mode = software_thread_set_aspect_mode;
     renderer->set_integer_scaling = software_thread_set_integer_scaling;
     renderer->set_bilinear = software_thread_set_bilinear;
+    renderer->set_deinterlace_mode = software_thread_set_deinterlace_mode;
     renderer->get_viewport_size = software_thread_get_viewport_size;
     renderer->get_display_size = software_thread_get_display_size;
     renderer->get_display_format = software_thread_get_display_format;
@@ -89,9 +94,17 @@ void renderer_init_software_thread(renderer_state* renderer, struct ps2_gs* gs,
     gs->backend.transfer_start = software_thread_transfer_start;
     gs->backend.transfer_write = software_thread_transfer_write;
     gs->backend.transfer_read = software_thread_transfer_read;
+    gs->backend.transfer_image = software_thread_transfer_image;
     gs->backend.udata = renderer->udata;
 }
 
+// Same backend as the threaded one, tiles are drawn on a worker pool
+void renderer_init_software_mt(renderer_state* renderer, struct ps2_gs* gs, SDL_Window* window) {
+    renderer_init_software_thread(renderer, gs, window);
+
+    renderer->init = software_mt_init;
+}
+
 void renderer_init_backend(renderer_state* renderer, struct ps2_gs* gs, SDL_Window* window, int id) {
     renderer->gs = gs;
 
@@ -105,6 +118,7 @@ void renderer_init_backend(renderer_state* renderer, struct ps2_gs* gs, SDL_Wind
         case RENDERER_NULL: renderer_init_null(renderer, gs, window); break;
         case RENDERER_SOFTWARE: renderer_init_software(renderer, gs, window); break;
         case RENDERER_SOFTWARE_THREAD: renderer_init_software_thread(renderer, gs, window); break;
+        case RENDERER_SOFTWARE_MT: renderer_init_software_mt(renderer, gs, window); break;
         default: {
             printf("renderer: Unknown backend %d\n", id);
         } break;
@@ -128,6 +142,9 @@ void renderer_set_integer_scaling(renderer_state* renderer, bool integer_scaling
 void renderer_set_bilinear(renderer_state* renderer, bool bilinear) {
     renderer->set_bilinear(renderer->udata, bilinear);
 }
+void renderer_set_deinterlace_mode(renderer_state* renderer, int mode) {
+    renderer->set_deinterlace_mode(renderer->udata, mode);
+}
 void renderer_get_viewport_size(renderer_state* renderer, int* w, int* h) {
     renderer->get_viewport_size(renderer->udata, w, h);
 }
@@ -165,6 +182,7 @@ void renderer_destroy(renderer_state* renderer) {
     renderer->set_aspect_mode = nullptr;
     renderer->set_integer_scaling = nullptr;
     renderer->set_bilinear = nullptr;
+    renderer->set_deinterlace_mode = nullptr;
     renderer->get_viewport_size = nullptr;
     renderer->get_display_size = nullptr;
     renderer->get_display_format = nullptr;
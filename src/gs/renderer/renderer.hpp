@@ -21,10 +21,18 @@ enum : int {
     RENDERER_ASPECT_AUTO
 };
 
+enum : int {
+    // Each field goes to its own lines, the others keep the last field
+    RENDERER_DEINTERLACE_WEAVE,
+    // Each field line is doubled
+    RENDERER_DEINTERLACE_BOB
+};
+
 enum : int {
     RENDERER_NULL = 0,
     RENDERER_SOFTWARE,
-    RENDERER_SOFTWARE_THREAD
+    RENDERER_SOFTWARE_THREAD,
+    RENDERER_SOFTWARE_MT
 };
 
 struct renderer_state {
@@ -38,6 +46,7 @@ struct renderer_state {
     void (*set_aspect_mode)(void*, int) = nullptr;
     void (*set_integer_scaling)(void*, bool) = nullptr;
     void (*set_bilinear)(void*, bool) = nullptr;
+    void (*set_deinterlace_mode)(void*, int) = nullptr;
     void (*get_viewport_size)(void*, int*, int*) = nullptr;
     void (*get_display_size)(void*, int*, int*) = nullptr;
     void (*get_display_format)(void*, int*) = nullptr;
@@ -51,12 +60,14 @@ renderer_state* renderer_create(void);
 void renderer_init_null(renderer_state* renderer, struct ps2_gs* gs, SDL_Window* window);
 void renderer_init_software(renderer_state* renderer, struct ps2_gs* gs, SDL_Window* window);
 void renderer_init_software_thread(renderer_state* renderer, struct ps2_gs* gs, SDL_Window* window);
+void renderer_init_software_mt(renderer_state* renderer, struct ps2_gs* gs, SDL_Window* window);
 void renderer_init_backend(renderer_state* renderer, struct ps2_gs* gs, SDL_Window* window, int id);
 void renderer_set_size(renderer_state* renderer, int w, int h);
 void renderer_set_scale(renderer_state* renderer, float scale);
 void renderer_set_aspect_mode(renderer_state* renderer, int mode);
 void renderer_set_integer_scaling(renderer_state* renderer, bool integer_scaling);
 void renderer_set_bilinear(renderer_state* renderer, bool bilinear);
+void renderer_set_deinterlace_mode(renderer_state* renderer, int mode);
 void renderer_get_viewport_size(renderer_state* renderer, int* w, int* h);
 void renderer_get_display_size(renderer_state* renderer, int* w, int* h);
 void renderer_get_display_format(renderer_state* renderer, int* fmt);
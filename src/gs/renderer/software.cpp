@@ -5,263 +5,12 @@
 
 #include "gs/gs.h"
 #include "software.hpp"
+#include "swizzle.hpp"
 
 #include <SDL.h>
 
 #include "GL/gl3w.h"
 
-int software_psmct32_block[] = {
-    0 , 1 , 4 , 5 , 16, 17, 20, 21,
-    2 , 3 , 6 , 7 , 18, 19, 22, 23,
-    8 , 9 , 12, 13, 24, 25, 28, 29,
-    10, 11, 14, 15, 26, 27, 30, 31
-};
-
-int software_psmct32_column[] = {
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15
-};
-
-static inline int psmct32_addr(int base, int width, int x, int y) {
-    // base expressed in blocks
-    // 1 page = 64x32 = 8 KiB = 2048 words
-    // 1 block = 8x8 = 256 B = 64 words
-    // 1 column = 8x2 = 64 B = 16 words
-
-    int page = (x >> 6) + ((y >> 5) * width);
-    int blkx = (x >> 3) & 7;
-    int blky = (y >> 3) & 3;
-    int blk = blkx + (blky * 8);
-    int col = (y >> 1) & 3;
-    int idx = (x & 7) + ((y & 1) * 8);
-
-    // Unswizzle block
-    blk = software_psmct32_block[blk];
-
-    // Unswizzle column
-    idx = software_psmct32_column[idx];
-
-    // printf("(%x, %d, %d, %d) -> p=%d b=%d c=%d addr=%08x\n",
-    //     base, width, x, y,
-    //     page, blk, cl,
-    //     (page * 2048) + (base * 64) + (blk * 64) + cl
-    // );
-
-    return (page * 2048) + ((base + blk) * 64) + (col * 16) + idx;
-}
-
-int software_psmct16_block[] = {
-    0 , 2 , 8 , 10,
-    1 , 3 , 9 , 11,
-    4 , 6 , 12, 14,
-    5 , 7 , 13, 15,
-    16, 18, 24, 26,
-    17, 19, 25, 27,
-    20, 22, 28, 30,
-    21, 23, 29, 31
-};
-
-int software_psmct16_column[] = {
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15
-};
-
-int software_psmct16_shift[] = {
-    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
-    1 , 1 , 1 , 1 , 1 , 1 , 1 , 1 ,
-    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
-    1 , 1 , 1 , 1 , 1 , 1 , 1 , 1 
-};
-
-static inline int psmct16_addr(int base, int width, int x, int y) {
-    // page            block          column
-    // 64 x 64 pixels  16 x 8 pixels  16 x 2 pixels
-    // base expressed in blocks
-    // 1 page = 64x32 = 8 KiB = 2048 words
-    // 1 block = 8x8 = 256 B = 64 words
-    // 1 column = 8x2 = 64 B = 16 words
-
-    int page = (x >> 6) + ((y >> 6) * (width >> 1));
-    int blkx = (x >> 4) & 3;
-    int blky = (y >> 3) & 7;
-    int blk = blkx + (blky * 4);
-    int col = (y >> 1) & 3;
-    int idx = (x & 15) + ((y & 1) * 16);
-
-    // Unswizzle block
-    blk = software_psmct16_block[blk];
-
-    // Unswizzle column
-    idx = software_psmct16_column[idx];
-
-    // printf("(%x, %d, %d, %d) -> p=%d b=%d c=%d addr=%08x\n",
-    //     base, width, x, y,
-    //     page, blk, cl,
-    //     (page * 2048) + (base * 64) + (blk * 64) + cl
-    // );
-
-    return (page * 2048) + ((base + blk) * 64) + (col * 16) + idx;
-}
-
-int software_psmt8_column_02[] = {
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7
-};
-
-int software_psmt8_column_13[] = {
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15
-};
-
-int software_psmt8_shift[] = {
-    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
-    2 , 2 , 2 , 2 , 2 , 2 , 2 , 2 ,
-    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
-    2 , 2 , 2 , 2 , 2 , 2 , 2 , 2 ,
-    1 , 1 , 1 , 1 , 1 , 1 , 1 , 1 ,
-    3 , 3 , 3 , 3 , 3 , 3 , 3 , 3 ,
-    1 , 1 , 1 , 1 , 1 , 1 , 1 , 1 ,
-    3 , 3 , 3 , 3 , 3 , 3 , 3 , 3
-};
-
-static inline int psmt8_addr(int base, int width, int x, int y) {
-    // page            block          column
-    // 128 x 64 pixels 16 x 16 pixels 16 x 4 pixels
-    // base expressed in blocks
-    // 1 page = 128x64 = 8 KiB = 2048 words
-    // 1 block = 16x16 = 256 B = 64 words
-    // 1 column = 16x4 = 64 B = 16 words
-    // 1 page = 128/4x64 = 32x64 words
-    // 1 block = 16/4x16 = 4x16 words
-    // 1 column = 16/4x4 = 4x4 words
-
-    int page = (x >> 7) + ((y >> 6) * (width >> 1));
-    int blkx = (x >> 4) & 7;
-    int blky = (y >> 4) & 3;
-    int blk = blkx + (blky * 8);
-    int col = (y >> 2) & 3;
-    int idx = (x & 15) + ((y & 3) * 16);
-    // int shift = (x & 3) * 16;
-
-    // Unswizzle block
-    blk = software_psmct32_block[blk];
-
-    // Unswizzle column
-    idx = (col & 1) ? software_psmt8_column_13[idx] : software_psmt8_column_02[idx];
-
-    // printf("(%x, %d, %d, %d) -> p=%d b=%d c=%d addr=%08x\n",
-    //     base, width, x, y,
-    //     page, blk, cl,
-    //     (page * 2048) + (base * 64) + (blk * 64) + cl
-    // );
-
-    return (page * 2048) + ((base + blk) * 64) + (col * 16) + idx;
-}
-
-int software_psmt4_block[] = {
-    0 , 2 , 8 , 10, 1 , 3 , 9 , 11,
-    4 , 6 , 12, 14, 5 , 7 , 13, 15,
-    16, 18, 24, 26, 17, 19, 25, 27,
-    20, 22, 28, 30, 21, 23, 29, 31
-};
-
-int software_psmt4_column_02[] = {
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7
-};
-
-int software_psmt4_column_13[] = {
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15
-};
-
-int software_psmt4_shift[] = {
-    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
-    8 , 8 , 8 , 8 , 8 , 8 , 8 , 8 ,
-    16, 16, 16, 16, 16, 16, 16, 16,
-    24, 24, 24, 24, 24, 24, 24, 24,
-    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
-    8 , 8 , 8 , 8 , 8 , 8 , 8 , 8 ,
-    16, 16, 16, 16, 16, 16, 16, 16,
-    24, 24, 24, 24, 24, 24, 24, 24,
-    4 , 4 , 4 , 4 , 4 , 4 , 4 , 4 ,
-    12, 12, 12, 12, 12, 12, 12, 12,
-    20, 20, 20, 20, 20, 20, 20, 20,
-    28, 28, 28, 28, 28, 28, 28, 28,
-    4 , 4 , 4 , 4 , 4 , 4 , 4 , 4 ,
-    12, 12, 12, 12, 12, 12, 12, 12,
-    20, 20, 20, 20, 20, 20, 20, 20,
-    28, 28, 28, 28, 28, 28, 28, 28
-};
-
-static inline int psmt4_addr(int base, int width, int x, int y) {
-    // page             block          column
-    // 128 x 128 pixels 32 x 16 pixels 32 x 4 pixels
-    int page = (x >> 7) + ((y >> 7) * (width >> 1));
-    int blkx = (x >> 5) & 3;
-    int blky = (y >> 4) & 7;
-    int blk = blkx + (blky * 4);
-    int col = (y >> 2) & 3;
-    int idx = (x & 31) + ((y & 3) * 32);
-    // int shift = (x & 3) * 16;
-
-    // Unswizzle block
-    blk = software_psmt4_block[blk];
-
-    // Unswizzle column
-    idx = (col & 1) ? software_psmt4_column_13[idx] : software_psmt4_column_02[idx];
-
-    // printf("(%x, %d, %d, %d) -> p=%d b=%d c=%d addr=%08x\n",
-    //     base, width, x, y,
-    //     page, blk, cl,
-    //     (page * 2048) + (base * 64) + (blk * 64) + cl
-    // );
-
-    return (page * 2048) + ((base + blk) * 64) + (col * 16) + idx;
-}
-
 static const char* default_vert_shader =
     "#version 330 core\n"
     "layout (location = 0) in vec3 pos;\n"
@@ -439,6 +188,9 @@ void software_set_bilinear(void* udata, bool bilinear) {
     ctx->bilinear = bilinear;
 }
 
+// Fields are shown at half height, there's nothing to deinterlace
+void software_set_deinterlace_mode(void* udata, int mode) {}
+
 void software_get_viewport_size(void* udata, int* w, int* h) {
     software_state* ctx = (software_state*)udata;
 
@@ -596,7 +348,7 @@ static inline uint32_t gs_read_cb_csm2(struct ps2_gs* gs, int i) {
 
     int idx = (x & 15) + ((gs->cov & 1) * 16);
 
-    return gs->vram[software_psmct16_shift[idx]];
+    return gs->vram[psmct16_shift[idx]];
 }
 
 static inline uint32_t gs_read_cb(struct ps2_gs* gs, int i) {
@@ -630,7 +382,7 @@ static inline uint32_t gs_read_cb(struct ps2_gs* gs, int i) {
 
                     int idx = (x & 15) + ((y & 1) * 16);
 
-                    return gs->vram[software_psmct16_shift[idx]];
+                    return gs->vram[psmct16_shift[idx]];
                 } break;
             }
         } break;
@@ -654,7 +406,7 @@ static inline uint32_t gs_read_cb(struct ps2_gs* gs, int i) {
 
                     int idx = (x & 15) + ((y & 1) * 16);
 
-                    return gs->vram[software_psmct16_shift[idx]];
+                    return gs->vram[psmct16_shift[idx]];
                 } break;
             }
         } break;
@@ -758,7 +510,7 @@ static inline uint32_t gs_read_tb_impl(struct ps2_gs* gs, int u, int v) {
 
             int idx = (u & 15) + ((v & 1) * 16);
 
-            return gs->vram[software_psmct16_shift[idx]];
+            return gs->vram[psmct16_shift[idx]];
         } break;
         case GS_PSMT8: {
             uint32_t addr = psmt8_addr(gs->ctx->tbp0, gs->ctx->tbw, u, v);
@@ -766,7 +518,7 @@ static inline uint32_t gs_read_tb_impl(struct ps2_gs* gs, int u, int v) {
 
             int idx = (u & 15) + ((v & 3) * 16);
 
-            return gs_read_cb(gs, vram[software_psmt8_shift[idx]]);
+            return gs_read_cb(gs, vram[psmt8_shift[idx]]);
         } break;
         case GS_PSMT8H: {
             uint32_t data = gs->vram[psmct32_addr(gs->ctx->tbp0, gs->ctx->tbw, u, v)];
@@ -777,7 +529,7 @@ static inline uint32_t gs_read_tb_impl(struct ps2_gs* gs, int u, int v) {
             uint32_t addr = psmt4_addr(gs->ctx->tbp0, gs->ctx->tbw, u, v);
 
             int idx = (u & 31) + ((v & 3) * 32);
-            int shift = software_psmt4_shift[idx];
+            int shift = psmt4_shift[idx];
         
             uint32_t mask = 0xful << shift;
         
@@ -1967,7 +1719,7 @@ static inline void gs_write_psmt4(struct ps2_gs* gs, software_state* ctx, uint32
     uint32_t addr = psmt4_addr(ctx->dbp, ctx->dbw, ctx->dx, ctx->dy);
 
     int idx = (ctx->dx & 31) + ((ctx->dy & 3) * 32);
-    int shift = software_psmt4_shift[idx];
+    int shift = psmt4_shift[idx];
 
     uint32_t mask = 0xful << shift;
 
@@ -1987,7 +1739,7 @@ static inline void gs_write_psmt8(struct ps2_gs* gs, software_state* ctx, uint32
 
     int idx = (ctx->dx & 15) + ((ctx->dy & 3) * 16);
 
-    vram[software_psmt8_shift[idx]] = index;
+    vram[psmt8_shift[idx]] = index;
 
     ctx->dx++;
 
@@ -2108,7 +1860,7 @@ static inline void gs_write_psmct16(struct ps2_gs* gs, software_state* ctx, uint
 
     int idx = (ctx->dx & 15) + ((ctx->dy & 3) * 16);
 
-    vram[software_psmct16_shift[idx]] = index;
+    vram[psmct16_shift[idx]] = index;
 
     ctx->dx++;
 
@@ -2169,6 +1921,14 @@ extern "C" void software_transfer_write(struct ps2_gs* gs, void* udata) {
     }
 }
 
+extern "C" void software_transfer_image(struct ps2_gs* gs, const uint64_t* data, int count, void* udata) {
+    for (int i = 0; i < count; i++) {
+        gs->hwreg = data[i];
+
+        software_transfer_write(gs, udata);
+    }
+}
+
 extern "C" void software_transfer_read(struct ps2_gs* gs, void* udata) {
     gs->hwreg = 0;
 }
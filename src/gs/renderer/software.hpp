@@ -62,6 +62,7 @@ void software_set_scale(void* ctx, float scale);
 void software_set_aspect_mode(void* ctx, int aspect_mode);
 void software_set_integer_scaling(void* ctx, bool integer_scaling);
 void software_set_bilinear(void* ctx, bool bilinear);
+void software_set_deinterlace_mode(void* ctx, int mode);
 void software_get_viewport_size(void* ctx, int* w, int* h);
 void software_get_display_size(void* ctx, int* w, int* h);
 void software_get_display_format(void* ctx, int* fmt);
@@ -81,4 +82,5 @@ void software_render(struct ps2_gs* gs, void* udata);
 void software_transfer_start(struct ps2_gs* gs, void* udata);
 void software_transfer_write(struct ps2_gs* gs, void* udata);
 void software_transfer_read(struct ps2_gs* gs, void* udata);
+void software_transfer_image(struct ps2_gs* gs, const uint64_t* data, int count, void* udata);
 }
\ No newline at end of file
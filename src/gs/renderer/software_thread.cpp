@@ -2,307 +2,22 @@
 #include <cstring>
 #include <cstdio>
 #include <cmath>
+#include <algorithm>
+#include <array>
+#include <utility>
+
+#ifdef _GS_USE_INTRINSICS
+#include <smmintrin.h>
+#endif
 
 #include "gs/gs.h"
 #include "software_thread.hpp"
+#include "swizzle.hpp"
 
 #include <SDL.h>
 
 #include "GL/gl3w.h"
 
-int psmct32_block[] = {
-    0 , 1 , 4 , 5 , 16, 17, 20, 21,
-    2 , 3 , 6 , 7 , 18, 19, 22, 23,
-    8 , 9 , 12, 13, 24, 25, 28, 29,
-    10, 11, 14, 15, 26, 27, 30, 31
-};
-
-int psmct32_column[] = {
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15
-};
-
-static inline int psmct32_addr(int base, int width, int x, int y) {
-    // base expressed in blocks
-    // 1 page = 64x32 = 8 KiB = 2048 words
-    // 1 block = 8x8 = 256 B = 64 words
-    // 1 column = 8x2 = 64 B = 16 words
-
-    int page = (x >> 6) + ((y >> 5) * width);
-    int blkx = (x >> 3) & 7;
-    int blky = (y >> 3) & 3;
-    int blk = blkx + (blky * 8);
-    int col = (y >> 1) & 3;
-    int idx = (x & 7) + ((y & 1) * 8);
-
-    // Unswizzle block
-    blk = psmct32_block[blk];
-
-    // Unswizzle column
-    idx = psmct32_column[idx];
-
-    // printf("(%x, %d, %d, %d) -> p=%d b=%d c=%d addr=%08x\n",
-    //     base, width, x, y,
-    //     page, blk, cl,
-    //     (page * 2048) + (base * 64) + (blk * 64) + cl
-    // );
-
-    return (page * 2048) + ((base + blk) * 64) + (col * 16) + idx;
-}
-
-int psmct16_block[] = {
-    0 , 2 , 8 , 10,
-    1 , 3 , 9 , 11,
-    4 , 6 , 12, 14,
-    5 , 7 , 13, 15,
-    16, 18, 24, 26,
-    17, 19, 25, 27,
-    20, 22, 28, 30,
-    21, 23, 29, 31
-};
-
-int psmct16_column[] = {
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15
-};
-
-int psmct16_shift[] = {
-    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
-    1 , 1 , 1 , 1 , 1 , 1 , 1 , 1 ,
-    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
-    1 , 1 , 1 , 1 , 1 , 1 , 1 , 1 
-};
-
-static inline int psmct16_addr(int base, int width, int x, int y) {
-    // page            block          column
-    // 64 x 64 pixels  16 x 8 pixels  16 x 2 pixels
-    // base expressed in blocks
-    // 1 page = 64x32 = 8 KiB = 2048 words
-    // 1 block = 8x8 = 256 B = 64 words
-    // 1 column = 8x2 = 64 B = 16 words
-
-    int page = (x >> 6) + ((y >> 6) * width);
-    int blkx = (x >> 4) & 3;
-    int blky = (y >> 3) & 7;
-    int blk = blkx + (blky * 4);
-    int col = (y >> 1) & 3;
-    int idx = (x & 15) + ((y & 1) * 16);
-
-    // Unswizzle block
-    blk = psmct16_block[blk];
-
-    // Unswizzle column
-    idx = psmct16_column[idx];
-
-    // printf("(%x, %d, %d, %d) -> p=%d b=%d c=%d addr=%08x\n",
-    //     base, width, x, y,
-    //     page, blk, cl,
-    //     (page * 2048) + (base * 64) + (blk * 64) + cl
-    // );
-
-    return (page * 2048) + ((base + blk) * 64) + (col * 16) + idx;
-}
-
-int psmct16s_block[] = {
-    0 , 2 , 16, 18,
-    1 , 3 , 17, 19,
-    8 , 10, 24, 26,
-    9 , 11, 25, 27,
-    4 , 6 , 20, 22,
-    5 , 7 , 21, 23,
-    12, 14, 28, 30,
-    13, 15, 29, 31
-};
-
-static inline int psmct16s_addr(int base, int width, int x, int y) {
-    // page            block          column
-    // 64 x 64 pixels  16 x 8 pixels  16 x 2 pixels
-    // base expressed in blocks
-    // 1 page = 64x32 = 8 KiB = 2048 words
-    // 1 block = 8x8 = 256 B = 64 words
-    // 1 column = 8x2 = 64 B = 16 words
-
-    int page = (x >> 6) + ((y >> 6) * width);
-    int blkx = (x >> 4) & 3;
-    int blky = (y >> 3) & 7;
-    int blk = blkx + (blky * 4);
-    int col = (y >> 1) & 3;
-    int idx = (x & 15) + ((y & 1) * 16);
-
-    // Unswizzle block
-    blk = psmct16s_block[blk];
-
-    // Unswizzle column
-    idx = psmct16_column[idx];
-
-    // printf("(%x, %d, %d, %d) -> p=%d b=%d c=%d addr=%08x\n",
-    //     base, width, x, y,
-    //     page, blk, cl,
-    //     (page * 2048) + (base * 64) + (blk * 64) + cl
-    // );
-
-    return (page * 2048) + ((base + blk) * 64) + (col * 16) + idx;
-}
-
-int psmt8_column_02[] = {
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7
-};
-
-int psmt8_column_13[] = {
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15
-};
-
-int psmt8_shift[] = {
-    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
-    2 , 2 , 2 , 2 , 2 , 2 , 2 , 2 ,
-    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
-    2 , 2 , 2 , 2 , 2 , 2 , 2 , 2 ,
-    1 , 1 , 1 , 1 , 1 , 1 , 1 , 1 ,
-    3 , 3 , 3 , 3 , 3 , 3 , 3 , 3 ,
-    1 , 1 , 1 , 1 , 1 , 1 , 1 , 1 ,
-    3 , 3 , 3 , 3 , 3 , 3 , 3 , 3
-};
-
-static inline int psmt8_addr(int base, int width, int x, int y) {
-    // page            block          column
-    // 128 x 64 pixels 16 x 16 pixels 16 x 4 pixels
-    // base expressed in blocks
-    // 1 page = 128x64 = 8 KiB = 2048 words
-    // 1 block = 16x16 = 256 B = 64 words
-    // 1 column = 16x4 = 64 B = 16 words
-    // 1 page = 128/4x64 = 32x64 words
-    // 1 block = 16/4x16 = 4x16 words
-    // 1 column = 16/4x4 = 4x4 words
-
-    int page = (x >> 7) + ((y >> 6) * (width >> 1));
-    int blkx = (x >> 4) & 7;
-    int blky = (y >> 4) & 3;
-    int blk = blkx + (blky * 8);
-    int col = (y >> 2) & 3;
-    int idx = (x & 15) + ((y & 3) * 16);
-    // int shift = (x & 3) * 16;
-
-    // Unswizzle block
-    blk = psmct32_block[blk];
-
-    // Unswizzle column
-    idx = (col & 1) ? psmt8_column_13[idx] : psmt8_column_02[idx];
-
-    // printf("(%x, %d, %d, %d) -> p=%d b=%d c=%d addr=%08x\n",
-    //     base, width, x, y,
-    //     page, blk, cl,
-    //     (page * 2048) + (base * 64) + (blk * 64) + cl
-    // );
-
-    return (page * 2048) + ((base + blk) * 64) + (col * 16) + idx;
-}
-
-int psmt4_block[] = {
-    0 , 2 , 8 , 10, 1 , 3 , 9 , 11,
-    4 , 6 , 12, 14, 5 , 7 , 13, 15,
-    16, 18, 24, 26, 17, 19, 25, 27,
-    20, 22, 28, 30, 21, 23, 29, 31
-};
-
-int psmt4_column_02[] = {
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7
-};
-
-int psmt4_column_13[] = {
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15,
-    2 , 3 , 6 , 7 , 10, 11, 14, 15
-};
-
-int psmt4_shift[] = {
-    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
-    8 , 8 , 8 , 8 , 8 , 8 , 8 , 8 ,
-    16, 16, 16, 16, 16, 16, 16, 16,
-    24, 24, 24, 24, 24, 24, 24, 24,
-    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
-    8 , 8 , 8 , 8 , 8 , 8 , 8 , 8 ,
-    16, 16, 16, 16, 16, 16, 16, 16,
-    24, 24, 24, 24, 24, 24, 24, 24,
-    4 , 4 , 4 , 4 , 4 , 4 , 4 , 4 ,
-    12, 12, 12, 12, 12, 12, 12, 12,
-    20, 20, 20, 20, 20, 20, 20, 20,
-    28, 28, 28, 28, 28, 28, 28, 28,
-    4 , 4 , 4 , 4 , 4 , 4 , 4 , 4 ,
-    12, 12, 12, 12, 12, 12, 12, 12,
-    20, 20, 20, 20, 20, 20, 20, 20,
-    28, 28, 28, 28, 28, 28, 28, 28
-};
-
-static inline int psmt4_addr(int base, int width, int x, int y) {
-    // page             block          column
-    // 128 x 128 pixels 32 x 16 pixels 32 x 4 pixels
-    int page = (x >> 7) + ((y >> 7) * (width >> 1));
-    int blkx = (x >> 5) & 3;
-    int blky = (y >> 4) & 7;
-    int blk = blkx + (blky * 4);
-    int col = (y >> 2) & 3;
-    int idx = (x & 31) + ((y & 3) * 32);
-    // int shift = (x & 3) * 16;
-
-    // Unswizzle block
-    blk = psmt4_block[blk];
-
-    // Unswizzle column
-    idx = (col & 1) ? psmt4_column_13[idx] : psmt4_column_02[idx];
-
-    // printf("(%x, %d, %d, %d) -> p=%d b=%d c=%d addr=%08x\n",
-    //     base, width, x, y,
-    //     page, blk, cl,
-    //     (page * 2048) + (base * 64) + (blk * 64) + cl
-    // );
-
-    return (page * 2048) + ((base + blk) * 64) + (col * 16) + idx;
-}
-
 static const char* default_vert_shader =
     "#version 330 core\n"
     "layout (location = 0) in vec3 pos;\n"
@@ -381,56 +96,515 @@ void render_sprite(struct ps2_gs* gs, void* udata);
 void transfer_start(struct ps2_gs* gs, void* udata);
 void transfer_write(struct ps2_gs* gs, void* udata);
 void transfer_read(struct ps2_gs* gs, void* udata);
+void transfer_image(struct ps2_gs* gs, const uint64_t* data, int count, void* udata);
+void software_thread_readout(software_thread_state* ctx);
+
+static inline void software_thread_load_block(struct ps2_gs* gs, int type, render_block* b) {
+    switch (type) {
+        case GS_BLOCK_TEX: {
+            gs->texa = b->tex.texa;
+            gs->texclut = b->tex.texclut;
+            gs->cbw = b->tex.cbw;
+            gs->cou = b->tex.cou;
+            gs->cov = b->tex.cov;
+            gs->aem = b->tex.aem;
+            gs->ta0 = b->tex.ta0;
+            gs->ta1 = b->tex.ta1;
+        } break;
+
+        case GS_BLOCK_MISC: {
+            gs->scanmsk = b->misc.scanmsk;
+            gs->fogcol = b->misc.fogcol;
+            gs->dimx = b->misc.dimx;
+            gs->dthe = b->misc.dthe;
+            gs->colclamp = b->misc.colclamp;
+            gs->pabe = b->misc.pabe;
+
+            memcpy(gs->dither, b->misc.dither, sizeof(gs->dither));
+        } break;
+
+        case GS_BLOCK_CLUT: {
+            memcpy(gs->clut_cache, b->clut.clut_cache, sizeof(gs->clut_cache));
+
+            gs->cbp0 = b->clut.cbp0;
+            gs->cbp1 = b->clut.cbp1;
+        } break;
+
+        // Contexts are drawn with straight from the block
+        default: break;
+    }
+}
+
+// Sleeps on the EE thread until ready returns true
+template <typename F> static inline void software_thread_wait_render(software_thread_state* ctx, F ready) {
+    if (ready())
+        return;
+
+    std::unique_lock <std::mutex> lock(ctx->wait_mtx);
+
+    ctx->producer_waiting = true;
+    ctx->done_cv.wait(lock, ready);
+    ctx->producer_waiting = false;
+}
+
+static inline void software_thread_notify_producer(software_thread_state* ctx) {
+    if (!ctx->producer_waiting)
+        return;
+
+    std::lock_guard <std::mutex> lock(ctx->wait_mtx);
+
+    ctx->done_cv.notify_one();
+}
+
+static inline void software_thread_notify_render(software_thread_state* ctx) {
+    if (!ctx->render_waiting)
+        return;
+
+    std::lock_guard <std::mutex> lock(ctx->wait_mtx);
+
+    ctx->work_cv.notify_one();
+}
+
+// Returns a sync point covering every command queued so far
+uint32_t software_thread_fence(software_thread_state* ctx) {
+    return ctx->cmd_tail.load(std::memory_order_relaxed);
+}
+
+// Blocks until every command before the sync point is done drawing
+void software_thread_wait_fence(software_thread_state* ctx, uint32_t fence) {
+    software_thread_wait_render(ctx, [ctx, fence]() {
+        return (int32_t)(ctx->cmd_head.load() - fence) >= 0;
+    });
+}
+
+// Calls f on every VRAM page a rectangle of a swizzled buffer can
+// touch. bp is in blocks, bw in units of 64 pixels. A buffer that
+// doesn't start on a page boundary spills into the next page
+template <typename F> static inline void software_thread_for_each_page(uint32_t bp, uint32_t bw, uint32_t psm, int x0, int y0, int x1, int y1, F f) {
+    int pw = 6, ph = 5;
+    uint32_t stride = bw;
+
+    switch (psm) {
+        case GS_PSMCT16:
+        case GS_PSMCT16S: ph = 6; break;
+        case GS_PSMT8: pw = 7; ph = 6; stride = bw >> 1; break;
+        case GS_PSMT4: pw = 7; ph = 7; stride = bw >> 1; break;
+    }
+
+    uint32_t base = bp >> 5;
+    uint32_t spill = (bp & 31) ? 1 : 0;
+
+    for (int py = y0 >> ph; py <= (y1 >> ph); py++) {
+        for (int px = x0 >> pw; px <= (x1 >> pw); px++) {
+            uint32_t page = base + px + (py * stride);
+
+            for (uint32_t i = 0; i <= spill; i++)
+                f((page + i) & (SOFTWARE_THREAD_VRAM_PAGES - 1));
+        }
+    }
+}
+
+// Same for a linear range of words
+template <typename F> static inline void software_thread_for_each_page_linear(uint32_t w0, uint32_t w1, F f) {
+    for (uint32_t page = w0 >> 11; page <= (w1 >> 11); page++)
+        f(page & (SOFTWARE_THREAD_VRAM_PAGES - 1));
+}
+
+static inline void software_thread_mark_page(software_thread_state* ctx, uint32_t page) {
+    if (ctx->texture_page[page].load(std::memory_order_relaxed))
+        ctx->page_version[page].fetch_add(1, std::memory_order_relaxed);
+}
+
+// Screen space bounds of a primitive, clipped to the scissor. Returns
+// false if nothing can be drawn
+static inline bool software_thread_bounds(const struct gs_vertex* vq, const struct gs_context* c, int prim, int* x0, int* y0, int* x1, int* y1) {
+    int count = (prim == 2) ? 3 : ((prim == 0) ? 1 : 2);
+
+    *x0 = INT32_MAX;
+    *y0 = INT32_MAX;
+    *x1 = INT32_MIN;
+    *y1 = INT32_MIN;
+
+    // Triangles are shifted by one pixel while drawing
+    for (int i = 0; i < count; i++) {
+        int x = (int)vq[i].x - (int)c->ofx;
+        int y = (int)vq[i].y - (int)c->ofy;
+
+        *x0 = std::min(*x0, x - 1);
+        *y0 = std::min(*y0, y - 1);
+        *x1 = std::max(*x1, x);
+        *y1 = std::max(*y1, y);
+    }
+
+    *x0 = std::max(*x0, (int)c->scax0);
+    *y0 = std::max(*y0, (int)c->scay0);
+    *x1 = std::min(*x1, (int)c->scax1);
+    *y1 = std::min(*y1, (int)c->scay1);
+
+    return (*x0 <= *x1) && (*y0 <= *y1);
+}
+
+// Invalidates textures read from the buffers a primitive draws to
+// and records them as the cache's target
+static inline void software_thread_mark_draw(software_thread_state* ctx, render_texture_cache* cache, struct ps2_gs* gs, int prim) {
+    struct gs_context* c = gs->ctx;
+    int x0, y0, x1, y1;
+
+    memset(cache->target, 0, sizeof(cache->target));
+
+    if (!software_thread_bounds(gs->vq, c, prim, &x0, &y0, &x1, &y1))
+        return;
+
+    auto mark = [ctx, cache](uint32_t page) {
+        cache->target[page >> 6] |= 1ull << (page & 63);
+
+        software_thread_mark_page(ctx, page);
+    };
+
+    software_thread_for_each_page(c->fbp >> 6, c->fbw >> 6, c->fbpsm, x0, y0, x1, y1, mark);
+
+    // The Z buffer is stored linearly
+    if (c->zte && !c->zbmsk) {
+        int shift = ((c->zbpsm == GS_ZSMZ16) || (c->zbpsm == GS_ZSMZ16S)) ? 1 : 0;
+
+        software_thread_for_each_page_linear(
+            c->zbp + ((x0 + (y0 * c->fbw)) >> shift),
+            c->zbp + ((x1 + (y1 * c->fbw)) >> shift),
+            mark
+        );
+    }
+}
+
+// Loads a command into a drawing state, except for the context
+static inline void software_thread_setup(struct ps2_gs* gs, uint64_t* ids, render_command& cmd) {
+    for (int i = 0; i < GS_BLOCK_COUNT; i++) {
+        render_block* b = cmd.blocks[i];
+
+        if (!b || (ids[i] == b->id))
+            continue;
+
+        software_thread_load_block(gs, i, b);
+
+        ids[i] = b->id;
+    }
+
+    gs->vq[0] = cmd.vq[0];
+    gs->vq[1] = cmd.vq[1];
+    gs->vq[2] = cmd.vq[2];
+    gs->attr = cmd.attr;
+    gs->iip = cmd.iip;
+    gs->tme = cmd.tme;
+    gs->fge = cmd.fge;
+    gs->abe = cmd.abe;
+    gs->aa1 = cmd.aa1;
+    gs->fst = cmd.fst;
+    gs->ctxt = cmd.ctxt;
+    gs->fix = cmd.fix;
+}
+
+static inline void software_thread_draw(software_thread_state* ctx, struct ps2_gs* gs, render_texture_cache* cache, int prim) {
+    software_thread_mark_draw(ctx, cache, gs, prim);
+
+    switch (prim) {
+        case 0: render_point(gs, cache); break;
+        case 1: render_line(gs, cache); break;
+        case 2: render_triangle(gs, cache); break;
+        case 3: render_sprite(gs, cache); break;
+    }
+}
+
+static inline void software_thread_draw_command(software_thread_state* ctx, render_command& cmd) {
+    struct ps2_gs* gs = &ctx->work;
+
+    software_thread_setup(gs, ctx->work_id, cmd);
+
+    gs->ctx = &cmd.blocks[GS_BLOCK_CONTEXT1 + cmd.ctxt]->context;
+
+    software_thread_draw(ctx, gs, &ctx->cache, cmd.prim);
+}
+
+// Hands blocks nobody references anymore back to the EE thread
+static inline void software_thread_release(software_thread_state* ctx, render_command& cmd) {
+    for (int i = 0; i < GS_BLOCK_COUNT; i++) {
+        render_block* b = cmd.blocks[i];
+
+        if (!b || (b->refs.fetch_sub(1, std::memory_order_acq_rel) != 1))
+            continue;
+
+        uint32_t tail = ctx->free_tail.load(std::memory_order_relaxed);
+
+        ctx->free_ring[tail & (SOFTWARE_THREAD_BLOCK_POOL_SIZE - 1)] = b;
+        ctx->free_tail.store(tail + 1);
+    }
+}
+
+static inline void software_mt_draw_tile(software_thread_state* ctx, render_worker* w, int tile) {
+    int tx = (tile % SOFTWARE_MT_TILES_X) << SOFTWARE_MT_TILE_SHIFT;
+    int ty = (tile / SOFTWARE_MT_TILES_X) << SOFTWARE_MT_TILE_SHIFT;
+
+    struct ps2_gs* gs = &w->gs;
+
+    for (uint32_t idx : ctx->bins[tile]) {
+        render_command& cmd = ctx->cmd_ring[idx & (SOFTWARE_THREAD_CMD_RING_SIZE - 1)];
+        render_block* b = cmd.blocks[GS_BLOCK_CONTEXT1 + cmd.ctxt];
+
+        software_thread_setup(gs, w->work_id, cmd);
+
+        // Clip the scissor to the tile so no other worker touches
+        // the same pixels
+        if ((w->context_id != b->id) || (w->tile != tile)) {
+            w->context = b->context;
+            w->context.scax0 = std::max((int)w->context.scax0, tx);
+            w->context.scay0 = std::max((int)w->context.scay0, ty);
+            w->context.scax1 = std::min((int)w->context.scax1, tx + (1 << SOFTWARE_MT_TILE_SHIFT) - 1);
+            w->context.scay1 = std::min((int)w->context.scay1, ty + (1 << SOFTWARE_MT_TILE_SHIFT) - 1);
+            w->context_id = b->id;
+            w->tile = tile;
+        }
+
+        gs->ctx = &w->context;
+
+        software_thread_draw(ctx, gs, &w->cache, cmd.prim);
+    }
+}
+
+static inline void software_mt_draw_tiles(software_thread_state* ctx, render_worker* w) {
+    int count = ctx->bin_list.size();
+    int i;
+
+    while ((i = ctx->next_bin.fetch_add(1)) < count)
+        software_mt_draw_tile(ctx, w, ctx->bin_list[i]);
+}
+
+void software_mt_worker_thread(software_thread_state* ctx, render_worker* w) {
+    uint64_t gen = 0;
+
+    while (true) {
+        {
+            std::unique_lock <std::mutex> lock(ctx->batch_mtx);
+
+            ctx->batch_cv.wait(lock, [ctx, gen]() {
+                return ctx->batch_quit || (ctx->batch_gen != gen);
+            });
+
+            if (ctx->batch_quit)
+                return;
+
+            gen = ctx->batch_gen;
+        }
+
+        software_mt_draw_tiles(ctx, w);
+
+        std::lock_guard <std::mutex> lock(ctx->batch_mtx);
+
+        if (!--ctx->batch_busy)
+            ctx->batch_done_cv.notify_one();
+    }
+}
+
+static inline bool software_mt_overlaps(uint32_t a0, uint32_t a1, uint32_t b0, uint32_t b1) {
+    return (a0 < b1) && (b0 < a1);
+}
+
+#define SOFTWARE_MT_BIN_OK 0
+#define SOFTWARE_MT_BIN_FLUSH 1
+#define SOFTWARE_MT_BIN_SERIAL 2
+
+// Adds a command to the bins of every tile it might touch. Commands
+// drawing to other buffers need a new batch, commands that could read
+// back what the batch draws or wrap around the buffer width are drawn
+// on their own
+static inline int software_mt_bin(software_thread_state* ctx, render_command& cmd, uint32_t idx, bool first) {
+    struct gs_context* c = &cmd.blocks[GS_BLOCK_CONTEXT1 + cmd.ctxt]->context;
+
+    if (first) {
+        ctx->batch_fbp = c->fbp;
+        ctx->batch_fbw = c->fbw;
+        ctx->batch_fbpsm = c->fbpsm;
+        ctx->batch_zbp = c->zbp;
+        ctx->batch_zbpsm = c->zbpsm;
+    } else if ((c->fbp != ctx->batch_fbp) || (c->fbw != ctx->batch_fbw) ||
+               (c->fbpsm != ctx->batch_fbpsm) || (c->zbp != ctx->batch_zbp) ||
+               (c->zbpsm != ctx->batch_zbpsm)) {
+        return SOFTWARE_MT_BIN_FLUSH;
+    }
+
+    int x0, y0, x1, y1;
+
+    if (!software_thread_bounds(cmd.vq, c, cmd.prim, &x0, &y0, &x1, &y1))
+        return SOFTWARE_MT_BIN_OK;
+
+    if (x1 >= (int)c->fbw)
+        return SOFTWARE_MT_BIN_SERIAL;
+
+    if (cmd.tme) {
+        // Conservative ranges in words, assuming 32-bit pixels
+        uint32_t height = (c->scay1 + 32) & ~31;
+        uint32_t fb0 = c->fbp, fb1 = c->fbp + (c->fbw * height);
+        uint32_t zb0 = c->zbp, zb1 = c->zbp + (c->fbw * height);
+        uint32_t tb0 = c->tbp0 << 6;
+        uint32_t tb1 = tb0 + (std::max(c->tbw, 1u) << 6) * ((c->vsize + 31) & ~31);
+        uint32_t cb0 = c->cbp << 6, cb1 = cb0 + 2048;
+
+        if (software_mt_overlaps(tb0, tb1, fb0, fb1) || software_mt_overlaps(tb0, tb1, zb0, zb1) ||
+            software_mt_overlaps(cb0, cb1, fb0, fb1) || software_mt_overlaps(cb0, cb1, zb0, zb1))
+            return SOFTWARE_MT_BIN_SERIAL;
+    }
+
+    x0 >>= SOFTWARE_MT_TILE_SHIFT;
+    y0 >>= SOFTWARE_MT_TILE_SHIFT;
+    x1 >>= SOFTWARE_MT_TILE_SHIFT;
+    y1 >>= SOFTWARE_MT_TILE_SHIFT;
+
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            int tile = x + (y * SOFTWARE_MT_TILES_X);
+
+            if (ctx->bins[tile].empty())
+                ctx->bin_list.push_back(tile);
+
+            ctx->bins[tile].push_back(idx);
+        }
+    }
+
+    return SOFTWARE_MT_BIN_OK;
+}
+
+// Draws commands from head up to tail at most, returns the new head
+static inline uint32_t software_mt_draw_batch(software_thread_state* ctx, uint32_t head, uint32_t tail) {
+    uint32_t end = head;
+
+    while ((end != tail) && ((end - head) < SOFTWARE_MT_BATCH_SIZE)) {
+        render_command& cmd = ctx->cmd_ring[end & (SOFTWARE_THREAD_CMD_RING_SIZE - 1)];
+
+        // Has to see everything drawn before it
+        if (cmd.prim == SOFTWARE_THREAD_CMD_READOUT) {
+            if (end == head) {
+                software_thread_readout(ctx);
+
+                ++end;
+            }
+
+            break;
+        }
+
+        int r = software_mt_bin(ctx, cmd, end, end == head);
+
+        if (r == SOFTWARE_MT_BIN_FLUSH)
+            break;
+
+        if (r == SOFTWARE_MT_BIN_SERIAL) {
+            if (end == head) {
+                software_thread_draw_command(ctx, cmd);
+
+                ++end;
+            }
+
+            break;
+        }
+
+        ++end;
+    }
+
+    if (!ctx->bin_list.empty()) {
+        ctx->next_bin = 0;
+
+        {
+            std::lock_guard <std::mutex> lock(ctx->batch_mtx);
+
+            ctx->batch_busy = ctx->workers.size() - 1;
+            ctx->batch_gen++;
+            ctx->batch_cv.notify_all();
+        }
+
+        software_mt_draw_tiles(ctx, ctx->workers[0]);
+
+        std::unique_lock <std::mutex> lock(ctx->batch_mtx);
+
+        ctx->batch_done_cv.wait(lock, [ctx]() {
+            return !ctx->batch_busy;
+        });
+
+        for (int tile : ctx->bin_list)
+            ctx->bins[tile].clear();
+
+        ctx->bin_list.clear();
+    }
+
+    for (uint32_t i = head; i != end; i++)
+        software_thread_release(ctx, ctx->cmd_ring[i & (SOFTWARE_THREAD_CMD_RING_SIZE - 1)]);
+
+    return end;
+}
 
 void software_thread_render_thread(software_thread_state* ctx) {
     while (!ctx->end_signal) {
-        while (true) {
-            ctx->queue_mtx.lock();
+        uint32_t head = ctx->cmd_head.load(std::memory_order_relaxed);
+        uint32_t tail = ctx->cmd_tail.load();
 
-            if (ctx->render_queue.empty()) {
-                ctx->queue_mtx.unlock();
+        if (head == tail) {
+            std::unique_lock <std::mutex> lock(ctx->wait_mtx);
 
-                break;
-            }
+            ctx->render_waiting = true;
 
-            // Explicitly copy data from the queue
-            render_data rdata = render_data(ctx->render_queue.front());
+            ctx->work_cv.wait(lock, [ctx, head]() {
+                return ctx->end_signal || (head != ctx->cmd_tail.load());
+            });
 
-            // Assign context pointer to the copied context
-            rdata.gs.ctx = &rdata.gs.context[(rdata.gs.attr & GS_CTXT) ? 1 : 0];
+            ctx->render_waiting = false;
 
-            ctx->render_queue.pop();
-            ctx->queue_mtx.unlock();
+            continue;
+        }
 
-            ctx->render_mtx.lock();
+        if (ctx->mt) {
+            head = software_mt_draw_batch(ctx, head, tail);
+        } else {
+            render_command& cmd = ctx->cmd_ring[head & (SOFTWARE_THREAD_CMD_RING_SIZE - 1)];
 
-            switch (rdata.prim) {
-                case 0: render_point(&rdata.gs, nullptr); break;
-                case 1: render_line(&rdata.gs, nullptr); break;
-                case 2: render_triangle(&rdata.gs, nullptr); break;
-                case 3: render_sprite(&rdata.gs, nullptr); break;
+            if (cmd.prim == SOFTWARE_THREAD_CMD_READOUT) {
+                software_thread_readout(ctx);
+            } else {
+                software_thread_draw_command(ctx, cmd);
             }
 
-            ctx->render_mtx.unlock();
+            software_thread_release(ctx, cmd);
+
+            ++head;
         }
 
-        std::this_thread::yield();
+        ctx->cmd_head.store(head);
+
+        software_thread_notify_producer(ctx);
     }
 }
 
 void software_thread_destroy(void* udata) {
     software_thread_state* ctx = (software_thread_state*)udata;
 
-    // Send end signal to rendering thread
-    ctx->end_signal = true;
+    // Send end signal to rendering thread, pending commands are dropped
+    {
+        std::lock_guard <std::mutex> lock(ctx->wait_mtx);
+
+        ctx->end_signal = true;
+        ctx->work_cv.notify_one();
+    }
 
-    // Clear rendering queue
-    ctx->queue_mtx.lock();
+    if (ctx->render_thr.joinable())
+        ctx->render_thr.join();
 
-    while (!ctx->render_queue.empty())
-        ctx->render_queue.pop();
+    {
+        std::lock_guard <std::mutex> lock(ctx->batch_mtx);
 
-    ctx->queue_mtx.unlock();
+        ctx->batch_quit = true;
+        ctx->batch_cv.notify_all();
+    }
+
+    for (render_worker* w : ctx->workers) {
+        if (w->thr.joinable())
+            w->thr.join();
+
+        delete w;
+    }
 
     for (GLuint p : ctx->programs)
         if (p) glDeleteProgram(p);
@@ -447,10 +621,10 @@ void software_thread_destroy(void* udata) {
     if (ctx->fb_in_tex) glDeleteTextures(1, &ctx->fb_in_tex);
     if (ctx->fb_out_tex) glDeleteTextures(1, &ctx->fb_out_tex);
 
-    if (ctx->buf)
-        free(ctx->buf);
+    for (int i = 0; i < 2; i++)
+        if (ctx->bufs[i]) free(ctx->bufs[i]);
 
-    // Should call destructors for our mutex, thread and queue
+    // Should call destructors for our thread and atomics
     delete ctx;
 }
 
@@ -505,9 +679,16 @@ void software_thread_set_size(void* udata, int width, int height) {
     ctx->tex_w = tex_w;
     ctx->tex_h = tex_h;
 
-    if (ctx->buf) free(ctx->buf);
+    // The render thread could still be reading into the back buffer
+    software_thread_wait_fence(ctx, ctx->readout_fence);
 
-    ctx->buf = (uint32_t*)malloc((ctx->tex_w * sizeof(uint32_t)) * ctx->tex_h);
+    for (int i = 0; i < 2; i++) {
+        if (ctx->bufs[i]) free(ctx->bufs[i]);
+
+        ctx->bufs[i] = (uint32_t*)calloc(ctx->tex_w * ctx->tex_h, sizeof(uint32_t));
+    }
+
+    ctx->buf = ctx->bufs[ctx->back ^ 1];
 
     if (ctx->tex) {
         glDeleteTextures(1, &ctx->tex);
@@ -574,6 +755,12 @@ void software_thread_set_bilinear(void* udata, bool bilinear) {
     ctx->bilinear = bilinear;
 }
 
+void software_thread_set_deinterlace_mode(void* udata, int mode) {
+    software_thread_state* ctx = (software_thread_state*)udata;
+
+    ctx->deinterlace = mode;
+}
+
 void software_thread_get_viewport_size(void* udata, int* w, int* h) {
     software_thread_state* ctx = (software_thread_state*)udata;
 
@@ -636,7 +823,9 @@ void software_thread_get_interlace_mode(void* udata, int* interlace) {
 }
 
 const char* software_thread_get_name(void* udata) {
-    return "Software (Threaded)";
+    software_thread_state* ctx = (software_thread_state*)udata;
+
+    return ctx->mt ? "Software (Multithreaded)" : "Software (Threaded)";
 }
 
 #define CLAMP(v, l, u) (((v) > (u)) ? (u) : (((v) < (l)) ? (l) : (v)))
@@ -744,43 +933,6 @@ static inline uint32_t gs_read_fb(struct ps2_gs* gs, int x, int y) {
     return 0;
 }
 
-static inline uint32_t gs_read_dispfb(struct ps2_gs* gs, int x, int y, int dfb) {
-    uint32_t dfbp = dfb ? gs->dfbp2 : gs->dfbp1;
-    uint32_t dfbw = dfb ? gs->dfbw2 : gs->dfbw1;
-    uint32_t dfbpsm = dfb ? gs->dfbpsm2 : gs->dfbpsm1;
-
-    switch (dfbpsm) {
-        case GS_PSMCT32: {
-            uint32_t addr = psmct32_addr(dfbp, dfbw, x, y);
-
-            return gs->vram[addr & 0xfffff];
-        }
-        case GS_PSMCT24: {
-            uint32_t addr = psmct32_addr(dfbp, dfbw, x, y);
-
-            return gs->vram[addr & 0xfffff] & 0xffffff;
-        }
-        case GS_PSMCT16: {
-            uint32_t addr = psmct16_addr(dfbp, dfbw, x, y);
-            uint16_t* vram = (uint16_t*)(&gs->vram[addr & 0xfffff]);
-
-            int idx = (x & 15) + ((y & 1) * 16);
-
-            return vram[psmct16_shift[idx] & 0xfffff];
-        } break;
-        case GS_PSMCT16S: {
-            uint32_t addr = psmct16s_addr(dfbp, dfbw, x, y);
-            uint16_t* vram = (uint16_t*)(&gs->vram[addr & 0xfffff]);
-
-            int idx = (x & 15) + ((y & 1) * 16);
-
-            return vram[psmct16_shift[idx] & 0xfffff];
-        } break;
-    }
-
-    return 0;
-}
-
 static inline uint32_t gs_read_zb(struct ps2_gs* gs, int x, int y) {
     switch (gs->ctx->zbpsm) {
         case GS_ZSMZ32:
@@ -1039,7 +1191,189 @@ static inline uint32_t gs_read_tb_impl(struct ps2_gs* gs, int u, int v) {
     return 0;
 }
 
-static inline uint32_t gs_read_tb(struct ps2_gs* gs, int u, int v) {
+static inline void software_thread_init_cache(software_thread_state* ctx, render_texture_cache* cache) {
+    for (int i = 0; i < SOFTWARE_THREAD_TEXTURE_CACHE_SIZE; i++)
+        cache->entries[i].used = false;
+
+    cache->tick = 0;
+    cache->page_version = ctx->page_version;
+    cache->texture_page = ctx->texture_page;
+}
+
+static inline bool gs_texture_uses_clut(uint32_t psm) {
+    switch (psm) {
+        case GS_PSMT8:
+        case GS_PSMT8H:
+        case GS_PSMT4:
+        case GS_PSMT4HL:
+        case GS_PSMT4HH:
+            return true;
+    }
+
+    return false;
+}
+
+static inline void gs_texture_set_key(struct ps2_gs* gs, render_texture* t) {
+    t->tbp0 = gs->ctx->tbp0;
+    t->tbw = gs->ctx->tbw;
+    t->tbpsm = gs->ctx->tbpsm;
+    t->usize = gs->ctx->usize;
+    t->vsize = gs->ctx->vsize;
+    t->ta0 = gs->ta0;
+    t->ta1 = gs->ta1;
+    t->aem = gs->aem;
+
+    // The CLUT only matters for indexed formats
+    bool clut = gs_texture_uses_clut(t->tbpsm);
+
+    t->cbp = clut ? gs->ctx->cbp : 0;
+    t->cbpsm = clut ? gs->ctx->cbpsm : 0;
+    t->csm = clut ? gs->ctx->csm : 0;
+    t->cbw = clut ? gs->cbw : 0;
+    t->cou = clut ? gs->cou : 0;
+    t->cov = clut ? gs->cov : 0;
+}
+
+static inline bool gs_texture_match(const render_texture* a, const render_texture* b) {
+    return (a->tbp0 == b->tbp0) && (a->tbw == b->tbw) && (a->tbpsm == b->tbpsm) &&
+           (a->usize == b->usize) && (a->vsize == b->vsize) &&
+           (a->cbp == b->cbp) && (a->cbpsm == b->cbpsm) && (a->csm == b->csm) &&
+           (a->cbw == b->cbw) && (a->cou == b->cou) && (a->cov == b->cov) &&
+           (a->ta0 == b->ta0) && (a->ta1 == b->ta1) && (a->aem == b->aem);
+}
+
+// Pages holding the texels and the CLUT of a texture
+static inline void gs_texture_collect_pages(render_texture* t) {
+    auto add = [t](uint32_t page) {
+        t->pages.push_back(page);
+    };
+
+    t->pages.clear();
+
+    software_thread_for_each_page(t->tbp0, t->tbw, t->tbpsm, 0, 0, t->usize - 1, t->vsize - 1, add);
+
+    if (!gs_texture_uses_clut(t->tbpsm))
+        return;
+
+    if (t->csm == 1) {
+        software_thread_for_each_page(t->cbp, t->cbw, GS_PSMCT16, t->cou, t->cov, t->cou + 255, t->cov, add);
+    } else {
+        bool ct32 = t->cbpsm == GS_PSMCT32;
+
+        software_thread_for_each_page(t->cbp, ct32 ? 1 : 2, ct32 ? GS_PSMCT32 : GS_PSMCT16, 0, 0, 15, 15, add);
+    }
+}
+
+static inline bool gs_texture_valid(render_texture_cache* cache, render_texture* t) {
+    for (size_t i = 0; i < t->pages.size(); i++)
+        if (cache->page_version[t->pages[i]].load(std::memory_order_relaxed) != t->versions[i])
+            return false;
+
+    return true;
+}
+
+// Texels drawn to by the primitive sampling them can't be cached
+static inline bool gs_texture_targeted(render_texture_cache* cache, render_texture* t) {
+    for (uint16_t page : t->pages)
+        if (cache->target[page >> 6] & (1ull << (page & 63)))
+            return true;
+
+    return false;
+}
+
+// Drops every decoded block and snapshots the current page versions
+static inline void gs_texture_reset(render_texture_cache* cache, render_texture* t) {
+    std::fill(t->decoded.begin(), t->decoded.end(), 0);
+
+    t->versions.resize(t->pages.size());
+
+    for (size_t i = 0; i < t->pages.size(); i++)
+        t->versions[i] = cache->page_version[t->pages[i]].load(std::memory_order_relaxed);
+}
+
+// Looks up the texture the current state samples from, returns null
+// when there's no cache or texturing is off
+static inline render_texture* gs_get_texture(render_texture_cache* cache, struct ps2_gs* gs) {
+    if (!cache || !gs->tme)
+        return nullptr;
+
+    render_texture key;
+    render_texture* lru = &cache->entries[0];
+
+    gs_texture_set_key(gs, &key);
+
+    ++cache->tick;
+
+    for (int i = 0; i < SOFTWARE_THREAD_TEXTURE_CACHE_SIZE; i++) {
+        render_texture* t = &cache->entries[i];
+
+        if (!t->used) {
+            lru = t;
+
+            continue;
+        }
+
+        if (gs_texture_match(t, &key)) {
+            if (!gs_texture_valid(cache, t))
+                gs_texture_reset(cache, t);
+
+            t->last_use = cache->tick;
+
+            return gs_texture_targeted(cache, t) ? nullptr : t;
+        }
+
+        if (lru->used && (t->last_use < lru->last_use))
+            lru = t;
+    }
+
+    render_texture* t = lru;
+
+    gs_texture_set_key(gs, t);
+    gs_texture_collect_pages(t);
+
+    // Start tracking writes before anything gets decoded
+    for (uint16_t page : t->pages)
+        cache->texture_page[page].store(1, std::memory_order_relaxed);
+
+    t->used = true;
+    t->last_use = cache->tick;
+    t->bw = (t->usize + 7) >> 3;
+    t->data.resize(t->usize * t->vsize);
+    t->decoded.resize(t->bw * ((t->vsize + 7) >> 3));
+
+    gs_texture_reset(cache, t);
+
+    return gs_texture_targeted(cache, t) ? nullptr : t;
+}
+
+static inline void gs_texture_decode_block(struct ps2_gs* gs, render_texture* t, int bu, int bv) {
+    int u1 = std::min((bu + 1) << 3, (int)t->usize);
+    int v1 = std::min((bv + 1) << 3, (int)t->vsize);
+
+    for (int v = bv << 3; v < v1; v++) {
+        uint32_t* row = &t->data[v * t->usize];
+
+        for (int u = bu << 3; u < u1; u++)
+            row[u] = gs_to_rgba32(gs, gs_read_tb_impl(gs, u, v), gs->ctx->tbpsm);
+    }
+
+    t->decoded[bu + (bv * t->bw)] = 1;
+}
+
+// Reads a texel as RGBA8, texels outside of the texture's size aren't
+// cached
+static inline uint32_t gs_fetch_tb(struct ps2_gs* gs, render_texture* t, int u, int v) {
+    if (!t || ((uint32_t)u >= t->usize) || ((uint32_t)v >= t->vsize))
+        return gs_to_rgba32(gs, gs_read_tb_impl(gs, u, v), gs->ctx->tbpsm);
+
+    if (!t->decoded[(u >> 3) + ((v >> 3) * t->bw)])
+        gs_texture_decode_block(gs, t, u >> 3, v >> 3);
+
+    return t->data[u + (v * t->usize)];
+}
+
+// Samples the texture, returns RGBA8
+static inline uint32_t gs_read_tb(struct ps2_gs* gs, render_texture* tex, int u, int v) {
     if ((gs->ctx->xyoffset >> 32) & 0xf)
         v += 0x10;
 
@@ -1054,15 +1388,10 @@ static inline uint32_t gs_read_tb(struct ps2_gs* gs, int u, int v) {
         int iu1 = iu0 + 1;
         int iv1 = iv0 + 1;
 
-        uint32_t s0 = gs_read_tb_impl(gs, iu0, iv0);
-        uint32_t s1 = gs_read_tb_impl(gs, iu1, iv0);
-        uint32_t s2 = gs_read_tb_impl(gs, iu0, iv1);
-        uint32_t s3 = gs_read_tb_impl(gs, iu1, iv1);
-
-        s0 = gs_to_rgba32(gs, s0, gs->ctx->tbpsm);
-        s1 = gs_to_rgba32(gs, s1, gs->ctx->tbpsm);
-        s2 = gs_to_rgba32(gs, s2, gs->ctx->tbpsm);
-        s3 = gs_to_rgba32(gs, s3, gs->ctx->tbpsm);
+        uint32_t s0 = gs_fetch_tb(gs, tex, iu0, iv0);
+        uint32_t s1 = gs_fetch_tb(gs, tex, iu1, iv0);
+        uint32_t s2 = gs_fetch_tb(gs, tex, iu0, iv1);
+        uint32_t s3 = gs_fetch_tb(gs, tex, iu1, iv1);
 
         int r0 = s0 & 0xff;
         int g0 = (s0 >> 8) & 0xff;
@@ -1091,9 +1420,12 @@ static inline uint32_t gs_read_tb(struct ps2_gs* gs, int u, int v) {
         bb = CLAMP(bb, 0, 255);
         aa = CLAMP(aa, 0, 255);
 
-        return gs_from_rgba32(gs, rr | (gg << 8) | (bb << 16) | (aa << 24), gs->ctx->tbpsm);
+        // The filtered texel goes through the texture's format
+        uint32_t c = gs_from_rgba32(gs, rr | (gg << 8) | (bb << 16) | (aa << 24), gs->ctx->tbpsm);
+
+        return gs_to_rgba32(gs, c, gs->ctx->tbpsm);
     } else {
-        return gs_read_tb_impl(gs, u >> 4, v >> 4);
+        return gs_fetch_tb(gs, tex, u >> 4, v >> 4);
     }
 }
 
@@ -1140,22 +1472,26 @@ static inline void gs_write_fb_no_alpha(struct ps2_gs* gs, int x, int y, uint32_
 
     // To-do: Implement FBMSK
     switch (gs->ctx->fbpsm) {
-        case GS_PSMCT32: {
-            uint32_t p = gs->vram[(gs->ctx->fbp + x + (y * gs->ctx->fbw)) & 0xfffff];
+        case GS_PSMCT32:
+        case GS_PSMCT24: {
+            uint32_t addr = psmct32_addr(gs->ctx->fbp >> 6, gs->ctx->fbw >> 6, x, y);
+            uint32_t p = gs->vram[addr];
 
-            gs->vram[(gs->ctx->fbp + x + (y * gs->ctx->fbw)) & 0xfffff] = (f & 0xffffff) | (p & 0xff000000);
+            gs->vram[addr] = (f & 0xffffff) | (p & 0xff000000);
         } break;
+        case GS_PSMCT16: {
+            uint32_t addr = psmct16_addr(gs->ctx->fbp >> 6, gs->ctx->fbw >> 6, x, y);
+            uint16_t* vram = (uint16_t*)(&gs->vram[addr]);
+            uint16_t* ptr = &vram[psmct16_shift[(x & 15) + ((y & 1) * 16)]];
 
-        case GS_PSMCT24: {
-            uint32_t p = gs->vram[(gs->ctx->fbp + x + (y * gs->ctx->fbw)) & 0xfffff];
-
-            gs->vram[gs->ctx->fbp + x + (y * gs->ctx->fbw)] = (f & 0xffffff) | (p & 0xff000000);
+            *ptr = (f & 0x7fff) | (*ptr & 0x8000);
         } break;
-        case GS_PSMCT16:
         case GS_PSMCT16S: {
-            uint16_t* ptr = ((uint16_t*)&gs->vram[gs->ctx->fbp]) + x + (y * gs->ctx->fbw);
+            uint32_t addr = psmct16s_addr(gs->ctx->fbp >> 6, gs->ctx->fbw >> 6, x, y);
+            uint16_t* vram = (uint16_t*)(&gs->vram[addr]);
+            uint16_t* ptr = &vram[psmct16_shift[(x & 15) + ((y & 1) * 16)]];
 
-            *ptr = (c & 0x7fff) | (*ptr & 0x8000);
+            *ptr = (f & 0x7fff) | (*ptr & 0x8000);
         } break;
     }
 }
@@ -1266,6 +1602,72 @@ static inline int gs_test_pixel(struct ps2_gs* gs, int x, int y, uint32_t z, uin
     return tr;
 }
 
+#ifdef _GS_USE_INTRINSICS
+// Depth can only be tested ahead of drawing when the pixels drawn
+// can't change the Z values of the ones being tested
+static inline bool gs_can_test_depth4(struct ps2_gs* gs, int ymax) {
+    if (!gs->ctx->zte)
+        return false;
+
+    // Conservative ranges in words, assuming 32-bit pixels
+    uint32_t size = gs->ctx->fbw * ((ymax + 32) & ~31);
+
+    return !software_mt_overlaps(gs->ctx->fbp, gs->ctx->fbp + size, gs->ctx->zbp, gs->ctx->zbp + size);
+}
+
+// Depth test for 4 horizontally adjacent pixels, returns a mask of
+// the ones that might pass. Pixels that can't be checked here are left
+// set, gs_test_pixel still does the full test on every pixel drawn
+static inline int gs_test_depth4(struct ps2_gs* gs, int x, int y, __m128i z) {
+    switch (gs->ctx->ztst) {
+        case 0: return 0;
+        case 1: return 0xf;
+    }
+
+    uint32_t idx = x + (y * gs->ctx->fbw);
+    __m128i zb;
+
+    switch (gs->ctx->zbpsm) {
+        case GS_ZSMZ32:
+        case GS_ZSMZ24: {
+            idx += gs->ctx->zbp;
+
+            if (idx > 0xffffc)
+                return 0xf;
+
+            zb = _mm_loadu_si128((__m128i*)&gs->vram[idx]);
+
+            if (gs->ctx->zbpsm == GS_ZSMZ24) {
+                zb = _mm_and_si128(zb, _mm_set1_epi32(0xffffff));
+                z = _mm_min_epu32(z, _mm_set1_epi32(0xffffff));
+            }
+        } break;
+
+        case GS_ZSMZ16:
+        case GS_ZSMZ16S: {
+            idx += gs->ctx->zbp << 1;
+
+            if (idx > 0x1ffffc)
+                return 0xf;
+
+            zb = _mm_cvtepu16_epi32(_mm_loadl_epi64((__m128i*)((uint16_t*)gs->vram + idx)));
+            z = _mm_min_epu32(z, _mm_set1_epi32(0xffff));
+        } break;
+
+        default: return 0xf;
+    }
+
+    // Unsigned compares
+    __m128i sign = _mm_set1_epi32(0x80000000);
+    __m128i pass = _mm_cmpgt_epi32(_mm_xor_si128(z, sign), _mm_xor_si128(zb, sign));
+
+    if (gs->ctx->ztst == 2)
+        pass = _mm_or_si128(pass, _mm_cmpeq_epi32(z, zb));
+
+    return _mm_movemask_ps(_mm_castsi128_ps(pass));
+}
+#endif
+
 static inline int gs_clamp_u(struct ps2_gs* gs, int u) {
     int iu = u >> 4;
 
@@ -1416,10 +1818,67 @@ static inline void gs_draw_pixel(struct ps2_gs* gs, int x, int y, uint32_t z, ui
 
     int tr = gs_test_pixel(gs, x, y, z, a);
 
-    if (tr == TR_FAIL)
+    if (tr == TR_FAIL)
+        return;
+
+    if (gs->abe) c = gs_alpha_blend(gs, x, y, c);
+
+    switch (tr) {
+        case TR_FB_ONLY: gs_write_fb(gs, x, y, c); break;
+        case TR_ZB_ONLY: gs_write_zb(gs, x, y, z); break;
+        case TR_RGB_ONLY: gs_write_fb_no_alpha(gs, x, y, c); break;
+        case TR_PASS: {
+            gs_write_zb(gs, x, y, z);
+            gs_write_fb(gs, x, y, c);
+        } break;
+    }
+}
+
+// Draw state the pixel pipelines are specialized on, every key gets
+// its own instance of the triangle and sprite loops
+#define GS_KEY_IIP 1
+#define GS_KEY_TME 2
+#define GS_KEY_FST 4
+#define GS_KEY_ABE 8
+#define GS_KEY_TEST 16
+#define GS_KEY_COUNT 32
+
+typedef void (*gs_pipeline_func)(struct ps2_gs* gs, render_texture* tex);
+
+static inline int gs_pipeline_key(struct ps2_gs* gs) {
+    int key = 0;
+
+    if (gs->iip) key |= GS_KEY_IIP;
+    if (gs->tme) key |= GS_KEY_TME;
+    if (gs->fst) key |= GS_KEY_FST;
+    if (gs->abe) key |= GS_KEY_ABE;
+
+    // Without any test enabled every pixel passes and Z is never
+    // written
+    if (gs->ctx->ate || gs->ctx->date || gs->ctx->zte)
+        key |= GS_KEY_TEST;
+
+    return key;
+}
+
+template <int key> static inline void gs_draw_pixel_key(struct ps2_gs* gs, int x, int y, uint32_t z, uint32_t c) {
+    int tr = TR_PASS;
+
+    if constexpr (key & GS_KEY_TEST) {
+        tr = gs_test_pixel(gs, x, y, z, c >> 24);
+
+        if (tr == TR_FAIL)
+            return;
+    }
+
+    if constexpr (key & GS_KEY_ABE)
+        c = gs_alpha_blend(gs, x, y, c);
+
+    if constexpr (!(key & GS_KEY_TEST)) {
+        gs_write_fb(gs, x, y, c);
+
         return;
-
-    if (gs->abe) c = gs_alpha_blend(gs, x, y, c);
+    }
 
     switch (tr) {
         case TR_FB_ONLY: gs_write_fb(gs, x, y, c); break;
@@ -1591,9 +2050,64 @@ void software_thread_init(void* udata, struct ps2_gs* gs, SDL_Window* window) {
     glGenBuffers(1, &ctx->vbo);
     glGenBuffers(1, &ctx->ebo);
 
+    ctx->cmd_head = 0;
+    ctx->cmd_tail = 0;
+    ctx->free_head = 0;
+    ctx->free_tail = 0;
+    ctx->render_waiting = false;
+    ctx->producer_waiting = false;
+
+    ctx->free_blocks.clear();
+
+    for (int i = 0; i < SOFTWARE_THREAD_BLOCK_POOL_SIZE; i++)
+        ctx->free_blocks.push_back(&ctx->block_pool[i]);
+
+    memset(&ctx->work, 0, sizeof(struct ps2_gs));
+
+    ctx->work.vram = gs->vram;
+
+    for (int i = 0; i < SOFTWARE_THREAD_VRAM_PAGES; i++) {
+        ctx->page_version[i] = 0;
+        ctx->texture_page[i] = 0;
+    }
+
+    software_thread_init_cache(ctx, &ctx->cache);
+
+    if (ctx->mt) {
+        int count = std::thread::hardware_concurrency();
+
+        // Leave a core for the EE thread
+        count = std::clamp(count - 1, 2, SOFTWARE_MT_MAX_WORKERS);
+
+        for (int i = 0; i < count; i++) {
+            render_worker* w = new render_worker;
+
+            memset(&w->gs, 0, sizeof(struct ps2_gs));
+            memset(w->work_id, 0, sizeof(w->work_id));
+
+            w->gs.vram = gs->vram;
+            w->context_id = 0;
+            w->tile = -1;
+
+            software_thread_init_cache(ctx, &w->cache);
+
+            ctx->workers.push_back(w);
+        }
+
+        for (int i = 1; i < count; i++)
+            ctx->workers[i]->thr = std::thread(software_mt_worker_thread, ctx, ctx->workers[i]);
+    }
+
     ctx->end_signal = false;
     ctx->render_thr = std::thread(software_thread_render_thread, ctx);
-    ctx->render_thr.detach();
+}
+
+void software_mt_init(void* udata, struct ps2_gs* gs, SDL_Window* window) {
+    software_thread_state* ctx = (software_thread_state*)udata;
+
+    ctx->mt = true;
+
+    software_thread_init(udata, gs, window);
 }
 
 static inline void software_thread_vram_blit(struct ps2_gs* gs, software_thread_state* ctx) {
@@ -1619,6 +2133,15 @@ static inline void software_thread_vram_blit(struct ps2_gs* gs, software_thread_
 
         memcpy(gs->vram + dst, gs->vram + src, ctx->rrw * sizeof(uint32_t));
     }
+
+    if (!ctx->rrw || !ctx->rrh)
+        return;
+
+    uint32_t dst = ctx->dbp + ctx->dsax + (ctx->dsay * ctx->rrw);
+
+    software_thread_for_each_page_linear(dst, dst + (ctx->rrw * ctx->rrh) - 1, [ctx](uint32_t page) {
+        software_thread_mark_page(ctx, page);
+    });
 }
 
 void render_point(struct ps2_gs* gs, void* udata) {
@@ -1714,7 +2237,11 @@ void gs_draw_wireframe(struct ps2_gs* gs, struct gs_vertex v0, struct gs_vertex
 
 #define IS_TOPLEFT(a, b) ((b.y > a.y) || ((a.y == b.y) && (b.x < a.x)))
 
-void render_triangle(struct ps2_gs* gs, void* udata) {
+template <int key> static void render_triangle_key(struct ps2_gs* gs, render_texture* tex) {
+    constexpr bool iip = key & GS_KEY_IIP;
+    constexpr bool tme = key & GS_KEY_TME;
+    constexpr bool fst = key & GS_KEY_FST;
+
     struct gs_vertex v0 = gs->vq[0];
     struct gs_vertex v1 = gs->vq[1];
     struct gs_vertex v2 = gs->vq[2];
@@ -1826,95 +2353,165 @@ void render_triangle(struct ps2_gs* gs, void* udata) {
 
     int area = EDGE(v0, v1, v2);
 
+    // Degenerate triangle, nothing to draw
+    if (!area)
+        return;
+
+    // Attributes are planes in screen space. Gradients along x are set
+    // up once, values are computed exactly at the left edge of the
+    // triangle on every row and stepped across it. Colors, UVs and Z
+    // use 48.16 fixed-point so the result doesn't depend on where the
+    // scissor starts the row
+    double inv_area = 1.0 / (double)area;
+    int xorg = MIN3(v0.x, v1.x, v2.x);
+
+#define ATTR_DX(f) (((double)v0.f * a12 + (double)v1.f * a20 + (double)v2.f * a01) * inv_area)
+#define ATTR_AT(f) (((double)v0.f * w0_org + (double)v1.f * w1_org + (double)v2.f * w2_org) * inv_area)
+#define FIXED(d) ((int64_t)llrint((d) * 65536.0))
+#define UNFIXED(x) ((uint32_t)(std::max((x), (int64_t)0) >> 16))
+
+    int64_t drdx = FIXED(ATTR_DX(r));
+    int64_t dgdx = FIXED(ATTR_DX(g));
+    int64_t dbdx = FIXED(ATTR_DX(b));
+    int64_t dadx = FIXED(ATTR_DX(a));
+    int64_t dudx = FIXED(ATTR_DX(u));
+    int64_t dvdx = FIXED(ATTR_DX(v));
+    int64_t dzdx = FIXED(ATTR_DX(z));
+    double dsdx = ATTR_DX(s);
+    double dtdx = ATTR_DX(t);
+    double dqdx = ATTR_DX(q);
+
+#ifdef _GS_USE_INTRINSICS
+    // Edge functions for 4 pixels at a time
+    __m128i step0 = _mm_setr_epi32(0, a12, a12 * 2, a12 * 3);
+    __m128i step1 = _mm_setr_epi32(0, a20, a20 * 2, a20 * 3);
+    __m128i step2 = _mm_setr_epi32(0, a01, a01 * 2, a01 * 3);
+    bool early_z = (key & GS_KEY_TEST) && gs_can_test_depth4(gs, ymax);
+    int mask = 0;
+#endif
+
     for (p.y = ymin; p.y <= ymax; p.y++) {
         // Barycentric coordinates at start of row
         int w0 = w0_row;
         int w1 = w1_row;
         int w2 = w2_row;
 
-        for (p.x = xmin; p.x <= xmax; p.x++) {
-            // If p is on or inside all edges, render pixel.
-            if (((w0 + bias0) | (w1 + bias1) | (w2 + bias2)) < 0) {
-                w0 += a12;
-                w1 += a20;
-                w2 += a01;
-
-                continue;
-            }
-
-            // Calculate interpolation weights
-            double iw0 = (double)w0 / (double)area;
-            double iw1 = (double)w1 / (double)area;
-            double iw2 = (double)w2 / (double)area;
+        // Attributes at the left edge, then moved to the first pixel
+        int skip = xmin - xorg;
+        int w0_org = w0_row - (a12 * skip);
+        int w1_org = w1_row - (a20 * skip);
+        int w2_org = w2_row - (a01 * skip);
+
+        int64_t ar = FIXED(ATTR_AT(r)) + drdx * skip;
+        int64_t ag = FIXED(ATTR_AT(g)) + dgdx * skip;
+        int64_t ab = FIXED(ATTR_AT(b)) + dbdx * skip;
+        int64_t aa = FIXED(ATTR_AT(a)) + dadx * skip;
+        int64_t au = FIXED(ATTR_AT(u)) + dudx * skip;
+        int64_t av = FIXED(ATTR_AT(v)) + dvdx * skip;
+        int64_t az = FIXED(ATTR_AT(z)) + dzdx * skip;
+        double s0 = ATTR_AT(s);
+        double t0 = ATTR_AT(t);
+        double q0 = ATTR_AT(q);
 
-            uint32_t fr, fg, fb, fa;
-
-            if (gs->iip) {
-                fr = v0.r * iw0 + v1.r * iw1 + v2.r * iw2;
-                fg = v0.g * iw0 + v1.g * iw1 + v2.g * iw2;
-                fb = v0.b * iw0 + v1.b * iw1 + v2.b * iw2;
-                fa = v0.a * iw0 + v1.a * iw1 + v2.a * iw2;
-            } else {
-                fr = v2.r;
-                fg = v2.g;
-                fb = v2.b;
-                fa = v2.a;
+        for (p.x = xmin; p.x <= xmax; p.x++) {
+#ifdef _GS_USE_INTRINSICS
+            int lane = (p.x - xmin) & 3;
+
+            if (!lane) {
+                __m128i e = _mm_or_si128(
+                    _mm_or_si128(
+                        _mm_add_epi32(_mm_set1_epi32(w0 + bias0), step0),
+                        _mm_add_epi32(_mm_set1_epi32(w1 + bias1), step1)
+                    ),
+                    _mm_add_epi32(_mm_set1_epi32(w2 + bias2), step2)
+                );
+
+                mask = ~_mm_movemask_ps(_mm_castsi128_ps(e)) & 0xf;
+
+                // Reject hidden pixels before they get shaded
+                if (mask && early_z) {
+                    __m128i z = _mm_setr_epi32(
+                        UNFIXED(az),
+                        UNFIXED(az + dzdx),
+                        UNFIXED(az + (dzdx * 2)),
+                        UNFIXED(az + (dzdx * 3))
+                    );
+
+                    mask &= gs_test_depth4(gs, p.x, p.y, z);
+                }
             }
 
-            if (gs->tme) {
-                // Fixed-point 12:4
-                int u, v;
-
-                if (gs->fst) {
-                    u = v0.u * iw0 + v1.u * iw1 + v2.u * iw2;
-                    v = v0.v * iw0 + v1.v * iw1 + v2.v * iw2;
+            if (mask & (1 << lane)) {
+#else
+            // If p is on or inside all edges, render pixel.
+            if (((w0 + bias0) | (w1 + bias1) | (w2 + bias2)) >= 0) {
+#endif
+                uint32_t fr, fg, fb, fa;
+
+                if constexpr (iip) {
+                    fr = UNFIXED(ar);
+                    fg = UNFIXED(ag);
+                    fb = UNFIXED(ab);
+                    fa = UNFIXED(aa);
                 } else {
-                    float s = v0.s * iw0 + v1.s * iw1 + v2.s * iw2;
-                    float t = v0.t * iw0 + v1.t * iw1 + v2.t * iw2;
-                    float q = v0.q * iw0 + v1.q * iw1 + v2.q * iw2;
-
-                    float uf = (s / q) * gs->ctx->usize;
-                    float vf = (t / q) * gs->ctx->vsize;
-
-                    // Convert to 12:4 fixed-point
-                    u = uf * (1 << 4);
-                    v = vf * (1 << 4);
+                    fr = v2.r;
+                    fg = v2.g;
+                    fb = v2.b;
+                    fa = v2.a;
                 }
 
-                u = gs_clamp_u(gs, u);
-                v = gs_clamp_v(gs, v);
+                if constexpr (tme) {
+                    // Fixed-point 12:4
+                    int u, v;
 
-                uint32_t f = fr | (fg << 8) | (fb << 16) | (fa << 24);
-                uint32_t t = gs_read_tb(gs, u, v);
-                t = gs_to_rgba32(gs, t, gs->ctx->tbpsm);
-                t = gs_apply_function(gs, t, f);
+                    if constexpr (fst) {
+                        u = UNFIXED(au);
+                        v = UNFIXED(av);
+                    } else {
+                        // STQ aren't stepped, rounding errors would
+                        // add up differently depending on the start
+                        double as = s0 + dsdx * (p.x - xorg);
+                        double at = t0 + dtdx * (p.x - xorg);
+                        double aq = q0 + dqdx * (p.x - xorg);
+
+                        float uf = (float)(as / aq) * gs->ctx->usize;
+                        float vf = (float)(at / aq) * gs->ctx->vsize;
+
+                        // Convert to 12:4 fixed-point
+                        u = uf * (1 << 4);
+                        v = vf * (1 << 4);
+                    }
 
-                fr = t & 0xff;
-                fg = (t >> 8) & 0xff;
-                fb = (t >> 16) & 0xff;
-                fa = t >> 24;
-            }
+                    u = gs_clamp_u(gs, u);
+                    v = gs_clamp_v(gs, v);
 
-            uint32_t fz = (uint32_t)floorf((double)v0.z * iw0 + (double)v1.z * iw1 + (double)v2.z * iw2);
+                    uint32_t f = fr | (fg << 8) | (fb << 16) | (fa << 24);
+                    uint32_t t = gs_read_tb(gs, tex, u, v);
+                    t = gs_apply_function(gs, t, f);
 
-            int tr = gs_test_pixel(gs, p.x, p.y, fz, fa);
+                    fr = t & 0xff;
+                    fg = (t >> 8) & 0xff;
+                    fb = (t >> 16) & 0xff;
+                    fa = t >> 24;
+                }
 
-            if (tr == TR_FAIL) {
-                w0 += a12;
-                w1 += a20;
-                w2 += a01;
+                uint32_t fz = UNFIXED(az);
+                uint32_t fc = fr | (fg << 8) | (fb << 16) | (fa << 24);
 
-                continue;
+                gs_draw_pixel_key<key>(gs, p.x, p.y, fz, fc);
             }
 
-            uint32_t fc = fr | (fg << 8) | (fb << 16) | (fa << 24);
-
-            gs_draw_pixel(gs, p.x, p.y, fz, fc);
-
             // One step to the right
             w0 += a12;
             w1 += a20;
             w2 += a01;
+            ar += drdx;
+            ag += dgdx;
+            ab += dbdx;
+            aa += dadx;
+            au += dudx;
+            av += dvdx;
+            az += dzdx;
         }
 
         // One row step
@@ -1923,12 +2520,20 @@ void render_triangle(struct ps2_gs* gs, void* udata) {
         w2_row += b01;
     }
 
+#undef ATTR_DX
+#undef ATTR_AT
+#undef FIXED
+#undef UNFIXED
+
     // gs_draw_wireframe(gs, gs->vq[0], gs->vq[1]);
     // gs_draw_wireframe(gs, gs->vq[1], gs->vq[2]);
     // gs_draw_wireframe(gs, gs->vq[2], gs->vq[0]);
 }
 
-void render_sprite(struct ps2_gs* gs, void* udata) {
+template <int key> static void render_sprite_key(struct ps2_gs* gs, render_texture* tex) {
+    constexpr bool tme = key & GS_KEY_TME;
+    constexpr bool fst = key & GS_KEY_FST;
+
     // gs_draw_wireframe(gs, dv0, dv2);
 
     // if (gs->tme) {
@@ -2059,21 +2664,40 @@ void render_sprite(struct ps2_gs* gs, void* udata) {
     float u = v0.u;
     float v = v0.v;
 
-    for (int y = ymin; y < ymax; y++) {
-        for (int x = xmin; x < xmax; x++) {
-            if (!gs_test_scissor(gs, x, y))
+    // Only walk the part of the sprite inside the scissor
+    int xs = std::max(xmin, (int)gs->ctx->scax0);
+    int ys = std::max(ymin, (int)gs->ctx->scay0);
+    int xe = std::min(xmax, (int)gs->ctx->scax1 + 1);
+    int ye = std::min(ymax, (int)gs->ctx->scay1 + 1);
+
+#ifdef _GS_USE_INTRINSICS
+    bool early_z = (key & GS_KEY_TEST) && gs_can_test_depth4(gs, ye);
+    int mask = 0xf;
+#endif
+
+    for (int y = ys; y < ye; y++) {
+        for (int x = xs; x < xe; x++) {
+#ifdef _GS_USE_INTRINSICS
+            int lane = (x - xs) & 3;
+
+            // Z is constant, test 4 pixels before texturing them
+            if (early_z && !lane)
+                mask = gs_test_depth4(gs, x, y, _mm_set1_epi32(z));
+
+            if (!(mask & (1 << lane)))
                 continue;
+#endif
 
             uint32_t c = v1.rgbaq & 0xffffffff;
 
-            if (gs->tme) {
+            if constexpr (tme) {
                 float tx = (float)(x - v0.x) / (float)(v1.x - v0.x);
                 float ty = (float)(y - v0.y) / (float)(v1.y - v0.y);
 
                 int iu;
                 int iv;
 
-                if (gs->fst) {
+                if constexpr (fst) {
                     u = v0.u + (v1.u - v0.u) * tx;
                     v = v0.v + (v1.v - v0.v) * ty;
 
@@ -2093,14 +2717,13 @@ void render_sprite(struct ps2_gs* gs, void* udata) {
                 u = gs_clamp_u(gs, iu);
                 v = gs_clamp_v(gs, iv);
 
-                c = gs_read_tb(gs, iu, iv);
-                c = gs_to_rgba32(gs, c, gs->ctx->tbpsm);
+                c = gs_read_tb(gs, tex, iu, iv);
                 c = gs_apply_function(gs, c, v1.rgbaq & 0xffffffff);
 
                 a = c >> 24;
             }
 
-            gs_draw_pixel(gs, x, y, z, c);
+            gs_draw_pixel_key<key>(gs, x, y, z, c);
         }
     }
 
@@ -2120,85 +2743,135 @@ void render_sprite(struct ps2_gs* gs, void* udata) {
     // gs_draw_wireframe(gs, dv3, dv0);
 }
 
-void render(struct ps2_gs* gs, void* udata) {
-    software_thread_state* ctx = (software_thread_state*)udata;
+template <size_t... keys>
+static constexpr std::array <gs_pipeline_func, GS_KEY_COUNT> gs_triangle_pipelines(std::index_sequence <keys...>) {
+    return { render_triangle_key<keys>... };
+}
 
-    int en1 = ctx->gs->pmode & 1;
-    int en2 = (ctx->gs->pmode >> 1) & 1;
+// Sprites are flat, IIP doesn't make a difference
+template <size_t... keys>
+static constexpr std::array <gs_pipeline_func, GS_KEY_COUNT> gs_sprite_pipelines(std::index_sequence <keys...>) {
+    return { render_sprite_key<keys & ~GS_KEY_IIP>... };
+}
 
-    uint32_t dfbp = 0;
-    int dfb = 0;
+static constexpr auto triangle_pipelines = gs_triangle_pipelines(std::make_index_sequence <GS_KEY_COUNT>());
+static constexpr auto sprite_pipelines = gs_sprite_pipelines(std::make_index_sequence <GS_KEY_COUNT>());
 
-    if (en1) {
-        dfb = 0;
-        dfbp = ctx->gs->dispfb1;
-    } else if (en2) {
-        dfb = 1;
-        dfbp = ctx->gs->dispfb2;
+// udata is the drawing thread's texture cache, if any
+void render_triangle(struct ps2_gs* gs, void* udata) {
+    render_texture* tex = gs_get_texture((render_texture_cache*)udata, gs);
+
+    triangle_pipelines[gs_pipeline_key(gs)](gs, tex);
+}
+
+void render_sprite(struct ps2_gs* gs, void* udata) {
+    render_texture* tex = gs_get_texture((render_texture_cache*)udata, gs);
+
+    sprite_pipelines[gs_pipeline_key(gs)](gs, tex);
+}
+
+// Display readout. Lines are read a column row at a time (8 pixels
+// for 32-bit formats, 16 for 16-bit ones), the rest pixel by pixel
+static inline void gs_load_column_row(uint32_t* dst, const uint32_t* src, uint32_t mask) {
+#ifdef _GS_USE_INTRINSICS
+    __m128i m = _mm_set1_epi32(mask);
+    __m128i a = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)src), _mm_loadl_epi64((const __m128i*)(src + 4)));
+    __m128i b = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(src + 8)), _mm_loadl_epi64((const __m128i*)(src + 12)));
+
+    _mm_storeu_si128((__m128i*)dst, _mm_and_si128(a, m));
+    _mm_storeu_si128((__m128i*)(dst + 4), _mm_and_si128(b, m));
+#else
+    for (int i = 0; i < 8; i++)
+        dst[i] = src[((i >> 1) * 4) + (i & 1)] & mask;
+#endif
+}
+
+static inline void gs_load_column_row16(uint16_t* dst, const uint32_t* src) {
+#ifdef _GS_USE_INTRINSICS
+    __m128i m = _mm_set1_epi32(0xffff);
+    __m128i a = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)src), _mm_loadl_epi64((const __m128i*)(src + 4)));
+    __m128i b = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(src + 8)), _mm_loadl_epi64((const __m128i*)(src + 12)));
+
+    _mm_storeu_si128((__m128i*)dst, _mm_packus_epi32(_mm_and_si128(a, m), _mm_and_si128(b, m)));
+    _mm_storeu_si128((__m128i*)(dst + 8), _mm_packus_epi32(_mm_srli_epi32(a, 16), _mm_srli_epi32(b, 16)));
+#else
+    for (int i = 0; i < 8; i++) {
+        uint32_t w = src[((i >> 1) * 4) + (i & 1)];
+
+        dst[i] = w & 0xffff;
+        dst[i + 8] = w >> 16;
     }
+#endif
+}
 
-    uint32_t* ptr = &gs->vram[dfbp];
+static inline void gs_read_display_line32(const uint32_t* vram, uint32_t* dst, const render_readout& r, int y, uint32_t mask) {
+    int x = 0;
 
-    // printf("fbp=%x fbw=%d fbpsm=%d stride=%d dy=%d\n", dfbp, dfbw, dfbpsm, stride, dy);
+    for (; (x + 8) <= r.w; x += 8)
+        gs_load_column_row(dst + x, &vram[psmct32_addr(r.dfbp, r.dfbw, x, y) & 0xfffff], mask);
 
-    if (!ctx->tex_w)
-        return;
+    for (; x < r.w; x++)
+        dst[x] = vram[psmct32_addr(r.dfbp, r.dfbw, x, y) & 0xfffff] & mask;
+}
 
-    if ((ctx->gs->smode2 & 3) == 3) {
-        // Need to deinterlace
-        int bpp = 0;
-        int odd = ((ctx->gs->csr >> 13) & 1) == 0;
+template <int (*addr_fn)(int, int, int, int)>
+static inline void gs_read_display_line16(const uint32_t* vram, uint16_t* dst, const render_readout& r, int y) {
+    int x = 0;
 
-        switch (ctx->disp_fmt) {
-            case GS_PSMCT32:
-            case GS_PSMCT24: {
-                bpp = 4;
+    for (; (x + 16) <= r.w; x += 16)
+        gs_load_column_row16(dst + x, &vram[addr_fn(r.dfbp, r.dfbw, x, y) & 0xfffff]);
 
-                for (int y = 0; y < ctx->tex_h / 2; y++) {
-                    for (int x = 0; x < ctx->tex_w; x++) {
-                        uint32_t* dst = ctx->buf + x + (((y * 2) + odd) * ctx->tex_w);
+    for (; x < r.w; x++) {
+        const uint16_t* p = (const uint16_t*)&vram[addr_fn(r.dfbp, r.dfbw, x, y) & 0xfffff];
 
-                        *dst = gs_read_dispfb(gs, x, y, dfb);
-                    }
-                }
-            } break;
-            case GS_PSMCT16:
-            case GS_PSMCT16S: {
-                for (int y = 0; y < ctx->tex_h / 2; y++) {
-                    for (int x = 0; x < ctx->tex_w; x++) {
-                        uint16_t* dst = ((uint16_t*)ctx->buf) + x + (((y * 2) + odd) * ctx->tex_w);
+        dst[x] = p[psmct16_shift[(x & 15) + ((y & 1) * 16)]];
+    }
+}
 
-                        *dst = gs_read_dispfb(gs, x, y, dfb);
-                    }
-                }
-            } break;
+// Render thread. Field lines are deinterlaced in the same pass
+void software_thread_readout(software_thread_state* ctx) {
+    const render_readout& r = ctx->readout;
+    const uint32_t* vram = ctx->gs->vram;
+
+    int bpp = ((r.fmt == GS_PSMCT16) || (r.fmt == GS_PSMCT16S)) ? 2 : 4;
+    int stride = r.w * bpp;
+    int lines = r.field ? (r.h / 2) : r.h;
+
+    for (int y = 0; y < lines; y++) {
+        int line = r.field ? ((y * 2) + r.odd) : y;
+        uint8_t* dst = (uint8_t*)r.dst + (line * stride);
+
+        switch (r.fmt) {
+            case GS_PSMCT32: gs_read_display_line32(vram, (uint32_t*)dst, r, y, 0xffffffff); break;
+            case GS_PSMCT24: gs_read_display_line32(vram, (uint32_t*)dst, r, y, 0xffffff); break;
+            case GS_PSMCT16: gs_read_display_line16 <psmct16_addr> (vram, (uint16_t*)dst, r, y); break;
+            case GS_PSMCT16S: gs_read_display_line16 <psmct16s_addr> (vram, (uint16_t*)dst, r, y); break;
+            default: memset(dst, 0, stride); break;
         }
-    } else {
-        switch (ctx->disp_fmt) {
-            case GS_PSMCT32:
-            case GS_PSMCT24: {
-                for (int y = 0; y < ctx->tex_h; y++) {
-                    for (int x = 0; x < ctx->tex_w; x++) {
-                        uint32_t* dst = ctx->buf + x + (y * ctx->tex_w);
 
-                        *dst = gs_read_dispfb(gs, x, y, dfb);
-                    }
-                }
-            } break;
-            case GS_PSMCT16:
-            case GS_PSMCT16S: {
-                for (int y = 0; y < ctx->tex_h; y++) {
-                    for (int x = 0; x < ctx->tex_w; x++) {
-                        uint16_t* dst = ((uint16_t*)ctx->buf) + x + (y * ctx->tex_w);
+        if (!r.field || ((line ^ 1) >= r.h))
+            continue;
 
-                        *dst = gs_read_dispfb(gs, x, y, dfb);
-                    }
-                }
-            } break;
+        // The other field's line is either this one again (bob) or
+        // the one shown last time (weave)
+        uint8_t* other = (uint8_t*)r.dst + ((line ^ 1) * stride);
+
+        if (r.deinterlace == RENDERER_DEINTERLACE_BOB) {
+            memcpy(other, dst, stride);
+        } else {
+            memcpy(other, (uint8_t*)r.prev + ((line ^ 1) * stride), stride);
         }
     }
+}
+
+// Shows ctx->buf, the readout of the next frame is queued separately
+void render(struct ps2_gs* gs, void* udata) {
+    software_thread_state* ctx = (software_thread_state*)udata;
+
+    if (!ctx->tex_w)
+        return;
 
-    ptr = ctx->buf;
+    uint32_t* ptr = ctx->buf;
 
     SDL_Rect size, rect;
 
@@ -2505,6 +3178,7 @@ void transfer_start(struct ps2_gs* gs, void* udata) {
 
     ctx->psmct24_data = 0;
     ctx->psmct24_shift = 0;
+    ctx->transfer_marked = false;
 
     // FILE* file = fopen("gs.dump", "a");
     // printf("dbp=%x (%x) dbw=%d (%d) dpsm=%02x dsa=(%d,%d) rr=(%d,%d) xdir=%d\n",
@@ -2520,11 +3194,7 @@ void transfer_start(struct ps2_gs* gs, void* udata) {
     // fclose(file);
 
     if (ctx->xdir == 2) {
-        ctx->render_mtx.lock();
-
         software_thread_vram_blit(gs, ctx);
-
-        ctx->render_mtx.unlock();
     } else if (ctx->xdir == 1) {
         printf("gs: Read transfer requested\n");
 
@@ -2755,9 +3425,130 @@ static inline void gs_store_hwreg_psmct16s(struct ps2_gs* gs, software_thread_st
     }
 }
 
+// Bulk uploads. Pixels starting a column row (8 pixels for 32-bit
+// formats, 16 for 16-bit ones) that don't cross the end of the
+// transfer row are stored a whole row at a time, the rest go through
+// the per-pixel writers above.
+//
+// The words of a column row are pairs at offsets 0, 4, 8 and 12 from
+// its first pixel
+static inline void gs_store_column_row(uint32_t* dst, const uint32_t* src) {
+#ifdef _GS_USE_INTRINSICS
+    __m128i a = _mm_loadu_si128((const __m128i*)src);
+    __m128i b = _mm_loadu_si128((const __m128i*)(src + 4));
+
+    _mm_storel_epi64((__m128i*)dst, a);
+    _mm_storel_epi64((__m128i*)(dst + 4), _mm_unpackhi_epi64(a, a));
+    _mm_storel_epi64((__m128i*)(dst + 8), b);
+    _mm_storel_epi64((__m128i*)(dst + 12), _mm_unpackhi_epi64(b, b));
+#else
+    for (int i = 0; i < 4; i++)
+        memcpy(dst + (i * 4), src + (i * 2), sizeof(uint32_t) * 2);
+#endif
+}
+
+// 16-bit pixels n and n + 8 share a word
+static inline void gs_store_column_row16(uint32_t* dst, const uint16_t* src) {
+#ifdef _GS_USE_INTRINSICS
+    __m128i lo = _mm_loadu_si128((const __m128i*)src);
+    __m128i hi = _mm_loadu_si128((const __m128i*)(src + 8));
+    __m128i a = _mm_unpacklo_epi16(lo, hi);
+    __m128i b = _mm_unpackhi_epi16(lo, hi);
+
+    _mm_storel_epi64((__m128i*)dst, a);
+    _mm_storel_epi64((__m128i*)(dst + 4), _mm_unpackhi_epi64(a, a));
+    _mm_storel_epi64((__m128i*)(dst + 8), b);
+    _mm_storel_epi64((__m128i*)(dst + 12), _mm_unpackhi_epi64(b, b));
+#else
+    uint32_t row[8];
+
+    for (int i = 0; i < 8; i++)
+        row[i] = src[i] | ((uint32_t)src[i + 8] << 16);
+
+    gs_store_column_row(dst, row);
+#endif
+}
+
+static inline void gs_store_image_psmct32(struct ps2_gs* gs, software_thread_state* ctx, const uint32_t* data, int count) {
+    unsigned int end = ctx->rrw + ctx->dsax;
+
+    while (count) {
+        if ((ctx->dx & 7) || (count < 8) || ((ctx->dx + 8) > end)) {
+            gs_write_psmct32(gs, ctx, *data++);
+
+            count--;
+
+            continue;
+        }
+
+        uint32_t addr = psmct32_addr(ctx->dbp, ctx->dbw, ctx->dx, ctx->dy) & 0xfffff;
+
+        gs_store_column_row(&gs->vram[addr], data);
+
+        data += 8;
+        count -= 8;
+        ctx->dx += 8;
+
+        if (ctx->dx == end) {
+            ctx->dx = ctx->dsax;
+            ctx->dy++;
+        }
+    }
+}
+
+template <
+    int (*addr_fn)(int, int, int, int),
+    void (*write_fn)(struct ps2_gs*, software_thread_state*, uint32_t)
+> static inline void gs_store_image_psmct16(struct ps2_gs* gs, software_thread_state* ctx, const uint16_t* data, int count) {
+    unsigned int end = ctx->rrw + ctx->dsax;
+
+    while (count) {
+        if ((ctx->dx & 15) || (count < 16) || ((ctx->dx + 16) > end)) {
+            write_fn(gs, ctx, *data++);
+
+            count--;
+
+            continue;
+        }
+
+        uint32_t addr = addr_fn(ctx->dbp, ctx->dbw, ctx->dx, ctx->dy) & 0xfffff;
+
+        gs_store_column_row16(&gs->vram[addr], data);
+
+        data += 16;
+        count -= 16;
+        ctx->dx += 16;
+
+        if (ctx->dx == end) {
+            ctx->dx = ctx->dsax;
+            ctx->dy++;
+        }
+    }
+}
+
+// Textures read from the transfer's area are stale from now on. Only
+// needs to happen again once something could have cached them
+static inline void software_thread_mark_transfer(software_thread_state* ctx) {
+    ctx->transfer_marked = true;
+
+    if (!ctx->rrw || !ctx->rrh)
+        return;
+
+    software_thread_for_each_page(ctx->dbp, ctx->dbw, ctx->dpsm,
+        ctx->dsax, ctx->dsay,
+        ctx->dsax + ctx->rrw - 1, ctx->dsay + ctx->rrh - 1,
+        [ctx](uint32_t page) {
+            software_thread_mark_page(ctx, page);
+        }
+    );
+}
+
 void transfer_write(struct ps2_gs* gs, void* udata) {
     software_thread_state* ctx = (software_thread_state*)udata;
 
+    if (!ctx->transfer_marked)
+        software_thread_mark_transfer(ctx);
+
     switch (ctx->dpsm) {
         case GS_PSMCT32: {
             gs_store_hwreg_psmct32(gs, ctx);
@@ -2801,146 +3592,259 @@ void transfer_write(struct ps2_gs* gs, void* udata) {
     }
 }
 
+void transfer_image(struct ps2_gs* gs, const uint64_t* data, int count, void* udata) {
+    software_thread_state* ctx = (software_thread_state*)udata;
+
+    if (!ctx->transfer_marked)
+        software_thread_mark_transfer(ctx);
+
+    switch (ctx->dpsm) {
+        case GS_PSMCT32: {
+            gs_store_image_psmct32(gs, ctx, (const uint32_t*)data, count * 2);
+        } return;
+
+        case GS_PSMCT16: {
+            gs_store_image_psmct16 <psmct16_addr, gs_write_psmct16> (gs, ctx, (const uint16_t*)data, count * 4);
+        } return;
+
+        case GS_PSMCT16S: {
+            gs_store_image_psmct16 <psmct16s_addr, gs_write_psmct16s> (gs, ctx, (const uint16_t*)data, count * 4);
+        } return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        gs->hwreg = data[i];
+
+        transfer_write(gs, ctx);
+    }
+}
+
 void transfer_read(struct ps2_gs* gs, void* udata) {
     gs->hwreg = 0;
 }
 
-extern "C" void software_thread_render_point(struct ps2_gs* gs, void* udata) {
-    software_thread_state* ctx = (software_thread_state*)udata;
+static inline render_block* software_thread_alloc_block(software_thread_state* ctx) {
+    // Collect the blocks the render thread released, wait if there
+    // are none (every block is in use by queued commands)
+    if (ctx->free_blocks.empty()) {
+        uint32_t head = ctx->free_head.load(std::memory_order_relaxed);
 
-    ctx->queue_mtx.lock();
-    ctx->render_queue.push(render_data());
+        software_thread_wait_render(ctx, [ctx, head]() {
+            return ctx->free_tail.load() != head;
+        });
 
-    render_data& rdata = ctx->render_queue.back();
+        uint32_t tail = ctx->free_tail.load(std::memory_order_acquire);
 
-    rdata.gs = *gs;
-    rdata.prim = 0;
-    ctx->queue_mtx.unlock();
-}
+        while (head != tail)
+            ctx->free_blocks.push_back(ctx->free_ring[(head++) & (SOFTWARE_THREAD_BLOCK_POOL_SIZE - 1)]);
 
-extern "C" void software_thread_render_line(struct ps2_gs* gs, void* udata) {
-    software_thread_state* ctx = (software_thread_state*)udata;
+        ctx->free_head.store(head, std::memory_order_release);
+    }
 
-    ctx->queue_mtx.lock();
-    ctx->render_queue.push(render_data());
+    render_block* b = ctx->free_blocks.back();
 
-    render_data& rdata = ctx->render_queue.back();
+    ctx->free_blocks.pop_back();
 
-    rdata.gs = *gs;
-    rdata.prim = 1;
-    ctx->queue_mtx.unlock();
+    b->id = ++ctx->block_id;
+    b->refs.store(1, std::memory_order_relaxed);
+
+    return b;
 }
 
-extern "C" void software_thread_render_triangle(struct ps2_gs* gs, void* udata) {
-    software_thread_state* ctx = (software_thread_state*)udata;
+static inline void software_thread_store_block(struct ps2_gs* gs, int type, render_block* b) {
+    switch (type) {
+        case GS_BLOCK_CONTEXT1: b->context = gs->context[0]; break;
+        case GS_BLOCK_CONTEXT2: b->context = gs->context[1]; break;
+
+        case GS_BLOCK_TEX: {
+            b->tex.texa = gs->texa;
+            b->tex.texclut = gs->texclut;
+            b->tex.cbw = gs->cbw;
+            b->tex.cou = gs->cou;
+            b->tex.cov = gs->cov;
+            b->tex.aem = gs->aem;
+            b->tex.ta0 = gs->ta0;
+            b->tex.ta1 = gs->ta1;
+        } break;
+
+        case GS_BLOCK_MISC: {
+            b->misc.scanmsk = gs->scanmsk;
+            b->misc.fogcol = gs->fogcol;
+            b->misc.dimx = gs->dimx;
+            b->misc.dthe = gs->dthe;
+            b->misc.colclamp = gs->colclamp;
+            b->misc.pabe = gs->pabe;
 
-    ctx->queue_mtx.lock();
-    ctx->render_queue.push(render_data());
+            memcpy(b->misc.dither, gs->dither, sizeof(gs->dither));
+        } break;
 
-    render_data& rdata = ctx->render_queue.back();
+        case GS_BLOCK_CLUT: {
+            memcpy(b->clut.clut_cache, gs->clut_cache, sizeof(gs->clut_cache));
 
-    rdata.gs = *gs;
-    rdata.prim = 2;
-    ctx->queue_mtx.unlock();
+            b->clut.cbp0 = gs->cbp0;
+            b->clut.cbp1 = gs->cbp1;
+        } break;
+    }
 }
 
-extern "C" void software_thread_render_sprite(struct ps2_gs* gs, void* udata) {
-    software_thread_state* ctx = (software_thread_state*)udata;
+static inline void software_thread_push(software_thread_state* ctx, struct ps2_gs* gs, int prim) {
+    uint32_t tail = ctx->cmd_tail.load(std::memory_order_relaxed);
 
-    ctx->queue_mtx.lock();
-    ctx->render_queue.push(render_data());
+    // Ring is full, wait for the render thread to catch up
+    if ((tail - ctx->cmd_head.load(std::memory_order_acquire)) >= SOFTWARE_THREAD_CMD_RING_SIZE)
+        software_thread_wait_fence(ctx, tail - SOFTWARE_THREAD_CMD_RING_SIZE + 1);
 
-    render_data& rdata = ctx->render_queue.back();
+    // The next transfer write has to invalidate what this draw caches
+    ctx->transfer_marked = false;
 
-    rdata.gs = *gs;
-    rdata.prim = 3;
-    ctx->queue_mtx.unlock();
-}
+    render_command& cmd = ctx->cmd_ring[tail & (SOFTWARE_THREAD_CMD_RING_SIZE - 1)];
 
-extern "C" void software_thread_render(struct ps2_gs* gs, void* udata) {
-    software_thread_state* ctx = (software_thread_state*)udata;
+    for (int i = 0; i < GS_BLOCK_COUNT; i++) {
+        // The other context isn't needed for this primitive
+        if (i == (GS_BLOCK_CONTEXT1 + !gs->ctxt)) {
+            cmd.blocks[i] = nullptr;
 
-    // Block until queue is empty
-    while (true) {
-        ctx->queue_mtx.lock();
+            continue;
+        }
 
-        if (ctx->render_queue.empty()) {
-            ctx->queue_mtx.unlock();
+        // Snapshot blocks that changed since the last primitive
+        if (!ctx->current[i] || (gs->block_version[i] != ctx->current_version[i])) {
+            render_block* b = software_thread_alloc_block(ctx);
 
-            break;
+            software_thread_store_block(gs, i, b);
+
+            if (ctx->current[i] && (ctx->current[i]->refs.fetch_sub(1, std::memory_order_acq_rel) == 1))
+                ctx->free_blocks.push_back(ctx->current[i]);
+
+            ctx->current[i] = b;
+            ctx->current_version[i] = gs->block_version[i];
         }
 
-        ctx->queue_mtx.unlock();
+        ctx->current[i]->refs.fetch_add(1, std::memory_order_relaxed);
+
+        cmd.blocks[i] = ctx->current[i];
     }
 
-    ctx->render_mtx.lock();
+    cmd.prim = prim;
+    cmd.attr = gs->attr;
+    cmd.iip = gs->iip;
+    cmd.tme = gs->tme;
+    cmd.fge = gs->fge;
+    cmd.abe = gs->abe;
+    cmd.aa1 = gs->aa1;
+    cmd.fst = gs->fst;
+    cmd.ctxt = gs->ctxt;
+    cmd.fix = gs->fix;
+    cmd.vq[0] = gs->vq[0];
+    cmd.vq[1] = gs->vq[1];
+    cmd.vq[2] = gs->vq[2];
 
-    render(gs, ctx);
+    ctx->cmd_tail.store(tail + 1);
 
-    ctx->render_mtx.unlock();
+    software_thread_notify_render(ctx);
 }
 
-extern "C" void software_thread_transfer_start(struct ps2_gs* gs, void* udata) {
-    software_thread_state* ctx = (software_thread_state*)udata;
+// Swaps the output buffers and queues a readout of the display into
+// the new back buffer. It's done on the render thread once everything
+// queued before it is drawn, the frame shows up on the next render()
+static inline void software_thread_push_readout(software_thread_state* ctx, struct ps2_gs* gs) {
+    // The frame read out last time is ready to be shown
+    software_thread_wait_fence(ctx, ctx->readout_fence);
 
-    // Block until queue is empty
-    while (true) {
-        ctx->queue_mtx.lock();
+    ctx->buf = ctx->bufs[ctx->back];
+    ctx->back ^= 1;
 
-        if (ctx->render_queue.empty()) {
-            ctx->queue_mtx.unlock();
+    int dfb = !(gs->pmode & 1) && (gs->pmode & 2);
 
-            break;
-        }
+    render_readout& r = ctx->readout;
 
-        ctx->queue_mtx.unlock();
-    }
+    r.dst = ctx->bufs[ctx->back];
+    r.prev = ctx->buf;
+    r.w = ctx->tex_w;
+    r.h = ctx->tex_h;
+    r.fmt = ctx->disp_fmt;
+    r.dfbp = dfb ? gs->dfbp2 : gs->dfbp1;
+    r.dfbw = dfb ? gs->dfbw2 : gs->dfbw1;
+    r.field = (gs->smode2 & 3) == 3;
+    r.odd = ((gs->csr >> 13) & 1) == 0;
+    r.deinterlace = ctx->deinterlace;
 
-    transfer_start(gs, ctx);
+    uint32_t tail = ctx->cmd_tail.load(std::memory_order_relaxed);
+
+    if ((tail - ctx->cmd_head.load(std::memory_order_acquire)) >= SOFTWARE_THREAD_CMD_RING_SIZE)
+        software_thread_wait_fence(ctx, tail - SOFTWARE_THREAD_CMD_RING_SIZE + 1);
+
+    render_command& cmd = ctx->cmd_ring[tail & (SOFTWARE_THREAD_CMD_RING_SIZE - 1)];
+
+    for (int i = 0; i < GS_BLOCK_COUNT; i++)
+        cmd.blocks[i] = nullptr;
+
+    cmd.prim = SOFTWARE_THREAD_CMD_READOUT;
+
+    ctx->cmd_tail.store(tail + 1);
+    ctx->readout_fence = tail + 1;
+
+    software_thread_notify_render(ctx);
 }
 
-extern "C" void software_thread_transfer_write(struct ps2_gs* gs, void* udata) {
-    software_thread_state* ctx = (software_thread_state*)udata;
+// Blocks until the render thread is done with every command
+static inline void software_thread_flush(software_thread_state* ctx) {
+    software_thread_wait_fence(ctx, software_thread_fence(ctx));
+}
 
-    // Block until queue is empty
-    while (true) {
-        ctx->queue_mtx.lock();
+extern "C" void software_thread_render_point(struct ps2_gs* gs, void* udata) {
+    software_thread_push((software_thread_state*)udata, gs, 0);
+}
 
-        if (ctx->render_queue.empty()) {
-            ctx->queue_mtx.unlock();
+extern "C" void software_thread_render_line(struct ps2_gs* gs, void* udata) {
+    software_thread_push((software_thread_state*)udata, gs, 1);
+}
 
-            break;
-        }
+extern "C" void software_thread_render_triangle(struct ps2_gs* gs, void* udata) {
+    software_thread_push((software_thread_state*)udata, gs, 2);
+}
 
-        ctx->queue_mtx.unlock();
-    }
+extern "C" void software_thread_render_sprite(struct ps2_gs* gs, void* udata) {
+    software_thread_push((software_thread_state*)udata, gs, 3);
+}
 
-    ctx->render_mtx.lock();
+extern "C" void software_thread_render(struct ps2_gs* gs, void* udata) {
+    software_thread_state* ctx = (software_thread_state*)udata;
 
-    transfer_write(gs, ctx);
+    if (ctx->tex_w)
+        software_thread_push_readout(ctx, gs);
 
-    ctx->render_mtx.unlock();
+    render(gs, ctx);
 }
 
-extern "C" void software_thread_transfer_read(struct ps2_gs* gs, void* udata) {
+extern "C" void software_thread_transfer_start(struct ps2_gs* gs, void* udata) {
     software_thread_state* ctx = (software_thread_state*)udata;
 
-    // Block until queue is empty
-    while (true) {
-        ctx->queue_mtx.lock();
+    software_thread_flush(ctx);
+
+    transfer_start(gs, ctx);
+}
 
-        if (ctx->render_queue.empty()) {
-            ctx->queue_mtx.unlock();
+extern "C" void software_thread_transfer_write(struct ps2_gs* gs, void* udata) {
+    software_thread_state* ctx = (software_thread_state*)udata;
 
-            break;
-        }
+    software_thread_flush(ctx);
 
-        ctx->queue_mtx.unlock();
-    }
+    transfer_write(gs, ctx);
+}
 
-    ctx->render_mtx.lock();
+extern "C" void software_thread_transfer_image(struct ps2_gs* gs, const uint64_t* data, int count, void* udata) {
+    software_thread_state* ctx = (software_thread_state*)udata;
 
-    transfer_read(gs, ctx);
+    software_thread_flush(ctx);
 
-    ctx->render_mtx.unlock();
+    transfer_image(gs, data, count, ctx);
 }
+
+extern "C" void software_thread_transfer_read(struct ps2_gs* gs, void* udata) {
+    software_thread_state* ctx = (software_thread_state*)udata;
+
+    software_thread_flush(ctx);
+
+    transfer_read(gs, ctx);
+}
\ No newline at end of file
@@ -5,8 +5,8 @@
 #include <thread>
 #include <chrono>
 #include <atomic>
-#include <queue>
 #include <mutex>
+#include <condition_variable>
 
 #include <SDL.h>
 
@@ -16,19 +16,209 @@
 
 #include "renderer.hpp"
 
-struct render_data {
+// Both sizes have to be powers of 2
+#define SOFTWARE_THREAD_CMD_RING_SIZE 1024
+#define SOFTWARE_THREAD_BLOCK_POOL_SIZE 256
+
+// Multithreaded mode, the drawing area (2048x2048) is split into
+// 32x32 tiles, primitives are binned per tile and tiles are drawn in
+// parallel. Commands are drawn in batches of up to BATCH_SIZE
+#define SOFTWARE_MT_TILE_SHIFT 5
+#define SOFTWARE_MT_TILES_X (2048 >> SOFTWARE_MT_TILE_SHIFT)
+#define SOFTWARE_MT_TILES (SOFTWARE_MT_TILES_X * SOFTWARE_MT_TILES_X)
+#define SOFTWARE_MT_BATCH_SIZE 512
+#define SOFTWARE_MT_MAX_WORKERS 8
+
+// Decoded textures kept per drawing thread, VRAM is tracked in 8 KiB
+// pages for invalidation
+#define SOFTWARE_THREAD_TEXTURE_CACHE_SIZE 8
+#define SOFTWARE_THREAD_VRAM_PAGES 512
+
+struct render_block_tex {
+    uint64_t texa;
+    uint64_t texclut;
+    uint32_t cbw;
+    uint32_t cou;
+    uint32_t cov;
+    int aem;
+    uint32_t ta0;
+    uint32_t ta1;
+};
+
+struct render_block_misc {
+    uint64_t scanmsk;
+    uint64_t fogcol;
+    uint64_t dimx;
+    uint64_t dthe;
+    uint64_t colclamp;
+    uint64_t pabe;
+    int dither[4][4];
+};
+
+struct render_block_clut {
+    uint32_t clut_cache[0x100];
+    uint32_t cbp0;
+    uint32_t cbp1;
+};
+
+// Immutable copy of one GS state block (GS_BLOCK_*), shared by every
+// command drawn with it and returned to the pool once all are done
+struct render_block {
+    std::atomic <int> refs;
+
+    // Unique across pool reuse, tells the render thread when to reload
+    uint64_t id;
+
+    union {
+        struct gs_context context;
+        struct render_block_tex tex;
+        struct render_block_misc misc;
+        struct render_block_clut clut;
+    };
+};
+
+// A single primitive. Drawing state is referenced through blocks, the
+// context block the primitive doesn't use is left null
+struct render_command {
     int prim;
+    uint32_t attr;
+    int iip;
+    int tme;
+    int fge;
+    int abe;
+    int aa1;
+    int fst;
+    int ctxt;
+    int fix;
+    struct gs_vertex vq[3];
+    render_block* blocks[GS_BLOCK_COUNT];
+};
+
+// A texture decoded to RGBA8 in 8x8 texel blocks as they get sampled.
+// Entries are keyed by everything decoding depends on and go stale
+// when one of the pages they were read from gets written
+struct render_texture {
+    bool used;
+    uint64_t last_use;
+
+    uint32_t tbp0, tbw, tbpsm, usize, vsize;
+    uint32_t cbp, cbpsm, csm, cbw, cou, cov;
+    uint32_t ta0, ta1;
+    int aem;
+
+    int bw;
+    std::vector <uint32_t> data;
+    std::vector <uint8_t> decoded;
+    std::vector <uint16_t> pages;
+    std::vector <uint32_t> versions;
+};
+
+// Page versions are shared by every thread, writes to pages no
+// texture was ever read from aren't tracked
+struct render_texture_cache {
+    render_texture entries[SOFTWARE_THREAD_TEXTURE_CACHE_SIZE];
+    uint64_t tick;
+
+    // Pages the current primitive draws to, textures in them are
+    // sampled straight from VRAM
+    uint64_t target[SOFTWARE_THREAD_VRAM_PAGES / 64];
+
+    std::atomic <uint32_t>* page_version;
+    std::atomic <uint8_t>* texture_page;
+};
+
+// Queued in place of a primitive, copies the display buffer into the
+// back output buffer (see render())
+#define SOFTWARE_THREAD_CMD_READOUT 4
+
+struct render_readout {
+    uint32_t* dst;
+    uint32_t* prev;
+    int w, h;
+    int fmt;
+    uint32_t dfbp, dfbw;
+
+    // Field mode, the display buffer only holds every other line
+    bool field;
+    int odd;
+    int deinterlace;
+};
+
+// Tile worker, worker 0 is the render thread itself
+struct render_worker {
+    std::thread thr;
+
+    // Drawing state, the context is a copy clipped to the current tile
     struct ps2_gs gs;
+    struct gs_context context;
+    uint64_t work_id[GS_BLOCK_COUNT];
+    uint64_t context_id;
+    int tile;
+    render_texture_cache cache;
 };
 
 struct software_thread_state {
-    std::queue <render_data> render_queue;
     std::thread render_thr;
-    std::mutex queue_mtx;
-    std::mutex render_mtx;
 
     std::atomic <bool> end_signal;
 
+    // Either thread only sleeps after setting its waiting flag, the
+    // other one only takes the mutex to notify when it sees the flag
+    std::mutex wait_mtx;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    std::atomic <bool> render_waiting;
+    std::atomic <bool> producer_waiting;
+
+    // Single producer (EE thread), single consumer (render thread).
+    // head only moves once a command is done drawing
+    render_command cmd_ring[SOFTWARE_THREAD_CMD_RING_SIZE];
+    std::atomic <uint32_t> cmd_head;
+    std::atomic <uint32_t> cmd_tail;
+
+    // Block pool. Free blocks are owned by the EE thread, the render
+    // thread hands back the ones it released last through free_ring
+    render_block block_pool[SOFTWARE_THREAD_BLOCK_POOL_SIZE];
+    std::vector <render_block*> free_blocks;
+    render_block* free_ring[SOFTWARE_THREAD_BLOCK_POOL_SIZE];
+    std::atomic <uint32_t> free_head;
+    std::atomic <uint32_t> free_tail;
+    uint64_t block_id = 0;
+
+    // Latest snapshot of every block and the GS versions they were
+    // taken at (EE thread only)
+    render_block* current[GS_BLOCK_COUNT] = { nullptr };
+    uint32_t current_version[GS_BLOCK_COUNT] = { 0 };
+
+    // State the render thread draws with, and the blocks loaded into it
+    struct ps2_gs work;
+    uint64_t work_id[GS_BLOCK_COUNT] = { 0 };
+    render_texture_cache cache;
+
+    // Texture invalidation. Host transfers only mark their area once
+    // per batch of draws (EE thread)
+    std::atomic <uint32_t> page_version[SOFTWARE_THREAD_VRAM_PAGES];
+    std::atomic <uint8_t> texture_page[SOFTWARE_THREAD_VRAM_PAGES];
+    bool transfer_marked = false;
+
+    // Multithreaded mode (render thread only)
+    bool mt = false;
+    std::vector <render_worker*> workers;
+    std::vector <uint32_t> bins[SOFTWARE_MT_TILES];
+    std::vector <int> bin_list;
+    std::atomic <int> next_bin;
+
+    // Every command in a batch draws to the same buffers
+    uint32_t batch_fbp = 0, batch_fbw = 0, batch_fbpsm = 0;
+    uint32_t batch_zbp = 0, batch_zbpsm = 0;
+
+    std::mutex batch_mtx;
+    std::condition_variable batch_cv;
+    std::condition_variable batch_done_cv;
+    uint64_t batch_gen = 0;
+    int batch_busy = 0;
+    bool batch_quit = false;
+
     unsigned int sbp = 0, dbp = 0;
     unsigned int sbw = 0, dbw = 0;
     unsigned int spsm = 0, dpsm = 0;
@@ -76,16 +266,25 @@ struct software_thread_state {
 
     unsigned int frame = 0;
 
+    // Double-buffered output. buf is the frame being shown, the render
+    // thread reads the next one into bufs[back] in the meantime
     uint32_t* buf = nullptr;
+    uint32_t* bufs[2] = { nullptr, nullptr };
+    int back = 0;
+    render_readout readout = {};
+    uint32_t readout_fence = 0;
+    int deinterlace = RENDERER_DEINTERLACE_WEAVE;
 };
 
 void software_thread_init(void* udata, struct ps2_gs* gs, SDL_Window* window);
+void software_mt_init(void* udata, struct ps2_gs* gs, SDL_Window* window);
 void software_thread_destroy(void* udata);
 void software_thread_set_size(void* udata, int width, int height);
 void software_thread_set_scale(void* udata, float scale);
 void software_thread_set_aspect_mode(void* udata, int aspect_mode);
 void software_thread_set_integer_scaling(void* udata, bool integer_scaling);
 void software_thread_set_bilinear(void* udata, bool bilinear);
+void software_thread_set_deinterlace_mode(void* udata, int mode);
 void software_thread_get_viewport_size(void* udata, int* w, int* h);
 void software_thread_get_display_size(void* udata, int* w, int* h);
 void software_thread_get_display_format(void* udata, int* fmt);
@@ -93,6 +292,8 @@ void software_thread_get_interlace_mode(void* udata, int* mode);
 void software_thread_set_window_rect(void* udata, int x, int y, int w, int h);
 void* software_thread_get_buffer_data(void* udata, int* w, int* h, int* bpp);
 const char* software_thread_get_name(void* udata);
+uint32_t software_thread_fence(software_thread_state* ctx);
+void software_thread_wait_fence(software_thread_state* ctx, uint32_t fence);
 // void software_push_shader(software_state* ctx, const char* path);
 // void software_pop_shader(software_state* ctx);
 
@@ -105,4 +306,5 @@ void software_thread_render(struct ps2_gs* gs, void* udata);
 void software_thread_transfer_start(struct ps2_gs* gs, void* udata);
 void software_thread_transfer_write(struct ps2_gs* gs, void* udata);
 void software_thread_transfer_read(struct ps2_gs* gs, void* udata);
+void software_thread_transfer_image(struct ps2_gs* gs, const uint64_t* data, int count, void* udata);
 }
\ No newline at end of file
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// GS VRAM swizzling, shared by every renderer
+//
+// Each format has a table holding the word offset of every pixel
+// within its page (block + column + word), so addressing is a page
+// base plus a single table read. Sub-word positions for 16, 8 and
+// 4-bit formats come from the *_shift tables
+
+inline constexpr int psmct32_block[] = {
+    0 , 1 , 4 , 5 , 16, 17, 20, 21,
+    2 , 3 , 6 , 7 , 18, 19, 22, 23,
+    8 , 9 , 12, 13, 24, 25, 28, 29,
+    10, 11, 14, 15, 26, 27, 30, 31
+};
+
+inline constexpr int psmct32_column[] = {
+    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
+    2 , 3 , 6 , 7 , 10, 11, 14, 15
+};
+
+inline constexpr int psmct16_block[] = {
+    0 , 2 , 8 , 10,
+    1 , 3 , 9 , 11,
+    4 , 6 , 12, 14,
+    5 , 7 , 13, 15,
+    16, 18, 24, 26,
+    17, 19, 25, 27,
+    20, 22, 28, 30,
+    21, 23, 29, 31
+};
+
+inline constexpr int psmct16s_block[] = {
+    0 , 2 , 16, 18,
+    1 , 3 , 17, 19,
+    8 , 10, 24, 26,
+    9 , 11, 25, 27,
+    4 , 6 , 20, 22,
+    5 , 7 , 21, 23,
+    12, 14, 28, 30,
+    13, 15, 29, 31
+};
+
+inline constexpr int psmct16_column[] = {
+    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
+    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
+    2 , 3 , 6 , 7 , 10, 11, 14, 15,
+    2 , 3 , 6 , 7 , 10, 11, 14, 15
+};
+
+inline constexpr int psmct16_shift[] = {
+    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
+    1 , 1 , 1 , 1 , 1 , 1 , 1 , 1 ,
+    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
+    1 , 1 , 1 , 1 , 1 , 1 , 1 , 1
+};
+
+inline constexpr int psmt8_column_02[] = {
+    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
+    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
+    2 , 3 , 6 , 7 , 10, 11, 14, 15,
+    2 , 3 , 6 , 7 , 10, 11, 14, 15,
+    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
+    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
+    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
+    10, 11, 14, 15, 2 , 3 , 6 , 7
+};
+
+inline constexpr int psmt8_column_13[] = {
+    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
+    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
+    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
+    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
+    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
+    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
+    2 , 3 , 6 , 7 , 10, 11, 14, 15,
+    2 , 3 , 6 , 7 , 10, 11, 14, 15
+};
+
+inline constexpr int psmt8_shift[] = {
+    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
+    2 , 2 , 2 , 2 , 2 , 2 , 2 , 2 ,
+    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
+    2 , 2 , 2 , 2 , 2 , 2 , 2 , 2 ,
+    1 , 1 , 1 , 1 , 1 , 1 , 1 , 1 ,
+    3 , 3 , 3 , 3 , 3 , 3 , 3 , 3 ,
+    1 , 1 , 1 , 1 , 1 , 1 , 1 , 1 ,
+    3 , 3 , 3 , 3 , 3 , 3 , 3 , 3
+};
+
+inline constexpr int psmt4_block[] = {
+    0 , 2 , 8 , 10, 1 , 3 , 9 , 11,
+    4 , 6 , 12, 14, 5 , 7 , 13, 15,
+    16, 18, 24, 26, 17, 19, 25, 27,
+    20, 22, 28, 30, 21, 23, 29, 31
+};
+
+inline constexpr int psmt4_column_02[] = {
+    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
+    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
+    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
+    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
+    2 , 3 , 6 , 7 , 10, 11, 14, 15,
+    2 , 3 , 6 , 7 , 10, 11, 14, 15,
+    2 , 3 , 6 , 7 , 10, 11, 14, 15,
+    2 , 3 , 6 , 7 , 10, 11, 14, 15,
+    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
+    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
+    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
+    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
+    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
+    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
+    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
+    10, 11, 14, 15, 2 , 3 , 6 , 7
+};
+
+inline constexpr int psmt4_column_13[] = {
+    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
+    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
+    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
+    8 , 9 , 12, 13, 0 , 1 , 4 , 5 ,
+    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
+    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
+    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
+    10, 11, 14, 15, 2 , 3 , 6 , 7 ,
+    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
+    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
+    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
+    0 , 1 , 4 , 5 , 8 , 9 , 12, 13,
+    2 , 3 , 6 , 7 , 10, 11, 14, 15,
+    2 , 3 , 6 , 7 , 10, 11, 14, 15,
+    2 , 3 , 6 , 7 , 10, 11, 14, 15,
+    2 , 3 , 6 , 7 , 10, 11, 14, 15
+};
+
+inline constexpr int psmt4_shift[] = {
+    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
+    8 , 8 , 8 , 8 , 8 , 8 , 8 , 8 ,
+    16, 16, 16, 16, 16, 16, 16, 16,
+    24, 24, 24, 24, 24, 24, 24, 24,
+    0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,
+    8 , 8 , 8 , 8 , 8 , 8 , 8 , 8 ,
+    16, 16, 16, 16, 16, 16, 16, 16,
+    24, 24, 24, 24, 24, 24, 24, 24,
+    4 , 4 , 4 , 4 , 4 , 4 , 4 , 4 ,
+    12, 12, 12, 12, 12, 12, 12, 12,
+    20, 20, 20, 20, 20, 20, 20, 20,
+    28, 28, 28, 28, 28, 28, 28, 28,
+    4 , 4 , 4 , 4 , 4 , 4 , 4 , 4 ,
+    12, 12, 12, 12, 12, 12, 12, 12,
+    20, 20, 20, 20, 20, 20, 20, 20,
+    28, 28, 28, 28, 28, 28, 28, 28
+};
+
+// Builds a w x h page table from a function returning the word offset
+// of a pixel within its page
+template <int w, int h, typename F>
+static constexpr std::array <uint16_t, w * h> gs_swizzle_table(F f) {
+    std::array <uint16_t, w * h> table {};
+
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            table[x + (y * w)] = f(x, y);
+
+    return table;
+}
+
+// page            block          column
+// 64 x 32 pixels  8 x 8 pixels   8 x 2 pixels
+inline constexpr auto psmct32_table = gs_swizzle_table <64, 32> ([](int x, int y) {
+    int blk = psmct32_block[((x >> 3) & 7) + (((y >> 3) & 3) * 8)];
+    int col = (y >> 1) & 3;
+    int idx = psmct32_column[(x & 7) + ((y & 1) * 8)];
+
+    return (blk * 64) + (col * 16) + idx;
+});
+
+// page            block          column
+// 64 x 64 pixels  16 x 8 pixels  16 x 2 pixels
+inline constexpr auto psmct16_table = gs_swizzle_table <64, 64> ([](int x, int y) {
+    int blk = psmct16_block[((x >> 4) & 3) + (((y >> 3) & 7) * 4)];
+    int col = (y >> 1) & 3;
+    int idx = psmct16_column[(x & 15) + ((y & 1) * 16)];
+
+    return (blk * 64) + (col * 16) + idx;
+});
+
+inline constexpr auto psmct16s_table = gs_swizzle_table <64, 64> ([](int x, int y) {
+    int blk = psmct16s_block[((x >> 4) & 3) + (((y >> 3) & 7) * 4)];
+    int col = (y >> 1) & 3;
+    int idx = psmct16_column[(x & 15) + ((y & 1) * 16)];
+
+    return (blk * 64) + (col * 16) + idx;
+});
+
+// page            block          column
+// 128 x 64 pixels 16 x 16 pixels 16 x 4 pixels
+inline constexpr auto psmt8_table = gs_swizzle_table <128, 64> ([](int x, int y) {
+    int blk = psmct32_block[((x >> 4) & 7) + (((y >> 4) & 3) * 8)];
+    int col = (y >> 2) & 3;
+    int idx = (x & 15) + ((y & 3) * 16);
+
+    idx = (col & 1) ? psmt8_column_13[idx] : psmt8_column_02[idx];
+
+    return (blk * 64) + (col * 16) + idx;
+});
+
+// page             block          column
+// 128 x 128 pixels 32 x 16 pixels 32 x 4 pixels
+inline constexpr auto psmt4_table = gs_swizzle_table <128, 128> ([](int x, int y) {
+    int blk = psmt4_block[((x >> 5) & 3) + (((y >> 4) & 7) * 4)];
+    int col = (y >> 2) & 3;
+    int idx = (x & 31) + ((y & 3) * 32);
+
+    idx = (col & 1) ? psmt4_column_13[idx] : psmt4_column_02[idx];
+
+    return (blk * 64) + (col * 16) + idx;
+});
+
+// base is expressed in blocks (64 words), width in pages. Every page
+// is 8 KiB (2048 words)
+static inline int psmct32_addr(int base, int width, int x, int y) {
+    int page = (x >> 6) + ((y >> 5) * width);
+
+    return (page * 2048) + (base * 64) + psmct32_table[(x & 63) + ((y & 31) * 64)];
+}
+
+static inline int psmct16_addr(int base, int width, int x, int y) {
+    int page = (x >> 6) + ((y >> 6) * width);
+
+    return (page * 2048) + (base * 64) + psmct16_table[(x & 63) + ((y & 63) * 64)];
+}
+
+static inline int psmct16s_addr(int base, int width, int x, int y) {
+    int page = (x >> 6) + ((y >> 6) * width);
+
+    return (page * 2048) + (base * 64) + psmct16s_table[(x & 63) + ((y & 63) * 64)];
+}
+
+static inline int psmt8_addr(int base, int width, int x, int y) {
+    int page = (x >> 7) + ((y >> 6) * (width >> 1));
+
+    return (page * 2048) + (base * 64) + psmt8_table[(x & 127) + ((y & 63) * 128)];
+}
+
+static inline int psmt4_addr(int base, int width, int x, int y) {
+    int page = (x >> 7) + ((y >> 7) * (width >> 1));
+
+    return (page * 2048) + (base * 64) + psmt4_table[(x & 127) + ((y & 127) * 128)];
+}
@@ -31,6 +31,12 @@ void iop_bus_init_fastmem(struct iop_bus* bus) {
     }
 }
 
+void* iop_bus_get_page(void* udata, uint32_t addr) {
+    struct iop_bus* bus = (struct iop_bus*)udata;
+
+    return bus->fastmem_r_table[(addr & 0x1fffffff) >> 13];
+}
+
 void iop_bus_init_bios(struct iop_bus* bus, struct ps2_bios* bios) {
     bus->bios = bios;
 }
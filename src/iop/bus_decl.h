@@ -15,5 +15,6 @@ uint32_t iop_bus_read32(void* udata, uint32_t addr);
 void iop_bus_write8(void* udata, uint32_t addr, uint32_t data);
 void iop_bus_write16(void* udata, uint32_t addr, uint32_t data);
 void iop_bus_write32(void* udata, uint32_t addr, uint32_t data);
+void* iop_bus_get_page(void* udata, uint32_t addr);
 
 #endif
\ No newline at end of file
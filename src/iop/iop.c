@@ -146,6 +146,8 @@ void iop_init(struct iop_state* iop, struct iop_bus_s bus) {
 
     iop->cop0_r[COP0_SR] = 0x10900000;
     iop->cop0_r[COP0_PRID] = 0x0000001f;
+
+    idle_loop_reset(&iop->idle);
 }
 
 void iop_init_kputchar(struct iop_state* iop, void (*kputchar)(void*, char), void* udata) {
@@ -193,7 +195,7 @@ static inline void iop_exception(struct iop_state* iop, uint32_t cause) {
     iop->next_pc = iop->pc + 4;
 }
 
-void iop_cycle(struct iop_state* iop) {
+static inline void iop_cycle_begin(struct iop_state* iop) {
     iop->last_cycles = 0;
 
     iop->saved_pc = iop->pc;
@@ -203,8 +205,10 @@ void iop_cycle(struct iop_state* iop) {
 
     if (iop->saved_pc & 3)
         iop_exception(iop, CAUSE_ADEL);
+}
 
-    iop->opcode = iop_bus_read32(iop, iop->pc);
+// Runs the fetched opcode
+static inline void iop_cycle_end(struct iop_state* iop) {
     iop->last_cycles = 0;
 
     if (iop->p) {
@@ -240,6 +244,69 @@ void iop_cycle(struct iop_state* iop) {
     iop->r[0] = 0;
 }
 
+void iop_cycle(struct iop_state* iop) {
+    iop_cycle_begin(iop);
+
+    iop->opcode = iop_bus_read32(iop, iop->pc);
+
+    iop_cycle_end(iop);
+}
+
+static uint32_t iop_idle_read(void* udata, uint32_t addr) {
+    return iop_bus_read32((struct iop_state*)udata, addr);
+}
+
+// Checks the loop the IOP just jumped back into, saved_pc holds the
+// delay slot of the backward branch
+static inline int iop_check_idle_loop(struct iop_state* iop) {
+    if ((iop->pc > iop->saved_pc) || ((iop->saved_pc - iop->pc) >= (IDLE_LOOP_MAX_LENGTH << 2)))
+        return 0;
+
+    if (iop->cop0_r[COP0_CAUSE] & iop->cop0_r[COP0_SR] & 0x00000400)
+        return 0;
+
+    return idle_loop_check(&iop->idle, iop->pc, iop->saved_pc, 0, iop_idle_read, iop);
+}
+
+// Runs up to count instructions, returns the number of them that
+// were skipped because the IOP was spinning in an idle loop
+int iop_run(struct iop_state* iop, int count) {
+    // Fetches go straight to the page holding the last fetched
+    // instruction, the pointer is only kept for this batch since
+    // the bus can remap pages in between (i.e. BIOS loads)
+    uint32_t page_tag = 0xffffffff;
+    uint8_t* page = NULL;
+
+    while (count--) {
+        iop_cycle_begin(iop);
+
+        uint32_t addr = iop_translate_addr(iop->pc);
+
+        if ((addr >> 13) != page_tag) {
+            page_tag = addr >> 13;
+            page = iop->bus.get_page ? iop->bus.get_page(iop->bus.udata, addr) : NULL;
+        }
+
+        if (page) {
+            iop->opcode = *(uint32_t*)(page + (addr & 0x1fff));
+        } else {
+            iop->opcode = iop_bus_read32(iop, iop->pc);
+        }
+
+        iop_cycle_end(iop);
+
+        // Nothing can change until the next event, skip the rest
+        // of the batch
+        if (count && iop_check_idle_loop(iop)) {
+            iop->total_cycles += count;
+
+            return count;
+        }
+    }
+
+    return 0;
+}
+
 void iop_reset(struct iop_state* iop) {
     for (int i = 0; i < 32; i++)
         iop->r[i] = 0;
@@ -264,6 +331,8 @@ void iop_reset(struct iop_state* iop) {
     iop->branch = 0;
     iop->delay_slot = 0;
     iop->branch_taken = 0;
+
+    idle_loop_reset(&iop->idle);
 }
 
 void iop_set_irq_pending(struct iop_state* iop) {
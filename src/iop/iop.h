@@ -8,6 +8,8 @@ extern "C" {
 #include <stdint.h>
 #include <stdio.h>
 
+#include "shared/idle.h"
+
 #define COP0_BPC      3
 #define COP0_BDA      5
 #define COP0_JUMPDEST 6
@@ -46,6 +48,10 @@ struct iop_bus_s {
     void (*write8)(void* udata, uint32_t addr, uint32_t data);
     void (*write16)(void* udata, uint32_t addr, uint32_t data);
     void (*write32)(void* udata, uint32_t addr, uint32_t data);
+
+    // Optional, returns a host pointer to the 8 KiB page holding
+    // addr or NULL if it isn't backed by plain memory
+    void* (*get_page)(void* udata, uint32_t addr);
 };
 
 struct iop_state {
@@ -73,6 +79,8 @@ struct iop_state {
     /* cache module list */
     int module_count;
     struct iop_module *module_list;
+
+    struct idle_loop idle;
 };
 
 /*
@@ -148,6 +156,7 @@ void iop_init(struct iop_state* iop, struct iop_bus_s bus);
 void iop_init_kputchar(struct iop_state* iop, void (*kputchar)(void*, char), void* udata);
 void iop_destroy(struct iop_state* iop);
 void iop_cycle(struct iop_state* iop);
+int iop_run(struct iop_state* iop, int count);
 void iop_reset(struct iop_state* iop);
 void iop_set_irq_pending(struct iop_state* iop);
 void iop_fetch(struct iop_state* iop);
@@ -10,11 +10,26 @@ struct ps2_iop_timers* ps2_iop_timers_create(void) {
     return malloc(sizeof(struct ps2_iop_timers));
 }
 
+// The IOP runs one instruction every 7 EE cycles, 4 scheduler
+// cycles each
+#define IOP_TIMER_TICK (7 * 4)
+
+void iop_timer_handle_event(void* udata, int overshoot);
+static void iop_timer_schedule(struct iop_timer* t);
+
 void ps2_iop_timers_init(struct ps2_iop_timers* timers, struct ps2_iop_intc* intc, struct sched_state* sched) {
     memset(timers, 0, sizeof(struct ps2_iop_timers));
 
     timers->intc = intc;
     timers->sched = sched;
+
+    for (int i = 0; i < 6; i++) {
+        timers->timer[i].last = sched->now;
+        timers->timer[i].id = i;
+        timers->timer[i].timers = timers;
+
+        iop_timer_schedule(&timers->timer[i]);
+    }
 }
 
 void ps2_iop_timers_destroy(struct ps2_iop_timers* timers) {
@@ -34,99 +49,154 @@ static inline uint32_t timer_get_irq_mask(int t) {
     return 0;
 }
 
-void iop_timer_tick(struct ps2_iop_timers* timers, int i) {
-    struct iop_timer* t = &timers->timer[i];
+// Scheduler cycles per counter tick
+static inline uint64_t iop_timer_div(struct iop_timer* t) {
+    // To-do: Breaks Crazy Taxi (USA)
+    if ((t->id == 1) && t->use_ext)
+        return IOP_TIMER_TICK * 91;
 
-    uint32_t prev = t->counter;
+    return IOP_TIMER_TICK;
+}
 
-    // To-do: Breaks Crazy Taxi (USA)
-    if (i == 1) {
-        if (t->use_ext) {
-            if (t->internal != 90) {
-                ++t->internal;
-            } else {
-                ++t->counter;
-                t->internal = 0;
-            }
-        } else {
-            ++t->counter;
-        }
+// Counter increment per tick
+static inline int64_t iop_timer_inc(struct iop_timer* t) {
+    return (t->id == 1) ? 1 : 9;
+}
+
+static inline int64_t iop_timer_ovf(struct iop_timer* t) {
+    return (t->id < 3) ? 0xffff : 0xffffffff;
+}
+
+static inline void iop_timer_irq(struct iop_timer* t) {
+    ps2_iop_intc_irq(t->timers->intc, timer_get_irq_mask(t->id));
+
+    if (!t->rep_irq) {
+        t->irq_en = 0;
     } else {
-        t->counter += 9;
+        if (t->levl) {
+            t->irq_en = !t->irq_en;
+        }
     }
+}
 
-    if (t->counter >= t->target && prev < t->target) {
-        // printf("iop: Timer 5 reached target %08x <= %08x\n", t->counter, t->target);
+// Ticks until the counter reaches the target or overflows
+static inline uint64_t iop_timer_ticks_until_event(struct iop_timer* t) {
+    int64_t inc = iop_timer_inc(t);
+    int64_t n = (iop_timer_ovf(t) + 1 - t->counter + inc - 1) / inc;
 
-        t->cmp_irq_set = 1;
+    if (t->counter < t->target) {
+        int64_t cmp = ((int64_t)t->target - t->counter + inc - 1) / inc;
 
-        if (t->cmp_irq && t->irq_en) {
-            // printf(" timer %d irq\n", i);
+        if (cmp < n)
+            n = cmp;
+    }
 
-            ps2_iop_intc_irq(timers->intc, timer_get_irq_mask(i));
+    return (n > 0) ? n : 0;
+}
 
-            if (!t->rep_irq) {
-                t->irq_en = 0;
-            } else {
-                if (t->levl) {
-                    t->irq_en = !t->irq_en;
-                }
-            }
+// Moves the counter forward, handling every compare and overflow
+// condition passed on the way
+static void iop_timer_advance(struct iop_timer* t, uint64_t ticks) {
+    int64_t inc = iop_timer_inc(t);
+    int64_t ovf = iop_timer_ovf(t);
 
-            if (t->irq_reset) {
-                t->counter = 0;
-            }
+    while (ticks) {
+        uint64_t n = iop_timer_ticks_until_event(t);
 
-            // printf("iop: Timer %d compare IRQ cnt=%d tgt=%d rep=%d levl=%d irq_en=%d irq_reset=%d\n", i,
-            //     t->counter,
-            //     t->target,
-            //     t->rep_irq,
-            //     t->levl,
-            //     t->irq_en,
-            //     t->irq_reset
-            // );
+        if (ticks < n) {
+            t->counter += ticks * inc;
+
+            return;
         }
-    }
 
-    uint64_t ovf = (i < 3) ? 0xffff : 0xffffffff;
+        ticks -= n;
 
-    if (t->counter > ovf) {
-        t->ovf_irq_set = 1;
+        int64_t prev = t->counter;
 
-        if (t->ovf_irq && t->irq_en) {
-            // printf("iop: Timer %d overflow IRQ rep=%d levl=%d irq_en=%d irq_reset=%d\n", i,
-            //     t->rep_irq,
-            //     t->levl,
-            //     t->irq_en,
-            //     t->irq_reset
-            // );
+        t->counter += n * inc;
 
-            ps2_iop_intc_irq(timers->intc, timer_get_irq_mask(i));
+        if (t->counter >= t->target && prev < t->target) {
+            // printf("iop: Timer 5 reached target %08x <= %08x\n", t->counter, t->target);
 
-            if (!t->rep_irq) {
-                t->irq_en = 0;
-            } else {
-                if (t->levl) {
-                    t->irq_en = !t->irq_en;
+            t->cmp_irq_set = 1;
+
+            if (t->cmp_irq && t->irq_en) {
+                // printf(" timer %d irq\n", i);
+
+                iop_timer_irq(t);
+
+                if (t->irq_reset) {
+                    t->counter = 0;
                 }
             }
+        }
 
-            if (t->irq_reset) {
-                t->counter = 0;
+        if (t->counter > ovf) {
+            t->ovf_irq_set = 1;
+            t->counter -= ovf + 1;
+
+            if (t->ovf_irq && t->irq_en) {
+                // printf("iop: Timer %d overflow IRQ rep=%d levl=%d irq_en=%d irq_reset=%d\n", i,
+                //     t->rep_irq,
+                //     t->levl,
+                //     t->irq_en,
+                //     t->irq_reset
+                // );
+
+                iop_timer_irq(t);
+
+                if (t->irq_reset) {
+                    t->counter = 0;
+                }
             }
         }
-
-        t->counter -= ovf;
     }
 }
 
-void ps2_iop_timers_tick(struct ps2_iop_timers* timers) {
-    for (int i = 0; i < 6; i++) {
-        iop_timer_tick(timers, i);
-    }
+// Catches the counter up with the scheduler
+static void iop_timer_sync(struct iop_timer* t) {
+    uint64_t div = iop_timer_div(t);
+    uint64_t ticks = (t->timers->sched->now - t->last) / div;
+
+    if (!ticks)
+        return;
+
+    t->last += ticks * div;
+
+    iop_timer_advance(t, ticks);
+}
+
+// Schedules an event for the next compare or overflow, has to
+// be called right after syncing
+static void iop_timer_schedule(struct iop_timer* t) {
+    struct sched_state* sched = t->timers->sched;
+
+    uint64_t ticks = iop_timer_ticks_until_event(t);
+    long cycles = (long)(t->last + (ticks * iop_timer_div(t)) - sched->now);
+
+    if (sched_reschedule(sched, t->event, cycles))
+        return;
+
+    struct sched_event event;
+
+    event.callback = iop_timer_handle_event;
+    event.cycles = cycles;
+    event.name = "IOP timer event";
+    event.udata = t;
+
+    t->event = sched_schedule(sched, event);
+}
+
+void iop_timer_handle_event(void* udata, int overshoot) {
+    struct iop_timer* t = (struct iop_timer*)udata;
+
+    iop_timer_sync(t);
+    iop_timer_schedule(t);
 }
 
 uint32_t iop_timer_handle_mode_read(struct ps2_iop_timers* timers, int i) {
+    iop_timer_sync(&timers->timer[i]);
+
     uint32_t r = timers->timer[i].mode;
 
     timers->timer[i].cmp_irq_set = 0;
@@ -139,14 +209,23 @@ uint32_t iop_timer_handle_mode_read(struct ps2_iop_timers* timers, int i) {
     return r;
 }
 
+static inline uint32_t iop_timer_handle_counter_read(struct ps2_iop_timers* timers, int i) {
+    iop_timer_sync(&timers->timer[i]);
+
+    if (timers->idle)
+        timers->idle->polled = 1;
+
+    return timers->timer[i].counter;
+}
+
 uint64_t ps2_iop_timers_read32(struct ps2_iop_timers* timers, uint32_t addr) {
     switch (addr & 0xfff) {
-        case 0x100: return timers->timer[0].counter;
-        case 0x110: return timers->timer[1].counter;
-        case 0x120: return timers->timer[2].counter;
-        case 0x480: return timers->timer[3].counter;
-        case 0x490: return timers->timer[4].counter;
-        case 0x4a0: return timers->timer[5].counter;
+        case 0x100: return iop_timer_handle_counter_read(timers, 0);
+        case 0x110: return iop_timer_handle_counter_read(timers, 1);
+        case 0x120: return iop_timer_handle_counter_read(timers, 2);
+        case 0x480: return iop_timer_handle_counter_read(timers, 3);
+        case 0x490: return iop_timer_handle_counter_read(timers, 4);
+        case 0x4a0: return iop_timer_handle_counter_read(timers, 5);
         case 0x108: return timers->timer[0].target;
         case 0x118: return timers->timer[1].target;
         case 0x128: return timers->timer[2].target;
@@ -167,6 +246,8 @@ uint64_t ps2_iop_timers_read32(struct ps2_iop_timers* timers, uint32_t addr) {
 void iop_timer_handle_mode_write(struct ps2_iop_timers* timers, int t, uint64_t data) {
     struct iop_timer* timer = &timers->timer[t];
 
+    iop_timer_sync(timer);
+
     timer->counter = 0;
     timer->mode |= 0x400;
     timer->mode &= 0x1c00;
@@ -193,32 +274,49 @@ void iop_timer_handle_mode_write(struct ps2_iop_timers* timers, int t, uint64_t
         timers->timer[t].t4_prescaler
     );
 
-    /* To-do: Schedule timer interrupts for better performance */
+    // Mode writes restart the counter
+    timer->last = timers->sched->now;
+
+    iop_timer_schedule(timer);
 }
 
 void iop_timer_handle_target_write(struct ps2_iop_timers* timers, int t, uint64_t data) {
     struct iop_timer* timer = &timers->timer[t];
 
+    iop_timer_sync(timer);
+
     timer->target = data;
 
     if (!timer->levl) {
         timer->irq_en = 1;
     }
 
+    iop_timer_schedule(timer);
+
     if (t != 5)
         return;
 
     // printf("iop: Timer %d target write %08x levl=%d mode=%08x counter=%08x\n", t, data, timer->levl, timer->mode, timer->counter);
 }
 
+void iop_timer_handle_counter_write(struct ps2_iop_timers* timers, int t, uint64_t data) {
+    struct iop_timer* timer = &timers->timer[t];
+
+    iop_timer_sync(timer);
+
+    timer->counter = data;
+
+    iop_timer_schedule(timer);
+}
+
 void ps2_iop_timers_write32(struct ps2_iop_timers* timers, uint32_t addr, uint64_t data) {
     switch (addr & 0xfff) {
-        case 0x100: /* printf("iop: Timer 0 counter write %08x prev=%08x\n", data, timers->timer[0].counter); */ timers->timer[0].counter = data; break;
-        case 0x110: /* printf("iop: Timer 1 counter write %08x prev=%08x\n", data, timers->timer[1].counter); */ timers->timer[1].counter = data; break;
-        case 0x120: /* printf("iop: Timer 2 counter write %08x prev=%08x\n", data, timers->timer[2].counter); */ timers->timer[2].counter = data; break;
-        case 0x480: /* printf("iop: Timer 3 counter write %08x prev=%08x\n", data, timers->timer[3].counter); */ timers->timer[3].counter = data; break;
-        case 0x490: /* printf("iop: Timer 4 counter write %08x prev=%08x\n", data, timers->timer[4].counter); */ timers->timer[4].counter = data; break;
-        case 0x4a0: /* printf("iop: Timer 5 counter write %08x prev=%08x\n", data, timers->timer[5].counter); */ timers->timer[5].counter = data; break;
+        case 0x100: /* printf("iop: Timer 0 counter write %08x prev=%08x\n", data, timers->timer[0].counter); */ iop_timer_handle_counter_write(timers, 0, data); break;
+        case 0x110: /* printf("iop: Timer 1 counter write %08x prev=%08x\n", data, timers->timer[1].counter); */ iop_timer_handle_counter_write(timers, 1, data); break;
+        case 0x120: /* printf("iop: Timer 2 counter write %08x prev=%08x\n", data, timers->timer[2].counter); */ iop_timer_handle_counter_write(timers, 2, data); break;
+        case 0x480: /* printf("iop: Timer 3 counter write %08x prev=%08x\n", data, timers->timer[3].counter); */ iop_timer_handle_counter_write(timers, 3, data); break;
+        case 0x490: /* printf("iop: Timer 4 counter write %08x prev=%08x\n", data, timers->timer[4].counter); */ iop_timer_handle_counter_write(timers, 4, data); break;
+        case 0x4a0: /* printf("iop: Timer 5 counter write %08x prev=%08x\n", data, timers->timer[5].counter); */ iop_timer_handle_counter_write(timers, 5, data); break;
         case 0x108: iop_timer_handle_target_write(timers, 0, data); break;
         case 0x118: iop_timer_handle_target_write(timers, 1, data); break;
         case 0x128: iop_timer_handle_target_write(timers, 2, data); break;
@@ -7,6 +7,11 @@ extern "C" {
 
 #include <stdint.h>
 
+#include "sched.h"
+#include "shared/idle.h"
+
+struct ps2_iop_timers;
+
 struct iop_timer {
     int64_t counter;
 
@@ -33,7 +38,14 @@ struct iop_timer {
     };
 
     uint32_t target;
-    int64_t internal;
+
+    // Counters are computed from the scheduler time when accessed,
+    // last is the time of the last update aligned to a counter tick
+    uint64_t last;
+    sched_handle event;
+
+    int id;
+    struct ps2_iop_timers* timers;
 };
 
 struct ps2_iop_timers {
@@ -41,12 +53,14 @@ struct ps2_iop_timers {
 
     struct ps2_iop_intc* intc;
     struct sched_state* sched;
+
+    // Counter reads keep the IOP from skipping idle loops
+    struct idle_loop* idle;
 };
 
 struct ps2_iop_timers* ps2_iop_timers_create(void);
 void ps2_iop_timers_init(struct ps2_iop_timers* timers, struct ps2_iop_intc* intc, struct sched_state* sched);
 void ps2_iop_timers_destroy(struct ps2_iop_timers* timers);
-void ps2_iop_timers_tick(struct ps2_iop_timers* timers);
 uint64_t ps2_iop_timers_read32(struct ps2_iop_timers* timers, uint32_t addr);
 void ps2_iop_timers_write32(struct ps2_iop_timers* timers, uint32_t addr, uint64_t data);
 
@@ -5,6 +5,15 @@
 
 #include "ps2.h"
 
+static void ps2_ee_code_write(void* udata, uint32_t addr) {
+    struct ps2_state* ps2 = (struct ps2_state*)udata;
+
+    ee_invalidate_code(ps2->ee, addr);
+
+    if (ps2->ee_jit)
+        ee_jit_invalidate(ps2->ee_jit, addr);
+}
+
 struct ps2_state* ps2_create(void) {
     return malloc(sizeof(struct ps2_state));
 }
@@ -47,6 +56,7 @@ void ps2_init(struct ps2_state* ps2) {
 
     // Initialize EE
     ee_bus_init(ps2->ee_bus, NULL);
+    ee_bus_init_code_write(ps2->ee_bus, ps2_ee_code_write, ps2);
 
     struct ee_bus_s ee_bus_data;
     ee_bus_data.read8 = ee_bus_read8;
@@ -59,6 +69,7 @@ void ps2_init(struct ps2_state* ps2) {
     ee_bus_data.write32 = ee_bus_write32;
     ee_bus_data.write64 = ee_bus_write64;
     ee_bus_data.write128 = ee_bus_write128;
+    ee_bus_data.protect_code = ee_bus_protect_code_page;
     ee_bus_data.udata = ps2->ee_bus;
 
     ee_init(ps2->ee, ps2->vu0, ps2->vu1, ee_bus_data);
@@ -75,24 +86,31 @@ void ps2_init(struct ps2_state* ps2) {
     iop_bus_data.write8 = iop_bus_write8;
     iop_bus_data.write16 = iop_bus_write16;
     iop_bus_data.write32 = iop_bus_write32;
+    iop_bus_data.get_page = iop_bus_get_page;
     iop_bus_data.udata = ps2->iop_bus;
 
     iop_init(ps2->iop, iop_bus_data);
 
     // Initialize devices
-    ps2_dmac_init(ps2->ee_dma, ps2->sif, ps2->iop_dma, ps2->ee->scratchpad, ps2->ee, ps2->ee_bus);
+    ps2_dmac_init(ps2->ee_dma, ps2->sif, ps2->iop_dma, ps2->ee->scratchpad, ps2->ee, ps2->sched, ps2->ee_bus);
     ps2_ram_init(ps2->ee_ram, RAM_SIZE_32MB);
     ps2_gif_init(ps2->gif, ps2->vu1, ps2->gs);
-    ps2_vif_init(ps2->vif, ps2->vu0, ps2->vu1, ps2->ee_intc, ps2->sched, ps2->ee_bus);
+    ps2_vif_init(ps2->vif, ps2->vu0, ps2->vu1, ps2->ee_intc, ps2->sched, &ps2->ee->idle, ps2->ee_bus);
     ps2_gs_init(ps2->gs, ps2->ee_intc, ps2->iop_intc, ps2->ee_timers, ps2->iop_timers, ps2->sched);
     ps2_ipu_init(ps2->ipu, ps2->ee_dma, ps2->ee_intc);
     ps2_intc_init(ps2->ee_intc, ps2->ee, ps2->sched);
     ps2_ee_timers_init(ps2->ee_timers, ps2->ee_intc, ps2->sched);
+
+    ps2->ee_timers->idle = &ps2->ee->idle;
+
     ps2_ram_init(ps2->iop_ram, RAM_SIZE_2MB);
     ps2_iop_dma_init(ps2->iop_dma, ps2->iop_intc, ps2->sif, ps2->cdvd, ps2->ee_dma, ps2->sio2, ps2->spu2, ps2->sched, ps2->iop_bus);
     ps2_ram_init(ps2->iop_spr, RAM_SIZE_1KB);
     ps2_iop_intc_init(ps2->iop_intc, ps2->iop);
     ps2_iop_timers_init(ps2->iop_timers, ps2->iop_intc, ps2->sched);
+
+    ps2->iop_timers->idle = &ps2->iop->idle;
+
     ps2_cdvd_init(ps2->cdvd, ps2->iop_dma, ps2->iop_intc, ps2->sched);
     ps2_sio2_init(ps2->sio2, ps2->iop_dma, ps2->iop_intc, ps2->sched);
     ps2_spu2_init(ps2->spu2, ps2->iop_dma, ps2->iop_intc, ps2->sched);
@@ -140,6 +158,7 @@ void ps2_init(struct ps2_state* ps2) {
     ee_bus_init_ram(ps2->ee_bus, ps2->ee_ram);
 
     ps2->ee_cycles = 7;
+    ps2->iop_batch = PS2_IOP_BATCH;
 }
 
 void ps2_init_kputchar(struct ps2_state* ps2, void (*ee_kputchar)(void*, char), void* ee_udata, void (*iop_kputchar)(void*, char), void* iop_udata) {
@@ -172,6 +191,8 @@ void ps2_load_bios(struct ps2_state* ps2, const char* path) {
 
     ee_bus_init_fastmem(ps2->ee_bus);
     iop_bus_init_fastmem(ps2->iop_bus);
+
+    ps2_flush_ee_code(ps2);
 }
 
 void ps2_load_rom1(struct ps2_state* ps2, const char* path) {
@@ -182,20 +203,144 @@ void ps2_load_rom2(struct ps2_state* ps2, const char* path) {
     ps2_bios_load(ps2->rom2, path);
 }
 
+void ps2_flush_ee_code(struct ps2_state* ps2) {
+    ee_flush_code(ps2->ee);
+
+    if (ps2->ee_jit)
+        ee_jit_flush(ps2->ee_jit);
+
+    ee_bus_unprotect_code_pages(ps2->ee_bus);
+}
+
+void ps2_set_ee_jit(struct ps2_state* ps2, int enabled) {
+    if (!enabled) {
+        if (ps2->ee_jit)
+            ee_jit_destroy(ps2->ee_jit);
+
+        ps2->ee_jit = NULL;
+
+        return;
+    }
+
+    if (ps2->ee_jit)
+        return;
+
+    ps2->ee_jit = ee_jit_create();
+
+    if (ee_jit_init(ps2->ee_jit, ps2->ee, ps2->ee_bus)) {
+        printf("ps2: EE recompiler not available on this host, using the interpreter\n");
+
+        ee_jit_destroy(ps2->ee_jit);
+
+        ps2->ee_jit = NULL;
+    }
+}
+
+void ps2_set_vu1_thread(struct ps2_state* ps2, int enabled) {
+    if (!enabled) {
+        if (ps2->vu1_thread)
+            vu_thread_destroy(ps2->vu1_thread);
+
+        ps2->vu1_thread = NULL;
+        ps2->vu1->thread = NULL;
+
+        return;
+    }
+
+    if (ps2->vu1_thread)
+        return;
+
+    ps2->vu1_thread = vu_thread_create();
+
+    if (vu_thread_init(ps2->vu1_thread, ps2->vu1, ps2->gif)) {
+        printf("ps2: Couldn't create VU1 thread, running VU1 synchronously\n");
+
+        vu_thread_destroy(ps2->vu1_thread);
+
+        ps2->vu1_thread = NULL;
+
+        return;
+    }
+
+    ps2->vu1->thread = ps2->vu1_thread;
+}
+
+void ps2_set_vu1_jit(struct ps2_state* ps2, int enabled) {
+    // The worker might be running recompiled code
+    if (ps2->vu1_thread)
+        vu_thread_wait(ps2->vu1_thread);
+
+    if (!enabled) {
+        if (ps2->vu1_jit)
+            vu_jit_destroy(ps2->vu1_jit);
+
+        ps2->vu1_jit = NULL;
+        ps2->vu1->jit = NULL;
+
+        return;
+    }
+
+    if (ps2->vu1_jit)
+        return;
+
+    ps2->vu1_jit = vu_jit_create();
+
+    if (vu_jit_init(ps2->vu1_jit, ps2->vu1)) {
+        printf("ps2: VU recompiler not available on this host, using the interpreter\n");
+
+        vu_jit_destroy(ps2->vu1_jit);
+
+        ps2->vu1_jit = NULL;
+
+        return;
+    }
+
+    ps2->vu1->jit = ps2->vu1_jit;
+}
+
+void ps2_set_dma_timed(struct ps2_state* ps2, int enabled) {
+    ps2->dma_timed = enabled;
+
+    ps2_dmac_set_timed(ps2->ee_dma, enabled);
+}
+
 void ps2_reset(struct ps2_state* ps2) {
+    // Let the running microprogram finish before VU1 gets cleared
+    if (ps2->vu1_thread)
+        vu_thread_wait(ps2->vu1_thread);
+
     ee_reset(ps2->ee);
     iop_reset(ps2->iop);
     vu_init(ps2->vu0, 0, ps2->gif, ps2->vif, ps2->vu1);
     vu_init(ps2->vu1, 1, ps2->gif, ps2->vif, ps2->vu1);
 
-    ps2_dmac_init(ps2->ee_dma, ps2->sif, ps2->iop_dma, ps2->ee->scratchpad, ps2->ee, ps2->ee_bus);
+    ps2->vu1->thread = ps2->vu1_thread;
+    ps2->vu1->jit = ps2->vu1_jit;
+
+    // The translations its blocks belong to are gone
+    if (ps2->vu1_jit)
+        vu_jit_flush(ps2->vu1_jit);
+
+    // Timed DMA slices still in flight belong to the old state
+    sched_cancel(ps2->sched, ps2->ee_dma->vif1.event);
+    sched_cancel(ps2->sched, ps2->ee_dma->gif.event);
+
+    ps2_dmac_init(ps2->ee_dma, ps2->sif, ps2->iop_dma, ps2->ee->scratchpad, ps2->ee, ps2->sched, ps2->ee_bus);
+
+    ps2->ee_dma->timed = ps2->dma_timed;
     ps2_gif_init(ps2->gif, ps2->vu1, ps2->gs);
-    ps2_vif_init(ps2->vif, ps2->vu0, ps2->vu1, ps2->ee_intc, ps2->sched, ps2->ee_bus);
+    ps2_vif_init(ps2->vif, ps2->vu0, ps2->vu1, ps2->ee_intc, ps2->sched, &ps2->ee->idle, ps2->ee_bus);
     ps2_intc_init(ps2->ee_intc, ps2->ee, ps2->sched);
     ps2_ee_timers_init(ps2->ee_timers, ps2->ee_intc, ps2->sched);
+
+    ps2->ee_timers->idle = &ps2->ee->idle;
+
     ps2_iop_dma_init(ps2->iop_dma, ps2->iop_intc, ps2->sif, ps2->cdvd, ps2->ee_dma, ps2->sio2, ps2->spu2, ps2->sched, ps2->iop_bus);
     ps2_iop_intc_init(ps2->iop_intc, ps2->iop);
     ps2_iop_timers_init(ps2->iop_timers, ps2->iop_intc, ps2->sched);
+
+    ps2->iop_timers->idle = &ps2->iop->idle;
+
     ps2_spu2_init(ps2->spu2, ps2->iop_dma, ps2->iop_intc, ps2->sched);
     ps2_usb_init(ps2->usb);
     ps2_fw_init(ps2->fw, ps2->iop_intc);
@@ -205,6 +350,13 @@ void ps2_reset(struct ps2_state* ps2) {
     ps2_ram_reset(ps2->ee_ram);
     ps2_ram_reset(ps2->iop_ram);
     ps2_ram_reset(ps2->ee->scratchpad);
+
+    ps2_flush_ee_code(ps2);
+
+    ps2->iop_pending = 0;
+    ps2->idle = 0;
+
+    ps2_set_vu1_jit(ps2, 1);
 }
 
 // To-do: This will soon be useless, need to integrate
@@ -231,56 +383,184 @@ static inline void ps2_trace(struct ps2_state* ps2) {
         if (depth > 0) --depth;
 }
 
+// Runs the IOP instructions owed to the EE in one go
+static inline void ps2_iop_sync(struct ps2_state* ps2) {
+    if (!ps2->iop_pending)
+        return;
+
+    ps2->iop_idle_cycles += iop_run(ps2->iop, ps2->iop_pending);
+
+    ps2->iop_pending = 0;
+}
+
+// Batches never run past a scheduler deadline, the IOP is
+// caught up right before the next event fires
+static inline void ps2_iop_sync_deadline(struct ps2_state* ps2) {
+    if (sched_cycles_until_next(ps2->sched) <= 4)
+        ps2_iop_sync(ps2);
+}
+
+// The IOP runs one instruction every 7 EE cycles
+static inline void ps2_iop_tick(struct ps2_state* ps2) {
+    if (--ps2->ee_cycles)
+        return;
+
+    ps2->ee_cycles = 7;
+
+    if (++ps2->iop_pending >= ps2->iop_batch)
+        ps2_iop_sync(ps2);
+}
+
+// Sends the packets kicked by VU1 since the last cycle to the GIF,
+// they stay in the ring while another path is mid-packet
+static inline void ps2_vu1_sync(struct ps2_state* ps2) {
+    struct vu_thread* t = ps2->vu1_thread;
+
+    if (!t || (t->path1_head == __atomic_load_n(&t->path1_tail, __ATOMIC_RELAXED)))
+        return;
+
+    if (ps2_gif_path_ready(ps2->gif, GIF_PATH1))
+        vu_thread_flush_path1(t);
+}
+
 void ps2_cycle(struct ps2_state* ps2) {
     // if (ps2->ee->pc == 0xe0040)
     //     printf("ee: Entry @ cyc=%ld\n", ps2->ee->total_cycles);
 
     // ps2_trace(ps2);
 
-    // Waitloop detection
-    // if (ps2->ee->pc == 0x81fc0) {
-    //     while (!sched_tick(ps2->sched, 4)) {
-    //         --ps2->ee_cycles;
+    // Single steps and breakpoints go through here, always use the
+    // interpreter so they stop on every instruction. It shares its
+    // state with the recompiler, which only runs from ps2_ee_run
+    ps2_vu1_sync(ps2);
+    ps2_iop_sync_deadline(ps2);
+    sched_tick(ps2->sched, 4);
+    ee_cycle(ps2->ee);
+    ps2_iop_tick(ps2);
+}
 
-    //         if (!ps2->ee_cycles) {
-    //             iop_cycle(ps2->iop);
-    //             ps2_iop_timers_tick(ps2->iop_timers);
-        
-    //             ps2->ee_cycles = 7;
-    //         }
-    //     }
+// Longest stretch the EE can run for before the next scheduler event
+// is due, capped so the IOP never falls more than a batch behind
+static inline int ps2_slice_cycles(struct ps2_state* ps2, int cycles) {
+    int64_t slice = (sched_cycles_until_next(ps2->sched) + 3) / 4;
 
-    //     ee_cycle(ps2->ee);
+    if (slice > cycles)
+        slice = cycles;
 
-    //     return;
-    // }
+    if (!ps2->idle && (slice > ps2->iop_batch * 7))
+        slice = ps2->iop_batch * 7;
 
-    sched_tick(ps2->sched, 4);
-    ee_cycle(ps2->ee);
-    ps2_ee_timers_tick(ps2->ee_timers);
+    return (slice < 1) ? 1 : (int)slice;
+}
 
-    --ps2->ee_cycles;
+// Short backward jumps are checked for idle loops, anything else
+// only costs a compare
+static inline int ps2_ee_idle(struct ps2_state* ps2) {
+    struct ee_state* ee = ps2->ee;
 
-    if (!ps2->ee_cycles) {
-        iop_cycle(ps2->iop);
+    if ((ee->pc > ee->prev_pc) || ((ee->prev_pc - ee->pc) >= (IDLE_LOOP_MAX_LENGTH << 2)))
+        return 0;
 
-        ps2_iop_timers_tick(ps2->iop_timers);
+    return ee_check_idle_loop(ee);
+}
+
+// Runs the EE for a slice, scheduler time is kept up to date so
+// events scheduled from within the slice are timed correctly
+static inline int ps2_ee_run(struct ps2_state* ps2, int cycles) {
+    struct sched_state* sched = ps2->sched;
+    uint64_t seq = sched->seq;
+    int ran = 0;
+
+    // Stop as soon as something gets scheduled, it might be due
+    // before the end of the slice
+    while ((ran < cycles) && (sched->seq == seq)) {
+        int n = 1;
+
+        if (ps2->ee_jit) {
+            n = ee_jit_run(ps2->ee_jit);
+        } else {
+            ee_cycle(ps2->ee);
+        }
 
-        ps2->ee_cycles = 7;
+        sched->now += 4 * n;
+        ran += n;
+
+        // Nothing can change until the next event, skip the rest
+        // of the slice
+        if ((ran < cycles) && (sched->seq == seq) && ps2_ee_idle(ps2)) {
+            int skip = cycles - ran;
+
+            ps2->ee->total_cycles += skip;
+            ps2->ee->count += skip;
+            ps2->ee_idle_cycles += skip;
+
+            sched->now += 4 * skip;
+
+            return cycles;
+        }
     }
+
+    return ran;
+}
+
+// Gives the IOP its share of the EE cycles that were just run
+static inline void ps2_iop_advance(struct ps2_state* ps2, int cycles) {
+    if (cycles < ps2->ee_cycles) {
+        ps2->ee_cycles -= cycles;
+
+        return;
+    }
+
+    cycles -= ps2->ee_cycles;
+
+    ps2->iop_pending += 1 + (cycles / 7);
+    ps2->ee_cycles = 7 - (cycles % 7);
+
+    ps2_iop_sync(ps2);
+}
+
+// Runs the whole system for at least the given number of EE
+// cycles, returns the number of EE cycles that were actually run
+int ps2_run_cycles(struct ps2_state* ps2, int cycles) {
+    int total = 0;
+
+    while (total < cycles) {
+        uint64_t ee_idle = ps2->ee_idle_cycles;
+        uint64_t iop_idle = ps2->iop_idle_cycles;
+
+        int ran = ps2_ee_run(ps2, ps2_slice_cycles(ps2, cycles - total));
+
+        ps2_vu1_sync(ps2);
+        ps2_iop_advance(ps2, ran);
+
+        // Time has already been advanced, fire whatever is due
+        int fired = sched_tick(ps2->sched, 0);
+
+        ps2->idle = !fired &&
+            (ps2->ee_idle_cycles != ee_idle) &&
+            (ps2->iop_idle_cycles != iop_idle);
+
+        total += ran;
+    }
+
+    return total;
+}
+
+void ps2_run_frame(struct ps2_state* ps2) {
+    ps2_run_cycles(ps2, PS2_FRAME_CYCLES);
 }
 
 void ps2_iop_cycle(struct ps2_state* ps2) {
+    ps2_iop_sync(ps2);
+
     while (ps2->ee_cycles) {
         sched_tick(ps2->sched, 1);
         ee_cycle(ps2->ee);
-        ps2_ee_timers_tick(ps2->ee_timers);
 
         --ps2->ee_cycles;
     }
 
     iop_cycle(ps2->iop);
-    ps2_iop_timers_tick(ps2->iop_timers);
 
     ps2->ee_cycles = 7;
 }
@@ -291,6 +571,15 @@ void ps2_destroy(struct ps2_state* ps2) {
 
     ps2_cdvd_destroy(ps2->cdvd);
 
+    if (ps2->ee_jit)
+        ee_jit_destroy(ps2->ee_jit);
+
+    if (ps2->vu1_thread)
+        vu_thread_destroy(ps2->vu1_thread);
+
+    if (ps2->vu1_jit)
+        vu_jit_destroy(ps2->vu1_jit);
+
     sched_destroy(ps2->sched);
     ee_destroy(ps2->ee);
     vu_destroy(ps2->vu0);
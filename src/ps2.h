@@ -13,6 +13,9 @@ extern "C" {
 #include "ee/intc.h"
 #include "ee/timers.h"
 #include "ee/vu.h"
+#include "ee/ee_jit.h"
+#include "ee/vu_jit.h"
+#include "ee/vu_thread.h"
 #include "iop/bus.h"
 #include "iop/bus_decl.h"
 #include "iop/iop.h"
@@ -44,6 +47,11 @@ struct ps2_elf_function {
     uint32_t addr;
 };
 
+#define PS2_IOP_BATCH 32
+
+// EE cycles per NTSC frame, the scheduler runs at 4 ticks per EE cycle
+#define PS2_FRAME_CYCLES ((GS_FRAME_NTSC + GS_VBLANK_NTSC) / 4)
+
 struct ps2_state {
     // CPUs
     struct ee_state* ee;
@@ -84,8 +92,34 @@ struct ps2_state {
 
     struct sched_state* sched;
 
+    // EE recompiler, NULL when running on the interpreter
+    struct ee_jit* ee_jit;
+
+    // VU1 worker thread, NULL when VU1 runs synchronously
+    struct vu_thread* vu1_thread;
+
+    // VU1 microprogram recompiler, NULL when interpreting them
+    struct vu_jit* vu1_jit;
+
+    // GIF/VIF1 DMA is sliced through the scheduler, instant otherwise
+    int dma_timed;
+
     int ee_cycles;
 
+    // IOP instructions owed to the EE, they get run in batches of
+    // up to iop_batch instructions or before the next scheduler
+    // event fires. A batch size of 1 keeps both CPUs in lockstep
+    int iop_pending;
+    int iop_batch;
+
+    // Cycles skipped by idle loop detection (EE and IOP cycles)
+    uint64_t ee_idle_cycles;
+    uint64_t iop_idle_cycles;
+
+    // Set when both CPUs spent the last slice in idle loops and no
+    // events fired, the next slice can run up to the next event
+    int idle;
+
     // Debug
     struct ps2_elf_function* func;
     unsigned int nfuncs;
@@ -100,7 +134,14 @@ void ps2_reset(struct ps2_state* ps2);
 void ps2_load_bios(struct ps2_state* ps2, const char* path);
 void ps2_load_rom1(struct ps2_state* ps2, const char* path);
 void ps2_load_rom2(struct ps2_state* ps2, const char* path);
+void ps2_flush_ee_code(struct ps2_state* ps2);
+void ps2_set_ee_jit(struct ps2_state* ps2, int enabled);
+void ps2_set_vu1_thread(struct ps2_state* ps2, int enabled);
+void ps2_set_vu1_jit(struct ps2_state* ps2, int enabled);
+void ps2_set_dma_timed(struct ps2_state* ps2, int enabled);
 void ps2_cycle(struct ps2_state* ps2);
+int ps2_run_cycles(struct ps2_state* ps2, int cycles);
+void ps2_run_frame(struct ps2_state* ps2);
 void ps2_iop_cycle(struct ps2_state* ps2);
 void ps2_destroy(struct ps2_state* ps2);
 
@@ -63,6 +63,9 @@ int ps2_elf_load(struct ps2_state* ps2, const char* path) {
 
     printf("Entry: 0x%08x\n", ehdr.e_entry);
 
+    // Segments were copied straight into RAM
+    ps2_flush_ee_code(ps2);
+
     // Read symbol table header
     Elf32_Shdr symtab;
 
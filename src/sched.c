@@ -6,114 +6,228 @@
 
 #include "sched.h"
 
+#define SCHED_INITIAL_CAP 32
+
 struct sched_state* sched_create(void) {
     return malloc(sizeof(struct sched_state));
 }
 
 void sched_init(struct sched_state* sched) {
     memset(sched, 0, sizeof(struct sched_state));
+}
 
-    if (sched->events)
-        free(sched->events);
+static inline int sched_before(const struct sched_entry* a, const struct sched_entry* b) {
+    if (a->timestamp != b->timestamp)
+        return a->timestamp < b->timestamp;
 
-    sched->nevents = 0;
-    sched->cap = 0;
-    sched->events = NULL;
-    sched->offset = 0;
+    // Events due on the same cycle fire in scheduling order
+    return a->seq < b->seq;
 }
 
-int event_compare(const void* a, const void* b) {
-    return ((struct sched_event*)a)->cycles - ((struct sched_event*)b)->cycles;
+static inline void sched_place(struct sched_state* sched, int i, struct sched_entry* e) {
+    sched->events[i] = *e;
+    sched->slots[e->slot].index = i;
 }
 
-void sched_schedule(struct sched_state* sched, struct sched_event event) {
-    if (!sched->nevents) {
-        sched->events = realloc(sched->events, sizeof(struct sched_event) * 32);
+static void sched_sift_up(struct sched_state* sched, int i) {
+    struct sched_entry e = sched->events[i];
 
-        if (!sched->events) {
-            printf("sched: Failed to allocate new event\n");
+    while (i) {
+        int parent = (i - 1) >> 1;
 
-            exit(1);
-        }
+        if (!sched_before(&e, &sched->events[parent]))
+            break;
 
-        sched->cap = 32;
-        sched->nevents = 1;
+        sched_place(sched, i, &sched->events[parent]);
 
-        sched->events[0] = event;
-    } else if (sched->nevents == 1) {
-        if (sched->events[0].cycles > event.cycles) {
-            sched->events[1] = sched->events[0];
-            sched->events[0] = event;
-        } else {
-            sched->events[1] = event;
-        }
+        i = parent;
+    }
 
-        // Clear offset, if there were more events in the
-        // queue, then we should subtract the offset from all of
-        // those.
-        sched->offset = 0;
+    sched_place(sched, i, &e);
+}
 
-        sched->nevents = 2;
-    } else {
-        if (sched->nevents == sched->cap) {
-            sched->cap <<= 1;
-            sched->events = realloc(sched->events, sizeof(struct sched_event) * sched->cap);
-        }
+static void sched_sift_down(struct sched_state* sched, int i) {
+    struct sched_entry e = sched->events[i];
 
-        // Need to sync events
-        // Don't apply offset to the current nearest event (offset is applied by ticking)
-        for (int i = 1; i < sched->nevents; i++) {
-            sched->events[i].cycles -= sched->offset;
-        }
+    while (1) {
+        int child = (i << 1) + 1;
 
-        sched->offset = 0;
+        if (child >= sched->nevents)
+            break;
 
-        for (int i = 0; i < sched->nevents; i++) {
-            sched->events[sched->nevents - i] = sched->events[sched->nevents - i - 1];
-        }
+        if ((child + 1 < sched->nevents) && sched_before(&sched->events[child + 1], &sched->events[child]))
+            ++child;
 
-        ++sched->nevents;
+        if (!sched_before(&sched->events[child], &e))
+            break;
 
-        sched->events[0] = event;
+        sched_place(sched, i, &sched->events[child]);
 
-        if (sched->events[0].cycles > sched->events[1].cycles) {
-            qsort(sched->events, sched->nevents, sizeof(struct sched_event), event_compare);
-        }
+        i = child;
     }
+
+    sched_place(sched, i, &e);
 }
 
-int sched_tick(struct sched_state* sched, int cycles) {
-    if (!sched->nevents)
+// Removes the entry at heap position i and releases its slot
+static void sched_remove(struct sched_state* sched, int i) {
+    struct sched_slot* slot = &sched->slots[sched->events[i].slot];
+
+    slot->index = -1;
+
+    // Generation 0 is skipped so 0 is never a valid handle
+    if (!++slot->gen)
+        slot->gen = 1;
+
+    sched->free_slots[sched->nfree++] = sched->events[i].slot;
+
+    if (i == --sched->nevents)
+        return;
+
+    sched_place(sched, i, &sched->events[sched->nevents]);
+
+    if (i && sched_before(&sched->events[i], &sched->events[(i - 1) >> 1])) {
+        sched_sift_up(sched, i);
+    } else {
+        sched_sift_down(sched, i);
+    }
+}
+
+static void sched_grow(struct sched_state* sched) {
+    int cap = sched->cap ? (sched->cap << 1) : SCHED_INITIAL_CAP;
+
+    sched->events = realloc(sched->events, sizeof(struct sched_entry) * cap);
+    sched->slots = realloc(sched->slots, sizeof(struct sched_slot) * cap);
+    sched->free_slots = realloc(sched->free_slots, sizeof(uint32_t) * cap);
+
+    if (!sched->events || !sched->slots || !sched->free_slots) {
+        printf("sched: Failed to allocate new event\n");
+
+        exit(1);
+    }
+
+    // New slots are handed out lowest first
+    for (int i = cap - 1; i >= sched->cap; i--) {
+        sched->slots[i].gen = 1;
+        sched->slots[i].index = -1;
+        sched->free_slots[sched->nfree++] = i;
+    }
+
+    sched->cap = cap;
+}
+
+static inline struct sched_slot* sched_lookup(struct sched_state* sched, sched_handle handle) {
+    uint32_t slot = handle & 0xffffffff;
+
+    if (slot >= (uint32_t)sched->cap)
+        return NULL;
+
+    if (sched->slots[slot].gen != (handle >> 32))
+        return NULL;
+
+    if (sched->slots[slot].index < 0)
+        return NULL;
+
+    return &sched->slots[slot];
+}
+
+sched_handle sched_schedule(struct sched_state* sched, struct sched_event event) {
+    if (sched->nevents == sched->cap)
+        sched_grow(sched);
+
+    uint32_t slot = sched->free_slots[--sched->nfree];
+
+    struct sched_entry* e = &sched->events[sched->nevents++];
+
+    e->timestamp = sched->now + ((event.cycles > 0) ? event.cycles : 0);
+    e->seq = sched->seq++;
+    e->slot = slot;
+    e->event = event;
+
+    sched->slots[slot].index = sched->nevents - 1;
+
+    sched_sift_up(sched, sched->nevents - 1);
+
+    return ((sched_handle)sched->slots[slot].gen << 32) | slot;
+}
+
+// Returns 0 if the event already fired or was cancelled
+int sched_cancel(struct sched_state* sched, sched_handle handle) {
+    struct sched_slot* slot = sched_lookup(sched, handle);
+
+    if (!slot)
         return 0;
 
-    sched->events[0].cycles -= cycles;
-    sched->offset += cycles;
+    sched_remove(sched, slot->index);
 
-    if (sched->events[0].cycles > 0)
+    return 1;
+}
+
+// Moves a pending event to fire the given number of cycles from now
+int sched_reschedule(struct sched_state* sched, sched_handle handle, long cycles) {
+    struct sched_slot* slot = sched_lookup(sched, handle);
+
+    if (!slot)
         return 0;
 
-    --sched->nevents;
+    int i = slot->index;
+    uint64_t timestamp = sched->now + ((cycles > 0) ? cycles : 0);
+    uint64_t prev = sched->events[i].timestamp;
 
-    struct sched_event event = sched->events[0];
+    sched->events[i].timestamp = timestamp;
+    sched->events[i].seq = sched->seq++;
 
-    for (int i = 0; i < sched->nevents; i++) {
-        sched->events[i] = sched->events[i + 1];
-        sched->events[i].cycles -= sched->offset;
+    if (timestamp < prev) {
+        sched_sift_up(sched, i);
+    } else {
+        sched_sift_down(sched, i);
     }
 
-    // Provide callback with overshot cycles
-    event.callback(event.udata, event.cycles);
+    return 1;
+}
 
-    sched->offset = 0;
+int sched_is_pending(struct sched_state* sched, sched_handle handle) {
+    return sched_lookup(sched, handle) != NULL;
+}
 
-    return 1;
+// Fires every event that's due, returns the number of events fired
+int sched_tick(struct sched_state* sched, int cycles) {
+    int fired = 0;
+
+    sched->now += cycles;
+
+    while (sched->nevents && (sched->events[0].timestamp <= sched->now)) {
+        struct sched_entry e = sched->events[0];
+
+        // Callbacks are free to schedule more events
+        sched_remove(sched, 0);
+
+        // Provide callback with overshot cycles
+        e.event.callback(e.event.udata, (int)(e.timestamp - sched->now));
+
+        ++fired;
+    }
+
+    return fired;
+}
+
+int64_t sched_cycles_until_next(struct sched_state* sched) {
+    if (!sched->nevents)
+        return SCHED_NO_EVENT;
+
+    return (int64_t)(sched->events[0].timestamp - sched->now);
 }
 
 const struct sched_event* sched_next_event(struct sched_state* sched) {
-    return &sched->events[0];
+    if (!sched->nevents)
+        return NULL;
+
+    return &sched->events[0].event;
 }
 
 void sched_destroy(struct sched_state* sched) {
     free(sched->events);
+    free(sched->slots);
+    free(sched->free_slots);
     free(sched);
-}
\ No newline at end of file
+}
@@ -7,24 +7,60 @@ extern "C" {
 
 #include <stdint.h>
 
+// Returned by sched_cycles_until_next when nothing is scheduled
+#define SCHED_NO_EVENT INT64_MAX
+
 struct sched_event {
+    // Delay from the time the event is scheduled
     long cycles;
     void (*callback)(void*, int);
     const char* name;
     void* udata;
 };
 
+// Identifies a scheduled event, stays unique after the event fires
+// or gets cancelled so stale handles are harmless. 0 is never valid
+typedef uint64_t sched_handle;
+
+struct sched_entry {
+    uint64_t timestamp;
+    uint64_t seq;
+    uint32_t slot;
+    struct sched_event event;
+};
+
+struct sched_slot {
+    uint32_t gen;
+
+    // Position in the heap, -1 when the slot is free
+    int index;
+};
+
 struct sched_state {
-    struct sched_event* events;
+    // Binary min-heap ordered by (timestamp, seq)
+    struct sched_entry* events;
     int nevents;
     int cap;
-    uint64_t offset;
+
+    struct sched_slot* slots;
+    uint32_t* free_slots;
+    int nfree;
+
+    // Absolute time in cycles
+    uint64_t now;
+
+    // Bumped every time an event is scheduled or rescheduled
+    uint64_t seq;
 };
 
 struct sched_state* sched_create(void);
 void sched_init(struct sched_state* sched);
-void sched_schedule(struct sched_state* sched, struct sched_event event);
+sched_handle sched_schedule(struct sched_state* sched, struct sched_event event);
+int sched_cancel(struct sched_state* sched, sched_handle handle);
+int sched_reschedule(struct sched_state* sched, sched_handle handle, long cycles);
+int sched_is_pending(struct sched_state* sched, sched_handle handle);
 int sched_tick(struct sched_state* sched, int cycles);
+int64_t sched_cycles_until_next(struct sched_state* sched);
 const struct sched_event* sched_next_event(struct sched_state* sched);
 void sched_destroy(struct sched_state* sched);
 
@@ -32,4 +68,4 @@ void sched_destroy(struct sched_state* sched);
 }
 #endif
 
-#endif
\ No newline at end of file
+#endif
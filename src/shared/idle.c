@@ -0,0 +1,202 @@
+#include <string.h>
+
+#include "idle.h"
+
+#define RS(op) (1u << (((op) >> 21) & 0x1f))
+#define RT(op) (1u << (((op) >> 16) & 0x1f))
+#define RD(op) (1u << (((op) >> 11) & 0x1f))
+
+void idle_loop_reset(struct idle_loop* l) {
+    memset(l, 0, sizeof(struct idle_loop));
+
+    l->start = 0xffffffff;
+}
+
+// Register usage of the instructions allowed inside an idle loop,
+// anything that stores, traps or touches other state is rejected
+static int idle_decode(uint32_t op, int ee, uint32_t* reads, uint32_t* writes, int* load) {
+    *load = 0;
+
+    switch (op >> 26) {
+        case 0x00: {
+            switch (op & 0x3f) {
+                // SLL, SRL, SRA
+                case 0x00: case 0x02: case 0x03: {
+                    *reads = RT(op); *writes = RD(op);
+                } return 1;
+
+                // SLLV, SRLV, SRAV, ADDU, SUBU, AND, OR, XOR, NOR, SLT, SLTU
+                case 0x04: case 0x06: case 0x07: case 0x21: case 0x23:
+                case 0x24: case 0x25: case 0x26: case 0x27: case 0x2a:
+                case 0x2b: {
+                    *reads = RS(op) | RT(op); *writes = RD(op);
+                } return 1;
+
+                // SYNC
+                case 0x0f: {
+                    *reads = 0; *writes = 0;
+                } return ee;
+
+                // DADDU, DSUBU
+                case 0x2d: case 0x2f: {
+                    *reads = RS(op) | RT(op); *writes = RD(op);
+                } return ee;
+
+                // DSLL, DSRL, DSRA, DSLL32, DSRL32, DSRA32
+                case 0x38: case 0x3a: case 0x3b: case 0x3c: case 0x3e:
+                case 0x3f: {
+                    *reads = RT(op); *writes = RD(op);
+                } return ee;
+            }
+        } return 0;
+
+        // ADDIU, SLTI, SLTIU, ANDI, ORI, XORI
+        case 0x09: case 0x0a: case 0x0b: case 0x0c: case 0x0d: case 0x0e: {
+            *reads = RS(op); *writes = RT(op);
+        } return 1;
+
+        // LUI
+        case 0x0f: {
+            *reads = 0; *writes = RT(op);
+        } return 1;
+
+        // DADDIU
+        case 0x19: {
+            *reads = RS(op); *writes = RT(op);
+        } return ee;
+
+        // LB, LH, LW, LBU, LHU
+        case 0x20: case 0x21: case 0x23: case 0x24: case 0x25: {
+            *reads = RS(op); *writes = RT(op); *load = 1;
+        } return 1;
+
+        // LWU, LD
+        case 0x27: case 0x37: {
+            *reads = RS(op); *writes = RT(op); *load = 1;
+        } return ee;
+    }
+
+    return 0;
+}
+
+// Conditional branches, branch likely only exists on the EE
+static int idle_decode_branch(uint32_t op, int ee, uint32_t* reads) {
+    switch (op >> 26) {
+        case 0x01: {
+            switch ((op >> 16) & 0x1f) {
+                case 0x00: case 0x01: *reads = RS(op); return 1;
+                case 0x02: case 0x03: *reads = RS(op); return ee;
+            }
+        } return 0;
+
+        case 0x04: case 0x05: *reads = RS(op) | RT(op); return 1;
+        case 0x06: case 0x07: *reads = RS(op); return 1;
+        case 0x14: case 0x15: *reads = RS(op) | RT(op); return ee;
+        case 0x16: case 0x17: *reads = RS(op); return ee;
+    }
+
+    return 0;
+}
+
+// code holds the loop from its first instruction up to the delay
+// slot of the backward branch
+int idle_loop_analyze(const uint32_t* code, int count, uint32_t start, int ee) {
+    uint32_t reads[IDLE_LOOP_MAX_LENGTH];
+    uint32_t writes[IDLE_LOOP_MAX_LENGTH];
+    int load[IDLE_LOOP_MAX_LENGTH];
+    int b = count - 2;
+
+    if ((count < 2) || (count > IDLE_LOOP_MAX_LENGTH))
+        return 0;
+
+    // The branch has to jump back to the start of the loop
+    uint32_t target = start + (b << 2) + 4 + ((int32_t)(code[b] << 16) >> 14);
+
+    if ((target != start) || !idle_decode_branch(code[b], ee, &reads[b]))
+        return 0;
+
+    writes[b] = 0;
+    load[b] = 0;
+
+    uint32_t written = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (i == b)
+            continue;
+
+        if (!idle_decode(code[i], ee, &reads[i], &writes[i], &load[i]))
+            return 0;
+
+        written |= writes[i];
+    }
+
+    written &= ~1u;
+
+    // Registers read before they're written in the same iteration
+    // carry state over from the previous one (i.e. a counter)
+    uint32_t defined = 0;
+    uint32_t delayed = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (reads[i] & written & ~defined)
+            return 0;
+
+        defined |= delayed;
+        delayed = 0;
+
+        // IOP loads have a delay slot, the next instruction
+        // still sees the old value
+        if (load[i] && !ee) {
+            delayed = writes[i];
+        } else {
+            defined |= writes[i];
+        }
+    }
+
+    return 1;
+}
+
+// Called after a short backward jump from end to start, returns 1
+// once the CPU has been spinning in the same idle loop for a while
+int idle_loop_check(struct idle_loop* l, uint32_t start, uint32_t end, int ee, idle_read_func read, void* udata) {
+    int count = ((end - start) >> 2) + 1;
+
+    // Skipping ahead would make the polled value jump
+    if (l->polled) {
+        l->polled = 0;
+        l->hits = 0;
+
+        return 0;
+    }
+
+    if ((start != l->start) || (end != l->end)) {
+        l->start = start;
+        l->end = end;
+        l->hits = 0;
+        l->idle = 0;
+
+        if (count > IDLE_LOOP_MAX_LENGTH)
+            return 0;
+
+        for (int i = 0; i < count; i++)
+            l->code[i] = read(udata, start + (i << 2));
+
+        l->idle = idle_loop_analyze(l->code, count, start, ee);
+
+        return 0;
+    }
+
+    if (!l->idle || (++l->hits < IDLE_LOOP_MIN_HITS))
+        return 0;
+
+    // Make sure the loop didn't get overwritten in the meantime
+    for (int i = 0; i < count; i++) {
+        if (read(udata, start + (i << 2)) != l->code[i]) {
+            l->start = 0xffffffff;
+
+            return 0;
+        }
+    }
+
+    return 1;
+}
@@ -0,0 +1,41 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// Longest loop considered for idle detection, in instructions
+#define IDLE_LOOP_MAX_LENGTH 8
+
+// Iterations a loop has to spin for before it gets skipped
+#define IDLE_LOOP_MIN_HITS 2
+
+// Last short backward branch seen by a CPU. Idle loops are polling
+// loops with no stores and no state carried between iterations, so
+// only an external event can make them exit
+struct idle_loop {
+    uint32_t start;
+    uint32_t end;
+    uint32_t code[IDLE_LOOP_MAX_LENGTH];
+    int idle;
+    int hits;
+
+    // Set by devices whose registers change without a scheduler
+    // event (i.e. timer counters) when they get read
+    int polled;
+};
+
+typedef uint32_t (*idle_read_func)(void* udata, uint32_t addr);
+
+void idle_loop_reset(struct idle_loop* l);
+int idle_loop_analyze(const uint32_t* code, int count, uint32_t start, int ee);
+int idle_loop_check(struct idle_loop* l, uint32_t start, uint32_t end, int ee, idle_read_func read, void* udata);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif